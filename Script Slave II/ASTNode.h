@@ -6,6 +6,7 @@
 
 #include "Token.h"
 #include "BaseVisitor.h"
+#include "AllocationCounter.h"
 
 
 class TypeInfo;
@@ -58,7 +59,8 @@ enum class NodeType{
 	StmtEmpty,
 	StartBlock,
 	IdentList,
-	Name
+	Name,
+	StmtError
 };
 
 #define CASE_RETURN(x) case NodeType::x: return #x;
@@ -99,6 +101,7 @@ static const char* NodeTypeAsString( NodeType op ){
 		CASE_RETURN(Param);
 		CASE_RETURN(ParamList);
 		CASE_RETURN(Name);
+		CASE_RETURN(StmtError);
 	default: return "Error";
 	}
 }
@@ -156,6 +159,18 @@ public:
 
 	virtual ~ASTNode(){}
 
+#ifdef TRACK_ALLOCATIONS
+	//Counts the nodes themselves as node allocations, their members count towards the surrounding scope.
+	static void* operator new(size_t size){
+		AllocationCounter::Scope scope(AllocationCategory::Nodes);
+		return ::operator new(size);
+	}
+
+	static void operator delete(void* p){
+		::operator delete(p);
+	}
+#endif
+
 protected:
 	NodeType m_nodeType;
 	Token m_token;
@@ -283,10 +298,11 @@ public:
 	DEFAULT_ACCEPT;
 	GET_MEMBER( std::string, Name );
 	GETSET_MEMBER(Symbol const*, Symbol);
+	GETSET_MEMBER(int, FieldOffset);	//Of the member of a MemberAccess in its object, see ClassLayout. -1 otherwise.
 
 	virtual std::string GetNodeAsString() { return m_Name; }
 
-	Ident( std::string Name ) : Expr( NodeType::Ident ), m_Name( Name ), m_Symbol(nullptr) {}
+	Ident( std::string Name ) : Expr( NodeType::Ident ), m_Name( Name ), m_Symbol(nullptr), m_FieldOffset(-1) {}
 };
 DEFAULT_TYPEDEF( Ident );
 
@@ -403,6 +419,14 @@ public:
 };
 DEFAULT_TYPEDEF( StmtBreak );
 
+//Stands in for a statement with a syntax error, so the rest of the function can still be checked.
+class StmtError : public Stmt{
+public:
+	DEFAULT_ACCEPT;
+	DEFAULT_CONSTRUCT( StmtError, Stmt );
+};
+DEFAULT_TYPEDEF( StmtError );
+
 class StmtWhile : public Stmt{
 public:
 	DEFAULT_ACCEPT;
@@ -0,0 +1,111 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+namespace{
+
+	const int NUM_CATEGORIES = (int) AllocationCategory::Count;
+
+	std::atomic<unsigned long long> g_numAllocations[NUM_CATEGORIES];
+	std::atomic<unsigned long long> g_allocatedBytes[NUM_CATEGORIES];
+	std::atomic<unsigned long long> g_numDeallocations(0);
+
+	THREAD_LOCAL AllocationCategory t_category = AllocationCategory::Other;
+
+#ifdef TRACK_ALLOCATIONS
+	void* Allocate(size_t size){
+		int category = (int) t_category;
+		++g_numAllocations[category];
+		g_allocatedBytes[category] += size;
+
+		void* p = malloc(size != 0 ? size : 1);
+		if (p == nullptr)
+			throw std::bad_alloc();
+		return p;
+	}
+
+	void Deallocate(void* p){
+		if (p == nullptr)
+			return;
+
+		++g_numDeallocations;
+		free(p);
+	}
+#endif
+}
+
+bool AllocationCounter::IsEnabled(){
+#ifdef TRACK_ALLOCATIONS
+	return true;
+#else
+	return false;
+#endif
+}
+
+unsigned long long AllocationCounter::GetNumAllocations(){
+	unsigned long long sum = 0;
+	for (int i = 0; i < NUM_CATEGORIES; ++i)
+		sum += g_numAllocations[i];
+	return sum;
+}
+
+unsigned long long AllocationCounter::GetAllocatedBytes(){
+	unsigned long long sum = 0;
+	for (int i = 0; i < NUM_CATEGORIES; ++i)
+		sum += g_allocatedBytes[i];
+	return sum;
+}
+
+unsigned long long AllocationCounter::GetNumDeallocations(){
+	return g_numDeallocations;
+}
+
+unsigned long long AllocationCounter::GetNumAllocations(AllocationCategory category){
+	return g_numAllocations[(int) category];
+}
+
+unsigned long long AllocationCounter::GetAllocatedBytes(AllocationCategory category){
+	return g_allocatedBytes[(int) category];
+}
+
+const char* AllocationCounter::GetCategoryName(AllocationCategory category){
+	switch (category){
+	case AllocationCategory::Tokens:	return "tokens";
+	case AllocationCategory::Nodes:		return "nodes";
+	case AllocationCategory::Strings:	return "strings";
+	case AllocationCategory::Maps:		return "maps";
+	default:							return "other";
+	}
+}
+
+AllocationCategory AllocationCounter::SetCategory(AllocationCategory category){
+	AllocationCategory previous = t_category;
+	t_category = category;
+	return previous;
+}
+
+#ifdef TRACK_ALLOCATIONS
+void* operator new(size_t size){
+	return Allocate(size);
+}
+
+void* operator new[](size_t size){
+	return Allocate(size);
+}
+
+void operator delete(void* p) throw() {
+	Deallocate(p);
+}
+
+void operator delete[](void* p) throw() {
+	Deallocate(p);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+
+//Call sites whose allocations are counted separately. Allocations made outside of any AllocationCounter::Scope
+//count as Other.
+enum class AllocationCategory{
+	Other,
+	Tokens,
+	Nodes,
+	Strings,
+	Maps,
+	Count
+};
+
+//Totals of all allocations made through operator new since the start of the process. AllocationCounter.cpp replaces
+//the global operator new and delete to count them if TRACK_ALLOCATIONS is defined (the project's TrackAllocations
+//property), otherwise all counts stay 0 and scopes cost nothing.
+class AllocationCounter{
+public:
+
+	//Attributes the allocations of the current thread to a category until it is destroyed. Scopes nest, the innermost
+	//one wins.
+	class Scope{
+	public:
+#ifdef TRACK_ALLOCATIONS
+		explicit Scope(AllocationCategory category)
+			: m_previous(SetCategory(category))
+		{}
+
+		~Scope(){
+			SetCategory(m_previous);
+		}
+#else
+		explicit Scope(AllocationCategory category){}
+#endif
+
+	private:
+		Scope(const Scope&);
+		Scope& operator=(const Scope&);
+
+#ifdef TRACK_ALLOCATIONS
+		AllocationCategory m_previous;
+#endif
+	};
+
+	static bool IsEnabled();
+
+	static unsigned long long GetNumAllocations();
+	static unsigned long long GetAllocatedBytes();
+	static unsigned long long GetNumDeallocations();
+
+	static unsigned long long GetNumAllocations(AllocationCategory category);
+	static unsigned long long GetAllocatedBytes(AllocationCategory category);
+
+	static const char* GetCategoryName(AllocationCategory category);
+
+	//Returns the previous category of the current thread.
+	static AllocationCategory SetCategory(AllocationCategory category);
+};
\ No newline at end of file
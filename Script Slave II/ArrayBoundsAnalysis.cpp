@@ -0,0 +1,183 @@
+#include "ArrayBoundsAnalysis.h"
+#include "SymbolScope.h"
+
+#include <algorithm>
+
+namespace{
+
+	//Declaration of the local variable or parameter p reads, nullptr for any other expression.
+	ASTNode const* GetLocal(Expr const* p){
+		if (p->GetNodeType() != NodeType::Ident)
+			return nullptr;
+
+		Symbol const* sym = ((Ident const*) p)->GetSymbol();
+		if (sym == nullptr || (sym->type != Symbol::VARIABLE && sym->type != Symbol::PARAMETER))
+			return nullptr;
+		return sym->GetNode();
+	}
+
+	bool IsNonNegativeLiteral(Expr const* p){
+		return p->GetNodeType() == NodeType::IntLit && ((IntLit const*) p)->GetValue() >= 0;
+	}
+
+	//Counts the statements in a subtree which write one variable.
+	class WriteCounter : public BaseVisitor{
+	public:
+		int numWrites = 0;
+
+		WriteCounter(ASTNode const* decl) : m_decl(decl) {}
+
+		virtual bool inNode(StmtVarDecl* n, bool last) override {
+			if (n == m_decl)
+				++numWrites;
+			return false;
+		}
+
+		virtual bool inNode(StmtAssign* n, bool last) override {
+			if (GetLocal(n->GetLHS()) == m_decl)
+				++numWrites;
+			return false;
+		}
+
+	private:
+		ASTNode const* m_decl;
+	};
+
+	int CountWrites(ASTNode* n, ASTNode const* decl){
+		WriteCounter counter(decl);
+		n->accept(&counter, true);
+		return counter.numWrites;
+	}
+
+	//Collects the subscripts a[i] of one array and index variable in a subtree.
+	class SubscriptCollector : public BaseVisitor{
+	public:
+		SubscriptCollector(ASTNode const* array, ASTNode const* index, std::unordered_set<BinOp const*>& subscripts)
+			: m_array(array), m_index(index), m_subscripts(subscripts)
+		{}
+
+		virtual bool inNode(BinOp* n, bool last) override {
+			if (n->GetType() == BinOp::Subscript && GetLocal(n->GetLeft()) == m_array && GetLocal(n->GetRight()) == m_index)
+				m_subscripts.insert(n);
+			return true;
+		}
+
+	private:
+		ASTNode const* m_array;
+		ASTNode const* m_index;
+		std::unordered_set<BinOp const*>& m_subscripts;
+	};
+
+	//True for i = i + 1 and i = 1 + i.
+	bool IsIncrement(Stmt const* stmt, ASTNode const* index){
+		if (stmt->GetNodeType() != NodeType::StmtAssign)
+			return false;
+
+		StmtAssign const* n = (StmtAssign const*) stmt;
+		if (GetLocal(n->GetLHS()) != index || n->GetExpr()->GetNodeType() != NodeType::BinOp)
+			return false;
+
+		BinOp const* sum = (BinOp const*) n->GetExpr();
+		if (sum->GetType() != BinOp::Add)
+			return false;
+
+		Expr const* step = GetLocal(sum->GetLeft()) == index ? sum->GetRight() : GetLocal(sum->GetRight()) == index ? sum->GetLeft() : nullptr;
+		return step != nullptr && step->GetNodeType() == NodeType::IntLit && ((IntLit const*) step)->GetValue() == 1;
+	}
+}
+
+void ArrayBoundsAnalysis::Process(FuncDef* n){
+	m_inBounds.clear();
+	n->GetStmtBlock()->accept(this, true);
+}
+
+bool ArrayBoundsAnalysis::inNode(StmtBlock* n, bool last){
+	const auto& stmts = n->GetChildren();
+	for (size_t i = 0; i < stmts.size(); ++i)
+		if (stmts[i]->GetNodeType() == NodeType::StmtWhile)
+			AnalyzeLoop((StmtWhile*) stmts[i].get(), stmts, i);
+	return true;
+}
+
+bool ArrayBoundsAnalysis::FindBoundCheck(Expr* cond, BoundCheck& check, std::vector<Expr*>& guarded){
+	if (cond->GetNodeType() != NodeType::BinOp)
+		return false;
+
+	BinOp* n = (BinOp*) cond;
+
+	if (n->GetType() == BinOp::And){
+		if (FindBoundCheck(n->GetLeft(), check, guarded)){
+			guarded.push_back(n->GetRight());
+			return true;
+		}
+		return FindBoundCheck(n->GetRight(), check, guarded);
+	}
+
+	Expr* index;
+	Expr* length;
+	if (n->GetType() == BinOp::LThan){
+		index = n->GetLeft();
+		length = n->GetRight();
+	}
+	else if (n->GetType() == BinOp::GThan){
+		index = n->GetRight();
+		length = n->GetLeft();
+	}
+	else
+		return false;
+
+	if (length->GetNodeType() != NodeType::BinOp || ((BinOp*) length)->GetType() != BinOp::MemberAccess)
+		return false;
+
+	BinOp* access = (BinOp*) length;
+	TypeInfo const* arrayType = access->GetLeft()->GetTypeInfo();
+	if (arrayType == nullptr || !arrayType->isArray || ((Ident*) access->GetRight())->GetName() != "length")
+		return false;
+
+	check.index = GetLocal(index);
+	check.array = GetLocal(access->GetLeft());
+	return check.index != nullptr && check.array != nullptr;
+}
+
+bool ArrayBoundsAnalysis::StartsNonNegative(const std::vector<StmtPtr>& stmts, size_t loop, ASTNode const* index){
+	for (size_t i = loop; i-- > 0;){
+		Stmt* stmt = stmts[i].get();
+
+		//Variables without an initializer start at 0
+		if (stmt == index)
+			return ((StmtVarDecl*) stmt)->GetExpr() == nullptr || IsNonNegativeLiteral(((StmtVarDecl*) stmt)->GetExpr());
+
+		if (stmt->GetNodeType() == NodeType::StmtAssign && GetLocal(((StmtAssign*) stmt)->GetLHS()) == index)
+			return IsNonNegativeLiteral(((StmtAssign*) stmt)->GetExpr());
+
+		if (CountWrites(stmt, index) > 0)
+			return false;
+	}
+
+	//Parameters can have any value
+	return false;
+}
+
+void ArrayBoundsAnalysis::AnalyzeLoop(StmtWhile* n, const std::vector<StmtPtr>& stmts, size_t loop){
+	BoundCheck check;
+	std::vector<Expr*> guarded;
+	if (!FindBoundCheck(n->GetExpr(), check, guarded) || !StartsNonNegative(stmts, loop, check.index))
+		return;
+
+	if (n->GetBody()->GetNodeType() != NodeType::StmtBlock)
+		return;
+
+	if (CountWrites(n->GetBody(), check.index) != 1 || CountWrites(n->GetBody(), check.array) != 0)
+		return;
+
+	const auto& body = ((StmtBlock*) n->GetBody())->GetChildren();
+	auto increment = std::find_if(body.begin(), body.end(), [&](const StmtPtr& stmt){ return IsIncrement(stmt.get(), check.index); });
+	if (increment == body.end())
+		return;
+
+	SubscriptCollector collector(check.array, check.index, m_inBounds);
+	for (Expr* p : guarded)
+		p->accept(&collector, true);
+	for (auto it = body.begin(); it != increment; ++it)
+		(*it)->accept(&collector, true);
+}
\ No newline at end of file
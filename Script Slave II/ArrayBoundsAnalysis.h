@@ -0,0 +1,58 @@
+#pragma once
+
+#include <unordered_set>
+#include <vector>
+#include "ASTNode.h"
+#include "BaseVisitor.h"
+
+/*
+	Range analysis of while loop induction variables on the type checked AST. A loop
+
+		i = 0;
+		while (i < a.length){
+			... a[i] ...
+			i = i + 1;
+		}
+
+	keeps i within [0, a.length) until the increment, so the subscripts a[i] before it can't fail:
+
+	- i and a are local variables or parameters, calls can't change them.
+	- The closest statement before the loop in the same block which writes i sets it to an int literal >= 0.
+	- The increment is a statement of the loop body itself and the only write of i in the loop. Only steps of 1 are
+	  accepted, i + 2 could overflow for arrays close to INT_MAX elements.
+	- a isn't written in the loop. The length of an array never changes, and a.length already failed if a is null.
+
+	The bound check may also be the left operand of a chain of &&, subscripts right of it are in bounds as well.
+*/
+class ArrayBoundsAnalysis : public BaseVisitor
+{
+public:
+
+	//Analyzes all loops of a function, forgetting the results of earlier calls.
+	void Process(FuncDef* n);
+
+	//True if the Subscript 'n' needs neither a null nor a bounds check.
+	bool IsInBounds(BinOp const* n) const {
+		return m_inBounds.count(n) > 0;
+	}
+
+	virtual bool inNode(StmtBlock* n, bool last) override;
+
+private:
+
+	struct BoundCheck{
+		ASTNode const* index;	//Declaration of i
+		ASTNode const* array;	//Declaration of a
+	};
+
+	//Finds i < a.length or a.length > i in a loop condition. 'guarded' receives the operands of && evaluated only
+	//after the check passed.
+	bool FindBoundCheck(Expr* cond, BoundCheck& check, std::vector<Expr*>& guarded);
+
+	//True if the statements before 'loop' in 'stmts' leave i >= 0.
+	bool StartsNonNegative(const std::vector<StmtPtr>& stmts, size_t loop, ASTNode const* index);
+
+	void AnalyzeLoop(StmtWhile* n, const std::vector<StmtPtr>& stmts, size_t loop);
+
+	std::unordered_set<BinOp const*> m_inBounds;
+};
\ No newline at end of file
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include "ASTNode.h"
+
+/*
+	Binary file format of a type checked AST, written by AstWriter and read by AstReader.
+
+	The file is a header followed by flat sections of fixed size records, in this order:
+
+		string offsets	numStrings + 1 uint32, string i is the bytes [offset[i], offset[i+1])
+		string bytes	all strings, interned, padded to a multiple of 4
+		types			AstTypeRecord, the TypeInfos referred to by Type and Expr nodes
+		tokens			AstTokenRecord, the token stream of the source, for error messages
+		nodes			AstNodeRecord in post-order, children always come before their parent
+		children		uint32 node indices, AST_NONE for missing optional children
+		scopes			AstScopeRecord in pre-order, scope 0 is the global scope
+		symbols			AstSymbolRecord
+
+	All indices refer to records of the respective section. Numbers are stored in the byte order of the machine which
+	wrote the file, files with a different byte order are rejected. AST_VERSION changes with every change of the
+	format or of the node types.
+*/
+
+#define AST_MAGIC "SSA\x1A"
+static const uint32_t AST_VERSION = 1;
+static const uint32_t AST_BYTE_ORDER = 0x01020304;
+static const uint32_t AST_NONE = 0xFFFFFFFF;
+
+struct AstHeader{
+	char magic[4];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t numStrings;
+	uint32_t stringBytes;		//Including the padding
+	uint32_t numTypes;
+	uint32_t numTokens;
+	uint32_t numNodes;
+	uint32_t numChildren;
+	uint32_t numScopes;
+	uint32_t numSymbols;
+	uint32_t root;				//Index of the StartBlock
+};
+
+struct AstTypeRecord{
+	uint32_t name;				//Without "[]"
+	uint32_t size;
+	uint32_t isArray;
+};
+
+struct AstTokenRecord{
+	uint32_t type;				//TokenType
+	uint32_t value;				//String literals without quotes
+	uint16_t line;
+	uint16_t pos;
+};
+
+struct AstNodeRecord{
+	uint16_t kind;				//NodeType
+	uint16_t op;				//BinOp::Types, UnOp::Types, BoolLit value, Type::IsArray
+	AstTokenRecord token;
+	uint32_t typeInfo;			//Of Type and Expr nodes, or AST_NONE
+	uint32_t symbol;			//Of Ident nodes, or AST_NONE
+	uint32_t payload;			//IntLit value, FloatLit bits, string of Ident, Type and StringLit
+	uint32_t firstChild;		//Children are [firstChild, firstChild + numChildren) of the children section
+	uint32_t numChildren;
+};
+
+struct AstScopeRecord{
+	uint32_t name;
+	uint32_t parent;			//AST_NONE for the global scope
+};
+
+struct AstSymbolRecord{
+	uint32_t name;
+	uint32_t scope;
+	uint32_t type;				//Symbol::SymbolType
+	uint32_t node;				//Declaration, AST_NONE if it isn't part of the AST
+	int32_t useCount;
+};
+
+//Node kinds which are derived from Expr, Stmt and GlobalStmt.
+inline bool IsAstExpr(NodeType kind){
+	switch (kind){
+	case NodeType::BinOp:
+	case NodeType::UnOp:
+	case NodeType::Ident:
+	case NodeType::IntLit:
+	case NodeType::FloatLit:
+	case NodeType::BoolLit:
+	case NodeType::StringLit:
+	case NodeType::FuncCallExpr:
+		return true;
+	default:
+		return false;
+	}
+}
+
+inline bool IsAstStmt(NodeType kind){
+	switch (kind){
+	case NodeType::StmtBreak:
+	case NodeType::StmtWhile:
+	case NodeType::StmtIfThen:
+	case NodeType::StmtIfThenElse:
+	case NodeType::StmtBlock:
+	case NodeType::StmtAssign:
+	case NodeType::StmtReturn:
+	case NodeType::StmtVarDecl:
+	case NodeType::StmtFuncCall:
+		return true;
+	default:
+		return false;
+	}
+}
+
+inline bool IsAstGlobalStmt(NodeType kind){
+	return kind == NodeType::FuncDef || kind == NodeType::GlobVarDef || kind == NodeType::ClassDef;
+}
\ No newline at end of file
@@ -0,0 +1,567 @@
+#include "AstReader.h"
+#include "ClassLayout.h"
+#include "MappedFile.h"
+#include "SymbolScope.h"
+#include "TypeTable.h"
+#include "Util.h"
+
+#include <cstring>
+
+namespace{
+
+	//Kind of declaration a symbol of the given type refers to.
+	NodeType GetDeclarationKind(Symbol::SymbolType type){
+		switch (type){
+		case Symbol::FUNCTION:		return NodeType::FuncDef;
+		case Symbol::VARIABLE:		return NodeType::StmtVarDecl;
+		case Symbol::PARAMETER:		return NodeType::Param;
+		case Symbol::GLOBAL_VAR:	return NodeType::GlobVarDef;
+		case Symbol::CLASS_VAR:		return NodeType::ClassVar;
+		case Symbol::RETURN_VALUE:	return NodeType::Type;
+		case Symbol::CLASS:			return NodeType::ClassDef;
+		default:					return NodeType::ASTNode;
+		}
+	}
+
+	//The symbols get their names from these Idents.
+	bool HasName(ASTNode const* decl){
+		switch (decl->GetNodeType()){
+		case NodeType::FuncDef:		return ((FuncDef const*) decl)->GetName() != nullptr;
+		case NodeType::StmtVarDecl:	return ((StmtVarDecl const*) decl)->GetName() != nullptr;
+		case NodeType::Param:		return ((Param const*) decl)->GetName() != nullptr;
+		case NodeType::GlobVarDef:	return ((GlobVarDef const*) decl)->GetName() != nullptr;
+		case NodeType::ClassVar:	return ((ClassVar const*) decl)->GetName() != nullptr;
+		case NodeType::ClassDef:	return ((ClassDef const*) decl)->GetName() != nullptr;
+		default:					return true;
+		}
+	}
+}
+
+bool AstReader::Read(const std::string& fileName, std::vector<Token>& tokens, StartBlockPtr& start, TypeTable& typeTable, SymbolScope& globalScope){
+	MappedFile file(fileName);
+	if (!file.IsValid())
+		return Fail("Could not read file " + fileName);
+
+	return Read(file.Data(), file.Size(), fileName, tokens, start, typeTable, globalScope);
+}
+
+bool AstReader::Read(const char* data, size_t size, const std::string& fileName, std::vector<Token>& tokens, StartBlockPtr& start, TypeTable& typeTable, SymbolScope& globalScope){
+	if (size < sizeof(AstHeader))
+		return Fail(fileName + " is not an AST file");
+
+	m_header = (const AstHeader*) data;
+	const AstHeader& h = *m_header;
+
+	if (memcmp(h.magic, AST_MAGIC, sizeof(h.magic)) != 0)
+		return Fail(fileName + " is not an AST file");
+	if (h.byteOrder != AST_BYTE_ORDER)
+		return Fail(fileName + " was written on a machine with a different byte order");
+	if (h.version != AST_VERSION)
+		return Fail(fileName + " was written by a different version of the compiler");
+
+	//64 bit sizes, so the record counts can't overflow the computation.
+	unsigned long long offsets = sizeof(AstHeader);
+	unsigned long long stringBytes = offsets + (h.numStrings + 1ull) * sizeof(uint32_t);
+	unsigned long long types = stringBytes + h.stringBytes;
+	unsigned long long tokenRecords = types + h.numTypes * (unsigned long long) sizeof(AstTypeRecord);
+	unsigned long long nodes = tokenRecords + h.numTokens * (unsigned long long) sizeof(AstTokenRecord);
+	unsigned long long children = nodes + h.numNodes * (unsigned long long) sizeof(AstNodeRecord);
+	unsigned long long scopes = children + h.numChildren * (unsigned long long) sizeof(uint32_t);
+	unsigned long long symbols = scopes + h.numScopes * (unsigned long long) sizeof(AstScopeRecord);
+	unsigned long long end = symbols + h.numSymbols * (unsigned long long) sizeof(AstSymbolRecord);
+
+	if (end != size || h.stringBytes % 4 != 0)
+		return Fail(fileName + " is truncated or damaged");
+
+	m_stringOffsets = (const uint32_t*) (data + offsets);
+	m_stringBytes = data + stringBytes;
+	m_children = (const uint32_t*) (data + children);
+
+	//TYPES
+	const AstTypeRecord* typeRecord = (const AstTypeRecord*) (data + types);
+	for (uint32_t i = 0; i < h.numTypes; ++i, ++typeRecord){
+		std::string name;
+		if (!GetString(typeRecord->name, name))
+			return false;
+
+		TypeInfo typeInfo(name, typeRecord->size, typeRecord->isArray != 0);
+		typeTable.Add(typeInfo);
+		m_types.push_back(typeTable.Get(typeInfo.name));
+	}
+
+	//TOKENS
+	const AstTokenRecord* tokenRecord = (const AstTokenRecord*) (data + tokenRecords);
+	tokens.reserve(tokens.size() + h.numTokens);
+	for (uint32_t i = 0; i < h.numTokens; ++i, ++tokenRecord){
+		Token token;
+		if (!GetToken(*tokenRecord, token))
+			return false;
+		tokens.push_back(token);
+	}
+
+	//NODES
+	//Post-order, so the children of every record have already been built.
+	m_nodes.resize(h.numNodes);
+	m_nodeAddresses.resize(h.numNodes);
+
+	m_record = (const AstNodeRecord*) (data + nodes);
+	for (uint32_t i = 0; i < h.numNodes; ++i, ++m_record){
+		if (m_record->firstChild > h.numChildren || m_record->numChildren > h.numChildren - m_record->firstChild)
+			return Fail(fileName + " is truncated or damaged");
+
+		m_nodes[i] = BuildNode(*m_record);
+		if (m_nodes[i] == nullptr)
+			return false;
+		m_nodeAddresses[i] = m_nodes[i].get();
+	}
+
+	if (h.root >= h.numNodes || m_nodes[h.root] == nullptr || m_nodes[h.root]->GetNodeType() != NodeType::StartBlock)
+		return Fail(fileName + " doesn't contain a program");
+
+	ASTNodePtr root = std::move(m_nodes[h.root]);
+	for (const auto& node : m_nodes){
+		if (node != nullptr)
+			return Fail(fileName + " contains nodes which aren't part of the program");
+	}
+
+	//SCOPES AND SYMBOLS
+	const AstScopeRecord* scopeRecord = (const AstScopeRecord*) (data + scopes);
+	std::vector<SymbolScope*> scopeAddresses;
+
+	for (uint32_t i = 0; i < h.numScopes; ++i, ++scopeRecord){
+		if (i == 0){
+			scopeAddresses.push_back(&globalScope);
+			continue;
+		}
+
+		std::string name;
+		if (!GetString(scopeRecord->name, name))
+			return false;
+		if (scopeRecord->parent >= i)
+			return Fail("Invalid parent of scope " + name);
+
+		SymbolScope* parent = scopeAddresses[scopeRecord->parent];
+		if (!parent->AddSubScope(name))
+			return Fail("Scope " + name + " is declared twice");
+		scopeAddresses.push_back(parent->GetSubScope(name));
+	}
+
+	if (!BuildSymbols((const AstSymbolRecord*) (data + symbols), h.numSymbols, scopeAddresses))
+		return false;
+
+	for (const auto& ident : m_identSymbols){
+		if (ident.second >= m_symbols.size())
+			return Fail("Invalid symbol of " + ident.first->GetName());
+		ident.first->SetSymbol(m_symbols[ident.second]);
+	}
+
+	//CLASSES
+	//The file only has the sizes of the classes. Their fields are laid out again, so the members get their offsets.
+	ClassLayout classLayout(typeTable);
+	classLayout.Process(((StartBlock*) root.get())->GetChildren());
+
+	for (BinOp* access : m_memberAccesses){
+		TypeInfo const* classInfo = access->GetLeft()->GetTypeInfo();
+		if (classInfo == nullptr || classInfo->isArray)
+			continue;
+
+		TypeInfo::Field const* field = nullptr;
+		if (access->GetRight()->GetNodeType() == NodeType::Ident)
+			field = classInfo->GetField(((Ident*) access->GetRight())->GetName());
+		if (field == nullptr)
+			return Fail("Invalid member access of class " + classInfo->name);
+
+		((Ident*) access->GetRight())->SetFieldOffset((int) field->offset);
+	}
+
+	start = StartBlockPtr((StartBlock*) root.release());
+	return true;
+}
+
+bool AstReader::GetString(uint32_t index, std::string& str){
+	if (index >= m_header->numStrings)
+		return Fail("Invalid string index");
+
+	uint32_t begin = m_stringOffsets[index];
+	uint32_t end = m_stringOffsets[index + 1];
+	if (begin > end || end > m_header->stringBytes)
+		return Fail("Invalid string offsets");
+
+	str.assign(m_stringBytes + begin, end - begin);
+	return true;
+}
+
+bool AstReader::GetToken(const AstTokenRecord& record, Token& token){
+	std::string value;
+	if (!GetString(record.value, value))
+		return false;
+	if (record.type > (uint32_t) TokenType::Eof)
+		return Fail("Invalid token type");
+
+	token = Token((TokenType) record.type, value, FilePosition(record.line, record.pos));
+	return true;
+}
+
+template<class T>
+bool AstReader::TakeChild(size_t i, bool (*accepts)(NodeType), std::unique_ptr<T>& child){
+	ASTNodePtr node;
+	if (!TakeChild(i, accepts, NodeType::ASTNode, node))
+		return false;
+
+	child.reset((T*) node.release());
+	return true;
+}
+
+template<class T>
+bool AstReader::TakeChild(size_t i, NodeType kind, std::unique_ptr<T>& child){
+	ASTNodePtr node;
+	if (!TakeChild(i, nullptr, kind, node))
+		return false;
+
+	child.reset((T*) node.release());
+	return true;
+}
+
+bool AstReader::TakeChild(size_t i, bool (*accepts)(NodeType), NodeType kind, ASTNodePtr& child){
+	if (i >= m_record->numChildren)
+		return Fail(std::string("Missing child of ") + NodeTypeAsString((NodeType) m_record->kind));
+
+	uint32_t index = m_children[m_record->firstChild + i];
+	if (index == AST_NONE)
+		return true;
+
+	//Only nodes before the current record are built, each of them can only be moved into one parent.
+	if (index >= m_nodes.size() || m_nodes[index] == nullptr)
+		return Fail(std::string("Invalid child of ") + NodeTypeAsString((NodeType) m_record->kind));
+
+	NodeType childKind = m_nodes[index]->GetNodeType();
+	if (accepts != nullptr ? !accepts(childKind) : childKind != kind)
+		return Fail(std::string(NodeTypeAsString(childKind)) + " can't be a child of " + NodeTypeAsString((NodeType) m_record->kind));
+
+	child = std::move(m_nodes[index]);
+	return true;
+}
+
+ASTNodePtr AstReader::BuildNode(const AstNodeRecord& record){
+	NodeType kind = (NodeType) record.kind;
+	ASTNodePtr node;
+	bool success = true;
+
+	//Children of list nodes are read in a loop, all other nodes have a fixed number of children.
+	auto expectChildren = [&](uint32_t num){
+		if (record.numChildren != num)
+			success = Fail(std::string("Wrong number of children of ") + NodeTypeAsString(kind));
+		return success;
+	};
+
+	switch (kind){
+	case NodeType::Type:
+	{
+		std::string name;
+		if (!expectChildren(0) || !GetString(record.payload, name))
+			return nullptr;
+		TypePtr p = std::make_unique<Type>(name);
+		p->SetIsArray(record.op != 0);
+		node = std::move(p);
+		break;
+	}
+	case NodeType::BinOp:
+	{
+		ExprPtr left, right;
+		if (record.op > BinOp::FunctionCall)
+			success = Fail("Invalid binary operator");
+		if (!success || !expectChildren(2) || !TakeChild(0, IsAstExpr, left) || !TakeChild(1, IsAstExpr, right))
+			return nullptr;
+		node = std::make_unique<BinOp>((BinOp::Types) record.op, std::move(left), std::move(right));
+		if (record.op == BinOp::MemberAccess)
+			m_memberAccesses.push_back((BinOp*) node.get());
+		break;
+	}
+	case NodeType::UnOp:
+	{
+		ExprPtr expr;
+		if (record.op > UnOp::Not)
+			success = Fail("Invalid unary operator");
+		if (!success || !expectChildren(1) || !TakeChild(0, IsAstExpr, expr))
+			return nullptr;
+		node = std::make_unique<UnOp>((UnOp::Types) record.op, std::move(expr));
+		break;
+	}
+	case NodeType::Ident:
+	{
+		std::string name;
+		if (!expectChildren(0) || !GetString(record.payload, name))
+			return nullptr;
+		IdentPtr p = std::make_unique<Ident>(name);
+		if (record.symbol != AST_NONE)
+			m_identSymbols.push_back(std::make_pair(p.get(), record.symbol));
+		node = std::move(p);
+		break;
+	}
+	case NodeType::IntLit:
+		if (!expectChildren(0))
+			return nullptr;
+		node = std::make_unique<IntLit>((int) record.payload);
+		break;
+	case NodeType::FloatLit:
+	{
+		float value;
+		memcpy(&value, &record.payload, sizeof(value));
+		if (!expectChildren(0))
+			return nullptr;
+		node = std::make_unique<FloatLit>(value);
+		break;
+	}
+	case NodeType::BoolLit:
+		if (!expectChildren(0))
+			return nullptr;
+		node = std::make_unique<BoolLit>(record.op != 0);
+		break;
+	case NodeType::StringLit:
+	{
+		std::string value;
+		if (!expectChildren(0) || !GetString(record.payload, value))
+			return nullptr;
+		node = std::make_unique<StringLit>(value);
+		break;
+	}
+	case NodeType::FuncCallExpr:
+	{
+		IdentPtr callee;
+		ArgListPtr args;
+		if (!expectChildren(2) || !TakeChild(0, NodeType::Ident, callee) || !TakeChild(1, NodeType::ArgList, args))
+			return nullptr;
+		node = std::make_unique<FuncCallExpr>(std::move(callee), std::move(args));
+		break;
+	}
+	case NodeType::IdentList:
+	{
+		IdentListPtr p = std::make_unique<IdentList>();
+		for (size_t i = 0; i < record.numChildren; ++i)
+			if (!TakeChild(i, NodeType::Ident, p->Push()))
+				return nullptr;
+		node = std::move(p);
+		break;
+	}
+	case NodeType::ArgList:
+	{
+		ArgListPtr p = std::make_unique<ArgList>();
+		for (size_t i = 0; i < record.numChildren; ++i)
+			if (!TakeChild(i, IsAstExpr, p->Push()))
+				return nullptr;
+		node = std::move(p);
+		break;
+	}
+	case NodeType::StmtAssign:
+	{
+		StmtAssignPtr p = std::make_unique<StmtAssign>();
+		if (!expectChildren(2) || !TakeChild(0, IsAstExpr, p->GetLHSRef()) || !TakeChild(1, IsAstExpr, p->GetExprRef()))
+			return nullptr;
+		node = std::move(p);
+		break;
+	}
+	case NodeType::StmtFuncCall:
+	{
+		StmtFuncCallPtr p = std::make_unique<StmtFuncCall>();
+		if (!expectChildren(2) || !TakeChild(0, NodeType::Ident, p->GetNameRef()) || !TakeChild(1, NodeType::ArgList, p->GetArgListRef()))
+			return nullptr;
+		node = std::move(p);
+		break;
+	}
+	case NodeType::StmtBreak:
+		if (!expectChildren(0))
+			return nullptr;
+		node = std::make_unique<StmtBreak>();
+		break;
+	case NodeType::StmtWhile:
+	{
+		StmtWhilePtr p = std::make_unique<StmtWhile>();
+		if (!expectChildren(2) || !TakeChild(0, IsAstExpr, p->GetExprRef()) || !TakeChild(1, IsAstStmt, p->GetBodyRef()))
+			return nullptr;
+		node = std::move(p);
+		break;
+	}
+	case NodeType::StmtIfThen:
+	{
+		StmtIfThenPtr p = std::make_unique<StmtIfThen>();
+		if (!expectChildren(2) || !TakeChild(0, IsAstExpr, p->GetExprRef()) || !TakeChild(1, IsAstStmt, p->GetThenRef()))
+			return nullptr;
+		node = std::move(p);
+		break;
+	}
+	case NodeType::StmtIfThenElse:
+	{
+		StmtIfThenElsePtr p = std::make_unique<StmtIfThenElse>();
+		if (!expectChildren(3) || !TakeChild(0, IsAstExpr, p->GetExprRef()) || !TakeChild(1, IsAstStmt, p->GetThenRef())
+			|| !TakeChild(2, IsAstStmt, p->GetElseRef()))
+			return nullptr;
+		node = std::move(p);
+		break;
+	}
+	case NodeType::StmtReturn:
+	{
+		StmtReturnPtr p = std::make_unique<StmtReturn>();
+		if (!expectChildren(1) || !TakeChild(0, IsAstExpr, p->GetExprRef()))
+			return nullptr;
+		node = std::move(p);
+		break;
+	}
+	case NodeType::StmtVarDecl:
+	{
+		StmtVarDeclPtr p = std::make_unique<StmtVarDecl>();
+		if (!expectChildren(3) || !TakeChild(0, NodeType::Type, p->GetTypeRef()) || !TakeChild(1, NodeType::Ident, p->GetNameRef())
+			|| !TakeChild(2, IsAstExpr, p->GetExprRef()))
+			return nullptr;
+		node = std::move(p);
+		break;
+	}
+	case NodeType::StmtBlock:
+	{
+		StmtBlockPtr p = std::make_unique<StmtBlock>();
+		for (size_t i = 0; i < record.numChildren; ++i)
+			if (!TakeChild(i, IsAstStmt, p->Push()))
+				return nullptr;
+		node = std::move(p);
+		break;
+	}
+	case NodeType::Param:
+	{
+		ParamPtr p = std::make_unique<Param>();
+		if (!expectChildren(2) || !TakeChild(0, NodeType::Type, p->GetTypeRef()) || !TakeChild(1, NodeType::Ident, p->GetNameRef()))
+			return nullptr;
+		node = std::move(p);
+		break;
+	}
+	case NodeType::ParamList:
+	{
+		ParamListPtr p = std::make_unique<ParamList>();
+		for (size_t i = 0; i < record.numChildren; ++i)
+			if (!TakeChild(i, NodeType::Param, p->Push()))
+				return nullptr;
+		node = std::move(p);
+		break;
+	}
+	case NodeType::GlobVarDef:
+	{
+		GlobVarDefPtr p = std::make_unique<GlobVarDef>();
+		if (!expectChildren(2) || !TakeChild(0, NodeType::Type, p->GetTypeRef()) || !TakeChild(1, NodeType::Ident, p->GetNameRef()))
+			return nullptr;
+		node = std::move(p);
+		break;
+	}
+	case NodeType::FuncDef:
+	{
+		FuncDefPtr p = std::make_unique<FuncDef>();
+		if (!expectChildren(4) || !TakeChild(0, NodeType::Type, p->GetRetTypeRef()) || !TakeChild(1, NodeType::Ident, p->GetNameRef())
+			|| !TakeChild(2, NodeType::ParamList, p->GetParamListRef()) || !TakeChild(3, NodeType::StmtBlock, p->GetStmtBlockRef()))
+			return nullptr;
+		node = std::move(p);
+		break;
+	}
+	case NodeType::ClassVar:
+	{
+		ClassVarPtr p = std::make_unique<ClassVar>();
+		if (!expectChildren(3) || !TakeChild(0, NodeType::Type, p->GetTypeRef()) || !TakeChild(1, NodeType::Ident, p->GetNameRef())
+			|| !TakeChild(2, IsAstExpr, p->GetExprRef()))
+			return nullptr;
+		node = std::move(p);
+		break;
+	}
+	case NodeType::ClassBody:
+	{
+		ClassBodyPtr p = std::make_unique<ClassBody>();
+		for (size_t i = 0; i < record.numChildren; ++i)
+			if (!TakeChild(i, NodeType::ClassVar, p->Push()))
+				return nullptr;
+		node = std::move(p);
+		break;
+	}
+	case NodeType::ClassDef:
+	{
+		ClassDefPtr p = std::make_unique<ClassDef>();
+		if (!expectChildren(2) || !TakeChild(0, NodeType::Ident, p->GetNameRef()) || !TakeChild(1, NodeType::ClassBody, p->GetBodyRef()))
+			return nullptr;
+		node = std::move(p);
+		break;
+	}
+	case NodeType::StartBlock:
+	{
+		StartBlockPtr p = std::make_unique<StartBlock>();
+		for (size_t i = 0; i < record.numChildren; ++i)
+			if (!TakeChild(i, IsAstGlobalStmt, p->Push()))
+				return nullptr;
+		node = std::move(p);
+		break;
+	}
+	default:
+		Fail("Invalid node type " + std::to_string(record.kind));
+		return nullptr;
+	}
+
+	Token token;
+	if (!GetToken(record.token, token))
+		return nullptr;
+	node->SetToken(token);
+
+	if (record.typeInfo != AST_NONE){
+		if (record.typeInfo >= m_types.size()){
+			Fail("Invalid type index");
+			return nullptr;
+		}
+		if (kind == NodeType::Type)
+			((Type*) node.get())->SetTypeInfo(m_types[record.typeInfo]);
+		else if (IsAstExpr(kind))
+			((Expr*) node.get())->SetTypeInfo(m_types[record.typeInfo]);
+	}
+
+	return node;
+}
+
+bool AstReader::BuildSymbols(const AstSymbolRecord* records, uint32_t numSymbols, std::vector<SymbolScope*>& scopes){
+	m_symbols.assign(numSymbols, nullptr);
+
+	//AddSymbol() rejects names which are already visible from the scope. The scopes are in pre-order, adding the
+	//symbols backwards declares those of nested scopes before the ones they shadow.
+	for (uint32_t i = numSymbols; i > 0; --i){
+		const AstSymbolRecord& record = records[i - 1];
+
+		std::string name;
+		if (!GetString(record.name, name))
+			return false;
+		if (record.scope >= scopes.size())
+			return Fail("Invalid scope of symbol " + name);
+		if (record.node == AST_NONE)		//Declaration was removed from the AST
+			continue;
+
+		Symbol::SymbolType type = (Symbol::SymbolType) record.type;
+		if (record.type > Symbol::CLASS || record.node >= m_nodeAddresses.size()
+			|| m_nodeAddresses[record.node]->GetNodeType() != GetDeclarationKind(type))
+			return Fail("Invalid declaration of symbol " + name);
+
+		ASTNode const* decl = m_nodeAddresses[record.node];
+		if (!HasName(decl))
+			return Fail("Declaration of symbol " + name + " has no name");
+
+		Symbol symbol = [&]() -> Symbol {
+			switch (type){
+			case Symbol::FUNCTION:		return Symbol::CreateFunctionSymbol((FuncDef const*) decl);
+			case Symbol::VARIABLE:		return Symbol::CreateVariableSymbol((StmtVarDecl const*) decl);
+			case Symbol::PARAMETER:		return Symbol::CreateParamSymbol((Param const*) decl);
+			case Symbol::GLOBAL_VAR:	return Symbol::CreateGlobalVariableSymbol((GlobVarDef const*) decl);
+			case Symbol::CLASS_VAR:		return Symbol::CreateClassVariableSymbol((ClassVar const*) decl);
+			case Symbol::RETURN_VALUE:	return Symbol::CreateReturnValueSymbol(name, (Type const*) decl);
+			default:					return Symbol::CreateClassSymbol((ClassDef const*) decl);
+			}
+		}();
+
+		SymbolScope* scope = scopes[record.scope];
+		if (!scope->AddSymbol(name, symbol))
+			return Fail("Symbol " + name + " is declared twice");
+
+		Symbol const* added = &scope->GetSymbols().find(name)->second;
+		added->useCount = record.useCount;
+		m_symbols[i - 1] = added;
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "ASTNode.h"
+#include "AstFormat.h"
+
+class Symbol;
+class SymbolScope;
+class TypeTable;
+
+/*
+	Restores an AST written by AstWriter, see AstFormat.h. The file is memory mapped and read in a single pass over
+	its sections: records are checked and turned into nodes, children are moved into their parents, then the scopes
+	and symbols are rebuilt and linked to the nodes. Nothing is parsed or type checked again, only the classes are laid
+	out, the file has just their sizes.
+*/
+class AstReader{
+public:
+
+	//The types of the file are added to typeTable, its scopes and symbols to globalScope, which has to be empty.
+	//Returns false if the file is missing or malformed, see GetError().
+	bool Read(const std::string& fileName, std::vector<Token>& tokens, StartBlockPtr& start, TypeTable& typeTable, SymbolScope& globalScope);
+
+	//Same for an AST in memory, which has to be aligned like the file. fileName is only used in the errors.
+	bool Read(const char* data, size_t size, const std::string& fileName, std::vector<Token>& tokens, StartBlockPtr& start, TypeTable& typeTable, SymbolScope& globalScope);
+
+	const std::string& GetError() const {
+		return m_error;
+	}
+
+private:
+
+	bool Fail(const std::string& error){
+		m_error = error;
+		return false;
+	}
+
+	bool GetString(uint32_t index, std::string& str);
+	bool GetToken(const AstTokenRecord& record, Token& token);
+
+	ASTNodePtr BuildNode(const AstNodeRecord& record);
+
+	//Moves child 'i' of the current record into 'child' if it is of the expected kind. Missing children are allowed.
+	template<class T>
+	bool TakeChild(size_t i, bool (*accepts)(NodeType), std::unique_ptr<T>& child);
+
+	template<class T>
+	bool TakeChild(size_t i, NodeType kind, std::unique_ptr<T>& child);
+
+	bool TakeChild(size_t i, bool (*accepts)(NodeType), NodeType kind, ASTNodePtr& child);
+
+	bool BuildSymbols(const AstSymbolRecord* records, uint32_t numSymbols, std::vector<SymbolScope*>& scopes);
+
+	const AstHeader* m_header;
+	const uint32_t* m_stringOffsets;
+	const char* m_stringBytes;
+	const uint32_t* m_children;
+
+	const AstNodeRecord* m_record;		//Record being built
+	std::vector<TypeInfo const*> m_types;
+	std::vector<ASTNodePtr> m_nodes;	//Built nodes which haven't been moved into their parent yet
+	std::vector<ASTNode*> m_nodeAddresses;
+	std::vector<std::pair<Ident*, uint32_t>> m_identSymbols;
+	std::vector<BinOp*> m_memberAccesses;
+	std::vector<Symbol const*> m_symbols;
+
+	std::string m_error;
+};
\ No newline at end of file
@@ -0,0 +1,281 @@
+#include "AstWriter.h"
+#include "SymbolScope.h"
+#include "TypeInfo.h"
+
+#include <cstring>
+
+void AstWriter::Write(StartBlock const* start, const SymbolScope& globalScope, const std::vector<Token>& tokens, OutputBuffer& out){
+	//Symbols are numbered first, Idents refer to them. Their declarations are filled in after the nodes.
+	AddScope(globalScope, AST_NONE);
+
+	uint32_t root = AddNode(start);
+
+	for (size_t i = 0; i < m_symbolList.size(); ++i){
+		auto it = m_nodeIndices.find(m_symbolList[i]->GetNode());
+		m_symbols[i].node = it != m_nodeIndices.end() ? it->second : AST_NONE;
+	}
+
+	std::vector<AstTokenRecord> tokenRecords;
+	tokenRecords.reserve(tokens.size());
+	for (const auto& token : tokens)
+		tokenRecords.push_back(MakeToken(token));
+
+	m_stringOffsets.push_back((uint32_t) m_stringBytes.size());
+	m_stringBytes.resize((m_stringBytes.size() + 3) & ~(size_t) 3, '\0');
+
+	AstHeader header;
+	memcpy(header.magic, AST_MAGIC, sizeof(header.magic));
+	header.version = AST_VERSION;
+	header.byteOrder = AST_BYTE_ORDER;
+	header.numStrings = (uint32_t) m_stringOffsets.size() - 1;
+	header.stringBytes = (uint32_t) m_stringBytes.size();
+	header.numTypes = (uint32_t) m_types.size();
+	header.numTokens = (uint32_t) tokenRecords.size();
+	header.numNodes = (uint32_t) m_nodes.size();
+	header.numChildren = (uint32_t) m_children.size();
+	header.numScopes = (uint32_t) m_scopes.size();
+	header.numSymbols = (uint32_t) m_symbols.size();
+	header.root = root;
+
+	out.Put((const char*) &header, sizeof(header));
+	PutSection(m_stringOffsets, out);
+	out.Put(m_stringBytes);
+	PutSection(m_types, out);
+	PutSection(tokenRecords, out);
+	PutSection(m_nodes, out);
+	PutSection(m_children, out);
+	PutSection(m_scopes, out);
+	PutSection(m_symbols, out);
+}
+
+uint32_t AstWriter::AddString(const std::string& str){
+	auto it = m_stringIndices.find(str);
+	if (it != m_stringIndices.end())
+		return it->second;
+
+	uint32_t index = (uint32_t) m_stringOffsets.size();
+	m_stringOffsets.push_back((uint32_t) m_stringBytes.size());
+	m_stringBytes += str;
+	m_stringIndices.insert(std::make_pair(str, index));
+	return index;
+}
+
+uint32_t AstWriter::AddType(TypeInfo const* typeInfo){
+	if (typeInfo == nullptr)
+		return AST_NONE;
+
+	auto it = m_typeIndices.find(typeInfo);
+	if (it != m_typeIndices.end())
+		return it->second;
+
+	AstTypeRecord record;
+	record.name = AddString(typeInfo->GetSimpleTypeName());
+	record.size = (uint32_t) typeInfo->size;
+	record.isArray = typeInfo->isArray;
+
+	uint32_t index = (uint32_t) m_types.size();
+	m_types.push_back(record);
+	m_typeIndices.insert(std::make_pair(typeInfo, index));
+	return index;
+}
+
+AstTokenRecord AstWriter::MakeToken(const Token& token){
+	std::string value = token.GetTokenValue();
+	if (token.type == TokenType::StringLit)		//GetTokenValue() adds quotes
+		value = value.substr(1, value.size() - 2);
+
+	AstTokenRecord record;
+	record.type = (uint32_t) token.type;
+	record.value = AddString(value);
+	record.line = token.filePosition.line;
+	record.pos = token.filePosition.pos;
+	return record;
+}
+
+void AstWriter::AddScope(const SymbolScope& scope, uint32_t parent){
+	uint32_t index = (uint32_t) m_scopes.size();
+
+	AstScopeRecord record;
+	record.name = AddString(scope.GetScopeName());
+	record.parent = parent;
+	m_scopes.push_back(record);
+
+	for (const auto& entry : scope.GetSymbols()){
+		const Symbol& sym = entry.second;
+
+		AstSymbolRecord symbol;
+		symbol.name = AddString(entry.first);
+		symbol.scope = index;
+		symbol.type = (uint32_t) sym.type;
+		symbol.node = AST_NONE;
+		symbol.useCount = sym.useCount;
+
+		m_symbolIndices.insert(std::make_pair(&sym, (uint32_t) m_symbols.size()));
+		m_symbols.push_back(symbol);
+		m_symbolList.push_back(&sym);
+	}
+
+	for (const auto& sub : scope.GetSubScopes())
+		AddScope(sub.second, index);
+}
+
+uint32_t AstWriter::AddNode(ASTNode const* n){
+	AstNodeRecord record;
+	record.kind = (uint16_t) n->GetNodeType();
+	record.op = 0;
+	record.token = MakeToken(n->GetToken());
+	record.typeInfo = AST_NONE;
+	record.symbol = AST_NONE;
+	record.payload = 0;
+
+	std::vector<uint32_t> children;
+
+	switch (n->GetNodeType()){
+	case NodeType::Type:
+	{
+		Type const* p = (Type const*) n;
+		record.op = p->GetIsArray();
+		record.typeInfo = AddType(p->GetTypeInfo());
+		record.payload = AddString(p->GetName());
+		break;
+	}
+	case NodeType::BinOp:
+	{
+		BinOp const* p = (BinOp const*) n;
+		record.op = (uint16_t) p->GetType();
+		children.push_back(AddChild(p->GetLeft()));
+		children.push_back(AddChild(p->GetRight()));
+		break;
+	}
+	case NodeType::UnOp:
+	{
+		UnOp const* p = (UnOp const*) n;
+		record.op = (uint16_t) p->GetType();
+		children.push_back(AddChild(p->GetExpr()));
+		break;
+	}
+	case NodeType::Ident:
+	{
+		Ident const* p = (Ident const*) n;
+		record.payload = AddString(p->GetName());
+		auto it = m_symbolIndices.find(p->GetSymbol());
+		if (it != m_symbolIndices.end())
+			record.symbol = it->second;
+		break;
+	}
+	case NodeType::IntLit:
+		record.payload = (uint32_t) ((IntLit const*) n)->GetValue();
+		break;
+	case NodeType::FloatLit:
+	{
+		float value = ((FloatLit const*) n)->GetValue();
+		memcpy(&record.payload, &value, sizeof(value));
+		break;
+	}
+	case NodeType::BoolLit:
+		record.op = ((BoolLit const*) n)->GetValue();
+		break;
+	case NodeType::StringLit:
+		record.payload = AddString(((StringLit const*) n)->GetValue());
+		break;
+	case NodeType::FuncCallExpr:
+	{
+		FuncCallExpr const* p = (FuncCallExpr const*) n;
+		children.push_back(AddChild(p->GetCallee()));
+		children.push_back(AddChild(p->GetArgs()));
+		break;
+	}
+	case NodeType::IdentList:
+		for (const auto& child : ((IdentList const*) n)->GetChildren())
+			children.push_back(AddChild(child.get()));
+		break;
+	case NodeType::ArgList:
+		for (const auto& child : ((ArgList const*) n)->GetChildren())
+			children.push_back(AddChild(child.get()));
+		break;
+	case NodeType::StmtAssign:
+		children.push_back(AddChild(((StmtAssign const*) n)->GetLHS()));
+		children.push_back(AddChild(((StmtAssign const*) n)->GetExpr()));
+		break;
+	case NodeType::StmtFuncCall:
+		children.push_back(AddChild(((StmtFuncCall const*) n)->GetName()));
+		children.push_back(AddChild(((StmtFuncCall const*) n)->GetArgList()));
+		break;
+	case NodeType::StmtBreak:
+		break;
+	case NodeType::StmtWhile:
+		children.push_back(AddChild(((StmtWhile const*) n)->GetExpr()));
+		children.push_back(AddChild(((StmtWhile const*) n)->GetBody()));
+		break;
+	case NodeType::StmtIfThen:
+		children.push_back(AddChild(((StmtIfThen const*) n)->GetExpr()));
+		children.push_back(AddChild(((StmtIfThen const*) n)->GetThen()));
+		break;
+	case NodeType::StmtIfThenElse:
+		children.push_back(AddChild(((StmtIfThenElse const*) n)->GetExpr()));
+		children.push_back(AddChild(((StmtIfThenElse const*) n)->GetThen()));
+		children.push_back(AddChild(((StmtIfThenElse const*) n)->GetElse()));
+		break;
+	case NodeType::StmtReturn:
+		children.push_back(AddChild(((StmtReturn const*) n)->GetExpr()));
+		break;
+	case NodeType::StmtVarDecl:
+		children.push_back(AddChild(((StmtVarDecl const*) n)->GetType()));
+		children.push_back(AddChild(((StmtVarDecl const*) n)->GetName()));
+		children.push_back(AddChild(((StmtVarDecl const*) n)->GetExpr()));
+		break;
+	case NodeType::StmtBlock:
+		for (const auto& child : ((StmtBlock const*) n)->GetChildren())
+			children.push_back(AddChild(child.get()));
+		break;
+	case NodeType::Param:
+		children.push_back(AddChild(((Param const*) n)->GetType()));
+		children.push_back(AddChild(((Param const*) n)->GetName()));
+		break;
+	case NodeType::ParamList:
+		for (const auto& child : ((ParamList const*) n)->GetChildren())
+			children.push_back(AddChild(child.get()));
+		break;
+	case NodeType::GlobVarDef:
+		children.push_back(AddChild(((GlobVarDef const*) n)->GetType()));
+		children.push_back(AddChild(((GlobVarDef const*) n)->GetName()));
+		break;
+	case NodeType::FuncDef:
+		children.push_back(AddChild(((FuncDef const*) n)->GetRetType()));
+		children.push_back(AddChild(((FuncDef const*) n)->GetName()));
+		children.push_back(AddChild(((FuncDef const*) n)->GetParamList()));
+		children.push_back(AddChild(((FuncDef const*) n)->GetStmtBlock()));
+		break;
+	case NodeType::ClassVar:
+		children.push_back(AddChild(((ClassVar const*) n)->GetType()));
+		children.push_back(AddChild(((ClassVar const*) n)->GetName()));
+		children.push_back(AddChild(((ClassVar const*) n)->GetExpr()));
+		break;
+	case NodeType::ClassBody:
+		for (const auto& child : ((ClassBody const*) n)->GetChildren())
+			children.push_back(AddChild(child.get()));
+		break;
+	case NodeType::ClassDef:
+		children.push_back(AddChild(((ClassDef const*) n)->GetName()));
+		children.push_back(AddChild(((ClassDef const*) n)->GetBody()));
+		break;
+	case NodeType::StartBlock:
+		for (const auto& child : ((StartBlock const*) n)->GetChildren())
+			children.push_back(AddChild(child.get()));
+		break;
+	default:
+		throw std::invalid_argument(std::string("AstWriter: Unknown node type ") + NodeTypeAsString(n->GetNodeType()));
+	}
+
+	if (IsAstExpr(n->GetNodeType()))
+		record.typeInfo = AddType(((Expr const*) n)->GetTypeInfo());
+
+	record.firstChild = (uint32_t) m_children.size();
+	record.numChildren = (uint32_t) children.size();
+	m_children.insert(m_children.end(), children.begin(), children.end());
+
+	uint32_t index = (uint32_t) m_nodes.size();
+	m_nodes.push_back(record);
+	m_nodeIndices.insert(std::make_pair(n, index));
+	return index;
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include "ASTNode.h"
+#include "AstFormat.h"
+#include "OutputBuffer.h"
+
+class Symbol;
+class SymbolScope;
+
+//Writes a type checked AST with its symbols, types and tokens in the format described in AstFormat.h.
+class AstWriter{
+public:
+
+	void Write(StartBlock const* start, const SymbolScope& globalScope, const std::vector<Token>& tokens, OutputBuffer& out);
+
+private:
+
+	uint32_t AddString(const std::string& str);
+	uint32_t AddType(TypeInfo const* typeInfo);
+	AstTokenRecord MakeToken(const Token& token);
+
+	void AddScope(const SymbolScope& scope, uint32_t parent);
+
+	//Adds n and everything below it, returns the index of n.
+	uint32_t AddNode(ASTNode const* n);
+
+	uint32_t AddChild(ASTNode const* n){
+		return n != nullptr ? AddNode(n) : AST_NONE;
+	}
+
+	template<class T>
+	void PutSection(const std::vector<T>& records, OutputBuffer& out){
+		if (!records.empty())
+			out.Put((const char*) records.data(), records.size() * sizeof(T));
+	}
+
+	std::map<std::string, uint32_t> m_stringIndices;
+	std::vector<uint32_t> m_stringOffsets;
+	std::string m_stringBytes;
+
+	std::map<TypeInfo const*, uint32_t> m_typeIndices;
+	std::map<ASTNode const*, uint32_t> m_nodeIndices;
+	std::map<Symbol const*, uint32_t> m_symbolIndices;
+
+	std::vector<AstTypeRecord> m_types;
+	std::vector<AstNodeRecord> m_nodes;
+	std::vector<uint32_t> m_children;
+	std::vector<AstScopeRecord> m_scopes;
+	std::vector<AstSymbolRecord> m_symbols;
+	std::vector<Symbol const*> m_symbolList;
+};
\ No newline at end of file
@@ -53,6 +53,7 @@ DEFINE_DEFAULT_VISIT(StringLit)
 
 DEFINE_DEFAULT_VISIT(Stmt)
 DEFINE_DEFAULT_VISIT(StmtBreak)
+DEFINE_DEFAULT_VISIT(StmtError)
 
 DEFINE_VISIT_2( StmtAssign, GetLHS(), GetExpr() )
 DEFINE_VISIT_2( StmtWhile, GetExpr(), GetBody() )
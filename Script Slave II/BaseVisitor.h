@@ -25,6 +25,7 @@ class FuncCallExpr;
 //Stmt
 class Stmt;
 class StmtBreak;
+class StmtError;
 class StmtAssign;
 class StmtWhile;
 class StmtIfThen;
@@ -74,6 +75,7 @@ public:
 	//Stmt
 	ADD_VISITEE(Stmt, ASTNode);
 	ADD_VISITEE(StmtBreak, Stmt);
+	ADD_VISITEE(StmtError, Stmt);
 	ADD_VISITEE(StmtAssign, Stmt);
 	ADD_VISITEE(StmtWhile, Stmt);
 	ADD_VISITEE(StmtIfThen, Stmt);
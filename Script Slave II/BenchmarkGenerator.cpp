@@ -0,0 +1,130 @@
+#include "BenchmarkGenerator.h"
+
+namespace{
+
+	void Indent(std::string& s, size_t depth){
+		s.append(depth, '\t');
+	}
+}
+
+const std::vector<BenchmarkGenerator::Shape>& BenchmarkGenerator::GetShapes(){
+	static const std::vector<Shape> shapes = {
+		{ "functions", "Functions calling each other", &BenchmarkGenerator::Functions, { 25, 50, 100, 200, 400 } },
+		{ "nesting", "Deeply nested while and if statements", &BenchmarkGenerator::Nesting, { 8, 16, 32, 64, 128 } },
+		{ "expression", "Long expression chains", &BenchmarkGenerator::ExpressionChain, { 100, 200, 400, 800, 1600 } },
+		{ "locals", "Many locals in one function", &BenchmarkGenerator::Locals, { 100, 200, 400, 800, 1600 } },
+		{ "class", "Wide class bodies", &BenchmarkGenerator::ClassFields, { 100, 200, 400, 800, 1600 } },
+		{ "string", "Huge string literals", &BenchmarkGenerator::StringLiteral, { 4000, 8000, 16000, 32000, 64000 } },
+	};
+	return shapes;
+}
+
+std::string BenchmarkGenerator::Functions(size_t count){
+	std::string s = "int g;\n\n";
+
+	for (size_t i = 0; i < count; ++i){
+		std::string n = std::to_string(i);
+
+		s += "int f" + n + "(int a, int b){\n";
+		s += "\tint c = a * " + n + " + b;\n";
+		s += "\tif(c > 100)\n\t\tc = c - b;\n";
+		s += "\tg = g + c;\n";
+		if (i > 0)
+			s += "\treturn c + f" + std::to_string(i - 1) + "(b, a);\n";
+		else
+			s += "\treturn c;\n";
+		s += "}\n\n";
+	}
+
+	s += "string main(){\n\treturn \"r=\" + f" + std::to_string(count > 0 ? count - 1 : 0) + "(1, 2) + \" g=\" + g;\n}\n";
+	return s;
+}
+
+std::string BenchmarkGenerator::Nesting(size_t depth){
+	std::string s = "int n;\n\nint main(){\n";
+
+	for (size_t i = 0; i < depth; ++i){
+		std::string k = std::to_string(i);
+
+		Indent(s, i + 1);
+		if (i % 2 == 0)
+			s += "while(n < " + k + "){\n";
+		else
+			s += "if(n > " + k + "){\n";
+	}
+
+	Indent(s, depth + 1);
+	s += "n = n + 1;\n";
+
+	for (size_t i = depth; i > 0; --i){
+		Indent(s, i);
+		if ((i - 1) % 2 == 0){
+			s += "\tn = n + 1;\n";
+			Indent(s, i);
+			s += "}\n";
+		}
+		else{
+			s += "}else{\n";
+			Indent(s, i);
+			s += "\tbreak;\n";
+			Indent(s, i);
+			s += "}\n";
+		}
+	}
+
+	s += "\treturn n;\n}\n";
+	return s;
+}
+
+std::string BenchmarkGenerator::ExpressionChain(size_t length){
+	std::string s = "int main(){\n\tint a = 3;\n\tint b = 5;\n\tint r = a";
+	const char* operators[] = { " + ", " - ", " * " };
+
+	for (size_t i = 1; i < length; ++i){
+		s += operators[i % 3];
+
+		//Every fourth operand is parenthesized to exercise the nested expression parsing.
+		if (i % 4 == 0)
+			s += "(a + b * " + std::to_string(i) + ")";
+		else
+			s += i % 2 == 0 ? "a" : "b";
+	}
+
+	s += ";\n\treturn r;\n}\n";
+	return s;
+}
+
+std::string BenchmarkGenerator::Locals(size_t count){
+	std::string s = "int main(){\n\tint v0 = 1;\n";
+
+	for (size_t i = 1; i < count; ++i)
+		s += "\tint v" + std::to_string(i) + " = v" + std::to_string(i - 1) + " + " + std::to_string(i) + ";\n";
+
+	s += "\treturn v" + std::to_string(count > 0 ? count - 1 : 0) + ";\n}\n";
+	return s;
+}
+
+std::string BenchmarkGenerator::ClassFields(size_t count){
+	std::string s = "class C{\n";
+	const char* types[] = { "int", "float", "string", "bool", "int[]" };
+
+	for (size_t i = 0; i < count; ++i)
+		s += std::string("\t") + types[i % 5] + " f" + std::to_string(i) + ";\n";
+
+	s += "}\n\nint main(){\n\treturn 0;\n}\n";
+	return s;
+}
+
+std::string BenchmarkGenerator::StringLiteral(size_t length){
+	std::string s = "string main(){\n\tstring s = \"";
+
+	for (size_t i = 0; i < length; ++i){
+		if (i % 64 == 63)
+			s += "\\n";
+		else
+			s += (char) ('a' + i % 26);
+	}
+
+	s += "\";\n\treturn s;\n}\n";
+	return s;
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+//Generates synthetic programs for -benchmark. Each shape scales one property of the source, so that the compile time
+//can be followed as the size grows.
+class BenchmarkGenerator{
+public:
+
+	struct Shape{
+		const char* name;
+		const char* description;
+		std::string (*generate)(size_t size);
+		std::vector<size_t> sizes;
+	};
+
+	static const std::vector<Shape>& GetShapes();
+
+	//Functions which each call the previous one
+	static std::string Functions(size_t count);
+
+	//Alternately nested while and if statements
+	static std::string Nesting(size_t depth);
+
+	//A single expression with the given number of operands
+	static std::string ExpressionChain(size_t length);
+
+	//Locals in a single function, each initialized from the one before
+	static std::string Locals(size_t count);
+
+	//A class with the given number of fields
+	static std::string ClassFields(size_t count);
+
+	//A string literal of the given length
+	static std::string StringLiteral(size_t length);
+};
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "ClassLayout.h"
+
+#include <algorithm>
+
+void ClassLayout::Process(std::vector<GlobalStmtPtr>& globals){
+	//Register all classes first, fields can be of any class type.
+	for (auto&& global : globals){
+		if (global == nullptr || global->GetNodeType() != NodeType::ClassDef)
+			continue;
+
+		const std::string& name = ((ClassDef*) global.get())->GetName()->GetName();
+		if (m_typeTable.Get(name) == nullptr)
+			m_typeTable.Add(TypeInfo(name, 0, false));
+		if (m_typeTable.Get(name + "[]") == nullptr)
+			m_typeTable.Add(TypeInfo(name, REFERENCE_SIZE, true));
+
+		m_typeTable.Get(name)->isClass = true;
+	}
+
+	for (auto&& global : globals)
+		if (global != nullptr && global->GetNodeType() == NodeType::ClassDef)
+			Layout((ClassDef*) global.get());
+}
+
+void ClassLayout::Layout(ClassDef* n){
+	TypeInfo* classInfo = m_typeTable.Get(n->GetName()->GetName());
+	std::vector<TypeInfo::Field> fields;
+
+	for (const auto& member : n->GetBody()->GetChildren()){
+		if (member->GetNodeType() != NodeType::ClassVar)
+			continue;
+
+		ClassVar* var = (ClassVar*) member.get();
+		Type* type = var->GetType();
+		TypeInfo const* typeInfo = m_typeTable.Get(type->GetName() + (type->GetIsArray() ? "[]" : ""));
+		size_t size = GetFieldSize(type, typeInfo);
+
+		if (size == 0)
+			continue;
+
+		TypeInfo::Field field = { var->GetName()->GetName(), typeInfo, 0, size };
+		fields.push_back(field);
+	}
+
+	//Without reordering, for the comparison in Print()
+	size_t declaredSize = 0;
+	size_t alignment = 1;
+	for (const auto& field : fields){
+		declaredSize = (declaredSize + field.size - 1) / field.size * field.size + field.size;
+		alignment = std::max(alignment, field.size);
+	}
+
+	std::stable_sort(fields.begin(), fields.end(), [](const TypeInfo::Field& a, const TypeInfo::Field& b){
+		return a.size > b.size;
+	});
+
+	size_t offset = 0;
+	for (auto&& field : fields){
+		field.offset = offset;
+		offset += field.size;
+	}
+
+	//Objects of empty classes still need an address of their own, and a size of 0 marks void.
+	classInfo->size = std::max<size_t>((offset + alignment - 1) / alignment * alignment, 1);
+	classInfo->fields = std::move(fields);
+
+	m_classes.push_back(classInfo);
+	m_declaredSizes.push_back(std::max<size_t>((declaredSize + alignment - 1) / alignment * alignment, 1));
+}
+
+size_t ClassLayout::GetFieldSize(const Type* type, TypeInfo const* typeInfo) const {
+	if (typeInfo == nullptr)
+		return 0;
+
+	//Classes may not be laid out yet, their sizes don't matter.
+	if (type->GetIsArray() || typeInfo->isClass || typeInfo->name == "string")
+		return REFERENCE_SIZE;
+
+	return typeInfo->size;
+}
+
+void ClassLayout::Print(OutputBuffer& out) const {
+	for (size_t i = 0; i < m_classes.size(); ++i){
+		TypeInfo const* classInfo = m_classes[i];
+
+		out.Put("class ");
+		out.Put(classInfo->name);
+		out.PutLit(": ");
+		out.PutInt((long long) classInfo->size);
+		out.PutLit(" bytes, ");
+		out.PutInt((long long) m_declaredSizes[i]);
+		out.PutLit(" in declaration order");
+		out.Newline();
+
+		for (const auto& field : classInfo->fields){
+			out.Put('\t');
+			out.PutInt((long long) field.offset);
+			out.PutLit(": ");
+			out.Put(field.name);
+			out.PutLit(" : ");
+			out.Put(field.type->name);
+			out.Newline();
+		}
+	}
+}
\ No newline at end of file
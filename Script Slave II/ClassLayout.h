@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "ASTNode.h"
+#include "TypeTable.h"
+#include "OutputBuffer.h"
+
+/*
+	Lays out the objects of all classes. Every class gets a TypeInfo with its object size and a field table, and an
+	array type, so variables of class types can be declared and member accesses checked to a constant offset. The VM
+	stores the fields of its instances at exactly these offsets.
+
+	Fields are sorted by decreasing alignment, the declaration order breaks ties. All sizes are powers of two, so this
+	leaves no padding between the fields, only at the end to round the object up to its largest alignment. A field's
+	alignment is its size. Fields of classes, strings and arrays hold a reference of REFERENCE_SIZE bytes, a pointer
+	in the VM. Fields whose type is unknown or void are left out, the second pass reports them.
+
+	Runs after the first pass, which rejects classes named like another type, and before CollectTypeInfo. Classes
+	already in the type table, e.g. read from an AST file, are laid out again.
+*/
+class ClassLayout{
+public:
+
+	static const size_t REFERENCE_SIZE = sizeof(void*);
+
+	explicit ClassLayout(TypeTable& typeTable)
+		: m_typeTable(typeTable)
+	{}
+
+	//Empty entries are skipped.
+	void Process(std::vector<GlobalStmtPtr>& globals);
+
+	//"class <name>: <size> bytes" and the fields with their offsets, for -dump-symbols.
+	void Print(OutputBuffer& out) const;
+
+private:
+	void Layout(ClassDef* n);
+	size_t GetFieldSize(const Type* type, TypeInfo const* typeInfo) const;
+
+	TypeTable& m_typeTable;
+	std::vector<TypeInfo const*> m_classes;
+	std::vector<size_t> m_declaredSizes;	//Of the objects with the fields in declaration order
+};
\ No newline at end of file
@@ -0,0 +1,447 @@
+#include "ClassWriter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "StringUtil.h"
+
+enum PoolTag{
+	CONSTANT_Utf8 = 1,
+	CONSTANT_Integer = 3,
+	CONSTANT_Float = 4,
+	CONSTANT_Class = 7,
+	CONSTANT_String = 8,
+	CONSTANT_Fieldref = 9,
+	CONSTANT_Methodref = 10,
+	CONSTANT_NameAndType = 12
+};
+
+unsigned short ConstantPool::AddUtf8(const std::string& str){
+	auto it = m_utf8.find(str);
+	if (it != m_utf8.end())
+		return it->second;
+
+	//Class files use modified UTF-8, which encodes the null character with two bytes.
+	size_t length = str.size() + std::count(str.begin(), str.end(), '\0');
+	m_maxUtf8Length = std::max(m_maxUtf8Length, length);
+
+	m_data.PutU1(CONSTANT_Utf8);
+	m_data.PutU2((unsigned short) length);
+	for (char c : str){
+		if (c == '\0'){
+			m_data.PutU1(0xC0);
+			m_data.PutU1(0x80);
+		}
+		else
+			m_data.PutU1((unsigned char) c);
+	}
+
+	unsigned short index = NextIndex();
+	m_utf8.emplace(str, index);
+	return index;
+}
+
+unsigned short ConstantPool::AddInteger(int value){
+	auto it = m_integers.find(value);
+	if (it != m_integers.end())
+		return it->second;
+
+	m_data.PutU1(CONSTANT_Integer);
+	m_data.PutU4((unsigned int) value);
+
+	unsigned short index = NextIndex();
+	m_integers.emplace(value, index);
+	return index;
+}
+
+unsigned short ConstantPool::AddFloat(float value){
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	auto it = m_floats.find(bits);
+	if (it != m_floats.end())
+		return it->second;
+
+	m_data.PutU1(CONSTANT_Float);
+	m_data.PutU4(bits);
+
+	unsigned short index = NextIndex();
+	m_floats.emplace(bits, index);
+	return index;
+}
+
+unsigned short ConstantPool::AddString(const std::string& str){
+	unsigned short utf8 = AddUtf8(str);
+
+	auto it = m_strings.find(utf8);
+	if (it != m_strings.end())
+		return it->second;
+
+	m_data.PutU1(CONSTANT_String);
+	m_data.PutU2(utf8);
+
+	unsigned short index = NextIndex();
+	m_strings.emplace(utf8, index);
+	return index;
+}
+
+unsigned short ConstantPool::AddClass(const std::string& name){
+	unsigned short utf8 = AddUtf8(name);
+
+	auto it = m_classes.find(utf8);
+	if (it != m_classes.end())
+		return it->second;
+
+	m_data.PutU1(CONSTANT_Class);
+	m_data.PutU2(utf8);
+
+	unsigned short index = NextIndex();
+	m_classes.emplace(utf8, index);
+	return index;
+}
+
+unsigned short ConstantPool::AddNameAndType(const std::string& name, const std::string& descriptor){
+	unsigned short nameIndex = AddUtf8(name);
+	unsigned short descIndex = AddUtf8(descriptor);
+	unsigned int key = (unsigned int) nameIndex << 16 | descIndex;
+
+	auto it = m_nameAndTypes.find(key);
+	if (it != m_nameAndTypes.end())
+		return it->second;
+
+	m_data.PutU1(CONSTANT_NameAndType);
+	m_data.PutU2(nameIndex);
+	m_data.PutU2(descIndex);
+
+	unsigned short index = NextIndex();
+	m_nameAndTypes.emplace(key, index);
+	return index;
+}
+
+unsigned short ConstantPool::AddMemberRef(const std::string& owner, const std::string& name, const std::string& descriptor, bool isMethod){
+	unsigned char tag = isMethod ? CONSTANT_Methodref : CONSTANT_Fieldref;
+	unsigned short classIndex = AddClass(owner);
+	unsigned short natIndex = AddNameAndType(name, descriptor);
+	unsigned long long key = (unsigned long long) tag << 32 | (unsigned int) classIndex << 16 | natIndex;
+
+	auto it = m_memberRefs.find(key);
+	if (it != m_memberRefs.end())
+		return it->second;
+
+	m_data.PutU1(tag);
+	m_data.PutU2(classIndex);
+	m_data.PutU2(natIndex);
+
+	unsigned short index = NextIndex();
+	m_memberRefs.emplace(key, index);
+	return index;
+}
+
+
+//Opcode of every Op, 0 for pseudo instructions. The order must match enum class Op.
+static const unsigned char g_opcodes[] = {
+	0x00,	//Label
+
+	0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,	//iconst_m1 - iconst_5
+	0x10,	//bipush
+	0x11,	//sipush
+	0x12,	//ldc (int)
+	0x12,	//ldc (float)
+	0x12,	//ldc (string)
+	0x01,	//aconst_null
+
+	0x15,	//iload
+	0x17,	//fload
+	0x19,	//aload
+	0x36,	//istore
+	0x38,	//fstore
+	0x3a,	//astore
+	0x84,	//iinc
+
+	0x2e,	//iaload
+	0x30,	//faload
+	0x33,	//baload
+	0x32,	//aaload
+	0x4f,	//iastore
+	0x51,	//fastore
+	0x54,	//bastore
+	0x53,	//aastore
+	0xbe,	//arraylength
+
+	0x60,	//iadd
+	0x64,	//isub
+	0x68,	//imul
+	0x6c,	//idiv
+	0x70,	//irem
+	0x74,	//ineg
+	0x62,	//fadd
+	0x66,	//fsub
+	0x6a,	//fmul
+	0x6e,	//fdiv
+	0x76,	//fneg
+	0x7e,	//iand
+	0x80,	//ior
+	0x82,	//ixor
+	0x95,	//fcmpl
+	0x96,	//fcmpg
+
+	0x99,	//ifeq
+	0x9a,	//ifne
+	0x9b,	//iflt
+	0x9c,	//ifge
+	0x9d,	//ifgt
+	0x9e,	//ifle
+	0x9f,	//if_icmpeq
+	0xa0,	//if_icmpne
+	0xa1,	//if_icmplt
+	0xa2,	//if_icmpge
+	0xa3,	//if_icmpgt
+	0xa4,	//if_icmple
+	0xa5,	//if_acmpeq
+	0xa6,	//if_acmpne
+	0xa7,	//goto
+
+	0xac,	//ireturn
+	0xae,	//freturn
+	0xb0,	//areturn
+	0xb1,	//return
+
+	0xb2,	//getstatic
+	0xb3,	//putstatic
+	0xb8,	//invokestatic
+	0xb6,	//invokevirtual
+	0xb7,	//invokespecial
+
+	0x57,	//pop
+	0x59,	//dup
+};
+
+static_assert(sizeof(g_opcodes) / sizeof(g_opcodes[0]) == (size_t) Op::NumOps, "g_opcodes does not match Op");
+
+const unsigned char OPCODE_WIDE = 0xc4;
+
+void ClassWriter::PutLocalInstr(OutputBuffer& code, unsigned char opcode, unsigned char shortOpcode, int index){
+	if (index <= 3)
+		code.PutU1(shortOpcode + (unsigned char) index);	//xload_0 - xload_3
+	else if (index <= 255){
+		code.PutU1(opcode);
+		code.PutU1((unsigned char) index);
+	}
+	else{
+		code.PutU1(OPCODE_WIDE);
+		code.PutU1(opcode);
+		code.PutU2((unsigned short) index);
+	}
+}
+
+void ClassWriter::PutConstant(OutputBuffer& code, unsigned short poolIndex){
+	if (poolIndex <= 255){
+		code.PutU1(0x12);	//ldc
+		code.PutU1((unsigned char) poolIndex);
+	}
+	else{
+		code.PutU1(0x13);	//ldc_w
+		code.PutU2(poolIndex);
+	}
+}
+
+unsigned short ClassWriter::GetRef(int index){
+	if (m_refIndices[index] == 0){
+		const MemberRef& ref = m_class.refs[index];
+		m_refIndices[index] = m_pool.AddMemberRef(ref.owner, ref.name, ref.descriptor, ref.isMethod);
+	}
+	return m_refIndices[index];
+}
+
+unsigned short ClassWriter::GetString(int index){
+	if (m_stringIndices[index] == 0)
+		m_stringIndices[index] = m_pool.AddString(unquote_string_literal(m_class.strings[index]));
+	return m_stringIndices[index];
+}
+
+bool ClassWriter::AssembleMethod(const JvmMethod& method, OutputBuffer& code){
+	struct BranchFixup{
+		size_t instrOffset;
+		int label;
+	};
+	std::vector<BranchFixup> fixups;
+
+	m_labelOffsets.assign(method.numLabels, -1);
+
+	for (const Instr& instr : method.code){
+		const size_t offset = code.Size();
+
+		switch (instr.op){
+		case Op::Label:
+			m_labelOffsets[instr.operand] = (int) offset;
+			break;
+
+		case Op::BIPush:
+			code.PutU1(g_opcodes[(int) instr.op]);
+			code.PutU1((unsigned char) instr.operand);
+			break;
+		case Op::SIPush:
+			code.PutU1(g_opcodes[(int) instr.op]);
+			code.PutU2((unsigned short) instr.operand);
+			break;
+		case Op::LdcInt:
+			PutConstant(code, m_pool.AddInteger(instr.operand));
+			break;
+		case Op::LdcFloat:
+			if (instr.fOperand == 0.0f && !std::signbit(instr.fOperand))
+				code.PutU1(0x0b);	//fconst_0
+			else if (instr.fOperand == 1.0f)
+				code.PutU1(0x0c);	//fconst_1
+			else if (instr.fOperand == 2.0f)
+				code.PutU1(0x0d);	//fconst_2
+			else
+				PutConstant(code, m_pool.AddFloat(instr.fOperand));
+			break;
+		case Op::LdcString:
+			PutConstant(code, GetString(instr.operand));
+			break;
+
+		case Op::ILoad:		PutLocalInstr(code, 0x15, 0x1a, instr.operand); break;
+		case Op::FLoad:		PutLocalInstr(code, 0x17, 0x22, instr.operand); break;
+		case Op::ALoad:		PutLocalInstr(code, 0x19, 0x2a, instr.operand); break;
+		case Op::IStore:	PutLocalInstr(code, 0x36, 0x3b, instr.operand); break;
+		case Op::FStore:	PutLocalInstr(code, 0x38, 0x43, instr.operand); break;
+		case Op::AStore:	PutLocalInstr(code, 0x3a, 0x4b, instr.operand); break;
+
+		case Op::IInc:
+			if (instr.operand <= 255 && instr.operand2 >= -128 && instr.operand2 <= 127){
+				code.PutU1(g_opcodes[(int) instr.op]);
+				code.PutU1((unsigned char) instr.operand);
+				code.PutU1((unsigned char) instr.operand2);
+			}
+			else{
+				code.PutU1(OPCODE_WIDE);
+				code.PutU1(g_opcodes[(int) instr.op]);
+				code.PutU2((unsigned short) instr.operand);
+				code.PutU2((unsigned short) instr.operand2);
+			}
+			break;
+
+		case Op::IfEq:
+		case Op::IfNe:
+		case Op::IfLt:
+		case Op::IfGe:
+		case Op::IfGt:
+		case Op::IfLe:
+		case Op::IfICmpEq:
+		case Op::IfICmpNe:
+		case Op::IfICmpLt:
+		case Op::IfICmpGe:
+		case Op::IfICmpGt:
+		case Op::IfICmpLe:
+		case Op::IfACmpEq:
+		case Op::IfACmpNe:
+		case Op::Goto:
+			fixups.push_back(BranchFixup{ offset, instr.operand });
+			code.PutU1(g_opcodes[(int) instr.op]);
+			code.PutU2(0);	//patched below
+			break;
+
+		case Op::GetStatic:
+		case Op::PutStatic:
+		case Op::InvokeStatic:
+		case Op::InvokeVirtual:
+		case Op::InvokeSpecial:
+			code.PutU1(g_opcodes[(int) instr.op]);
+			code.PutU2(GetRef(instr.operand));
+			break;
+
+		default:
+			code.PutU1(g_opcodes[(int) instr.op]);
+			break;
+		}
+	}
+
+	if (code.Size() > 65535){
+		m_error = string_format("Method '%s' exceeds the maximum code size of 65535 bytes.", method.name.c_str());
+		return false;
+	}
+
+	//Patch the branch offsets, they are relative to the branch instruction.
+	for (const BranchFixup& fixup : fixups){
+		int delta = m_labelOffsets[fixup.label] - (int) fixup.instrOffset;
+
+		if (delta < -32768 || delta > 32767){
+			m_error = string_format("Branch offset too large in method '%s'.", method.name.c_str());
+			return false;
+		}
+
+		code.PatchU2(fixup.instrOffset + 1, (unsigned short) delta);
+	}
+
+	return true;
+}
+
+bool ClassWriter::Write(OutputBuffer& out){
+	m_refIndices.assign(m_class.refs.size(), 0);
+	m_stringIndices.assign(m_class.strings.size(), 0);
+	m_error.clear();
+
+	const unsigned short thisClass = m_pool.AddClass(m_class.name);
+	const unsigned short superClass = m_pool.AddClass("java/lang/Object");
+	const unsigned short codeName = m_pool.AddUtf8("Code");
+
+	//Everything after the constant pool. Assembling methods adds pool entries, so the pool can only be written afterwards.
+	OutputBuffer body(64 * 1024);
+	OutputBuffer code(16 * 1024);
+
+	body.PutU2(JvmClass::ACC_PUBLIC | JvmClass::ACC_SUPER);
+	body.PutU2(thisClass);
+	body.PutU2(superClass);
+	body.PutU2(0);	//interfaces
+
+	body.PutU2((unsigned short) m_class.fields.size());
+	for (const auto& field : m_class.fields){
+		body.PutU2(field.accessFlags);
+		body.PutU2(m_pool.AddUtf8(field.name));
+		body.PutU2(m_pool.AddUtf8(field.descriptor));
+		body.PutU2(0);	//attributes
+	}
+
+	body.PutU2((unsigned short) m_class.methods.size());
+	for (const auto& method : m_class.methods){
+		code.Clear();
+		if (!AssembleMethod(method, code))
+			return false;
+
+		body.PutU2(method.accessFlags);
+		body.PutU2(m_pool.AddUtf8(method.name));
+		body.PutU2(m_pool.AddUtf8(method.descriptor));
+		body.PutU2(1);	//attributes
+
+		//Code attribute
+		body.PutU2(codeName);
+		body.PutU4((unsigned int) (12 + code.Size()));
+		body.PutU2((unsigned short) method.maxStack);
+		body.PutU2((unsigned short) method.maxLocals);
+		body.PutU4((unsigned int) code.Size());
+		body.Put(code.Data(), code.Size());
+		body.PutU2(0);	//exception table
+		body.PutU2(0);	//attributes
+	}
+
+	body.PutU2(0);	//class attributes
+
+	if (m_pool.GetCount() > 65535){
+		m_error = "The constant pool exceeds 65535 entries.";
+		return false;
+	}
+
+	if (m_pool.GetMaxUtf8Length() > 65535){
+		m_error = "A string constant or name exceeds the maximum length of 65535 bytes.";
+		return false;
+	}
+
+	out.PutU4(0xCAFEBABE);
+	out.PutU2(0);	//minor version
+	out.PutU2(JVM_CLASS_VERSION);
+	m_pool.Write(out);
+	out.Put(body.Data(), body.Size());
+
+	return true;
+}
\ No newline at end of file
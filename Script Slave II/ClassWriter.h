@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include "CodeGen.h"
+#include "OutputBuffer.h"
+
+//Constant pool of a class file. Every entry is only added once.
+class ConstantPool{
+public:
+	unsigned short AddUtf8(const std::string& str);
+	unsigned short AddInteger(int value);
+	unsigned short AddFloat(float value);
+	unsigned short AddString(const std::string& str);
+	unsigned short AddClass(const std::string& name);
+	unsigned short AddNameAndType(const std::string& name, const std::string& descriptor);
+	unsigned short AddMemberRef(const std::string& owner, const std::string& name, const std::string& descriptor, bool isMethod);
+
+	//Number of entries + 1, as stored in the class file
+	unsigned int GetCount() const { return m_count; }
+
+	//Encoded length of the longest Utf8 entry, the class file only has 2 bytes for it
+	size_t GetMaxUtf8Length() const { return m_maxUtf8Length; }
+
+	void Write(OutputBuffer& out) const {
+		out.PutU2((unsigned short) m_count);
+		out.Put(m_data.Data(), m_data.Size());
+	}
+
+	ConstantPool()
+		: m_data(4096), m_count(1), m_maxUtf8Length(0)
+	{}
+
+private:
+	unsigned short NextIndex(){
+		return (unsigned short) m_count++;
+	}
+
+	OutputBuffer m_data;
+	unsigned int m_count;
+	size_t m_maxUtf8Length;
+
+	std::unordered_map<std::string, unsigned short> m_utf8;
+	std::unordered_map<int, unsigned short> m_integers;
+	std::unordered_map<unsigned int, unsigned short> m_floats;		//Keyed by bit pattern, so -0.0f and NaNs are kept apart
+	std::unordered_map<unsigned short, unsigned short> m_strings;	//Utf8 index -> String index
+	std::unordered_map<unsigned short, unsigned short> m_classes;	//Utf8 index -> Class index
+	std::unordered_map<unsigned int, unsigned short> m_nameAndTypes;	//(name << 16 | descriptor) -> NameAndType index
+	std::unordered_map<unsigned long long, unsigned short> m_memberRefs;	//(tag << 32 | class << 16 | nameAndType) -> Fieldref/Methodref index
+};
+
+//Assembles a JvmClass into a binary class file, so no external assembler is needed.
+class ClassWriter{
+public:
+
+	//Writes the complete class file into 'out'. Returns false if a JVM limit is exceeded, see GetError().
+	bool Write(OutputBuffer& out);
+
+	const std::string& GetError() const {
+		return m_error;
+	}
+
+	ClassWriter(const JvmClass& cls)
+		: m_class(cls)
+	{}
+
+private:
+	bool AssembleMethod(const JvmMethod& method, OutputBuffer& code);
+
+	void PutLocalInstr(OutputBuffer& code, unsigned char opcode, unsigned char shortOpcode, int index);
+	void PutConstant(OutputBuffer& code, unsigned short poolIndex);
+	unsigned short GetRef(int index);
+	unsigned short GetString(int index);
+
+	const JvmClass& m_class;
+	ConstantPool m_pool;
+	std::vector<unsigned short> m_refIndices;		//JvmClass::refs index -> constant pool index, 0 if not added yet
+	std::vector<unsigned short> m_stringIndices;	//JvmClass::strings index -> constant pool index, 0 if not added yet
+	std::vector<int> m_labelOffsets;
+	std::string m_error;
+};
\ No newline at end of file
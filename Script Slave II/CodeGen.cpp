@@ -1,284 +1,972 @@
 #include "CodeGen.h"
 
-#include <iostream>
 #include <algorithm>
-#include <fstream>
-#include <stack>
+#include "ClassWriter.h"
+#include <unordered_map>
 #include "BaseVisitor.h"
-/*
+#include "StringUtil.h"
+
+enum OperandKind{
+	NoOperand,
+	IntOperand,
+	FloatOperand,
+	StringOperand,
+	LabelOperand,
+	RefOperand
+};
+
+struct InstrTemplate{
+	const char* text;		//Preformatted Jasmin text, including indentation and a trailing space if an operand follows.
+	size_t length;
+	OperandKind operand;
+	int stackDelta;			//Invoke instructions additionally apply MemberRef::stackDelta
+};
+
+#define INSTR(text, operand, delta) { text, sizeof(text) - 1, operand, delta }
+
+static const InstrTemplate g_instrTemplates[] = {
+	INSTR("", LabelOperand, 0),
+
+	INSTR("\ticonst_m1", NoOperand, 1),
+	INSTR("\ticonst_0", NoOperand, 1),
+	INSTR("\ticonst_1", NoOperand, 1),
+	INSTR("\ticonst_2", NoOperand, 1),
+	INSTR("\ticonst_3", NoOperand, 1),
+	INSTR("\ticonst_4", NoOperand, 1),
+	INSTR("\ticonst_5", NoOperand, 1),
+	INSTR("\tbipush ", IntOperand, 1),
+	INSTR("\tsipush ", IntOperand, 1),
+	INSTR("\tldc ", IntOperand, 1),
+	INSTR("\tldc ", FloatOperand, 1),
+	INSTR("\tldc ", StringOperand, 1),
+	INSTR("\taconst_null", NoOperand, 1),
+
+	INSTR("\tiload ", IntOperand, 1),
+	INSTR("\tfload ", IntOperand, 1),
+	INSTR("\taload ", IntOperand, 1),
+	INSTR("\tistore ", IntOperand, -1),
+	INSTR("\tfstore ", IntOperand, -1),
+	INSTR("\tastore ", IntOperand, -1),
+	INSTR("\tiinc ", IntOperand, 0),
+
+	INSTR("\tiaload", NoOperand, -1),
+	INSTR("\tfaload", NoOperand, -1),
+	INSTR("\tbaload", NoOperand, -1),
+	INSTR("\taaload", NoOperand, -1),
+	INSTR("\tiastore", NoOperand, -3),
+	INSTR("\tfastore", NoOperand, -3),
+	INSTR("\tbastore", NoOperand, -3),
+	INSTR("\taastore", NoOperand, -3),
+	INSTR("\tarraylength", NoOperand, 0),
+
+	INSTR("\tiadd", NoOperand, -1),
+	INSTR("\tisub", NoOperand, -1),
+	INSTR("\timul", NoOperand, -1),
+	INSTR("\tidiv", NoOperand, -1),
+	INSTR("\tirem", NoOperand, -1),
+	INSTR("\tineg", NoOperand, 0),
+	INSTR("\tfadd", NoOperand, -1),
+	INSTR("\tfsub", NoOperand, -1),
+	INSTR("\tfmul", NoOperand, -1),
+	INSTR("\tfdiv", NoOperand, -1),
+	INSTR("\tfneg", NoOperand, 0),
+	INSTR("\tiand", NoOperand, -1),
+	INSTR("\tior", NoOperand, -1),
+	INSTR("\tixor", NoOperand, -1),
+	INSTR("\tfcmpl", NoOperand, -1),
+	INSTR("\tfcmpg", NoOperand, -1),
+
+	INSTR("\tifeq ", LabelOperand, -1),
+	INSTR("\tifne ", LabelOperand, -1),
+	INSTR("\tiflt ", LabelOperand, -1),
+	INSTR("\tifge ", LabelOperand, -1),
+	INSTR("\tifgt ", LabelOperand, -1),
+	INSTR("\tifle ", LabelOperand, -1),
+	INSTR("\tif_icmpeq ", LabelOperand, -2),
+	INSTR("\tif_icmpne ", LabelOperand, -2),
+	INSTR("\tif_icmplt ", LabelOperand, -2),
+	INSTR("\tif_icmpge ", LabelOperand, -2),
+	INSTR("\tif_icmpgt ", LabelOperand, -2),
+	INSTR("\tif_icmple ", LabelOperand, -2),
+	INSTR("\tif_acmpeq ", LabelOperand, -2),
+	INSTR("\tif_acmpne ", LabelOperand, -2),
+	INSTR("\tgoto ", LabelOperand, 0),
+
+	INSTR("\tireturn", NoOperand, -1),
+	INSTR("\tfreturn", NoOperand, -1),
+	INSTR("\tareturn", NoOperand, -1),
+	INSTR("\treturn", NoOperand, 0),
+
+	INSTR("\tgetstatic ", RefOperand, 1),
+	INSTR("\tputstatic ", RefOperand, -1),
+	INSTR("\tinvokestatic ", RefOperand, 0),
+	INSTR("\tinvokevirtual ", RefOperand, 0),
+	INSTR("\tinvokespecial ", RefOperand, 0),
+
+	INSTR("\tpop", NoOperand, -1),
+	INSTR("\tdup", NoOperand, 1),
+};
+
+#undef INSTR
+
+static_assert(sizeof(g_instrTemplates) / sizeof(g_instrTemplates[0]) == (size_t) Op::NumOps, "g_instrTemplates does not match Op");
+
+//Pointers to the native types, so types can be compared without string comparisons.
+struct NativeTypes{
+	TypeInfo const* voidType;
+	TypeInfo const* intType;
+	TypeInfo const* floatType;
+	TypeInfo const* boolType;
+	TypeInfo const* stringType;
+
+	NativeTypes(const TypeTable& tt)
+		: voidType(tt.Get("void")), intType(tt.Get("int")), floatType(tt.Get("float")),
+		boolType(tt.Get("bool")), stringType(tt.Get("string"))
+	{}
+
+	//Returns an empty string for types the JVM backend can't represent.
+	std::string GetDescriptor(TypeInfo const* ti) const {
+		if (ti == nullptr)
+			return "";
+
+		std::string simple = ti->GetSimpleTypeName();
+		std::string desc;
+
+		if (simple == "int")			desc = "I";
+		else if (simple == "float")		desc = "F";
+		else if (simple == "bool")		desc = "Z";
+		else if (simple == "string")	desc = "Ljava/lang/String;";
+		else if (simple == "void" && !ti->isArray) desc = "V";
+		else return "";
+
+		return ti->isArray ? "[" + desc : desc;
+	}
+
+	bool IsIntLike(TypeInfo const* ti) const {
+		return ti == intType || ti == boolType;
+	}
+};
+
 class CodeWalker : public BaseVisitor{
 public:
-	//EXPRESSIONS
-	virtual void outNode( UnOp* n, bool last ){
-		std::string op;
-
-		switch( n->GetType() ){
-		case UnOp::Not:
-			AddLine( "  iconst_1" );
-			AddLine( "  ixor" );
-			IncStackDepth( 1 );	//Inc stack by one to account for the iconst_1
-			IncStackDepth( -1 ); //dec because of ixor
-			break;
-		case UnOp::Neg:
-			AddLine( "  ineg" );
-			break;
+
+	void GenerateMethod(FuncDef* n, JvmMethod& method){
+		m_method = &method;
+		m_locals.clear();
+		m_numLocals = 0;
+		m_labelCounter = 0;
+		m_currStackDepth = 0;
+		m_maxStackDepth = 0;
+
+		for (const auto& param : n->GetParamList()->GetChildren())
+			m_locals[param.get()] = m_numLocals++;
+
+		ACCEPT(GetStmtBlock(), true);
+
+		//The JVM must not fall off the end of a method, so add a return if the function doesn't end with one.
+		const auto& stmts = n->GetStmtBlock()->GetChildren();
+		if (stmts.empty() || stmts.back()->GetNodeType() != NodeType::StmtReturn){
+			TypeInfo const* retType = n->GetRetType()->GetTypeInfo();
+			if (retType != m_types.voidType)
+				PushDefault(retType);
+			EmitReturn(retType);
 		}
+
+		method.numLabels = m_labelCounter;
+		method.maxStack = std::max(m_maxStackDepth, 1);
+		method.maxLocals = std::max(m_numLocals, 1);
 	}
 
-	//private
-	std::string makeBranch( std::string op ){
-		const auto label = "L" + std::to_string( m_labelCounter++ );
-		const auto lc1 = label + "_true";
-		const auto lc2 = label + "_end";
-		std::string out =
-			"  " + op + " " + lc1 + "\n"
-			"  iconst_0\n"
-			"  goto " + lc2 + "\n"
-			+ lc1 + ":\n"
-			"  iconst_1\n"
-			+ lc2 + ":";
-
-
-		//IncStackDepth( -1 ); //push iconst_0 or iconst_1, but pop two operands because of 'op'. Will be added in outNode.
-
-		return out;
-	}
-
-	virtual void outNode( BinOp* n, bool last ){
-		std::string op;
-
-		switch( n->GetType() ){
-		case BinOp::Equal:		op = makeBranch( "if_icmpeq" ); break;
-		case BinOp::Unequal:	op = makeBranch( "if_icmpne" ); break;
-		case BinOp::LThan:		op = makeBranch( "if_icmplt" ); break;
-		case BinOp::LThanEq:	op = makeBranch( "if_icmple" ); break;
-		case BinOp::GThan:		op = makeBranch( "if_icmpgt" ); break;
-		case BinOp::GThanEq:	op = makeBranch( "if_icmpge" ); break;
-		case BinOp::And:		op = "  iand"; break;
-		case BinOp::Or:			op = "  ior"; break;
-		case BinOp::Xor:		op = "  ixor"; break;
-		case BinOp::Add:		op = "  iadd"; break;
-		case BinOp::Sub:		op = "  isub"; break;
-		case BinOp::Mul:		op = "  imul"; break;
-		case BinOp::Div:		op = "  idiv"; break;
-		case BinOp::Mod:		op = "  irem"; break;
+	//STATEMENTS
+	virtual void visit(StmtVarDecl* n, bool last){
+		int slot = m_numLocals++;
+		m_locals[n] = slot;
+
+		TypeInfo const* type = n->GetType()->GetTypeInfo();
+
+		if (n->GetExpr())
+			GenExpr(n->GetExpr());
+		else
+			PushDefault(type);
+
+		StoreLocal(type, slot, n->GetName()->GetSymbol());
+	}
+
+	virtual void visit(StmtAssign* n, bool last){
+		Expr* lhs = n->GetLHS();
+
+		if (lhs->GetNodeType() == NodeType::Ident){
+			Ident* ident = (Ident*) lhs;
+			Symbol const* sym = ident->GetSymbol();
+
+			GenExpr(n->GetExpr());
+
+			if (sym->type == Symbol::GLOBAL_VAR)
+				Emit(Op::PutStatic, m_refs.at(sym->GetNode()));
+			else if (sym->type == Symbol::VARIABLE || sym->type == Symbol::PARAMETER)
+				StoreLocal(ident->GetTypeInfo(), m_locals.at(sym->GetNode()), sym);
+			else
+				AddError(lhs->GetToken(), "Assignment to '%s' is not supported by the code generator.", ident->GetName().c_str());
+			return;
+		}
+
+		if (lhs->GetNodeType() == NodeType::BinOp && ((BinOp*) lhs)->GetType() == BinOp::Subscript){
+			BinOp* subscript = (BinOp*) lhs;
+
+			GenExpr(subscript->GetLeft());
+			GenExpr(subscript->GetRight());
+			GenExpr(n->GetExpr());
+
+			TypeInfo const* elemType = subscript->GetTypeInfo();
+			if (elemType == m_types.intType)		Emit(Op::IAStore);
+			else if (elemType == m_types.floatType)	Emit(Op::FAStore);
+			else if (elemType == m_types.boolType)	Emit(Op::BAStore);
+			else									Emit(Op::AAStore);
+			return;
 		}
-		AddLine( op );
 
-		IncStackDepth( -1 ); //2 popped, result pushed
+		if (lhs->GetNodeType() == NodeType::BinOp && ((BinOp*) lhs)->GetType() == BinOp::MemberAccess){
+			RejectMemberAccess((BinOp*) lhs);
+			return;
+		}
+
+		AddError(lhs->GetToken(), "Assignment target is not supported by the code generator.");
 	}
 
+	virtual void visit(StmtFuncCall* n, bool last){
+		GenCall(n->GetName(), n->GetArgList());
 
-	virtual bool inNode( Ident* n, bool last ){
-		//auto var = m_table.GetVariable( n->GetName() );
+		if (n->GetName()->GetSymbol()->GetTypeInfo() != m_types.voidType)
+			Emit(Op::Pop, 0, "discard return value");
+	}
+
+	virtual void visit(StmtReturn* n, bool last){
+		if (n->GetExpr() == nullptr){
+			Emit(Op::Return);
+			return;
+		}
 
-		//AddLine( "  iload " + std::to_string( var.Get().m_varIndex ), "load " + n->GetName() );
+		GenExpr(n->GetExpr());
+		EmitReturn(n->GetExpr()->GetTypeInfo());
+	}
 
-		IncStackDepth( 1 ); //value pushed
-		return true;
+	virtual void visit(StmtBreak* n, bool last){
+		Emit(Op::Goto, m_breakLabels.back(), "break");
 	}
 
-	virtual bool inNode( IntLit* n, bool last ){
-		int i = n->GetValue();
-		std::string instr;
+	virtual void visit(StmtWhile* n, bool last){
+		const int lstart = NewLabel();
+		const int lend = NewLabel();
 
-		//use best instruction depending on value of i: iconst_x < bipush < sipush < ldc
-		if( i == -1 )
-			instr = "  iconst_m1";
-		else if( i >= 0 && i <= 5 )
-			instr = "  iconst_" + std::to_string( i );
-		else if( i >= -128 && i <= 127 )
-			instr = "  bipush " + std::to_string( i );
-		else if( i >= -32768 && i <= 32767 )
-			instr = "  sipush " + std::to_string( i );
-		else
-			instr = "  ldc " + std::to_string( i );
+		Emit(Op::Label, lstart, "start of while");
+
+		//No jump is emitted for while(true), it is only left through a break
+		GenCondJump(n->GetExpr(), false, lend);
 
-		AddLine( instr, "push " + std::to_string( i ) );
-		IncStackDepth( 1 ); //value pushed
+		m_breakLabels.push_back(lend);
+		ACCEPT(GetBody(), true);
+		m_breakLabels.pop_back();
 
-		return true;
+		Emit(Op::Goto, lstart);
+		Emit(Op::Label, lend, "end of while");
 	}
 
-	virtual bool inNode( BoolLit* n, bool last ){
-		std::string lit = (n->GetValue() == true) ? "true" : "false";
-		AddLine( "  iconst_" + std::to_string( n->GetValue() ), "push " + lit );
-		IncStackDepth( 1 ); //value pushed
-		return true;
+	virtual void visit(StmtIfThen* n, bool last){
+		const int lskip = NewLabel();
+		GenCondJump(n->GetExpr(), false, lskip);
+
+		ACCEPT(GetThen(), true);
+
+		Emit(Op::Label, lskip, "end of if-then");
 	}
 
+	virtual void visit(StmtIfThenElse* n, bool last){
+		const int lelse = NewLabel();
+		const int lend = NewLabel();
+		GenCondJump(n->GetExpr(), false, lelse);
+
+		ACCEPT(GetThen(), true);
 
+		Emit(Op::Goto, lend);
+		Emit(Op::Label, lelse);
 
+		ACCEPT(GetElse(), true);
 
-	virtual bool inNode( StmtBreak* n, bool last ){
-		AddLine( "  goto " + m_labelStack.top(), "break" );
-		return true;
+		Emit(Op::Label, lend, "end of if-then-else");
 	}
 
-	virtual bool inNode( StmtLet* n, bool last ){
-		n->GetExprRef()->accept( this, true );
-		return false;
+	CodeWalker(JvmClass& cls, const NativeTypes& types, const std::map<ASTNode const*, int>& refs, std::vector<std::pair<std::string, Token>>& errors)
+		: m_class(cls), m_types(types), m_refs(refs), m_errors(errors), m_method(nullptr),
+		m_concatRef(-1), m_equalsRef(-1), m_valueOfRefs()
+	{}
+
+private:
+
+	//EXPRESSIONS
+	void GenExpr(Expr* p){
+		switch (p->GetNodeType()){
+		case NodeType::IntLit:
+			PushInt(((IntLit*) p)->GetValue());
+			return;
+		case NodeType::FloatLit:
+		{
+			Instr instr(Op::LdcFloat);
+			instr.fOperand = ((FloatLit*) p)->GetValue();
+			Emit(instr);
+			return;
+		}
+		case NodeType::BoolLit:
+			Emit(((BoolLit*) p)->GetValue() ? Op::IConst1 : Op::IConst0);
+			return;
+		case NodeType::StringLit:
+			Emit(Op::LdcString, GetStringIndex(((StringLit*) p)->GetValue()));
+			return;
+		case NodeType::Ident:
+			Load((Ident*) p);
+			return;
+		case NodeType::UnOp:
+		{
+			UnOp* n = (UnOp*) p;
+			GenExpr(n->GetExpr());
+
+			if (n->GetType() == UnOp::Not){
+				Emit(Op::IConst1);
+				Emit(Op::IXor, 0, "not");
+			}
+			else if (n->GetExpr()->GetTypeInfo() == m_types.floatType)
+				Emit(Op::FNeg);
+			else
+				Emit(Op::INeg);
+			return;
+		}
+		case NodeType::BinOp:
+			GenBinOp((BinOp*) p);
+			return;
+		case NodeType::FuncCallExpr:
+		{
+			FuncCallExpr* n = (FuncCallExpr*) p;
+			GenCall(n->GetCallee(), n->GetArgs());
+			return;
+		}
+		default:
+			AddError(p->GetToken(), "Expression '%s' is not supported by the code generator.", p->GetNodeAsString().c_str());
+			return;
+		}
 	}
-	virtual void outNode( StmtLet* n, bool last ){
-		//const auto& name = n->GetVar()->GetName();
-		//auto var = m_table.GetVariable( name );
-		//AddLine( "  istore " + std::to_string( var.Get().m_varIndex ), "store in " + name );
-		//IncStackDepth( -1 );//value popped
+
+	void GenBinOp(BinOp* n){
+		TypeInfo const* lt = n->GetLeft()->GetTypeInfo();
+		const bool isFloat = lt == m_types.floatType;
+
+		switch (n->GetType()){
+		case BinOp::Add:
+			if (n->GetTypeInfo() == m_types.stringType){
+				GenStringOperand(n->GetLeft());
+				GenStringOperand(n->GetRight());
+				Emit(Op::InvokeVirtual, GetConcatRef(), "concatenate");
+				return;
+			}
+			GenExpr(n->GetLeft());
+			GenExpr(n->GetRight());
+			Emit(isFloat ? Op::FAdd : Op::IAdd);
+			return;
+		case BinOp::Sub:
+			GenExpr(n->GetLeft());
+			GenExpr(n->GetRight());
+			Emit(isFloat ? Op::FSub : Op::ISub);
+			return;
+		case BinOp::Mul:
+			GenExpr(n->GetLeft());
+			GenExpr(n->GetRight());
+			Emit(isFloat ? Op::FMul : Op::IMul);
+			return;
+		case BinOp::Div:
+			GenExpr(n->GetLeft());
+			GenExpr(n->GetRight());
+			Emit(isFloat ? Op::FDiv : Op::IDiv);
+			return;
+		case BinOp::Mod:
+			GenExpr(n->GetLeft());
+			GenExpr(n->GetRight());
+			Emit(Op::IRem);
+			return;
+		case BinOp::And:
+		case BinOp::Or:
+		{
+			//Materialize the result of the short-circuit evaluation as 0 or 1
+			const int lfalse = NewLabel();
+			const int lend = NewLabel();
+
+			GenCondJump(n, false, lfalse);
+			Emit(Op::IConst1);
+			Emit(Op::Goto, lend);
+			Emit(Op::Label, lfalse);
+			Emit(Op::IConst0);
+			Emit(Op::Label, lend);
+			IncStackDepth(-1); //Only one of the two constants is pushed at runtime
+			return;
+		}
+		case BinOp::Xor:
+			GenExpr(n->GetLeft());
+			GenExpr(n->GetRight());
+			Emit(Op::IXor);
+			return;
+		case BinOp::Equal:
+		case BinOp::Unequal:
+		case BinOp::LThan:
+		case BinOp::LThanEq:
+		case BinOp::GThan:
+		case BinOp::GThanEq:
+		{
+			//Materialize the result of the comparison as 0 or 1
+			Op branch = GenCompare(n);
+			const int ltrue = NewLabel();
+			const int lend = NewLabel();
+
+			Emit(branch, ltrue);
+			Emit(Op::IConst0);
+			Emit(Op::Goto, lend);
+			Emit(Op::Label, ltrue);
+			Emit(Op::IConst1);
+			Emit(Op::Label, lend);
+			IncStackDepth(-1); //Only one of the two constants is pushed at runtime
+			return;
+		}
+		case BinOp::Subscript:
+		{
+			GenExpr(n->GetLeft());
+			GenExpr(n->GetRight());
+
+			TypeInfo const* elemType = n->GetTypeInfo();
+			if (elemType == m_types.intType)		Emit(Op::IALoad);
+			else if (elemType == m_types.floatType)	Emit(Op::FALoad);
+			else if (elemType == m_types.boolType)	Emit(Op::BALoad);
+			else									Emit(Op::AALoad);
+			return;
+		}
+		case BinOp::MemberAccess:
+			if (n->GetLeft()->GetTypeInfo()->isArray){
+				GenExpr(n->GetLeft());
+				Emit(Op::ArrayLength);
+				return;
+			}
+			RejectMemberAccess(n);
+			return;
+		default:
+			AddError(n->GetToken(), "Operation '%s' is not supported by the code generator.", BinOp::GetTypeAsString(n->GetType()));
+			return;
+		}
 	}
 
-	void visit( StmtWhile* n, bool last ){
-		const auto label = "L" + std::to_string( m_labelCounter++ );
-		const auto lstart = label + "_start";
-		const auto lend = label + "_end";
+	//Emits a jump to 'label' which is taken if p evaluates to 'jumpIf'. Comparisons branch directly instead of
+	//materializing their result, && and || skip their right operand if the left one decides the result.
+	void GenCondJump(Expr* p, bool jumpIf, int label){
+		switch (p->GetNodeType()){
+		case NodeType::BoolLit:
+			if (((BoolLit*) p)->GetValue() == jumpIf)
+				Emit(Op::Goto, label);
+			return;
+		case NodeType::UnOp:
+			if (((UnOp*) p)->GetType() == UnOp::Not){
+				GenCondJump(((UnOp*) p)->GetExpr(), !jumpIf, label);
+				return;
+			}
+			break;
+		case NodeType::BinOp:
+		{
+			BinOp* n = (BinOp*) p;
+
+			switch (n->GetType()){
+			case BinOp::And:
+			case BinOp::Or:
+			{
+				const bool decidingValue = n->GetType() == BinOp::Or; //false decides &&, true decides ||
+
+				if (decidingValue == jumpIf){
+					GenCondJump(n->GetLeft(), jumpIf, label);
+					GenCondJump(n->GetRight(), jumpIf, label);
+				}
+				else{
+					const int lskip = NewLabel();
+					GenCondJump(n->GetLeft(), decidingValue, lskip);
+					GenCondJump(n->GetRight(), jumpIf, label);
+					Emit(Op::Label, lskip);
+				}
+				return;
+			}
+			case BinOp::Equal:
+			case BinOp::Unequal:
+			case BinOp::LThan:
+			case BinOp::LThanEq:
+			case BinOp::GThan:
+			case BinOp::GThanEq:
+			{
+				Op branch = GenCompare(n);
+				Emit(jumpIf ? branch : NegateBranch(branch), label);
+				return;
+			}
+			default:
+				break;
+			}
+			break;
+		}
+		default:
+			break;
+		}
 
-		AddLine( lstart + ":", "start of while" );
-		ACCEPT( GetExpr(), false );
+		GenExpr(p);
+		Emit(jumpIf ? Op::IfNe : Op::IfEq, label);
+	}
 
-		AddLine( "  ifeq " + lend, "while-loop condition jump" );
-		IncStackDepth( -1 );
+	//Pushes the operands of a comparison and returns the branch instruction that jumps if the comparison is true.
+	Op GenCompare(BinOp* n){
+		TypeInfo const* lt = n->GetLeft()->GetTypeInfo();
+		const BinOp::Types type = n->GetType();
+
+		GenExpr(n->GetLeft());
+		GenExpr(n->GetRight());
+
+		if (m_types.IsIntLike(lt)){
+			switch (type){
+			case BinOp::Equal:		return Op::IfICmpEq;
+			case BinOp::Unequal:	return Op::IfICmpNe;
+			case BinOp::LThan:		return Op::IfICmpLt;
+			case BinOp::LThanEq:	return Op::IfICmpLe;
+			case BinOp::GThan:		return Op::IfICmpGt;
+			default:				return Op::IfICmpGe;
+			}
+		}
 
-		m_labelStack.push( lend );
-		ACCEPT( GetBody(), true );
-		m_labelStack.pop();
+		if (lt == m_types.floatType){
+			//NaN has to make every comparison except != false, so pick fcmpg/fcmpl accordingly
+			Emit(type == BinOp::LThan || type == BinOp::LThanEq ? Op::FCmpG : Op::FCmpL);
+			switch (type){
+			case BinOp::Equal:		return Op::IfEq;
+			case BinOp::Unequal:	return Op::IfNe;
+			case BinOp::LThan:		return Op::IfLt;
+			case BinOp::LThanEq:	return Op::IfLe;
+			case BinOp::GThan:		return Op::IfGt;
+			default:				return Op::IfGe;
+			}
+		}
+
+		if (lt == m_types.stringType){
+			Emit(Op::InvokeVirtual, GetEqualsRef());
+			return type == BinOp::Equal ? Op::IfNe : Op::IfEq;
+		}
 
-		AddLine( "  goto " + lstart );
-		AddLine( lend + ":", "end of while" );
+		return type == BinOp::Equal ? Op::IfACmpEq : Op::IfACmpNe;
 	}
 
-	void visit( StmtIfThen* n, bool last ){
-		ACCEPT( GetExpr(), false );
+	//Pushes the value of p converted to a java/lang/String
+	void GenStringOperand(Expr* p){
+		GenExpr(p);
+
+		TypeInfo const* type = p->GetTypeInfo();
+		if (type == m_types.stringType)
+			return;
 
-		auto label = "L" + std::to_string( m_labelCounter++ ) + "_skip";
-		AddLine( "  ifeq " + label, "start of if-then" );
-		IncStackDepth( -1 );
+		int index = type == m_types.intType ? 0 : type == m_types.floatType ? 1 : type == m_types.boolType ? 2 : 3;
+		static const char* descs[] = { "(I)Ljava/lang/String;", "(F)Ljava/lang/String;", "(Z)Ljava/lang/String;", "(Ljava/lang/Object;)Ljava/lang/String;" };
 
-		ACCEPT( GetThen(), true );
+		if (m_valueOfRefs[index] == 0)
+			m_valueOfRefs[index] = AddRef("java/lang/String", "valueOf", descs[index], 0) + 1;
 
-		AddLine( label + ":", "end of if-then" );
+		Emit(Op::InvokeStatic, m_valueOfRefs[index] - 1);
 	}
 
-	void visit( StmtIfThenElse* n, bool last ){
-		ACCEPT( GetExpr(), false );
+	void GenCall(Ident* callee, ArgList* args){
+		Symbol const* sym = callee->GetSymbol();
 
+		if (sym->type != Symbol::FUNCTION){
+			AddError(callee->GetToken(), "Symbol '%s' is not a function.", sym->name.c_str());
+			return;
+		}
 
-		const auto label = "L" + std::to_string( m_labelCounter++ );
-		const auto lelse = label + "_else";
-		const auto lend = label + "_end";
-		AddLine( "  ifeq " + lelse, "start of if-then-else" );
-		IncStackDepth( -1 );
+		for (const auto& arg : args->GetChildren())
+			GenExpr(arg.get());
 
-		ACCEPT( GetThen(), true );
+		Emit(Op::InvokeStatic, m_refs.at(sym->GetNode()));
+	}
 
-		AddLine( "  goto " + lend );
-		AddLine( lelse + ":" );
+	void Load(Ident* n){
+		Symbol const* sym = n->GetSymbol();
 
-		ACCEPT( GetElse(), true );
+		if (sym->type == Symbol::GLOBAL_VAR){
+			Emit(Op::GetStatic, m_refs.at(sym->GetNode()));
+			return;
+		}
 
-		AddLine( lend + ":", "end of if-then-else" );
+		if (sym->type != Symbol::VARIABLE && sym->type != Symbol::PARAMETER){
+			AddError(n->GetToken(), "Symbol '%s' can not be used as a value by the code generator.", n->GetName().c_str());
+			return;
+		}
+
+		TypeInfo const* type = n->GetTypeInfo();
+		Op op = m_types.IsIntLike(type) ? Op::ILoad : type == m_types.floatType ? Op::FLoad : Op::ALoad;
+		Emit(op, m_locals.at(sym->GetNode()), "load", sym);
 	}
 
-	const std::vector<std::string>& GetCode(){
-		return m_code;
+	void StoreLocal(TypeInfo const* type, int slot, Symbol const* sym){
+		Op op = m_types.IsIntLike(type) ? Op::IStore : type == m_types.floatType ? Op::FStore : Op::AStore;
+		Emit(op, slot, "store in", sym);
 	}
 
-	int GetMaximumStackDepth(){
-		return m_maxStackDepth;
+	//Class files get no classes for the script's class definitions, so their fields can't be accessed. The VM
+	//supports them.
+	void RejectMemberAccess(BinOp* n){
+		AddError(n->GetToken(), "Member '%s' of class '%s' can't be accessed in a class file, class objects are only supported by the VM (-run).",
+			((Ident*) n->GetRight())->GetName().c_str(), n->GetLeft()->GetTypeInfo()->name.c_str());
 	}
 
-	CodeWalker( const SymbolScope& symbolTable )
-		: m_table( symbolTable ), m_labelCounter( 0 ), m_currStackDepth( 0 ), m_maxStackDepth( 0 )
-	{
-		//Shadow initialization, there's only actual need to initialize all variables which are in the in-set of the start node during liveness flow analysis.
-		AddLine( "  ; variable initialization" );
-		const auto& vars = symbolTable.GetAllVariables( );
-		for( auto&& v : vars ){
-			AddLine( "  iconst_0" );
-			//AddLine( "  istore " + std::to_string( v.second.m_varIndex ), "init " + v.first );
+	void PushDefault(TypeInfo const* type){
+		if (m_types.IsIntLike(type))
+			Emit(Op::IConst0);
+		else if (type == m_types.floatType){
+			Instr instr(Op::LdcFloat);
+			instr.fOperand = 0.0f;
+			Emit(instr);
 		}
-		AddLine( "  ; code" );
+		else if (type == m_types.stringType)
+			Emit(Op::LdcString, GetStringIndex("\"\""));
+		else
+			Emit(Op::AConstNull);
 	}
 
-private:
+	void PushInt(int i){
+		//use best instruction depending on value of i: iconst_x < bipush < sipush < ldc
+		if (i >= -1 && i <= 5)
+			Emit((Op) ((int) Op::IConst0 + i));
+		else if (i >= -128 && i <= 127)
+			Emit(Op::BIPush, i);
+		else if (i >= -32768 && i <= 32767)
+			Emit(Op::SIPush, i);
+		else
+			Emit(Op::LdcInt, i);
+	}
 
-	void AddLine( std::string line, std::string comment = "" ){
-		const int tabLength = 4;
-		int commentPadding;
-		const int length = line.length();
+	void EmitReturn(TypeInfo const* type){
+		if (type == m_types.voidType)
+			Emit(Op::Return);
+		else if (m_types.IsIntLike(type))
+			Emit(Op::IReturn);
+		else if (type == m_types.floatType)
+			Emit(Op::FReturn);
+		else
+			Emit(Op::AReturn);
+	}
 
-		if( comment == "" ){
-			m_code.push_back( line );
-			return;
-		}
+	void Emit(Op op, int operand = 0, const char* comment = nullptr, Symbol const* sym = nullptr){
+		Emit(Instr(op, operand, comment, sym));
+	}
+
+	void Emit(const Instr& instr){
+		m_method->code.push_back(instr);
+
+		int delta = g_instrTemplates[(int) instr.op].stackDelta;
+		if (instr.op == Op::InvokeStatic || instr.op == Op::InvokeVirtual || instr.op == Op::InvokeSpecial)
+			delta += m_class.refs[instr.operand].stackDelta;
+
+		IncStackDepth(delta);
+	}
 
-		commentPadding = 8 * tabLength;
+	int NewLabel(){
+		return m_labelCounter++;
+	}
+
+	int GetStringIndex(const std::string& str){
+		auto it = m_stringIndices.find(str);
+		if (it != m_stringIndices.end())
+			return it->second;
+
+		int index = m_class.strings.size();
+		m_class.strings.push_back(str);
+		m_stringIndices.emplace(str, index);
+		return index;
+	}
 
-		int tabNum = (commentPadding - length) / tabLength;
-		while( tabNum < 0 ) tabNum += 2;
+	int AddRef(const char* owner, const char* name, const char* descriptor, int stackDelta){
+		m_class.refs.push_back(MemberRef{ owner, name, descriptor, true, stackDelta });
+		return m_class.refs.size() - 1;
+	}
 
-		if( line.length() % tabLength == 0 ) --tabNum;
-		if( tabNum <= 0 ) tabNum = 1;
+	int GetConcatRef(){
+		if (m_concatRef < 0)
+			m_concatRef = AddRef("java/lang/String", "concat", "(Ljava/lang/String;)Ljava/lang/String;", -1);
+		return m_concatRef;
+	}
 
-		m_code.push_back( line + std::string( tabNum, '\t' ) + "; " + comment );
+	int GetEqualsRef(){
+		if (m_equalsRef < 0)
+			m_equalsRef = AddRef("java/lang/String", "equals", "(Ljava/lang/Object;)Z", -1);
+		return m_equalsRef;
 	}
 
-	void IncStackDepth( int amount ){
+	void IncStackDepth(int amount){
 		m_currStackDepth += amount;
 
 #ifdef DEBUG_BUILD
-		if( m_currStackDepth < 0 )
+		if (m_currStackDepth < 0)
 			__debugbreak();
 #endif
 
-		m_maxStackDepth = std::max( m_maxStackDepth, m_currStackDepth );
+		m_maxStackDepth = std::max(m_maxStackDepth, m_currStackDepth);
 	}
 
-	const SymbolScope& m_table;
-	std::vector<std::string> m_code;
-	std::stack<std::string> m_labelStack;	//For nested while-statements, needed for Break;
+	void AddError(const Token& tok, const std::string fmt_str, ...){
+		va_list ap;
+		va_start(ap, fmt_str);
+		std::string v = va_string_format(fmt_str, ap);
+		m_errors.emplace_back(v, tok);
+		va_end(ap);
+	}
+
+	JvmClass& m_class;
+	const NativeTypes& m_types;
+	const std::map<ASTNode const*, int>& m_refs;		//Declaration node of global variables and functions -> index into m_class.refs
+	std::vector<std::pair<std::string, Token>>& m_errors;
+	std::unordered_map<std::string, int> m_stringIndices;
+
+	JvmMethod* m_method;
+	std::unordered_map<ASTNode const*, int> m_locals;	//Declaration node of parameters and local variables -> local variable index
+	std::vector<int> m_breakLabels;						//For nested while-statements, needed for Break;
+	int m_numLocals;
 	int m_labelCounter;
 	int m_currStackDepth;	//Try to determine the estimated maximum stack depth.
 	int m_maxStackDepth;
+
+	int m_concatRef;
+	int m_equalsRef;
+	int m_valueOfRefs[4];	//index + 1 of String.valueOf for int, float, bool and Object, 0 if not yet added
 };
 
 
-bool CodeGen::Generate( StartBlockPtr& node, const SymbolScope& table ){
-	if( !m_code.empty() )
-		m_code.clear();
+bool CodeGen::Generate( StartBlockPtr& node, const TypeTable& typeTable, std::string className ){
+	m_class = JvmClass();
+	m_class.name = className;
+	m_errors.clear();
 
-	//Add boilerplate code
-	m_code.push_back( ".bytecode 50.0" );				//m_code[0]
-	m_code.push_back( ".class public <ERROR>" );		//m_code[1]
-	m_code.push_back( ".super java/lang/Object\n\n"
-		".method public <init>()V\n"
-		"  .limit stack 1\n"
-		"  .limit locals 1\n"
-		"  aload_0\n"
-		"  invokespecial java/lang/Object/<init>()V\n"
-		"  return\n"
-		".end method\n\n"
+	NativeTypes types(typeTable);
+	std::map<ASTNode const*, int> refs;
+	FuncDef* scriptMain = nullptr;
+	bool hasStringGlobals = false;
 
-		".method public static main([Ljava/lang/String;)V"
-		);												//m_code[2]
-	m_code.push_back( "  .limit stack <ERROR>" );		//m_code[3]
-	m_code.push_back( "  .limit locals <ERROR>" );		//m_code[4]
+	//Register all fields and methods first, functions may be called before their definition.
+	for (const auto& stmt : node->GetChildren()){
+		if (stmt->GetNodeType() == NodeType::GlobVarDef){
+			GlobVarDef* n = (GlobVarDef*) stmt.get();
+			std::string desc = types.GetDescriptor(n->GetType()->GetTypeInfo());
 
-	//CodeWalker cw( table );
-	//node->GetStmtBlock()->accept( &cw, false ); //Only generate code for the Statement Block.
+			if (desc.empty()){
+				AddError(n->GetType()->GetToken(), "Type '%s' is not supported by the code generator.", n->GetType()->GetName().c_str());
+				continue;
+			}
 
-	m_code.push_back(
-		"  return\n"
-		".end method"
-		);
+			hasStringGlobals |= n->GetType()->GetTypeInfo() == types.stringType;
+			m_class.fields.push_back(JvmField{ n->GetName()->GetName(), desc, JvmClass::ACC_PUBLIC | JvmClass::ACC_STATIC });
+			refs[n] = m_class.refs.size();
+			m_class.refs.push_back(MemberRef{ className, n->GetName()->GetName(), desc, false, 0 });
+		}
+		else if (stmt->GetNodeType() == NodeType::FuncDef){
+			FuncDef* n = (FuncDef*) stmt.get();
+			TypeInfo const* retType = n->GetRetType()->GetTypeInfo();
+			std::string desc = "(";
+
+			for (const auto& param : n->GetParamList()->GetChildren()){
+				std::string paramDesc = types.GetDescriptor(param->GetType()->GetTypeInfo());
+				if (paramDesc.empty())
+					AddError(param->GetType()->GetToken(), "Type '%s' is not supported by the code generator.", param->GetType()->GetName().c_str());
+				desc += paramDesc;
+			}
+
+			std::string retDesc = types.GetDescriptor(retType);
+			if (retDesc.empty())
+				AddError(n->GetRetType()->GetToken(), "Type '%s' is not supported by the code generator.", n->GetRetType()->GetName().c_str());
+			desc += ")" + retDesc;
+
+			int numParams = n->GetParamList()->GetChildren().size();
+			refs[n] = m_class.refs.size();
+			m_class.refs.push_back(MemberRef{ className, n->GetName()->GetName(), desc, true, (retType == types.voidType ? 0 : 1) - numParams });
+
+			if (n->GetName()->GetName() == "main" && numParams == 0)
+				scriptMain = n;
+		}
+	}
 
-	return true;
+	if (!m_errors.empty())
+		return false;
+
+	//Constructor, needed to be a valid class.
+	int objectInit = m_class.refs.size();
+	m_class.refs.push_back(MemberRef{ "java/lang/Object", "<init>", "()V", true, -1 });
+
+	JvmMethod init{ "<init>", "()V", JvmClass::ACC_PUBLIC };
+	init.code.push_back(Instr(Op::ALoad, 0));
+	init.code.push_back(Instr(Op::InvokeSpecial, objectInit));
+	init.code.push_back(Instr(Op::Return));
+	init.numLabels = 0;
+	init.maxStack = 1;
+	init.maxLocals = 1;
+	m_class.methods.push_back(std::move(init));
+
+	CodeWalker cw(m_class, types, refs, m_errors);
+
+	for (const auto& stmt : node->GetChildren()){
+		if (stmt->GetNodeType() != NodeType::FuncDef)
+			continue;
+
+		FuncDef* n = (FuncDef*) stmt.get();
+		const MemberRef& ref = m_class.refs[refs[n]];
+
+		m_class.methods.push_back(JvmMethod{ ref.name, ref.descriptor, JvmClass::ACC_PUBLIC | JvmClass::ACC_STATIC });
+		cw.GenerateMethod(n, m_class.methods.back());
+	}
+
+	//Strings are initialized to "" everywhere else, so do the same for string globals.
+	if (hasStringGlobals){
+		JvmMethod clinit{ "<clinit>", "()V", JvmClass::ACC_STATIC };
+
+		m_class.strings.push_back("\"\"");
+		for (const auto& stmt : node->GetChildren()){
+			if (stmt->GetNodeType() == NodeType::GlobVarDef && ((GlobVarDef*) stmt.get())->GetType()->GetTypeInfo() == types.stringType){
+				clinit.code.push_back(Instr(Op::LdcString, m_class.strings.size() - 1));
+				clinit.code.push_back(Instr(Op::PutStatic, refs[stmt.get()]));
+			}
+		}
+		clinit.code.push_back(Instr(Op::Return));
+		clinit.numLabels = 0;
+		clinit.maxStack = 1;
+		clinit.maxLocals = 0;
+		m_class.methods.push_back(std::move(clinit));
+	}
+
+	//JVM entry point, calls the script's main function.
+	if (scriptMain){
+		JvmMethod main{ "main", "([Ljava/lang/String;)V", JvmClass::ACC_PUBLIC | JvmClass::ACC_STATIC };
+		main.code.push_back(Instr(Op::InvokeStatic, refs[scriptMain]));
+		if (scriptMain->GetRetType()->GetTypeInfo() != types.voidType)
+			main.code.push_back(Instr(Op::Pop));
+		main.code.push_back(Instr(Op::Return));
+		main.numLabels = 0;
+		main.maxStack = 1;
+		main.maxLocals = 1;
+		m_class.methods.push_back(std::move(main));
+	}
+
+	return m_errors.empty();
+}
+
+static void WriteAccessFlags( OutputBuffer& out, unsigned short flags ){
+	if (flags & JvmClass::ACC_PUBLIC)
+		out.PutLit("public ");
+	if (flags & JvmClass::ACC_STATIC)
+		out.PutLit("static ");
+}
+
+static void WriteInstr( OutputBuffer& out, const JvmClass& cls, const Instr& instr ){
+	const InstrTemplate& tmpl = g_instrTemplates[(int) instr.op];
+
+	if (instr.op == Op::Label){
+		out.Put('L');
+		out.PutInt(instr.operand);
+		out.Put(':');
+	}
+	else{
+		out.Put(tmpl.text, tmpl.length);
+
+		switch (tmpl.operand){
+		case IntOperand:
+			out.PutInt(instr.operand);
+			if (instr.op == Op::IInc){
+				out.Put(' ');
+				out.PutInt(instr.operand2);
+			}
+			break;
+		case FloatOperand:		out.PutFloat(instr.fOperand); break;
+		case StringOperand:		out.Put(cls.strings[instr.operand]); break;
+		case LabelOperand:		out.Put('L'); out.PutInt(instr.operand); break;
+		case RefOperand:
+		{
+			const MemberRef& ref = cls.refs[instr.operand];
+			out.Put(ref.owner);
+			out.Put('/');
+			out.Put(ref.name);
+			if (!ref.isMethod)
+				out.Put(' ');
+			out.Put(ref.descriptor);
+			break;
+		}
+		default: break;
+		}
+	}
+
+	if (instr.comment || instr.symbol){
+		out.PadTo(32);
+		out.PutLit("; ");
+		if (instr.comment)
+			out.Put(instr.comment);
+		if (instr.comment && instr.symbol)
+			out.Put(' ');
+		if (instr.symbol)
+			out.Put(instr.symbol->name);
+	}
+
+	out.Newline();
+}
+
+void CodeGen::WriteJasmin( OutputBuffer& out ) const {
+	out.PutLit(".bytecode ");
+	out.PutInt(JVM_CLASS_VERSION);
+	out.PutLit(".0\n.class public ");
+	out.Put(m_class.name);
+	out.PutLit("\n.super java/lang/Object\n\n");
+
+	for (const auto& field : m_class.fields){
+		out.PutLit(".field ");
+		WriteAccessFlags(out, field.accessFlags);
+		out.Put(field.name);
+		out.Put(' ');
+		out.Put(field.descriptor);
+		out.Newline();
+	}
+
+	for (const auto& method : m_class.methods){
+		out.PutLit("\n.method ");
+		WriteAccessFlags(out, method.accessFlags);
+		out.Put(method.name);
+		out.Put(method.descriptor);
+		out.PutLit("\n\t.limit stack ");
+		out.PutInt(method.maxStack);
+		out.PutLit("\n\t.limit locals ");
+		out.PutInt(method.maxLocals);
+		out.Newline();
+
+		for (const auto& instr : method.code)
+			WriteInstr(out, m_class, instr);
+
+		out.PutLit(".end method\n");
+	}
 }
 
 bool CodeGen::WriteToFile( std::string fileName ){
-	std::ofstream outfile( fileName );
+	OutputBuffer out(64 * 1024);
+	WriteJasmin(out);
+	return out.WriteToFile(fileName);
+}
 
-	for( auto && s : m_code ){
-		outfile << s << "\n";
+bool CodeGen::WriteClassFile( std::string fileName ){
+	OutputBuffer out(64 * 1024);
+	ClassWriter writer(m_class);
+
+	if (!writer.Write(out)){
+		m_writeError = writer.GetError();
+		return false;
+	}
+
+	if (!out.WriteToFile(fileName)){
+		m_writeError = "Could not write file " + fileName;
+		return false;
 	}
 
 	return true;
-}*/
\ No newline at end of file
+}
\ No newline at end of file
@@ -3,18 +3,238 @@
 
 #include <vector>
 #include <string>
+#include <map>
 #include "ASTNode.h"
 #include "SymbolScope.h"
+#include "TypeTable.h"
+#include "OutputBuffer.h"
+#include "StringUtil.h"
+
+//JVM instructions known to the code generator. The order must match g_instrTemplates in CodeGen.cpp.
+enum class Op : unsigned char{
+	Label,			//Pseudo instruction, marks the position of label 'operand'
+
+	IConstM1,
+	IConst0,
+	IConst1,
+	IConst2,
+	IConst3,
+	IConst4,
+	IConst5,
+	BIPush,
+	SIPush,
+	LdcInt,
+	LdcFloat,
+	LdcString,		//operand is an index into JvmClass::strings
+	AConstNull,
+
+	ILoad,
+	FLoad,
+	ALoad,
+	IStore,
+	FStore,
+	AStore,
+	IInc,			//operand is the local variable index, operand2 the constant
+
+	IALoad,
+	FALoad,
+	BALoad,
+	AALoad,
+	IAStore,
+	FAStore,
+	BAStore,
+	AAStore,
+	ArrayLength,
+
+	IAdd,
+	ISub,
+	IMul,
+	IDiv,
+	IRem,
+	INeg,
+	FAdd,
+	FSub,
+	FMul,
+	FDiv,
+	FNeg,
+	IAnd,
+	IOr,
+	IXor,
+	FCmpL,
+	FCmpG,
+
+	IfEq,			//Branches: operand is a label id
+	IfNe,
+	IfLt,
+	IfGe,
+	IfGt,
+	IfLe,
+	IfICmpEq,
+	IfICmpNe,
+	IfICmpLt,
+	IfICmpGe,
+	IfICmpGt,
+	IfICmpLe,
+	IfACmpEq,
+	IfACmpNe,
+	Goto,
+
+	IReturn,
+	FReturn,
+	AReturn,
+	Return,
+
+	GetStatic,		//operand is an index into JvmClass::refs
+	PutStatic,
+	InvokeStatic,
+	InvokeVirtual,
+	InvokeSpecial,
+
+	Pop,
+	Dup,
+
+	NumOps
+};
+
+class Instr{
+public:
+	Op op;
+	union{
+		int operand;		//Immediate value, local variable index, label id or index into JvmClass::refs/strings
+		float fOperand;		//Value of Op::LdcFloat
+	};
+	int operand2;			//Constant of Op::IInc
+	Symbol const* symbol;	//Variable or function the instruction refers to. Only used for comments.
+	const char* comment;	//Static text, may be nullptr
+
+	Instr(Op op, int operand = 0, const char* comment = nullptr, Symbol const* symbol = nullptr)
+		: op(op), operand(operand), operand2(0), symbol(symbol), comment(comment)
+	{}
+};
+
+inline bool IsBranch(Op op){
+	return op >= Op::IfEq && op <= Op::Goto;
+}
+
+//Branch taken in exactly the cases the given one isn't. This holds for float comparisons too, as long as fcmpl/fcmpg
+//was picked such that NaN makes the original branch fall through.
+inline Op NegateBranch(Op op){
+	switch (op){
+	case Op::IfEq:		return Op::IfNe;
+	case Op::IfNe:		return Op::IfEq;
+	case Op::IfLt:		return Op::IfGe;
+	case Op::IfGe:		return Op::IfLt;
+	case Op::IfGt:		return Op::IfLe;
+	case Op::IfLe:		return Op::IfGt;
+	case Op::IfICmpEq:	return Op::IfICmpNe;
+	case Op::IfICmpNe:	return Op::IfICmpEq;
+	case Op::IfICmpLt:	return Op::IfICmpGe;
+	case Op::IfICmpGe:	return Op::IfICmpLt;
+	case Op::IfICmpGt:	return Op::IfICmpLe;
+	case Op::IfICmpLe:	return Op::IfICmpGt;
+	case Op::IfACmpEq:	return Op::IfACmpNe;
+	case Op::IfACmpNe:	return Op::IfACmpEq;
+	default:			return op;
+	}
+}
+
+//Field or method referenced by GetStatic/PutStatic/Invoke*.
+class MemberRef{
+public:
+	std::string owner;
+	std::string name;
+	std::string descriptor;
+	bool isMethod;
+	int stackDelta;			//Change of the operand stack depth caused by the instruction using this reference
+};
+
+class JvmField{
+public:
+	std::string name;
+	std::string descriptor;
+	unsigned short accessFlags;
+};
+
+class JvmMethod{
+public:
+	std::string name;
+	std::string descriptor;
+	unsigned short accessFlags;
+	std::vector<Instr> code;
+	int numLabels;
+	int maxStack;
+	int maxLocals;
+
+	JvmMethod(std::string name, std::string descriptor, unsigned short accessFlags)
+		: name(std::move(name)), descriptor(std::move(descriptor)), accessFlags(accessFlags), numLabels(0), maxStack(0), maxLocals(0)
+	{}
+};
+
+class JvmClass{
+public:
+	enum AccessFlags{
+		ACC_PUBLIC = 0x0001,
+		ACC_STATIC = 0x0008,
+		ACC_SUPER = 0x0020
+	};
+
+	std::string name;
+	std::vector<JvmField> fields;
+	std::vector<JvmMethod> methods;
+	std::vector<MemberRef> refs;
+	std::vector<std::string> strings;	//String constants, stored as they appear in the source (with quotes and escapes)
+};
+
+//Major version of the generated class files. Versions below 50 never require a StackMapTable attribute.
+const int JVM_CLASS_VERSION = 49;
+
 /*
+	Translates a type checked AST into JVM instructions. Every function becomes a static method, every global variable
+	a static field of one class. A script function 'main' without parameters is called by the generated JVM entry point.
+	Class definitions are not supported by the code generator yet and are skipped.
+*/
 class CodeGen
 {
 public:
 
-	bool Generate( StartBlockPtr& node, const SymbolScope& table );
+	bool Generate( StartBlockPtr& node, const TypeTable& typeTable, std::string className );
 	bool WriteToFile( std::string fileName );
 
+	//Writes the class as Jasmin assembly.
+	void WriteJasmin( OutputBuffer& out ) const;
+
+	//Writes a binary .class file directly, without an external assembler. See GetWriteError() if this fails.
+	bool WriteClassFile( std::string fileName );
+
+	const std::string& GetWriteError() const {
+		return m_writeError;
+	}
+
+	const JvmClass& GetClass() const {
+		return m_class;
+	}
+
+	JvmClass& GetClass(){
+		return m_class;
+	}
+
+	const std::vector<std::pair<std::string, Token>>& GetErrors() const {
+		return m_errors;
+	}
+
 private:
-	std::vector<std::string> m_code;
+
+	void AddError(const Token& tok, const std::string fmt_str, ...){
+		va_list ap;
+		va_start(ap, fmt_str);
+		std::string v = va_string_format(fmt_str, ap);
+		m_errors.emplace_back(v, tok);
+		va_end(ap);
+	}
+
+	JvmClass m_class;
+	std::vector<std::pair<std::string, Token>> m_errors;
+	std::string m_writeError;
 };
-*/
+
 #endif
\ No newline at end of file
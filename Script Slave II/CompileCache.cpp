@@ -0,0 +1,123 @@
+#include "CompileCache.h"
+#include "MappedFile.h"
+
+#include <atomic>
+#include <cstdio>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#pragma warning (push)
+#pragma warning (disable : 4996 )
+
+namespace{
+
+	bool WriteBytes(const std::string& fileName, const char* data, size_t size){
+		FILE* file = fopen(fileName.c_str(), "wb");
+
+		if (!file)
+			return false;
+
+		bool success = size == 0 || fwrite(data, 1, size, file) == size;
+		return fclose(file) == 0 && success;
+	}
+
+	//Unique among all processes and threads storing entries at the same time.
+	std::string MakeTempSuffix(){
+		static std::atomic<unsigned int> counter(0);
+
+		char suffix[48];
+		sprintf(suffix, ".%d-%u.tmp", (int) getpid(), counter++);
+		return suffix;
+	}
+}
+
+CompileCache::CompileCache(const std::string& dir)
+	: m_dir(dir)
+{
+	if (m_dir.empty())
+		return;
+
+	//Fails harmlessly if the directory already exists, and if it can't be created every Fetch() misses.
+#ifdef _WIN32
+	_mkdir(m_dir.c_str());
+#else
+	mkdir(m_dir.c_str(), 0777);
+#endif
+
+	if (m_dir.back() != '/' && m_dir.back() != '\\')
+		m_dir += '/';
+}
+
+unsigned long long CompileCache::Hash(const char* data, size_t length, unsigned long long hash){
+	for (size_t i = 0; i < length; ++i){
+		hash ^= (unsigned char) data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+std::string CompileCache::MakeKey(const std::string& source, const std::string& options){
+	//The parts are separated by a zero byte, so moving characters from one part into another changes the hash.
+	const char separator = 0;
+	unsigned long long hash = Hash(COMPILER_VERSION, sizeof(COMPILER_VERSION));
+	hash = Hash(options.data(), options.size(), hash);
+	hash = Hash(&separator, 1, hash);
+	hash = Hash(source.data(), source.size(), hash);
+
+	//The length makes collisions between sources of different size impossible.
+	char key[40];
+	sprintf(key, "%016llx-%llx", hash, (unsigned long long) source.size());
+	return key;
+}
+
+bool CompileCache::Fetch(const std::string& key, const std::string& ext, const std::string& outFile) const {
+	if (!IsEnabled())
+		return false;
+
+	MappedFile entry(GetEntryName(key, ext));
+	if (!entry.IsValid())
+		return false;
+
+	return WriteBytes(outFile, entry.Data(), entry.Size());
+}
+
+bool CompileCache::Store(const std::string& key, const std::string& ext, const std::string& file) const {
+	if (!IsEnabled())
+		return false;
+
+	MappedFile output(file);
+	if (!output.IsValid())
+		return false;
+
+	return Store(key, ext, output.Data(), output.Size());
+}
+
+bool CompileCache::Store(const std::string& key, const std::string& ext, const char* data, size_t size) const {
+	if (!IsEnabled())
+		return false;
+
+	std::string entryName = GetEntryName(key, ext);
+	std::string tempName = entryName + MakeTempSuffix();
+	if (!WriteBytes(tempName, data, size)){
+		remove(tempName.c_str());
+		return false;
+	}
+
+	//rename() doesn't replace existing files on Windows. An existing entry has the same contents anyway.
+	remove(entryName.c_str());
+	return rename(tempName.c_str(), entryName.c_str()) == 0;
+}
+
+std::string CompileCache::GetEntryName(const std::string& key, const std::string& ext) const {
+	return m_dir + key + "." + ext;
+}
+
+#pragma warning (pop)
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+//Bump whenever a change to the compiler changes its output, old cache entries are then never hit again.
+#define COMPILER_VERSION "ss2-0.9"
+
+/*
+	On-disk cache of compiler outputs, so unchanged sources don't have to be compiled again. An entry is keyed by a
+	hash of the source bytes, the compiler version and the options, and is stored as "<key>.<ext>" in the cache
+	directory, one file per output (class file, Jasmin assembly, and the tokens and checked AST in the format of
+	AstWriter, for the outputs which need the AST).
+
+	Entries are written to a temporary file of their own first and then renamed, so neither an interrupted compile
+	nor two compiles storing the same entry at once can leave a truncated entry behind. Cached files are memory mapped when they are loaded.
+*/
+class CompileCache
+{
+public:
+
+	//Caching is disabled if dir is empty. The directory is created if it doesn't exist.
+	CompileCache(const std::string& dir);
+
+	bool IsEnabled() const {
+		return !m_dir.empty();
+	}
+
+	//Key of a compilation, 'options' must contain every option which changes the output.
+	static std::string MakeKey(const std::string& source, const std::string& options);
+
+	//64-bit FNV-1a
+	static unsigned long long Hash(const char* data, size_t length, unsigned long long hash = 14695981039346656037ull);
+
+	//Writes the cached output 'ext' of 'key' to outFile. Returns false if there is no such entry.
+	bool Fetch(const std::string& key, const std::string& ext, const std::string& outFile) const;
+
+	//Stores the output in 'file' as entry 'ext' of 'key'.
+	bool Store(const std::string& key, const std::string& ext, const std::string& file) const;
+
+	//Same for an output in memory.
+	bool Store(const std::string& key, const std::string& ext, const char* data, size_t size) const;
+
+	//File of entry 'ext' of 'key', to read it in place. It doesn't exist if the entry was never stored.
+	std::string GetEntryName(const std::string& key, const std::string& ext) const;
+
+private:
+
+	std::string m_dir;
+};
\ No newline at end of file
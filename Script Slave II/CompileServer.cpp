@@ -0,0 +1,280 @@
+#include "CompileServer.h"
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+namespace{
+
+	const size_t MAX_LINE_LENGTH = 4096;
+	const size_t MAX_SOURCE_LENGTH = 64 * 1024 * 1024;
+
+	//Requests are handled one at a time. A client which stops sending or receiving is dropped after this long, so it
+	//can't block the others.
+	const int CONNECTION_TIMEOUT_SECONDS = 10;
+
+	bool SendAll(int socket, const char* data, size_t size){
+		while (size > 0){
+			ssize_t sent = send(socket, data, size, 0);
+			if (sent < 0 && errno == EINTR)
+				continue;
+			if (sent <= 0)
+				return false;
+
+			data += sent;
+			size -= sent;
+		}
+		return true;
+	}
+
+	bool SendAll(int socket, const std::string& data){
+		return SendAll(socket, data.data(), data.size());
+	}
+
+	bool ReceiveAll(int socket, char* data, size_t size){
+		while (size > 0){
+			ssize_t received = recv(socket, data, size, 0);
+			if (received < 0 && errno == EINTR)
+				continue;
+			if (received <= 0)
+				return false;
+
+			data += received;
+			size -= received;
+		}
+		return true;
+	}
+
+	//recv() and send() on the socket fail with EAGAIN once they wait longer than seconds, ending the connection.
+	bool SetTimeout(int socket, int seconds){
+		timeval timeout;
+		timeout.tv_sec = seconds;
+		timeout.tv_usec = 0;
+		return setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0 &&
+			setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) == 0;
+	}
+
+	//Reads a line without its '\n'. Lines are short, so they are read a character at a time.
+	bool ReceiveLine(int socket, std::string& line){
+		line.clear();
+
+		char c;
+		while (ReceiveAll(socket, &c, 1)){
+			if (c == '\n')
+				return true;
+			if (line.size() == MAX_LINE_LENGTH)
+				return false;
+			line += c;
+		}
+		return false;
+	}
+
+	bool ParseLength(const std::string& str, size_t& length){
+		if (str.empty() || str.size() > 10 || str.find_first_not_of("0123456789") != std::string::npos)
+			return false;
+
+		length = (size_t) std::stoull(str);
+		return length <= MAX_SOURCE_LENGTH;
+	}
+
+	bool SendAnswer(int socket, bool succeeded, const std::string& output){
+		return SendAll(socket, (succeeded ? "ok " : "failed ") + std::to_string(output.size()) + "\n") && SendAll(socket, output);
+	}
+
+	bool MakeAddress(const std::string& path, sockaddr_un& address){
+		if (path.empty() || path.size() >= sizeof(address.sun_path))
+			return false;
+
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		memcpy(address.sun_path, path.c_str(), path.size() + 1);
+		return true;
+	}
+}
+#endif
+
+bool CompileServer::Run(const Handler& handler){
+#ifdef _WIN32
+	return Fail("The compile server needs Unix domain sockets, which aren't available on this platform");
+#else
+	sockaddr_un address;
+	if (!MakeAddress(m_socketPath, address))
+		return Fail("Invalid socket path " + m_socketPath);
+
+	//Clients closing their connection early must not end the server.
+	signal(SIGPIPE, SIG_IGN);
+
+	//A server which didn't shut down cleanly leaves its socket behind, bind() fails on it. Other files are kept.
+	struct stat info;
+	if (stat(m_socketPath.c_str(), &info) == 0){
+		if (!S_ISSOCK(info.st_mode))
+			return Fail(m_socketPath + " exists and isn't a socket");
+		unlink(m_socketPath.c_str());
+	}
+
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0)
+		return Fail("Could not create a socket");
+
+	if (bind(listener, (const sockaddr*) &address, sizeof(address)) != 0 || listen(listener, 16) != 0){
+		close(listener);
+		return Fail("Could not listen on " + m_socketPath);
+	}
+
+	bool running = true;
+	while (running){
+		int connection = accept(listener, nullptr, nullptr);
+		if (connection < 0){
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			m_error = "Could not accept connections";
+			break;
+		}
+
+		if (SetTimeout(connection, CONNECTION_TIMEOUT_SECONDS))
+			running = Handle(connection, handler);
+		close(connection);
+	}
+
+	close(listener);
+	unlink(m_socketPath.c_str());
+	return running == false;
+#endif
+}
+
+#ifndef _WIN32
+bool CompileServer::Handle(int connection, const Handler& handler){
+	std::string line;
+	if (!ReceiveLine(connection, line))
+		return true;
+
+	if (line == "shutdown"){
+		SendAnswer(connection, true, "");
+		return false;
+	}
+
+	size_t space = line.find(' ');
+	std::string command = line.substr(0, space);
+	std::string arguments = space != std::string::npos ? line.substr(space + 1) : "";
+
+	Request request;
+	request.checkOnly = command == "check" || command == "check-buffer";
+	request.hasSource = command == "compile-buffer" || command == "check-buffer";
+
+	if (!request.hasSource && command != "compile" && command != "check"){
+		SendAnswer(connection, false, "Unknown request '" + command + "'.\n");
+		return true;
+	}
+
+	//"<length> <file>", followed by the source
+	if (request.hasSource){
+		space = arguments.find(' ');
+		size_t length;
+
+		if (space == std::string::npos || !ParseLength(arguments.substr(0, space), length)){
+			SendAnswer(connection, false, "Malformed request '" + line + "'.\n");
+			return true;
+		}
+
+		request.source.resize(length);
+		if (length > 0 && !ReceiveAll(connection, &request.source[0], length))
+			return true;
+
+		arguments = arguments.substr(space + 1);
+	}
+
+	request.fileName = arguments;
+	if (request.fileName.empty()){
+		SendAnswer(connection, false, "No file name given.\n");
+		return true;
+	}
+
+	//The compiler writes everything to std::cout, which is collected for the client.
+	std::ostringstream output;
+	std::streambuf* console = std::cout.rdbuf(output.rdbuf());
+	bool succeeded;
+
+	try{
+		succeeded = handler(request);
+	}
+	catch (const std::exception& e){
+		output << "Internal error: " << e.what() << "\n";
+		succeeded = false;
+	}
+
+	std::cout.rdbuf(console);
+
+	SendAnswer(connection, succeeded, output.str());
+	return true;
+}
+#endif
+
+bool CompileServer::Send(const std::string& socketPath, const std::string& command, const std::string& fileName, const std::string* source,
+	bool& succeeded, std::string& output, std::string& error){
+#ifdef _WIN32
+	error = "The compile server needs Unix domain sockets, which aren't available on this platform";
+	return false;
+#else
+	sockaddr_un address;
+	if (!MakeAddress(socketPath, address)){
+		error = "Invalid socket path " + socketPath;
+		return false;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+
+	int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (connection < 0 || connect(connection, (const sockaddr*) &address, sizeof(address)) != 0){
+		if (connection >= 0)
+			close(connection);
+		error = "Could not connect to " + socketPath;
+		return false;
+	}
+
+	//The server resolves file names in its own working directory.
+	std::string path = fileName;
+	char directory[4096];
+	if (!path.empty() && path[0] != '/' && getcwd(directory, sizeof(directory)) != nullptr)
+		path = std::string(directory) + "/" + path;
+
+	std::string line = command;
+	if (source != nullptr)
+		line += " " + std::to_string(source->size());
+	if (!path.empty())
+		line += " " + path;
+	line += "\n";
+
+	//"ok <length>" or "failed <length>", followed by the output
+	std::string answer;
+	size_t space = std::string::npos;
+	size_t length = 0;
+
+	bool success = SendAll(connection, line) && (source == nullptr || SendAll(connection, *source)) &&
+		ReceiveLine(connection, answer) && (space = answer.find(' ')) != std::string::npos &&
+		ParseLength(answer.substr(space + 1), length);
+
+	if (success){
+		succeeded = answer.compare(0, space, "ok") == 0;
+		output.resize(length);
+		success = length == 0 || ReceiveAll(connection, &output[0], length);
+	}
+
+	close(connection);
+
+	if (!success)
+		error = "The connection to " + socketPath + " failed";
+	return success;
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+/*
+	Compiles files on request of clients connecting to a Unix domain socket, so everything which is built once per
+	process stays in memory between compiles. Every connection carries one request:
+
+		compile <file>\n						Compile the file
+		check <file>\n							Only check it for errors
+		compile-buffer <length> <file>\n<bytes>	Same, but for the source in <bytes> instead of the file's content
+		check-buffer <length> <file>\n<bytes>
+		shutdown\n								Stop the server
+
+	The answer is "ok <length>\n" or "failed <length>\n", followed by the output of the request. Connections are
+	handled one after another, a client which stalls for 10 seconds is disconnected without an answer.
+*/
+class CompileServer{
+public:
+
+	struct Request{
+		std::string fileName;
+		bool checkOnly;
+		bool hasSource;
+		std::string source;		//Content of the file if hasSource is set
+	};
+
+	//Everything the handler writes to std::cout is sent to the client. Returns false if the request failed.
+	typedef std::function<bool(const Request& request)> Handler;
+
+	CompileServer(const std::string& socketPath)
+		: m_socketPath(socketPath)
+	{}
+
+	//Handles requests until a client sends "shutdown". Returns false if the socket couldn't be used.
+	bool Run(const Handler& handler);
+
+	//Client side, sends a request with an optional source and receives the answer. Returns false if the server
+	//couldn't be reached, not if the request failed.
+	static bool Send(const std::string& socketPath, const std::string& command, const std::string& fileName, const std::string* source,
+		bool& succeeded, std::string& output, std::string& error);
+
+	const std::string& GetError() const {
+		return m_error;
+	}
+
+private:
+
+	bool Fail(const std::string& error){
+		m_error = error;
+		return false;
+	}
+
+	//Reads and handles the request of one connection. Returns false for "shutdown".
+	bool Handle(int connection, const Handler& handler);
+
+	std::string m_socketPath;
+	std::string m_error;
+};
\ No newline at end of file
@@ -0,0 +1,342 @@
+#include "ConstantFolder.h"
+#include "SymbolScope.h"
+#include "StringUtil.h"
+#include "Util.h"
+
+#include <cmath>
+#include <cstdint>
+
+namespace{
+
+	//Collects the declarations of all variables which appear on the left hand side of an assignment.
+	class AssignmentCollector : public BaseVisitor{
+	public:
+		AssignmentCollector(std::set<ASTNode const*>& assigned) : m_assigned(assigned) {}
+
+		virtual bool inNode(StmtAssign* n, bool last) override {
+			if (n->GetLHS()->GetNodeType() == NodeType::Ident){
+				Symbol const* sym = ((Ident*) n->GetLHS())->GetSymbol();
+				if (sym != nullptr)
+					m_assigned.insert(sym->GetNode());
+			}
+			return false;
+		}
+
+	private:
+		std::set<ASTNode const*>& m_assigned;
+	};
+
+	bool IsLiteral(Expr const* p){
+		switch (p->GetNodeType()){
+		case NodeType::IntLit:
+		case NodeType::FloatLit:
+		case NodeType::BoolLit:
+		case NodeType::StringLit:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	ExprPtr CloneLiteral(Expr const* p){
+		ExprPtr lit;
+		switch (p->GetNodeType()){
+		case NodeType::IntLit:		lit = std::make_unique<IntLit>(((IntLit const*) p)->GetValue()); break;
+		case NodeType::FloatLit:	lit = std::make_unique<FloatLit>(((FloatLit const*) p)->GetValue()); break;
+		case NodeType::BoolLit:		lit = std::make_unique<BoolLit>(((BoolLit const*) p)->GetValue()); break;
+		case NodeType::StringLit:	lit = std::make_unique<StringLit>(((StringLit const*) p)->GetValue()); break;
+		default: return nullptr;
+		}
+		lit->SetTypeInfo(p->GetTypeInfo());
+		return lit;
+	}
+
+	//Content of a literal as it appears inside of a string literal, without quotes and with escape sequences intact.
+	//Returns false for floats, see the comment on ConstantFolder.
+	bool GetStringContent(Expr const* p, std::string& content){
+		switch (p->GetNodeType()){
+		case NodeType::IntLit:
+			content = std::to_string(((IntLit const*) p)->GetValue());
+			return true;
+		case NodeType::BoolLit:
+			content = ((BoolLit const*) p)->GetValue() ? "true" : "false";
+			return true;
+		case NodeType::StringLit:
+		{
+			const std::string& value = ((StringLit const*) p)->GetValue();
+			content = value.substr(1, value.size() - 2);
+			return true;
+		}
+		default:
+			return false;
+		}
+	}
+
+	//Integer arithmetic of the JVM: two's complement with wrap around.
+	int Wrap(int64_t value){
+		return (int) (uint32_t) value;
+	}
+
+	template<class T>
+	bool Compare(BinOp::Types type, T a, T b, bool& result){
+		switch (type){
+		case BinOp::LThan:		result = a < b; return true;
+		case BinOp::LThanEq:	result = a <= b; return true;
+		case BinOp::GThan:		result = a > b; return true;
+		case BinOp::GThanEq:	result = a >= b; return true;
+		case BinOp::Equal:		result = a == b; return true;
+		case BinOp::Unequal:	result = a != b; return true;
+		default: return false;
+		}
+	}
+
+	int CountNodes(Expr const* p){
+		switch (p->GetNodeType()){
+		case NodeType::UnOp:
+			return 1 + CountNodes(((UnOp const*) p)->GetExpr());
+		case NodeType::BinOp:
+			return 1 + CountNodes(((BinOp const*) p)->GetLeft()) + CountNodes(((BinOp const*) p)->GetRight());
+		default:
+			return 1;
+		}
+	}
+}
+
+void ConstantFolder::Process(StartBlockPtr& start){
+	AssignmentCollector collector(m_assigned);
+	start->accept(&collector, false);
+
+	start->accept(this, false);
+}
+
+bool ConstantFolder::inNode(StmtVarDecl* n, bool last){
+	if (n->GetExpr() == nullptr)
+		return false;
+
+	Fold(n->GetExprRef());
+
+	Expr const* init = n->GetExpr();
+	if (IsLiteral(init) && m_assigned.count(n) == 0 && init->GetTypeInfo() == n->GetType()->GetTypeInfo())
+		m_constants[n] = init;
+
+	return false;
+}
+
+bool ConstantFolder::inNode(StmtAssign* n, bool last){
+	if (n->GetLHS()->GetNodeType() == NodeType::BinOp) //Array index
+		Fold(n->GetLHSRef());
+	Fold(n->GetExprRef());
+	return false;
+}
+
+bool ConstantFolder::inNode(StmtFuncCall* n, bool last){
+	for (auto& arg : n->GetArgList()->GetChildren())
+		Fold(arg);
+	return false;
+}
+
+bool ConstantFolder::inNode(StmtWhile* n, bool last){
+	Fold(n->GetExprRef());
+	return true;
+}
+
+bool ConstantFolder::inNode(StmtIfThen* n, bool last){
+	Fold(n->GetExprRef());
+	return true;
+}
+
+bool ConstantFolder::inNode(StmtIfThenElse* n, bool last){
+	Fold(n->GetExprRef());
+	return true;
+}
+
+bool ConstantFolder::inNode(StmtReturn* n, bool last){
+	if (n->GetExpr() != nullptr)
+		Fold(n->GetExprRef());
+	return false;
+}
+
+bool ConstantFolder::inNode(ClassVar* n, bool last){
+	if (n->GetExpr() != nullptr)
+		Fold(n->GetExprRef());
+	return false;
+}
+
+void ConstantFolder::Fold(ExprPtr& expr){
+	switch (expr->GetNodeType()){
+	case NodeType::Ident:
+	{
+		Symbol const* sym = ((Ident*) expr.get())->GetSymbol();
+		if (sym == nullptr || sym->type != Symbol::VARIABLE)
+			return;
+
+		auto it = m_constants.find((StmtVarDecl const*) sym->GetNode());
+		if (it == m_constants.end())
+			return;
+
+		Token tok = expr->GetToken();
+		expr = CloneLiteral(it->second);
+		expr->SetToken(tok);
+		--sym->useCount;
+		++m_numPropagated;
+		return;
+	}
+	case NodeType::UnOp:
+		FoldUnOp(expr);
+		return;
+	case NodeType::BinOp:
+		FoldBinOp(expr);
+		return;
+	case NodeType::FuncCallExpr:
+		for (auto& arg : ((FuncCallExpr*) expr.get())->GetArgs()->GetChildren())
+			Fold(arg);
+		return;
+	default:
+		return;
+	}
+}
+
+void ConstantFolder::FoldUnOp(ExprPtr& expr){
+	UnOp* n = (UnOp*) expr.get();
+	Fold(n->GetExprRef());
+
+	Expr const* operand = n->GetExpr();
+
+	if (n->GetType() == UnOp::Neg && operand->GetNodeType() == NodeType::IntLit)
+		Replace(expr, std::make_unique<IntLit>(Wrap(-(int64_t) ((IntLit const*) operand)->GetValue())), n->GetTypeInfo());
+	else if (n->GetType() == UnOp::Neg && operand->GetNodeType() == NodeType::FloatLit)
+		Replace(expr, std::make_unique<FloatLit>(-((FloatLit const*) operand)->GetValue()), n->GetTypeInfo());
+	else if (n->GetType() == UnOp::Not && operand->GetNodeType() == NodeType::BoolLit)
+		Replace(expr, std::make_unique<BoolLit>(!((BoolLit const*) operand)->GetValue()), n->GetTypeInfo());
+}
+
+void ConstantFolder::FoldBinOp(ExprPtr& expr){
+	BinOp* n = (BinOp*) expr.get();
+	BinOp::Types type = n->GetType();
+
+	switch (type){
+	case BinOp::MemberAccess:	//Right side is the name of a member, not a value
+		Fold(n->GetLeftRef());
+		return;
+	case BinOp::Subscript:
+		Fold(n->GetLeftRef());
+		Fold(n->GetRightRef());
+		return;
+	case BinOp::FunctionCall:
+		return;
+	default:
+		Fold(n->GetLeftRef());
+		Fold(n->GetRightRef());
+		break;
+	}
+
+	Expr const* left = n->GetLeft();
+	Expr const* right = n->GetRight();
+
+	if (!IsLiteral(left) || !IsLiteral(right))
+		return;
+
+	NodeType lt = left->GetNodeType();
+	NodeType rt = right->GetNodeType();
+	bool cmp;
+
+	//String concatenation, the other operand may have any type
+	if (type == BinOp::Add && (lt == NodeType::StringLit || rt == NodeType::StringLit)){
+		std::string a, b;
+		if (GetStringContent(left, a) && GetStringContent(right, b))
+			Replace(expr, std::make_unique<StringLit>("\"" + a + b + "\""), n->GetTypeInfo());
+		return;
+	}
+
+	//The type checker makes sure both operands have the same type from here on
+	if (lt != rt)
+		return;
+
+	switch (lt){
+	case NodeType::IntLit:
+	{
+		int64_t a = ((IntLit const*) left)->GetValue();
+		int64_t b = ((IntLit const*) right)->GetValue();
+
+		if (Compare(type, a, b, cmp)){
+			Replace(expr, std::make_unique<BoolLit>(cmp), n->GetTypeInfo());
+			return;
+		}
+
+		switch (type){
+		case BinOp::Add: Replace(expr, std::make_unique<IntLit>(Wrap(a + b)), n->GetTypeInfo()); return;
+		case BinOp::Sub: Replace(expr, std::make_unique<IntLit>(Wrap(a - b)), n->GetTypeInfo()); return;
+		case BinOp::Mul: Replace(expr, std::make_unique<IntLit>(Wrap(a * b)), n->GetTypeInfo()); return;
+		case BinOp::Div:
+			if (b != 0)		//Keep the ArithmeticException
+				Replace(expr, std::make_unique<IntLit>(Wrap(a / b)), n->GetTypeInfo());
+			return;
+		case BinOp::Mod:
+			if (b != 0)
+				Replace(expr, std::make_unique<IntLit>(Wrap(a % b)), n->GetTypeInfo());
+			return;
+		default:
+			return;
+		}
+	}
+	case NodeType::FloatLit:
+	{
+		float a = ((FloatLit const*) left)->GetValue();
+		float b = ((FloatLit const*) right)->GetValue();
+
+		if (Compare(type, a, b, cmp)){
+			Replace(expr, std::make_unique<BoolLit>(cmp), n->GetTypeInfo());
+			return;
+		}
+
+		float result;
+		switch (type){
+		case BinOp::Add: result = a + b; break;
+		case BinOp::Sub: result = a - b; break;
+		case BinOp::Mul: result = a * b; break;
+		case BinOp::Div: result = a / b; break;
+		default: return;
+		}
+
+		//Infinity and NaN can't be written as a literal in the output
+		if (std::isfinite(result))
+			Replace(expr, std::make_unique<FloatLit>(result), n->GetTypeInfo());
+		return;
+	}
+	case NodeType::BoolLit:
+	{
+		bool a = ((BoolLit const*) left)->GetValue();
+		bool b = ((BoolLit const*) right)->GetValue();
+
+		switch (type){
+		case BinOp::And:		cmp = a && b; break;
+		case BinOp::Or:			cmp = a || b; break;
+		case BinOp::Xor:
+		case BinOp::Unequal:	cmp = a != b; break;
+		case BinOp::Equal:		cmp = a == b; break;
+		default: return;
+		}
+		Replace(expr, std::make_unique<BoolLit>(cmp), n->GetTypeInfo());
+		return;
+	}
+	case NodeType::StringLit:
+	{
+		std::string a = unquote_string_literal(((StringLit const*) left)->GetValue());
+		std::string b = unquote_string_literal(((StringLit const*) right)->GetValue());
+
+		if (type == BinOp::Equal || type == BinOp::Unequal)
+			Replace(expr, std::make_unique<BoolLit>((a == b) == (type == BinOp::Equal)), n->GetTypeInfo());
+		return;
+	}
+	default:
+		return;
+	}
+}
+
+void ConstantFolder::Replace(ExprPtr& expr, ExprPtr lit, TypeInfo const* type){
+	m_numEliminated += CountNodes(expr.get()) - 1;
+
+	lit->SetToken(expr->GetToken());
+	lit->SetTypeInfo(type);
+	expr = std::move(lit);
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include "ASTNode.h"
+#include "BaseVisitor.h"
+
+/*
+	Folds unary and binary operations whose operands are literals into a single literal and propagates the
+	initializers of local variables which are never assigned after their declaration. Runs on the type checked AST,
+	every new literal gets the TypeInfo of the node it replaces.
+
+	Nothing is folded which would change behaviour at runtime: integer division by zero stays in the code, integer
+	arithmetic wraps around like on the JVM and floats are not converted to strings because Java formats them
+	differently than the C library does.
+*/
+class ConstantFolder : public BaseVisitor
+{
+public:
+
+	void Process(StartBlockPtr& start);
+
+	//Number of AST nodes removed by folding.
+	int GetNumEliminated() const {
+		return m_numEliminated;
+	}
+
+	//Number of variable uses replaced by the constant the variable was initialized with.
+	int GetNumPropagated() const {
+		return m_numPropagated;
+	}
+
+	virtual bool inNode(StmtVarDecl* n, bool last) override;
+	virtual bool inNode(StmtAssign* n, bool last) override;
+	virtual bool inNode(StmtFuncCall* n, bool last) override;
+	virtual bool inNode(StmtWhile* n, bool last) override;
+	virtual bool inNode(StmtIfThen* n, bool last) override;
+	virtual bool inNode(StmtIfThenElse* n, bool last) override;
+	virtual bool inNode(StmtReturn* n, bool last) override;
+	virtual bool inNode(ClassVar* n, bool last) override;
+
+private:
+
+	void Fold(ExprPtr& expr);
+	void FoldUnOp(ExprPtr& expr);
+	void FoldBinOp(ExprPtr& expr);
+
+	//Replaces 'expr' by 'lit', which takes over the token and the TypeInfo.
+	void Replace(ExprPtr& expr, ExprPtr lit, TypeInfo const* type);
+
+	std::set<ASTNode const*> m_assigned;					//Declarations of all variables which are assigned somewhere
+	std::map<StmtVarDecl const*, Expr const*> m_constants;	//Local variables known to always hold a literal value
+
+	int m_numEliminated = 0;
+	int m_numPropagated = 0;
+};
\ No newline at end of file
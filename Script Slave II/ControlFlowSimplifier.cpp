@@ -0,0 +1,174 @@
+#include "ControlFlowSimplifier.h"
+#include "SymbolScope.h"
+#include "Util.h"
+
+#include <algorithm>
+
+namespace{
+
+	//Returns 1 if p is the literal true, 0 if it is false and -1 if it isn't a bool literal.
+	int GetBoolLiteral(Expr const* p){
+		if (p->GetNodeType() != NodeType::BoolLit)
+			return -1;
+		return ((BoolLit const*) p)->GetValue() ? 1 : 0;
+	}
+
+	bool IsBareDecl(Stmt const* p){
+		return p != nullptr && p->GetNodeType() == NodeType::StmtVarDecl;
+	}
+}
+
+void ControlFlowSimplifier::outNode(StmtBlock* n, bool last){
+	auto& children = n->GetChildren();
+
+	for (auto& child : children)
+		Simplify(child);
+
+	children.erase(std::remove(children.begin(), children.end(), nullptr), children.end());
+}
+
+void ControlFlowSimplifier::outNode(StmtWhile* n, bool last){
+	SimplifyCondition(n->GetExprRef());
+	SimplifyChild(n->GetBodyRef());
+}
+
+void ControlFlowSimplifier::outNode(StmtIfThen* n, bool last){
+	SimplifyCondition(n->GetExprRef());
+	SimplifyChild(n->GetThenRef());
+}
+
+void ControlFlowSimplifier::outNode(StmtIfThenElse* n, bool last){
+	SimplifyCondition(n->GetExprRef());
+	SimplifyChild(n->GetThenRef());
+	SimplifyChild(n->GetElseRef());
+
+	//if(~x) a else b  =>  if(x) b else a
+	if (n->GetExpr()->GetNodeType() == NodeType::UnOp && ((UnOp*) n->GetExpr())->GetType() == UnOp::Not){
+		ExprPtr inner = std::move(((UnOp*) n->GetExpr())->GetExprRef());
+		n->GetExprRef() = std::move(inner);
+		std::swap(n->GetThenRef(), n->GetElseRef());
+		++m_numConditionsSimplified;
+	}
+}
+
+void ControlFlowSimplifier::SimplifyCondition(ExprPtr& expr){
+	if (expr->GetNodeType() == NodeType::UnOp){
+		UnOp* n = (UnOp*) expr.get();
+		SimplifyCondition(n->GetExprRef());
+
+		//~~x  =>  x
+		if (n->GetType() == UnOp::Not && n->GetExpr()->GetNodeType() == NodeType::UnOp && ((UnOp*) n->GetExpr())->GetType() == UnOp::Not){
+			ExprPtr inner = std::move(((UnOp*) n->GetExpr())->GetExprRef());
+			expr = std::move(inner);
+			++m_numConditionsSimplified;
+		}
+		return;
+	}
+
+	if (expr->GetNodeType() != NodeType::BinOp)
+		return;
+
+	BinOp* n = (BinOp*) expr.get();
+	switch (n->GetType()){
+	case BinOp::And:
+	case BinOp::Or:
+	case BinOp::Xor:
+		SimplifyCondition(n->GetLeftRef());
+		SimplifyCondition(n->GetRightRef());
+		return;
+	case BinOp::Equal:
+	case BinOp::Unequal:
+		break;
+	default:
+		return;
+	}
+
+	//x == true, x != false, true == x, ...
+	ExprPtr* tested;
+	int lit;
+	if ((lit = GetBoolLiteral(n->GetRight())) != -1)
+		tested = &n->GetLeftRef();
+	else if ((lit = GetBoolLiteral(n->GetLeft())) != -1)
+		tested = &n->GetRightRef();
+	else
+		return;
+
+	SimplifyCondition(*tested);
+
+	const bool negate = (lit == 1) != (n->GetType() == BinOp::Equal);
+	ExprPtr result = std::move(*tested);
+
+	if (negate){
+		Token tok = n->GetToken();
+		TypeInfo const* type = n->GetTypeInfo();
+		result = std::make_unique<UnOp>(UnOp::Not, std::move(result));
+		result->SetToken(tok);
+		result->SetTypeInfo(type);
+	}
+
+	expr = std::move(result);
+	++m_numConditionsSimplified;
+
+	//~x could have become ~~y
+	if (negate)
+		SimplifyCondition(expr);
+}
+
+void ControlFlowSimplifier::Simplify(StmtPtr& stmt){
+	switch (stmt->GetNodeType()){
+	case NodeType::StmtWhile:
+	{
+		StmtWhile* n = (StmtWhile*) stmt.get();
+		if (GetBoolLiteral(n->GetExpr()) == 0 && !IsBareDecl(n->GetBody())){
+			ReleaseSymbolUses(n->GetBody());
+			stmt = nullptr;
+			++m_numBranchesRemoved;
+		}
+		return;
+	}
+	case NodeType::StmtIfThen:
+	{
+		StmtIfThen* n = (StmtIfThen*) stmt.get();
+		int cond = GetBoolLiteral(n->GetExpr());
+
+		if (cond == 1){
+			StmtPtr then = std::move(n->GetThenRef());
+			stmt = std::move(then);
+			++m_numBranchesRemoved;
+		}
+		else if (cond == 0 && !IsBareDecl(n->GetThen())){
+			ReleaseSymbolUses(n->GetThen());
+			stmt = nullptr;
+			++m_numBranchesRemoved;
+		}
+		return;
+	}
+	case NodeType::StmtIfThenElse:
+	{
+		StmtIfThenElse* n = (StmtIfThenElse*) stmt.get();
+		int cond = GetBoolLiteral(n->GetExpr());
+
+		if (cond == -1 || IsBareDecl(cond == 1 ? n->GetElse() : n->GetThen()))
+			return;
+
+		ReleaseSymbolUses(cond == 1 ? n->GetElse() : n->GetThen());
+
+		StmtPtr taken = std::move(cond == 1 ? n->GetThenRef() : n->GetElseRef());
+		stmt = std::move(taken);
+		++m_numBranchesRemoved;
+		return;
+	}
+	default:
+		return;
+	}
+}
+
+void ControlFlowSimplifier::SimplifyChild(StmtPtr& stmt){
+	Token tok = stmt->GetToken();
+	Simplify(stmt);
+
+	if (stmt == nullptr){
+		stmt = std::make_unique<StmtBlock>();
+		stmt->SetToken(tok);
+	}
+}
\ No newline at end of file
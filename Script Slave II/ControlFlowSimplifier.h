@@ -0,0 +1,52 @@
+#pragma once
+
+#include "ASTNode.h"
+#include "BaseVisitor.h"
+
+/*
+	Removes branches whose condition is a constant after constant folding: dead arms of if statements are dropped
+	and the if statement is replaced by the arm which is taken, while(false) loops are removed. while(true) loops
+	are kept, the code generators emit them without a condition test so they can only be left through a break.
+
+	Comparisons of a bool with a literal in conditions are turned into direct tests, "x == true" becomes "x" and
+	"x == false" becomes "~x". An if-then-else on a negated condition swaps its arms instead of negating.
+
+	A dead arm which is a declaration without a surrounding block is kept, its variable is visible after the if
+	statement.
+*/
+class ControlFlowSimplifier : public BaseVisitor
+{
+public:
+
+	void Process(StartBlockPtr& start){
+		start->accept(this, false);
+	}
+
+	//Number of if and while statements which were replaced by one of their arms or removed.
+	int GetNumBranchesRemoved() const {
+		return m_numBranchesRemoved;
+	}
+
+	//Number of comparisons and negations removed from conditions.
+	int GetNumConditionsSimplified() const {
+		return m_numConditionsSimplified;
+	}
+
+	virtual void outNode(StmtBlock* n, bool last) override;
+	virtual void outNode(StmtWhile* n, bool last) override;
+	virtual void outNode(StmtIfThen* n, bool last) override;
+	virtual void outNode(StmtIfThenElse* n, bool last) override;
+
+private:
+
+	void SimplifyCondition(ExprPtr& expr);
+
+	//Replaces stmt by the statement it simplifies to, or by nullptr if it can be removed.
+	void Simplify(StmtPtr& stmt);
+
+	//Simplify() for statements which can't be removed from their parent, these become an empty block instead.
+	void SimplifyChild(StmtPtr& stmt);
+
+	int m_numBranchesRemoved = 0;
+	int m_numConditionsSimplified = 0;
+};
\ No newline at end of file
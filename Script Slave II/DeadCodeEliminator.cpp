@@ -0,0 +1,234 @@
+#include "DeadCodeEliminator.h"
+#include "SymbolScope.h"
+#include "Util.h"
+
+#include <algorithm>
+
+namespace{
+
+	//Collects the variable declarations, the symbols referring to them and whether anything written to them has
+	//side effects.
+	class VariableCollector : public BaseVisitor{
+	public:
+		std::map<ASTNode const*, Symbol const*> decls;	//Symbol is nullptr if no Ident refers to the variable
+		std::set<ASTNode const*> impure;
+
+		virtual bool inNode(GlobVarDef* n, bool last) override {
+			decls.insert(std::make_pair(n, nullptr));
+			return false;
+		}
+
+		virtual bool inNode(StmtVarDecl* n, bool last) override {
+			decls.insert(std::make_pair(n, nullptr));
+			if (n->GetExpr() != nullptr && !DeadCodeEliminator::IsPure(n->GetExpr()))
+				impure.insert(n);
+			return true;
+		}
+
+		virtual bool inNode(StmtAssign* n, bool last) override {
+			if (n->GetLHS()->GetNodeType() == NodeType::Ident){
+				Symbol const* sym = ((Ident*) n->GetLHS())->GetSymbol();
+				if (sym != nullptr && !DeadCodeEliminator::IsPure(n->GetExpr()))
+					impure.insert(sym->GetNode());
+			}
+			return true;
+		}
+
+		virtual bool inNode(Ident* n, bool last) override {
+			Symbol const* sym = n->GetSymbol();
+			if (sym != nullptr && (sym->type == Symbol::VARIABLE || sym->type == Symbol::GLOBAL_VAR))
+				decls[sym->GetNode()] = sym;
+			return false;
+		}
+	};
+
+	//Returns true if execution never continues after stmt.
+	bool Terminates(Stmt const* stmt){
+		switch (stmt->GetNodeType()){
+		case NodeType::StmtReturn:
+		case NodeType::StmtBreak:
+			return true;
+		case NodeType::StmtBlock:
+		{
+			const auto& children = ((StmtBlock const*) stmt)->GetChildren();
+			return std::any_of(children.begin(), children.end(), [](const StmtPtr& child){ return Terminates(child.get()); });
+		}
+		case NodeType::StmtIfThenElse:
+			return Terminates(((StmtIfThenElse const*) stmt)->GetThen()) && Terminates(((StmtIfThenElse const*) stmt)->GetElse());
+		default:
+			return false;
+		}
+	}
+}
+
+void DeadCodeEliminator::Process(StartBlockPtr& start){
+	RemoveUnreachableFunctions(start);
+
+	int removed;
+	do{
+		removed = m_numVariables + m_numStatements;
+		FindUnusedVariables(start);
+
+		start->accept(this, false);
+
+		auto& globals = start->GetChildren();
+		for (auto& global : globals){
+			if (global->GetNodeType() == NodeType::GlobVarDef && m_unused.count(global.get()) > 0){
+				Remove(std::move(global));
+				++m_numVariables;
+			}
+		}
+		globals.erase(std::remove(globals.begin(), globals.end(), nullptr), globals.end());
+	} while (removed != m_numVariables + m_numStatements);
+}
+
+bool DeadCodeEliminator::IsPure(Expr const* p){
+	switch (p->GetNodeType()){
+	case NodeType::IntLit:
+	case NodeType::FloatLit:
+	case NodeType::BoolLit:
+	case NodeType::StringLit:
+	case NodeType::Ident:
+		return true;
+	case NodeType::UnOp:
+		return IsPure(((UnOp const*) p)->GetExpr());
+	case NodeType::BinOp:
+	{
+		BinOp const* n = (BinOp const*) p;
+		switch (n->GetType()){
+		case BinOp::Subscript:
+		case BinOp::FunctionCall:
+		case BinOp::MemberAccess:
+		case BinOp::Div:
+		case BinOp::Mod:
+			return false;
+		default:
+			return IsPure(n->GetLeft()) && IsPure(n->GetRight());
+		}
+	}
+	default:
+		return false;
+	}
+}
+
+void DeadCodeEliminator::RemoveUnreachableFunctions(StartBlockPtr& start){
+	auto& globals = start->GetChildren();
+
+	auto entry = std::find_if(globals.begin(), globals.end(), [](const GlobalStmtPtr& global){
+		return global->GetNodeType() == NodeType::FuncDef && ((FuncDef*) global.get())->GetName()->GetName() == "main"
+			&& ((FuncDef*) global.get())->GetParamList()->IsEmpty();
+	});
+	if (entry == globals.end())
+		return;
+
+	//Everything which isn't a function is reachable, class variables might call functions in their initializers.
+	std::set<ASTNode const*> reached;
+	std::vector<ASTNode*> pending;
+	for (auto& global : globals){
+		if (global->GetNodeType() != NodeType::FuncDef || global == *entry){
+			reached.insert(global.get());
+			pending.push_back(global.get());
+		}
+	}
+
+	while (!pending.empty()){
+		ASTNode* n = pending.back();
+		pending.pop_back();
+
+		std::set<ASTNode const*> callees;
+		CollectCallees(n, callees);
+
+		for (auto callee : callees){
+			if (reached.insert(callee).second)
+				pending.push_back(const_cast<ASTNode*>(callee));
+		}
+	}
+
+	for (auto& global : globals){
+		if (reached.count(global.get()) == 0){
+			Remove(std::move(global));
+			++m_numFunctions;
+		}
+	}
+	globals.erase(std::remove(globals.begin(), globals.end(), nullptr), globals.end());
+}
+
+void DeadCodeEliminator::FindUnusedVariables(StartBlockPtr& start){
+	VariableCollector collector;
+	start->accept(&collector, false);
+
+	m_unused.clear();
+	for (const auto& decl : collector.decls){
+		if ((decl.second == nullptr || decl.second->useCount == 0) && collector.impure.count(decl.first) == 0)
+			m_unused.insert(decl.first);
+	}
+}
+
+bool DeadCodeEliminator::IsUnusedVariableStmt(Stmt const* stmt) const {
+	if (stmt->GetNodeType() == NodeType::StmtVarDecl)
+		return m_unused.count(stmt) > 0;
+
+	if (stmt->GetNodeType() == NodeType::StmtAssign && ((StmtAssign const*) stmt)->GetLHS()->GetNodeType() == NodeType::Ident){
+		Symbol const* sym = ((Ident const*) ((StmtAssign const*) stmt)->GetLHS())->GetSymbol();
+		return sym != nullptr && m_unused.count(sym->GetNode()) > 0;
+	}
+
+	return false;
+}
+
+void DeadCodeEliminator::outNode(StmtBlock* n, bool last){
+	auto& children = n->GetChildren();
+
+	auto terminator = std::find_if(children.begin(), children.end(), [](const StmtPtr& child){ return Terminates(child.get()); });
+	if (terminator != children.end()){
+		for (auto it = terminator + 1; it != children.end(); ++it){
+			Remove(std::move(*it));
+			++m_numStatements;
+		}
+	}
+
+	for (auto& child : children){
+		if (child != nullptr && IsUnusedVariableStmt(child.get())){
+			if (child->GetNodeType() == NodeType::StmtVarDecl)
+				++m_numVariables;
+			else
+				++m_numStatements;
+			Remove(std::move(child));
+		}
+	}
+
+	children.erase(std::remove(children.begin(), children.end(), nullptr), children.end());
+}
+
+void DeadCodeEliminator::outNode(StmtWhile* n, bool last){
+	RemoveChild(n->GetBodyRef());
+}
+
+void DeadCodeEliminator::outNode(StmtIfThen* n, bool last){
+	RemoveChild(n->GetThenRef());
+}
+
+void DeadCodeEliminator::outNode(StmtIfThenElse* n, bool last){
+	RemoveChild(n->GetThenRef());
+	RemoveChild(n->GetElseRef());
+}
+
+void DeadCodeEliminator::Remove(ASTNodePtr n){
+	ReleaseSymbolUses(n.get());
+	m_removed.push_back(std::move(n));
+}
+
+void DeadCodeEliminator::RemoveChild(StmtPtr& stmt){
+	if (!IsUnusedVariableStmt(stmt.get()))
+		return;
+
+	if (stmt->GetNodeType() == NodeType::StmtVarDecl)
+		++m_numVariables;
+	else
+		++m_numStatements;
+
+	Token tok = stmt->GetToken();
+	Remove(std::move(stmt));
+	stmt = std::make_unique<StmtBlock>();
+	stmt->SetToken(tok);
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <vector>
+#include "ASTNode.h"
+#include "BaseVisitor.h"
+
+/*
+	Removes code which can't affect the program, after constant folding and control flow simplification:
+
+	- Functions which can't be reached from main(). The call graph is built from the symbols of the called
+	  functions, nothing is removed if the program has no main() without parameters.
+	- Statements following a return or break in the same block.
+	- Local and global variables which are never read, together with the assignments to them. The use counts
+	  SecondPass attaches to every Symbol decide what is read, a variable is only removed if nothing written to it
+	  has a side effect. Removing one variable can leave another one unused, this is repeated until nothing changes.
+
+	Symbols keep pointing to the declarations they were created for, so removed nodes are kept alive as long as the
+	DeadCodeEliminator exists.
+*/
+class DeadCodeEliminator : public BaseVisitor
+{
+public:
+
+	void Process(StartBlockPtr& start);
+
+	int GetNumFunctionsRemoved() const {
+		return m_numFunctions;
+	}
+
+	int GetNumVariablesRemoved() const {
+		return m_numVariables;
+	}
+
+	//Unreachable statements and assignments to removed variables.
+	int GetNumStatementsRemoved() const {
+		return m_numStatements;
+	}
+
+	//Expressions which can be evaluated or skipped without changing anything but the value they produce.
+	//Divisions might throw, subscripts might be out of bounds.
+	static bool IsPure(Expr const* p);
+
+	virtual void outNode(StmtBlock* n, bool last) override;
+	virtual void outNode(StmtWhile* n, bool last) override;
+	virtual void outNode(StmtIfThen* n, bool last) override;
+	virtual void outNode(StmtIfThenElse* n, bool last) override;
+
+private:
+
+	void RemoveUnreachableFunctions(StartBlockPtr& start);
+
+	//Puts the variables which are never read and only written without side effects into m_unused.
+	void FindUnusedVariables(StartBlockPtr& start);
+
+	//Returns true if stmt declares or assigns one of the variables in m_unused.
+	bool IsUnusedVariableStmt(Stmt const* stmt) const;
+
+	//Moves n to m_removed after releasing the uses of the symbols in it.
+	void Remove(ASTNodePtr n);
+
+	//Removes stmt if it belongs to an unused variable. The statement can't be taken from its parent, it is replaced
+	//by an empty block.
+	void RemoveChild(StmtPtr& stmt);
+
+	std::set<ASTNode const*> m_unused;	//Declarations of the variables removed in the current round
+	std::vector<ASTNodePtr> m_removed;
+
+	int m_numFunctions = 0;
+	int m_numVariables = 0;
+	int m_numStatements = 0;
+};
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include "DiagnosticPrinter.h"
+
+#include <iostream>
+
+DiagnosticPrinter::DiagnosticPrinter(const std::string& source)
+	: m_source(source)
+{}
+
+DiagnosticPrinter::~DiagnosticPrinter(){
+	Flush();
+}
+
+void DiagnosticPrinter::Error(const std::string& message, const FilePosition& position){
+	++m_numErrors;
+
+	if (m_numShown >= MAX_ERRORS || ++m_repeats[message] > MAX_REPEATS){
+		++m_numHidden;
+		return;
+	}
+
+	++m_numShown;
+	m_out.Put(position.ToString());
+	m_out.Put(' ');
+	m_out.Put(message);
+	m_out.Newline();
+	PutSourceLine(position);
+}
+
+void DiagnosticPrinter::Message(const std::string& message, const FilePosition& position){
+	m_out.Put(message);
+	m_out.Newline();
+	PutSourceLine(position);
+}
+
+void DiagnosticPrinter::Message(const std::string& message){
+	m_out.Put(message);
+	m_out.Newline();
+}
+
+void DiagnosticPrinter::Flush(){
+	if (m_numHidden > 0){
+		m_out.PutInt((long long) m_numHidden);
+		m_out.Put(m_numHidden == 1 ? " more error not shown.\n" : " more errors not shown.\n");
+		m_numHidden = 0;
+	}
+
+	if (m_out.Size() > 0){
+		std::cout.write(m_out.Data(), m_out.Size());
+		m_out.Clear();
+	}
+}
+
+void DiagnosticPrinter::PutSourceLine(const FilePosition& position){
+	if (m_source.empty())
+		return;
+
+	if (m_lineStarts.empty()){
+		m_lineStarts.push_back(0);
+		for (size_t i = 0; i < m_source.size(); ++i)
+			if (m_source[i] == '\n')
+				m_lineStarts.push_back(i + 1);
+	}
+
+	if (position.line == 0 || position.line > m_lineStarts.size())
+		return;
+
+	size_t begin = m_lineStarts[position.line - 1];
+	size_t end = position.line < m_lineStarts.size() ? m_lineStarts[position.line] - 1 : m_source.size();
+	if (end > begin && m_source[end - 1] == '\r')
+		--end;
+
+	m_out.Put(m_source.data() + begin, end - begin);
+	m_out.Newline();
+
+	//Tabs are copied, so the caret lines up however wide they are shown.
+	size_t caret = begin + (position.pos > 0 ? position.pos - 1 : 0);
+	if (caret > end)
+		caret = end;
+
+	for (size_t i = begin; i < caret; ++i)
+		m_out.Put(m_source[i] == '\t' ? '\t' : ' ');
+	m_out.PutLit("^\n");
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include "FilePosition.h"
+#include "OutputBuffer.h"
+
+//Prints errors together with the source line they point at and a caret below the position. The line starts are
+//indexed on the first error, so each error only costs the length of its line. Everything is collected and written
+//to std::cout by Flush(), at the latest when the printer is destroyed.
+class DiagnosticPrinter{
+public:
+
+	//Errors with the same message are shown this often, later ones are only counted.
+	static const size_t MAX_REPEATS = 3;
+
+	//Errors beyond this number are only counted.
+	static const size_t MAX_ERRORS = 100;
+
+	//The source must outlive the printer. Without a source, e.g. for AST files, only the messages are printed.
+	explicit DiagnosticPrinter(const std::string& source);
+	~DiagnosticPrinter();
+
+	//Prints "<line>:<pos> <message>" and the source line.
+	void Error(const std::string& message, const FilePosition& position);
+
+	//Prints the message as it is, followed by the source line. Not limited like Error().
+	void Message(const std::string& message, const FilePosition& position);
+	void Message(const std::string& message);
+
+	void Flush();
+
+	size_t GetNumErrors() const {
+		return m_numErrors;
+	}
+
+private:
+	DiagnosticPrinter(const DiagnosticPrinter&);
+	DiagnosticPrinter& operator=(const DiagnosticPrinter&);
+
+	void PutSourceLine(const FilePosition& position);
+
+	const std::string& m_source;
+	std::vector<size_t> m_lineStarts;	//Empty until the first source line is printed
+	OutputBuffer m_out;
+
+	std::map<std::string, size_t> m_repeats;
+	size_t m_numErrors = 0;
+	size_t m_numShown = 0;
+	size_t m_numHidden = 0;
+};
\ No newline at end of file
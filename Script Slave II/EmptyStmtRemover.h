@@ -0,0 +1,30 @@
+#pragma once
+
+#include <algorithm>
+#include "ASTNode.h"
+#include "BaseVisitor.h"
+
+//Removes useless nodes from the AST which are a left-over from parsing phase.
+class EmptyStmtRemover : public BaseVisitor{
+public:
+
+	virtual void outNode( StmtBlock* n, bool last ){ //Want to perform this check *after* the containing elements have been checked.
+		auto& children = n->GetChildren( );
+		children.erase( std::remove_if( children.begin( ), children.end( ), 
+			[]( const StmtPtr& ptr ) -> bool 
+		{
+			if( ptr->GetNodeType() == NodeType::StmtEmpty )	//Remove EmptyStmt's
+				return true;
+
+			if( ptr->GetNodeType() == NodeType::StmtBlock &&		//Remove StmtBlocks which don't contain any Stmts
+				((StmtBlock*) ptr.get())->GetChildren().size() == 0 )
+				return true;
+			return false;
+		}
+		
+		), children.end( ) );
+
+
+		return;
+	}
+};
\ No newline at end of file
@@ -1,7 +1,6 @@
 #include "ExprParser.h"
 #include <stdexcept>
 #include <map>
-#include <iostream>
 #include "Token.h"
 #include "ASTNode.h"
 #include "Util.h"
@@ -147,6 +146,7 @@ ExprPtr ExprParser::lparen_led(Token self, ExprPtr left){
 		throw std::runtime_error("lparen_led: Expected identifier for function call on left side.");
 
 	std::unique_ptr<ArgList> list = std::make_unique<ArgList>( );
+	list->SetToken(self);
 	std::unique_ptr<FuncCallExpr> n = std::make_unique<FuncCallExpr>((std::unique_ptr<Ident>&&)std::move(left), std::move(list));
 	n->SetToken(n->GetCallee()->GetToken());
 
@@ -180,9 +180,10 @@ ExprPtr ExprParser::lbracket_led(Token self, ExprPtr left){
 }
 
 ExprPtr ExprParser::period_led(Token self, ExprPtr left){
-	auto ptr = std::make_unique<BinOp>(BinOp::MemberAccess, std::move(left), ParseExpression(100 - 1));
+	//Binds as tightly as the period itself, so a.b.c is (a.b).c.
+	auto ptr = std::make_unique<BinOp>(BinOp::MemberAccess, std::move(left), ParseExpression(100));
 
-	if (m_tokens.GetCurrentToken().type != TokenType::Ident){
+	if (ptr->GetRight()->GetNodeType() != NodeType::Ident){
 		throw std::runtime_error("period_led: Expected identifier right of period.");
 	}
 
@@ -239,9 +240,17 @@ int ExprParser::lbp( Token self ){
 
 
 ExprParser::ExprParser( TokenStack& tokens )
-	: m_tokens( tokens )
+	: m_tokens( tokens ), m_rules( GetRules() )
 {
-#define ADD_RULE(type, lbp, nud, led) m_rules.insert( std::make_pair( TokenType::type, TokenRule( lbp, nud, led ) ) );
+}
+
+//The rules are the same for all parsers, they are built once per process.
+const std::map<TokenType, ExprParser::TokenRule>& ExprParser::GetRules(){
+	static std::map<TokenType, TokenRule> rules;
+	if( !rules.empty() )
+		return rules;
+
+#define ADD_RULE(type, lbp, nud, led) rules.insert( std::make_pair( TokenType::type, TokenRule( lbp, nud, led ) ) );
 	ADD_RULE( IntLit, 0, &ExprParser::integer_nud, &ExprParser::default_led );
 	ADD_RULE(FloatLit, 0, &ExprParser::float_nud, &ExprParser::default_led);
 	ADD_RULE(BoolLit, 0, &ExprParser::boolean_nud, &ExprParser::default_led);
@@ -273,6 +282,8 @@ ExprParser::ExprParser( TokenStack& tokens )
 	ADD_RULE(Comma, 0, &ExprParser::default_nud, &ExprParser::default_led);
 	ADD_RULE(Eof, 0, &ExprParser::default_nud, &ExprParser::default_led);
 #undef ADD_RULE
+
+	return rules;
 }
 
 bool ExprParser::AdvanceToken( TokenType type ){
@@ -291,8 +302,8 @@ bool ExprParser::MatchExpression( ExprPtr& in ){
 		m_tokens.DiscardIndex();
 		return true;
 	}
+	//Failures are expected while the parser tries alternatives, the furthest error is reported once parsing fails.
 	catch( std::runtime_error ex ){
-		std::cout << "Error: " << ex.what() << "\n";
 		m_tokens.PopIndex();
 		return false;
 	}
@@ -78,8 +78,10 @@ private:
 
 	bool AdvanceToken( TokenType type );
 
+	static const std::map<TokenType, TokenRule>& GetRules();
+
 	TokenStack& m_tokens;
-	std::map<TokenType, TokenRule> m_rules;
+	const std::map<TokenType, TokenRule>& m_rules;
 
 };
 
@@ -26,6 +26,9 @@ public:
 		if (!success)
 			AddError(n->GetName()->GetToken(), "Symbol '%s' is already in use.", n->GetName()->GetName().c_str());
 
+		if (m_typeTable.Get(n->GetName()->GetName()) != nullptr) //ClassLayout adds the classes as types
+			AddError(n->GetName()->GetToken(), "Type '%s' is already defined.", n->GetName()->GetName().c_str());
+
 		std::string scopeName = "class" + std::to_string(n->GetToken().filePosition.line) + ":" + std::to_string(n->GetToken().filePosition.pos);
 
 		success = m_currentScope->AddSubScope(scopeName);
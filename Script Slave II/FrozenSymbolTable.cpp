@@ -0,0 +1,63 @@
+#include "FrozenSymbolTable.h"
+#include "SymbolScope.h"
+
+FrozenSymbolTable::FrozenSymbolTable(SymbolScope& root){
+	AllocationCounter::Scope allocationScope(AllocationCategory::Maps);
+	Add(root);
+}
+
+void FrozenSymbolTable::Add(SymbolScope& scope){
+	scope.m_frozen = this;
+	scope.m_frozenIndex = m_scopes.size();
+	m_scopes.push_back(Scope());
+
+	//The maps are sorted by name, so the runs are as well.
+	Scope frozen;
+	frozen.symbolsBegin = m_symbols.size();
+	for (auto&& sym : scope.m_symbols)
+		m_symbols.push_back(MakeEntry(sym.first, &sym.second));
+	frozen.symbolsEnd = m_symbols.size();
+
+	frozen.subScopesBegin = m_subScopes.size();
+	for (auto&& sub : scope.m_subScopes)
+		m_subScopes.push_back(MakeEntry(sub.first, &sub.second));
+	frozen.subScopesEnd = m_subScopes.size();
+
+	m_scopes[scope.m_frozenIndex] = frozen;
+
+	for (auto&& sub : scope.m_subScopes)
+		Add(sub.second);
+}
+
+FrozenSymbolTable::Entry FrozenSymbolTable::MakeEntry(const std::string& name, const void* target){
+	Entry entry = { m_names.size(), name.size(), target };
+	m_names += name;
+	return entry;
+}
+
+const void* FrozenSymbolTable::Find(const std::vector<Entry>& entries, size_t begin, size_t end, const std::string& name) const {
+	while (begin < end){
+		size_t middle = begin + (end - begin) / 2;
+		const Entry& entry = entries[middle];
+		int order = m_names.compare(entry.nameOffset, entry.nameLength, name);
+
+		if (order == 0)
+			return entry.target;
+		else if (order < 0)
+			begin = middle + 1;
+		else
+			end = middle;
+	}
+
+	return nullptr;
+}
+
+Symbol const* FrozenSymbolTable::FindSymbol(size_t scopeIndex, const std::string& name) const {
+	const Scope& scope = m_scopes[scopeIndex];
+	return (Symbol const*) Find(m_symbols, scope.symbolsBegin, scope.symbolsEnd, name);
+}
+
+SymbolScope* FrozenSymbolTable::FindSubScope(size_t scopeIndex, const std::string& name) const {
+	const Scope& scope = m_scopes[scopeIndex];
+	return (SymbolScope*) Find(m_subScopes, scope.subScopesBegin, scope.subScopesEnd, name);
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+class Symbol;
+class SymbolScope;
+
+//Read-only copy of the lookup tables of a scope tree, created by SymbolScope::Freeze(). Until SymbolScope::Thaw(), the
+//scopes answer GetSymbol() and GetSubScope() from it and reject every change, so any number of threads can look up
+//symbols without locks and later passes can't declare or remove anything by accident. The entries of all
+//scopes are stored in two arrays, each scope's in one sorted run, and the names in one string next to each other.
+//The Symbol and SymbolScope objects themselves stay where they are, so pointers to them remain valid.
+class FrozenSymbolTable{
+public:
+
+	//Freezes the root and all scopes nested in it.
+	explicit FrozenSymbolTable(SymbolScope& root);
+
+	Symbol const* FindSymbol(size_t scopeIndex, const std::string& name) const;
+	SymbolScope* FindSubScope(size_t scopeIndex, const std::string& name) const;
+
+private:
+	FrozenSymbolTable(const FrozenSymbolTable&);
+	FrozenSymbolTable& operator=(const FrozenSymbolTable&);
+
+	struct Entry{
+		size_t nameOffset;
+		size_t nameLength;
+		const void* target;		//Symbol or SymbolScope
+	};
+
+	struct Scope{
+		size_t symbolsBegin, symbolsEnd;
+		size_t subScopesBegin, subScopesEnd;
+	};
+
+	void Add(SymbolScope& scope);
+	Entry MakeEntry(const std::string& name, const void* target);
+	const void* Find(const std::vector<Entry>& entries, size_t begin, size_t end, const std::string& name) const;
+
+	std::string m_names;
+	std::vector<Entry> m_symbols;
+	std::vector<Entry> m_subScopes;
+	std::vector<Scope> m_scopes;
+};
\ No newline at end of file
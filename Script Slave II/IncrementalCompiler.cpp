@@ -0,0 +1,307 @@
+#include "IncrementalCompiler.h"
+#include "EmptyStmtRemover.h"
+#include "FirstPass.h"
+#include "CollectTypeInfo.h"
+#include "SecondPass.h"
+#include "Util.h"
+
+#include <map>
+#include <set>
+
+namespace{
+
+	class TokenMover : public BaseVisitor{
+	public:
+		TokenMover(int lines) : m_lines(lines) {}
+
+		virtual bool inNode(ASTNode* n, bool last) override {
+			Token tok = n->GetToken();
+			tok.filePosition.line = (unsigned short) (tok.filePosition.line + m_lines);
+			n->SetToken(tok);
+			return true;
+		}
+
+	private:
+		int m_lines;
+	};
+
+	void AppendKey(std::string& key, const Token& tok, int firstLine, bool withPosition){
+		key += std::to_string((int) tok.type);
+		key += ' ';
+		key += tok.GetTokenValue();
+		if (withPosition){
+			key += ' ';
+			key += std::to_string(tok.filePosition.line - firstLine);
+			key += ':';
+			key += std::to_string(tok.filePosition.pos);
+		}
+		key += '\n';
+	}
+
+	enum class Fate{
+		Removed,
+		Reused,
+		NewBody
+	};
+}
+
+bool IncrementalCompiler::Update(const std::vector<Token>& previousTokens, const std::vector<Token>& tokens, StartBlockPtr& start){
+	std::vector<Definition> before, after;
+	if (!Split(previousTokens, before) || !Split(tokens, after))
+		return false;
+
+	auto& globals = start->GetChildren();
+	if (globals.size() != before.size())
+		return false;
+
+	//Reuse unchanged definitions, the first unused one with the same tokens.
+	std::multimap<std::string, size_t> unchanged;
+	for (size_t i = 0; i < before.size(); ++i)
+		unchanged.insert(std::make_pair(before[i].key, i));
+
+	std::vector<Fate> fates(before.size(), Fate::Removed);
+	std::vector<int> reused(after.size(), -1);		//Index of the old definition, or -1 if parsed again
+	std::vector<int> bodyOf(after.size(), -1);		//Index of the old function which gets the new body
+
+	for (size_t j = 0; j < after.size(); ++j){
+		auto it = unchanged.find(after[j].key);
+		if (it != unchanged.end()){
+			reused[j] = (int) it->second;
+			fates[it->second] = Fate::Reused;
+			unchanged.erase(it);
+		}
+	}
+
+	std::map<std::string, size_t> changedBefore;
+	for (size_t i = 0; i < before.size(); ++i){
+		if (fates[i] != Fate::Removed)
+			continue;
+		if (before[i].isClass || !changedBefore.insert(std::make_pair(before[i].name, i)).second)
+			return false;
+	}
+
+	//Functions with the same signature only get a new body. Names of all other changed definitions are collected,
+	//everything referring to them has to be checked again.
+	std::set<std::string> changedNames;
+	for (size_t j = 0; j < after.size(); ++j){
+		if (reused[j] >= 0)
+			continue;
+		if (after[j].isClass)
+			return false;
+
+		auto it = changedBefore.find(after[j].name);
+		if (it != changedBefore.end() && fates[it->second] == Fate::Removed && before[it->second].signature == after[j].signature
+			&& globals[it->second]->GetNodeType() == NodeType::FuncDef){
+			bodyOf[j] = (int) it->second;
+			fates[it->second] = Fate::NewBody;
+		}
+		else
+			changedNames.insert(after[j].name);
+	}
+
+	for (size_t i = 0; i < before.size(); ++i){
+		if (fates[i] == Fate::Removed)
+			changedNames.insert(before[i].name);
+	}
+
+	for (size_t j = 0; j < after.size(); ++j){
+		if (reused[j] < 0)
+			continue;
+
+		bool mentionsChange = false;
+		for (size_t k = after[j].begin; k < after[j].end && !mentionsChange; ++k)
+			mentionsChange = tokens[k].type == TokenType::Ident && changedNames.count(tokens[k].GetTokenValue()) > 0;
+
+		if (!mentionsChange)
+			continue;
+		if (globals[reused[j]]->GetNodeType() != NodeType::FuncDef)
+			return false;
+
+		bodyOf[j] = reused[j];
+		fates[reused[j]] = Fate::NewBody;
+		reused[j] = -1;
+	}
+
+	//Everything is parsed before the AST is changed.
+	std::vector<GlobalStmtPtr> parsed(after.size());
+	for (size_t j = 0; j < after.size(); ++j){
+		if (reused[j] >= 0)
+			continue;
+
+		parsed[j] = Parse(tokens, after[j]);
+		if (parsed[j] == nullptr || (bodyOf[j] >= 0 && parsed[j]->GetNodeType() != NodeType::FuncDef))
+			return false;
+	}
+
+	//Removed nodes still point to the symbols whose use counts they hold, release them before any symbol is removed.
+	for (size_t i = 0; i < before.size(); ++i){
+		if (fates[i] == Fate::Removed)
+			ReleaseSymbolUses(globals[i].get());
+		else if (fates[i] == Fate::NewBody)
+			ReleaseSymbolUses(((FuncDef*) globals[i].get())->GetStmtBlock());
+	}
+
+	//The scopes are frozen since the last check, the second pass freezes them again.
+	m_globalScope.Thaw();
+
+	for (size_t i = 0; i < before.size(); ++i){
+		if (fates[i] == Fate::Removed){
+			m_globalScope.RemoveSymbol(before[i].name);
+			if (globals[i]->GetNodeType() == NodeType::FuncDef)
+				m_globalScope.RemoveSubScope(before[i].name);
+		}
+		else if (fates[i] == Fate::NewBody){
+			//The function's scope keeps the return value and the parameters, the locals are in the body's scopes.
+			SymbolScope* scope = m_globalScope.GetSubScope(before[i].name);
+			if (scope == nullptr)
+				return false;
+
+			std::vector<std::string> bodyScopes;
+			for (const auto& sub : scope->GetSubScopes())
+				bodyScopes.push_back(sub.first);
+			for (const auto& name : bodyScopes)
+				scope->RemoveSubScope(name);
+		}
+	}
+
+	//CHECK
+	//Like the full compile, but only the new definitions and bodies are visited.
+	std::vector<std::pair<std::string, Token>> errors;
+	StartBlockPtr changed = std::make_unique<StartBlock>();
+
+	for (size_t j = 0; j < after.size(); ++j){
+		if (parsed[j] == nullptr)
+			continue;
+
+		if (bodyOf[j] >= 0){
+			FuncDef* func = (FuncDef*) globals[bodyOf[j]].get();
+			int lines = (int) tokens[after[j].begin].filePosition.line - (int) previousTokens[before[bodyOf[j]].begin].filePosition.line;
+
+			func->GetStmtBlockRef() = std::move(((FuncDef*) parsed[j].get())->GetStmtBlockRef());
+			if (lines != 0){
+				TokenMover mover(lines);
+				mover.inNode(func, false);
+				func->GetRetType()->accept(&mover, false);
+				func->GetName()->accept(&mover, false);
+				func->GetParamList()->accept(&mover, false);
+			}
+
+			FirstPass firstPass(m_typeTable, *m_globalScope.GetSubScope(before[bodyOf[j]].name));
+			func->GetStmtBlock()->accept(&firstPass, false);
+			errors.insert(errors.end(), firstPass.GetErrors().begin(), firstPass.GetErrors().end());
+
+			changed->Add(std::move(globals[bodyOf[j]]));
+		}
+		else{
+			FirstPass firstPass(m_typeTable, m_globalScope);
+			parsed[j]->accept(&firstPass, false);
+			errors.insert(errors.end(), firstPass.GetErrors().begin(), firstPass.GetErrors().end());
+
+			changed->Add(std::move(parsed[j]));
+		}
+	}
+
+	if (!errors.empty())
+		return false;
+
+	CollectTypeInfo cti(m_typeTable);
+	cti.Process(changed);
+	if (!cti.GetErrors().empty())
+		return false;
+
+	SecondPass secondPass(m_typeTable, m_globalScope);
+	secondPass.Process(changed);
+	if (!secondPass.GetErrors().empty())
+		return false;
+
+	//Put everything together in the order of the new source. Removed definitions are deleted with the old list.
+	std::vector<GlobalStmtPtr> result;
+	auto next = changed->GetChildren().begin();
+
+	for (size_t j = 0; j < after.size(); ++j){
+		if (reused[j] < 0){
+			result.push_back(std::move(*next++));
+			++m_numChecked;
+			if (bodyOf[j] >= 0)
+				++m_numBodies;
+			continue;
+		}
+
+		GlobalStmtPtr& global = globals[reused[j]];
+		int lines = (int) tokens[after[j].begin].filePosition.line - (int) previousTokens[before[reused[j]].begin].filePosition.line;
+		if (lines != 0)
+			MoveTokens(global.get(), lines);
+
+		result.push_back(std::move(global));
+		++m_numReused;
+	}
+
+	globals = std::move(result);
+	return true;
+}
+
+bool IncrementalCompiler::Split(const std::vector<Token>& tokens, std::vector<Definition>& definitions){
+	size_t begin = 0;
+	int depth = 0;
+	size_t i;
+
+	for (i = 0; i < tokens.size() && tokens[i].type != TokenType::Eof; ++i){
+		if (tokens[i].type == TokenType::LBrace)
+			++depth;
+		else if (tokens[i].type == TokenType::RBrace && --depth < 0)
+			return false;
+
+		bool complete = depth == 0 && (tokens[i].type == TokenType::Semicolon || tokens[i].type == TokenType::RBrace);
+		if (!complete)
+			continue;
+
+		Definition def;
+		def.begin = begin;
+		def.end = i + 1;
+		def.isClass = tokens[begin].type == TokenType::Class;
+
+		//The name is the last identifier before the parameters, the body or the end.
+		size_t nameEnd = begin;
+		while (nameEnd < def.end && tokens[nameEnd].type != TokenType::LParen && tokens[nameEnd].type != TokenType::LBrace
+			&& tokens[nameEnd].type != TokenType::Assign && tokens[nameEnd].type != TokenType::Semicolon)
+			++nameEnd;
+		for (size_t k = begin; k < nameEnd; ++k){
+			if (tokens[k].type == TokenType::Ident)
+				def.name = tokens[k].GetTokenValue();
+		}
+
+		int firstLine = tokens[begin].filePosition.line;
+		bool inBody = false;
+		for (size_t k = begin; k < def.end; ++k){
+			inBody = inBody || (!def.isClass && tokens[k].type == TokenType::LBrace);
+			AppendKey(def.key, tokens[k], firstLine, true);
+			if (!inBody)
+				AppendKey(def.signature, tokens[k], firstLine, true);
+		}
+
+		definitions.push_back(def);
+		begin = i + 1;
+	}
+
+	return begin == i && depth == 0;
+}
+
+GlobalStmtPtr IncrementalCompiler::Parse(const std::vector<Token>& tokens, const Definition& definition){
+	std::vector<Token> part(tokens.begin() + definition.begin, tokens.begin() + definition.end);
+	part.push_back(Token(TokenType::Eof, "Eof", part.back().filePosition));
+
+	TokenStack ts(part);
+	StartBlockPtr start;
+	if (!m_parse(ts, start) || ts.GetCurrentToken().type != TokenType::Eof || start->GetChildren().size() != 1)
+		return nullptr;
+
+	EmptyStmtRemover esr;
+	start->accept(&esr, false);
+
+	return std::move(start->GetChildren()[0]);
+}
+
+void IncrementalCompiler::MoveTokens(ASTNode* n, int lines){
+	TokenMover mover(lines);
+	n->accept(&mover, false);
+}
\ No newline at end of file
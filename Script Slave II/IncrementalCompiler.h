@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "ASTNode.h"
+#include "TokenStack.h"
+
+class SymbolScope;
+class TypeTable;
+
+/*
+	Brings the checked AST of an earlier compile up to date with a changed source, so only the edited definitions go
+	through the front end again. The token streams are split into top-level definitions, which end with a ';' or a
+	'}' outside of braces. Definitions whose tokens are unchanged, apart from being moved up or down, keep their
+	nodes, symbols and scopes. Changed definitions are parsed and checked again:
+
+	- If only the body of a function changed, the new body replaces the old one. The function keeps its symbol, so
+	  other functions calling it are still valid.
+	- Otherwise the old definition and its symbols are removed and the new one is checked like in a full compile.
+	  Unchanged definitions which mention the name of such a definition are checked again as well, e.g. the callers
+	  of a function whose parameters changed.
+
+	Classes aren't handled, any changed class requires a full compile.
+*/
+class IncrementalCompiler
+{
+public:
+
+	typedef bool (*ParseFunc)(TokenStack& ts, StartBlockPtr& start);
+
+	//'parse' is match_start(), which is only available in the main translation unit.
+	IncrementalCompiler(ParseFunc parse, TypeTable& typeTable, SymbolScope& globalScope)
+		: m_parse(parse), m_typeTable(typeTable), m_globalScope(globalScope)
+	{}
+
+	//Updates start, globalScope and typeTable, the result of checking previousTokens, to the source of 'tokens'.
+	//Returns false if the source has to be compiled from scratch, because it has errors or changes which can't be
+	//applied. The AST and the symbols are unusable then.
+	bool Update(const std::vector<Token>& previousTokens, const std::vector<Token>& tokens, StartBlockPtr& start);
+
+	int GetNumReused() const {
+		return m_numReused;
+	}
+
+	//Definitions which were parsed and checked again, only their bodies for m_numBodies of them.
+	int GetNumChecked() const {
+		return m_numChecked;
+	}
+
+	int GetNumBodies() const {
+		return m_numBodies;
+	}
+
+private:
+
+	//Tokens [begin, end) of a top-level definition.
+	struct Definition{
+		size_t begin;
+		size_t end;
+		std::string name;
+		bool isClass;
+		std::string key;		//Tokens with their positions relative to the first line
+		std::string signature;	//Same for the tokens before the body of a function, all tokens of other definitions
+	};
+
+	bool Split(const std::vector<Token>& tokens, std::vector<Definition>& definitions);
+
+	//Parses the tokens of a single definition.
+	GlobalStmtPtr Parse(const std::vector<Token>& tokens, const Definition& definition);
+
+	//Moves the tokens of all nodes in a subtree by 'lines' lines.
+	void MoveTokens(ASTNode* n, int lines);
+
+	ParseFunc m_parse;
+	TypeTable& m_typeTable;
+	SymbolScope& m_globalScope;
+
+	int m_numReused = 0;
+	int m_numChecked = 0;
+	int m_numBodies = 0;
+};
\ No newline at end of file
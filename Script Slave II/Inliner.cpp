@@ -0,0 +1,579 @@
+#include "Inliner.h"
+#include "DeadCodeEliminator.h"
+#include "SymbolScope.h"
+#include "Util.h"
+
+#include <algorithm>
+
+namespace{
+
+	class NodeCounter : public BaseVisitor{
+	public:
+		int count = 0;
+
+		virtual bool inNode(ASTNode* n, bool last) override {
+			++count;
+			return true;
+		}
+	};
+
+	class ReturnFinder : public BaseVisitor{
+	public:
+		bool found = false;
+
+		virtual bool inNode(StmtReturn* n, bool last) override {
+			found = true;
+			return false;
+		}
+	};
+
+	int CountNodes(ASTNode* n){
+		NodeCounter counter;
+		n->accept(&counter, false);
+		return counter.count;
+	}
+
+	FuncDef* GetCallee(Ident const* name){
+		Symbol const* sym = name->GetSymbol();
+		if (sym == nullptr || sym->type != Symbol::FUNCTION)
+			return nullptr;
+		return const_cast<FuncDef*>((FuncDef const*) sym->GetNode());
+	}
+
+	//Expressions whose value can't be changed by a call and whose evaluation can't fail. They may be evaluated at
+	//any point of the inlined expression.
+	bool IsStable(Expr const* p){
+		switch (p->GetNodeType()){
+		case NodeType::IntLit:
+		case NodeType::FloatLit:
+		case NodeType::BoolLit:
+		case NodeType::StringLit:
+			return true;
+		case NodeType::Ident:
+		{
+			Symbol const* sym = ((Ident const*) p)->GetSymbol();
+			return sym != nullptr && (sym->type == Symbol::VARIABLE || sym->type == Symbol::PARAMETER);
+		}
+		case NodeType::UnOp:
+			return IsStable(((UnOp const*) p)->GetExpr());
+		case NodeType::BinOp:
+			return DeadCodeEliminator::IsPure(p) && IsStable(((BinOp const*) p)->GetLeft()) && IsStable(((BinOp const*) p)->GetRight());
+		default:
+			return false;
+		}
+	}
+
+	bool IsLeaf(Expr const* p){
+		switch (p->GetNodeType()){
+		case NodeType::IntLit:
+		case NodeType::FloatLit:
+		case NodeType::BoolLit:
+		case NodeType::StringLit:
+		case NodeType::Ident:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	void CountUses(Expr const* p, std::map<ASTNode const*, int>& uses){
+		switch (p->GetNodeType()){
+		case NodeType::Ident:
+		{
+			Symbol const* sym = ((Ident const*) p)->GetSymbol();
+			if (sym != nullptr)
+				++uses[sym->GetNode()];
+			return;
+		}
+		case NodeType::UnOp:
+			CountUses(((UnOp const*) p)->GetExpr(), uses);
+			return;
+		case NodeType::BinOp:
+			CountUses(((BinOp const*) p)->GetLeft(), uses);
+			CountUses(((BinOp const*) p)->GetRight(), uses);
+			return;
+		case NodeType::FuncCallExpr:
+			for (const auto& arg : ((FuncCallExpr const*) p)->GetArgs()->GetChildren())
+				CountUses(arg.get(), uses);
+			return;
+		default:
+			return;
+		}
+	}
+
+	TypePtr CloneType(Type const* p){
+		TypePtr type = std::make_unique<Type>(p->GetName());
+		type->SetTypeInfo(p->GetTypeInfo());
+		type->SetIsArray(p->GetIsArray());
+		type->SetToken(p->GetToken());
+		return type;
+	}
+}
+
+void Inliner::Process(StartBlockPtr& start){
+	//The temporaries are declared in the callers' scopes, which are frozen since the second pass.
+	m_globalScope.Thaw();
+
+	std::vector<FuncDef*> funcs;
+	for (auto& global : start->GetChildren()){
+		if (global->GetNodeType() == NodeType::FuncDef){
+			FuncDef* func = (FuncDef*) global.get();
+			funcs.push_back(func);
+			CollectCallees(func, m_callees[func]);
+		}
+	}
+
+	std::set<FuncDef*> visited;
+	std::vector<FuncDef*> order;
+	for (auto func : funcs)
+		OrderByCalls(func, visited, order);
+
+	for (auto func : order){
+		m_caller = func;
+		m_callerScope = m_globalScope.GetSubScope(func->GetName()->GetName());
+		func->GetStmtBlock()->accept(this, true);
+	}
+
+	m_globalScope.Freeze();
+}
+
+void Inliner::OrderByCalls(FuncDef* func, std::set<FuncDef*>& visited, std::vector<FuncDef*>& order){
+	if (!visited.insert(func).second)
+		return;
+
+	for (auto callee : m_callees[func]){
+		if (m_callees.count((FuncDef const*) callee) > 0)
+			OrderByCalls(const_cast<FuncDef*>((FuncDef const*) callee), visited, order);
+	}
+
+	order.push_back(func);
+}
+
+bool Inliner::IsRecursive(FuncDef const* func){
+	auto it = m_recursive.find(func);
+	if (it != m_recursive.end())
+		return it->second;
+
+	std::set<ASTNode const*> reached;
+	std::vector<ASTNode const*> pending(m_callees[func].begin(), m_callees[func].end());
+
+	while (!pending.empty() && reached.count(func) == 0){
+		ASTNode const* n = pending.back();
+		pending.pop_back();
+
+		if (!reached.insert(n).second)
+			continue;
+
+		auto callees = m_callees.find((FuncDef const*) n);
+		if (callees != m_callees.end())
+			pending.insert(pending.end(), callees->second.begin(), callees->second.end());
+	}
+
+	return m_recursive[func] = reached.count(func) > 0;
+}
+
+Inliner::Candidate Inliner::GetCandidate(FuncDef* func){
+	auto it = m_candidates.find(func);
+	if (it != m_candidates.end())
+		return it->second;
+
+	Candidate candidate{ Kind::None, 0 };
+	StmtBlock* body = func->GetStmtBlock();
+	const auto& stmts = body->GetChildren();
+
+	ReturnFinder finder;
+	body->accept(&finder, true);
+
+	if (IsRecursive(func))
+		candidate.kind = Kind::None;
+	else if (stmts.size() == 1 && stmts[0]->GetNodeType() == NodeType::StmtReturn && ((StmtReturn*) stmts[0].get())->GetExpr() != nullptr){
+		candidate.kind = Kind::Expression;
+		candidate.cost = CountNodes(((StmtReturn*) stmts[0].get())->GetExpr());
+	}
+	else if (func->GetRetType()->GetName() == "void" && !finder.found){
+		candidate.kind = Kind::Procedure;
+		candidate.cost = CountNodes(body) - 1;
+	}
+
+	return m_candidates[func] = candidate;
+}
+
+bool Inliner::ShouldInline(FuncDef* callee, Kind kind){
+	if (callee == m_caller || m_callees.count(callee) == 0)
+		return false;
+
+	Candidate candidate = GetCandidate(callee);
+	if (candidate.kind != kind)
+		return false;
+
+	if (candidate.cost <= MAX_COST)
+		return true;
+
+	Symbol const* sym = m_globalScope.GetSymbol(callee->GetName()->GetName(), SymbolScope::Function);
+	return candidate.cost <= MAX_SINGLE_CALL_COST && sym != nullptr && sym->useCount == 1;
+}
+
+bool Inliner::inNode(StmtVarDecl* n, bool last){
+	if (n->GetExpr() != nullptr)
+		InlineExpr(n->GetExprRef());
+	return false;
+}
+
+bool Inliner::inNode(StmtAssign* n, bool last){
+	if (n->GetLHS()->GetNodeType() != NodeType::Ident)
+		InlineExpr(n->GetLHSRef());
+	InlineExpr(n->GetExprRef());
+	return false;
+}
+
+bool Inliner::inNode(StmtFuncCall* n, bool last){
+	for (auto& arg : n->GetArgList()->GetChildren())
+		InlineExpr(arg);
+	return false;
+}
+
+bool Inliner::inNode(StmtWhile* n, bool last){
+	InlineExpr(n->GetExprRef());
+	return true;
+}
+
+bool Inliner::inNode(StmtIfThen* n, bool last){
+	InlineExpr(n->GetExprRef());
+	return true;
+}
+
+bool Inliner::inNode(StmtIfThenElse* n, bool last){
+	InlineExpr(n->GetExprRef());
+	return true;
+}
+
+bool Inliner::inNode(StmtReturn* n, bool last){
+	if (n->GetExpr() != nullptr)
+		InlineExpr(n->GetExprRef());
+	return false;
+}
+
+void Inliner::outNode(StmtBlock* n, bool last){
+	for (auto& child : n->GetChildren())
+		InlineStmt(child);
+}
+
+void Inliner::outNode(StmtWhile* n, bool last){
+	InlineStmt(n->GetBodyRef());
+}
+
+void Inliner::outNode(StmtIfThen* n, bool last){
+	InlineStmt(n->GetThenRef());
+}
+
+void Inliner::outNode(StmtIfThenElse* n, bool last){
+	InlineStmt(n->GetThenRef());
+	InlineStmt(n->GetElseRef());
+}
+
+void Inliner::InlineExpr(ExprPtr& expr){
+	switch (expr->GetNodeType()){
+	case NodeType::UnOp:
+		InlineExpr(((UnOp*) expr.get())->GetExprRef());
+		return;
+	case NodeType::BinOp:
+	{
+		BinOp* n = (BinOp*) expr.get();
+		if (n->GetType() == BinOp::FunctionCall)
+			return;
+		InlineExpr(n->GetLeftRef());
+		if (n->GetType() != BinOp::MemberAccess)	//Right side is the name of a member
+			InlineExpr(n->GetRightRef());
+		return;
+	}
+	case NodeType::FuncCallExpr:
+	{
+		FuncCallExpr* n = (FuncCallExpr*) expr.get();
+		for (auto& arg : n->GetArgs()->GetChildren())
+			InlineExpr(arg);
+
+		FuncDef* callee = GetCallee(n->GetCallee());
+		if (callee != nullptr && ShouldInline(callee, Kind::Expression))
+			InlineExpression(expr, callee);
+		return;
+	}
+	default:
+		return;
+	}
+}
+
+void Inliner::InlineStmt(StmtPtr& stmt){
+	if (stmt->GetNodeType() != NodeType::StmtFuncCall)
+		return;
+
+	FuncDef* callee = GetCallee(((StmtFuncCall*) stmt.get())->GetName());
+	if (callee != nullptr && ShouldInline(callee, Kind::Procedure))
+		InlineProcedure(stmt, callee);
+}
+
+bool Inliner::InlineExpression(ExprPtr& expr, FuncDef* callee){
+	FuncCallExpr* call = (FuncCallExpr*) expr.get();
+	const auto& args = call->GetArgs()->GetChildren();
+	const auto& params = callee->GetParamList()->GetChildren();
+	Expr const* body = ((StmtReturn*) callee->GetStmtBlock()->GetChildren()[0].get())->GetExpr();
+
+	if (args.size() != params.size())
+		return false;
+
+	std::map<ASTNode const*, int> uses;
+	CountUses(body, uses);
+
+	//Arguments which could change or fail while the body is evaluated have to be used exactly once, in a body
+	//which can't observe when it is evaluated.
+	int numUnstable = 0;
+	for (size_t i = 0; i < args.size(); ++i){
+		const int numUses = uses[params[i].get()];
+
+		if (IsStable(args[i].get())){
+			if (numUses > 1 && !IsLeaf(args[i].get()))
+				return false;
+		}
+		else if (numUses != 1 || ++numUnstable > 1 || !IsStable(body))
+			return false;
+	}
+
+	for (size_t i = 0; i < args.size(); ++i)
+		m_arguments[params[i].get()] = args[i].get();
+
+	ExprPtr result = CloneExpr(body);
+	result->SetToken(call->GetToken());
+	m_arguments.clear();
+
+	//Counted first, the call and its arguments are deleted with the assignment.
+	Count(callee, GetCandidate(callee).cost, CALL_OVERHEAD + args.size());
+
+	ReleaseSymbolUses(call);
+	expr = std::move(result);
+	return true;
+}
+
+void Inliner::InlineProcedure(StmtPtr& stmt, FuncDef* callee){
+	StmtFuncCall* call = (StmtFuncCall*) stmt.get();
+	auto& args = call->GetArgList()->GetChildren();
+	const auto& params = callee->GetParamList()->GetChildren();
+
+	if (args.size() != params.size())
+		return;
+
+	m_callee = callee;
+
+	//The arguments are evaluated in order into the parameters, which become locals of the caller
+	StmtBlockPtr block = std::make_unique<StmtBlock>();
+	block->SetToken(call->GetToken());
+
+	for (size_t i = 0; i < args.size(); ++i)
+		block->Add(NewLocal(params[i].get(), params[i]->GetType(), params[i]->GetName(), std::move(args[i])));
+
+	for (const auto& child : callee->GetStmtBlock()->GetChildren())
+		block->Add(CloneStmt(child.get()));
+
+	m_renamed.clear();
+
+	--call->GetName()->GetSymbol()->useCount;
+	stmt = std::move(block);
+
+	Count(callee, GetCandidate(callee).cost, CALL_OVERHEAD);
+}
+
+StmtVarDeclPtr Inliner::NewLocal(ASTNode const* original, Type const* type, Ident const* name, ExprPtr init){
+	const std::string newName = m_callee->GetName()->GetName() + "$" + name->GetName() + "$" + std::to_string(m_numRenamed++);
+
+	StmtVarDeclPtr decl = std::make_unique<StmtVarDecl>();
+	decl->SetToken(original->GetToken());
+	decl->GetTypeRef() = CloneType(type);
+	decl->GetNameRef() = std::make_unique<Ident>(newName);
+	decl->GetName()->SetToken(name->GetToken());
+	decl->GetName()->SetTypeInfo(type->GetTypeInfo());
+	decl->GetExprRef() = std::move(init);
+
+	m_callerScope->AddSymbol(newName, Symbol::CreateVariableSymbol(decl.get()));
+	Symbol const* sym = m_callerScope->GetSymbol(newName, SymbolScope::Variable);
+	decl->GetName()->SetSymbol(sym);
+	m_renamed[original] = sym;
+
+	return decl;
+}
+
+IdentPtr Inliner::CloneIdent(Ident const* p){
+	Symbol const* sym = p->GetSymbol();
+	IdentPtr ident;
+
+	auto renamed = sym != nullptr ? m_renamed.find(sym->GetNode()) : m_renamed.end();
+	if (renamed != m_renamed.end()){
+		sym = renamed->second;
+		ident = std::make_unique<Ident>(sym->name);
+	}
+	else
+		ident = std::make_unique<Ident>(p->GetName());
+
+	ident->SetSymbol(sym);
+	ident->SetTypeInfo(p->GetTypeInfo());
+	ident->SetFieldOffset(p->GetFieldOffset());
+	ident->SetToken(p->GetToken());
+
+	if (sym != nullptr)
+		++sym->useCount;
+	return ident;
+}
+
+ExprPtr Inliner::CloneExpr(Expr const* p){
+	ExprPtr expr;
+
+	switch (p->GetNodeType()){
+	case NodeType::Ident:
+	{
+		Symbol const* sym = ((Ident const*) p)->GetSymbol();
+		auto argument = sym != nullptr ? m_arguments.find(sym->GetNode()) : m_arguments.end();
+		if (argument != m_arguments.end())
+			return CloneExpr(argument->second);
+
+		return CloneIdent((Ident const*) p);
+	}
+	case NodeType::IntLit:		expr = std::make_unique<IntLit>(((IntLit const*) p)->GetValue()); break;
+	case NodeType::FloatLit:	expr = std::make_unique<FloatLit>(((FloatLit const*) p)->GetValue()); break;
+	case NodeType::BoolLit:		expr = std::make_unique<BoolLit>(((BoolLit const*) p)->GetValue()); break;
+	case NodeType::StringLit:	expr = std::make_unique<StringLit>(((StringLit const*) p)->GetValue()); break;
+	case NodeType::UnOp:
+		expr = std::make_unique<UnOp>(((UnOp const*) p)->GetType(), CloneExpr(((UnOp const*) p)->GetExpr()));
+		break;
+	case NodeType::BinOp:
+	{
+		BinOp const* n = (BinOp const*) p;
+		expr = std::make_unique<BinOp>(n->GetType(), CloneExpr(n->GetLeft()), CloneExpr(n->GetRight()));
+		break;
+	}
+	case NodeType::FuncCallExpr:
+	{
+		FuncCallExpr const* n = (FuncCallExpr const*) p;
+		ArgListPtr args = std::make_unique<ArgList>();
+		args->SetToken(n->GetArgs()->GetToken());
+		for (const auto& arg : n->GetArgs()->GetChildren())
+			args->Add(CloneExpr(arg.get()));
+		expr = std::make_unique<FuncCallExpr>(CloneIdent(n->GetCallee()), std::move(args));
+		break;
+	}
+	default:
+		_ASSERT(false);
+		return nullptr;
+	}
+
+	expr->SetTypeInfo(p->GetTypeInfo());
+	expr->SetToken(p->GetToken());
+	return expr;
+}
+
+StmtPtr Inliner::CloneStmt(Stmt const* p){
+	StmtPtr stmt;
+
+	switch (p->GetNodeType()){
+	case NodeType::StmtVarDecl:
+	{
+		StmtVarDecl const* n = (StmtVarDecl const*) p;
+		return NewLocal(n, n->GetType(), n->GetName(), n->GetExpr() != nullptr ? CloneExpr(n->GetExpr()) : nullptr);
+	}
+	case NodeType::StmtAssign:
+	{
+		StmtAssign const* n = (StmtAssign const*) p;
+		StmtAssignPtr assign = std::make_unique<StmtAssign>();
+		assign->GetLHSRef() = CloneExpr(n->GetLHS());
+		assign->GetExprRef() = CloneExpr(n->GetExpr());
+
+		//Writing a variable doesn't use it, like in SecondPass
+		if (assign->GetLHS()->GetNodeType() == NodeType::Ident && ((Ident*) assign->GetLHS())->GetSymbol() != nullptr)
+			--((Ident*) assign->GetLHS())->GetSymbol()->useCount;
+
+		stmt = std::move(assign);
+		break;
+	}
+	case NodeType::StmtFuncCall:
+	{
+		StmtFuncCall const* n = (StmtFuncCall const*) p;
+		StmtFuncCallPtr call = std::make_unique<StmtFuncCall>();
+		call->GetNameRef() = CloneIdent(n->GetName());
+		call->GetArgListRef() = std::make_unique<ArgList>();
+		call->GetArgList()->SetToken(n->GetArgList()->GetToken());
+		for (const auto& arg : n->GetArgList()->GetChildren())
+			call->GetArgList()->Add(CloneExpr(arg.get()));
+		stmt = std::move(call);
+		break;
+	}
+	case NodeType::StmtWhile:
+	{
+		StmtWhile const* n = (StmtWhile const*) p;
+		StmtWhilePtr loop = std::make_unique<StmtWhile>();
+		loop->GetExprRef() = CloneExpr(n->GetExpr());
+		loop->GetBodyRef() = CloneStmt(n->GetBody());
+		stmt = std::move(loop);
+		break;
+	}
+	case NodeType::StmtIfThen:
+	{
+		StmtIfThen const* n = (StmtIfThen const*) p;
+		StmtIfThenPtr branch = std::make_unique<StmtIfThen>();
+		branch->GetExprRef() = CloneExpr(n->GetExpr());
+		branch->GetThenRef() = CloneStmt(n->GetThen());
+		stmt = std::move(branch);
+		break;
+	}
+	case NodeType::StmtIfThenElse:
+	{
+		StmtIfThenElse const* n = (StmtIfThenElse const*) p;
+		StmtIfThenElsePtr branch = std::make_unique<StmtIfThenElse>();
+		branch->GetExprRef() = CloneExpr(n->GetExpr());
+		branch->GetThenRef() = CloneStmt(n->GetThen());
+		branch->GetElseRef() = CloneStmt(n->GetElse());
+		stmt = std::move(branch);
+		break;
+	}
+	case NodeType::StmtBlock:
+	{
+		StmtBlockPtr block = std::make_unique<StmtBlock>();
+		for (const auto& child : ((StmtBlock const*) p)->GetChildren())
+			block->Add(CloneStmt(child.get()));
+		stmt = std::move(block);
+		break;
+	}
+	case NodeType::StmtBreak:
+		stmt = std::make_unique<StmtBreak>();
+		break;
+	default:
+		_ASSERT(false);
+		return nullptr;
+	}
+
+	stmt->SetToken(p->GetToken());
+	return stmt;
+}
+
+void Inliner::Count(FuncDef const* callee, int cost, int saved){
+	const std::string& calleeName = callee->GetName()->GetName();
+	const std::string& callerName = m_caller->GetName()->GetName();
+
+	auto it = std::find_if(m_report.begin(), m_report.end(), [&](const Report& r){ return r.callee == calleeName && r.caller == callerName; });
+	if (it == m_report.end()){
+		m_report.push_back(Report{ calleeName, callerName, cost, 0, 0 });
+		it = m_report.end() - 1;
+	}
+
+	++it->numCalls;
+	it->saved += saved;
+}
+
+int Inliner::GetNumInlined() const {
+	int num = 0;
+	for (const auto& r : m_report)
+		num += r.numCalls;
+	return num;
+}
+
+int Inliner::GetEstimatedSavings() const {
+	int saved = 0;
+	for (const auto& r : m_report)
+		saved += r.saved;
+	return saved;
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "ASTNode.h"
+#include "BaseVisitor.h"
+
+class Symbol;
+class SymbolScope;
+
+/*
+	Replaces calls of small functions by their bodies on the type checked AST. Two kinds of functions are inlined:
+
+	- Functions whose body is a single "return <expr>;". The call expression is replaced by the returned expression,
+	  parameters are replaced by the arguments. A call is left alone if that would evaluate an argument with side
+	  effects more than once, not at all or in a different order relative to the rest of the expression.
+	- Functions returning void without any return statement, at statement calls. The call becomes a block which
+	  declares the parameters as locals initialized with the arguments, followed by the body.
+
+	Locals of the inlined function are renamed to "<callee>$<name>$<n>" and get new symbols in the caller's scope.
+	Recursive functions, found through the call graph, are never inlined. Callees are processed before their callers,
+	so bodies are inlined in their final form.
+
+	The cost of a function is the number of AST nodes in its body. Functions up to MAX_COST are always inlined,
+	functions with a single call site up to MAX_SINGLE_CALL_COST, since the original is removed afterwards.
+*/
+class Inliner : public BaseVisitor
+{
+public:
+
+	static const int MAX_COST = 12;
+	static const int MAX_SINGLE_CALL_COST = 40;
+
+	//Instructions an invocation costs besides the body: the invoke, the return and storing the result.
+	static const int CALL_OVERHEAD = 3;
+
+	struct Report{
+		std::string callee;
+		std::string caller;
+		int cost;		//Size of the inlined body in AST nodes
+		int numCalls;
+		int saved;		//Estimated number of instructions saved, CALL_OVERHEAD and the argument passing per call
+	};
+
+	Inliner(SymbolScope& globalScope) : m_globalScope(globalScope) {}
+
+	void Process(StartBlockPtr& start);
+
+	int GetNumInlined() const;
+	int GetEstimatedSavings() const;
+
+	//One entry per inlined callee and caller, in the order in which they were inlined.
+	const std::vector<Report>& GetReport() const {
+		return m_report;
+	}
+
+	virtual bool inNode(StmtVarDecl* n, bool last) override;
+	virtual bool inNode(StmtAssign* n, bool last) override;
+	virtual bool inNode(StmtFuncCall* n, bool last) override;
+	virtual bool inNode(StmtWhile* n, bool last) override;
+	virtual bool inNode(StmtIfThen* n, bool last) override;
+	virtual bool inNode(StmtIfThenElse* n, bool last) override;
+	virtual bool inNode(StmtReturn* n, bool last) override;
+	virtual void outNode(StmtBlock* n, bool last) override;
+	virtual void outNode(StmtWhile* n, bool last) override;
+	virtual void outNode(StmtIfThen* n, bool last) override;
+	virtual void outNode(StmtIfThenElse* n, bool last) override;
+
+private:
+
+	enum class Kind{
+		None,
+		Expression,		//return <expr>;
+		Procedure		//void, no return
+	};
+
+	struct Candidate{
+		Kind kind;
+		int cost;
+	};
+
+	//Functions in an order where every function comes after the ones it calls, apart from recursion.
+	void OrderByCalls(FuncDef* func, std::set<FuncDef*>& visited, std::vector<FuncDef*>& order);
+
+	bool IsRecursive(FuncDef const* func);
+
+	Candidate GetCandidate(FuncDef* func);
+
+	//Cost model, decides whether a call of 'callee' of the given kind is inlined into m_caller.
+	bool ShouldInline(FuncDef* callee, Kind kind);
+
+	void InlineExpr(ExprPtr& expr);
+	void InlineStmt(StmtPtr& stmt);
+
+	//Tries to replace the call by the returned expression. Returns false if the call has to stay.
+	bool InlineExpression(ExprPtr& expr, FuncDef* callee);
+	void InlineProcedure(StmtPtr& stmt, FuncDef* callee);
+
+	ExprPtr CloneExpr(Expr const* p);
+	StmtPtr CloneStmt(Stmt const* p);
+	IdentPtr CloneIdent(Ident const* p);
+
+	//Declaration of a renamed local of the inlined function with a new symbol in the caller's scope.
+	StmtVarDeclPtr NewLocal(ASTNode const* original, Type const* type, Ident const* name, ExprPtr init);
+
+	void Count(FuncDef const* callee, int cost, int saved);
+
+	SymbolScope& m_globalScope;
+	SymbolScope* m_callerScope;
+	FuncDef* m_caller;
+	FuncDef* m_callee;		//Procedure being inlined
+
+	std::map<FuncDef const*, Candidate> m_candidates;
+	std::map<FuncDef const*, bool> m_recursive;
+	std::map<FuncDef const*, std::set<ASTNode const*>> m_callees;
+
+	//While cloning: parameters replaced by arguments and locals replaced by renamed ones.
+	std::map<ASTNode const*, Expr const*> m_arguments;
+	std::map<ASTNode const*, Symbol const*> m_renamed;
+
+	int m_numRenamed = 0;
+	std::vector<Report> m_report;
+};
\ No newline at end of file
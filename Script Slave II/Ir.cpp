@@ -0,0 +1,691 @@
+#include "Ir.h"
+
+#include <algorithm>
+#include "StringUtil.h"
+
+#define IR_OP_TEXT(name, text) text,
+
+static const char* g_opNames[] = {
+	IR_OPS(IR_OP_TEXT)
+};
+
+#undef IR_OP_TEXT
+
+static_assert(sizeof(g_opNames) / sizeof(g_opNames[0]) == (size_t) IrOp::NumOps, "g_opNames does not match IrOp");
+
+static const char* GetTypeName(IrType type){
+	switch (type){
+	case IrType::Void:		return "void";
+	case IrType::Int:		return "int";
+	case IrType::Float:		return "float";
+	case IrType::Bool:		return "bool";
+	case IrType::String:	return "string";
+	case IrType::Array:		return "array";
+	case IrType::Object:	return "object";
+	default:				return "?";
+	}
+}
+
+void IrFunction::ComputeCfg(){
+	for (auto& block : blocks){
+		block.preds.clear();
+		block.succs.clear();
+	}
+
+	//Predecessors are always sorted by block index, phi arguments rely on that order.
+	for (size_t i = 0; i < blocks.size(); ++i){
+		const IrInstr& term = blocks[i].instrs.back();
+
+		for (int t = 0; t < term.NumTargets(); ++t){
+			auto& succs = blocks[i].succs;
+			if (std::find(succs.begin(), succs.end(), term.targets[t]) != succs.end())
+				continue;
+
+			succs.push_back(term.targets[t]);
+			blocks[term.targets[t]].preds.push_back(i);
+		}
+	}
+}
+
+void IrFunction::RemoveUnreachableBlocks(){
+	std::vector<bool> reachable(blocks.size(), false);
+	std::vector<int> worklist(1, 0);
+	reachable[0] = true;
+
+	while (!worklist.empty()){
+		int b = worklist.back();
+		worklist.pop_back();
+
+		for (int s : blocks[b].succs){
+			if (!reachable[s]){
+				reachable[s] = true;
+				worklist.push_back(s);
+			}
+		}
+	}
+
+	std::vector<int> newIndex(blocks.size(), -1);
+	int count = 0;
+	for (size_t i = 0; i < blocks.size(); ++i)
+		if (reachable[i])
+			newIndex[i] = count++;
+
+	if (count == (int) blocks.size())
+		return;
+
+	for (size_t i = 0; i < blocks.size(); ++i){
+		if (!reachable[i])
+			continue;
+
+		IrBlock& block = blocks[i];
+
+		//Drop the phi arguments of edges which are removed
+		for (auto& instr : block.instrs){
+			if (instr.op != IrOp::Phi)
+				break;
+
+			std::vector<int> args;
+			for (size_t p = 0; p < block.preds.size(); ++p)
+				if (reachable[block.preds[p]])
+					args.push_back(instr.args[p]);
+			instr.args = std::move(args);
+		}
+
+		IrInstr& term = block.instrs.back();
+		for (int t = 0; t < term.NumTargets(); ++t)
+			term.targets[t] = newIndex[term.targets[t]];
+	}
+
+	std::vector<IrBlock> remaining;
+	remaining.reserve(count);
+	for (size_t i = 0; i < blocks.size(); ++i)
+		if (reachable[i])
+			remaining.push_back(std::move(blocks[i]));
+
+	blocks = std::move(remaining);
+	ComputeCfg();
+}
+
+std::vector<int> IrFunction::ComputeReversePostorder() const {
+	std::vector<int> order;
+	std::vector<bool> visited(blocks.size(), false);
+	std::vector<std::pair<int, size_t>> stack;	//Block and index of the next successor to visit
+
+	stack.emplace_back(0, 0);
+	visited[0] = true;
+
+	while (!stack.empty()){
+		auto& top = stack.back();
+		const auto& succs = blocks[top.first].succs;
+
+		if (top.second < succs.size()){
+			int s = succs[top.second++];
+			if (!visited[s]){
+				visited[s] = true;
+				stack.emplace_back(s, 0);
+			}
+		}
+		else{
+			order.push_back(top.first);
+			stack.pop_back();
+		}
+	}
+
+	std::reverse(order.begin(), order.end());
+	return order;
+}
+
+void IrFunction::ComputeDominators(){
+	std::vector<int> rpo = ComputeReversePostorder();
+	std::vector<int> rpoIndex(blocks.size(), -1);
+	for (size_t i = 0; i < rpo.size(); ++i)
+		rpoIndex[rpo[i]] = i;
+
+	for (auto& block : blocks)
+		block.idom = -1;
+	blocks[0].idom = 0;
+
+	auto intersect = [&](int a, int b){
+		while (a != b){
+			while (rpoIndex[a] > rpoIndex[b])
+				a = blocks[a].idom;
+			while (rpoIndex[b] > rpoIndex[a])
+				b = blocks[b].idom;
+		}
+		return a;
+	};
+
+	bool changed = true;
+	while (changed){
+		changed = false;
+
+		for (size_t i = 1; i < rpo.size(); ++i){
+			IrBlock& block = blocks[rpo[i]];
+			int newIdom = -1;
+
+			for (int p : block.preds){
+				if (blocks[p].idom < 0)
+					continue;
+				newIdom = newIdom < 0 ? p : intersect(p, newIdom);
+			}
+
+			if (newIdom != block.idom){
+				block.idom = newIdom;
+				changed = true;
+			}
+		}
+	}
+}
+
+std::vector<std::vector<int>> IrFunction::ComputeDominanceFrontiers() const {
+	std::vector<std::vector<int>> frontiers(blocks.size());
+
+	for (size_t b = 0; b < blocks.size(); ++b){
+		if (blocks[b].preds.size() < 2 || blocks[b].idom < 0)
+			continue;
+
+		for (int p : blocks[b].preds){
+			int runner = p;
+
+			while (runner != blocks[b].idom && blocks[runner].idom >= 0){
+				auto& df = frontiers[runner];
+				if (std::find(df.begin(), df.end(), (int) b) == df.end())
+					df.push_back(b);
+
+				if (runner == 0)
+					break;
+				runner = blocks[runner].idom;
+			}
+		}
+	}
+
+	return frontiers;
+}
+
+bool IrFunction::Dominates(int a, int b) const {
+	for (;;){
+		if (a == b)
+			return true;
+		if (b == 0 || blocks[b].idom < 0)
+			return false;
+		b = blocks[b].idom;
+	}
+}
+
+
+static void WriteReg(OutputBuffer& out, int reg){
+	if (reg < 0){
+		out.PutLit("<none>");
+		return;
+	}
+
+	out.Put('%');
+	out.PutInt(reg);
+}
+
+static void WriteStringConstant(OutputBuffer& out, const std::string& str){
+	out.Put('"');
+	for (char c : str){
+		switch (c){
+		case '\n':	out.PutLit("\\n"); break;
+		case '\t':	out.PutLit("\\t"); break;
+		case '"':	out.PutLit("\\\""); break;
+		case '\\':	out.PutLit("\\\\"); break;
+		default:	out.Put(c); break;
+		}
+	}
+	out.Put('"');
+}
+
+static void WriteInstr(OutputBuffer& out, const IrModule& module, const IrFunction& function, const IrInstr& instr){
+	out.Put('\t');
+
+	if (instr.dest >= 0){
+		WriteReg(out, instr.dest);
+		out.PutLit(" = ");
+	}
+
+	out.Put(g_opNames[(int) instr.op]);
+	if (instr.type != IrType::Void){
+		out.Put('.');
+		out.Put(GetTypeName(instr.type));
+	}
+
+	switch (instr.op){
+	case IrOp::Const:
+	case IrOp::Param:
+		out.Put(' ');
+		out.PutInt(instr.imm);
+		break;
+	case IrOp::ConstFloat:
+		out.Put(' ');
+		out.PutFloat(instr.fimm);
+		break;
+	case IrOp::ConstString:
+		out.Put(' ');
+		WriteStringConstant(out, module.strings[instr.imm]);
+		break;
+	case IrOp::LoadVar:
+	case IrOp::StoreVar:
+		out.PutLit(" $");
+		out.Put(function.varNames[instr.imm]);
+		break;
+	case IrOp::LoadGlobal:
+	case IrOp::StoreGlobal:
+		out.PutLit(" @");
+		out.Put(module.globalNames[instr.imm]);
+		break;
+	case IrOp::LoadField:
+	case IrOp::StoreField:
+		out.PutLit(" +");
+		out.PutInt(instr.imm);
+		break;
+	case IrOp::Call:
+		out.Put(' ');
+		out.Put(module.functions[instr.imm].name);
+		out.Put('(');
+		for (size_t i = 0; i < instr.args.size(); ++i){
+			if (i > 0)
+				out.PutLit(", ");
+			WriteReg(out, instr.args[i]);
+		}
+		out.Put(')');
+		break;
+	default:
+		break;
+	}
+
+	bool first = instr.op != IrOp::LoadGlobal && instr.op != IrOp::StoreGlobal && instr.op != IrOp::StoreVar &&
+		instr.op != IrOp::LoadField && instr.op != IrOp::StoreField;
+	for (int i = 0; i < 3; ++i){
+		if (instr.ops[i] < 0)
+			continue;
+
+		out.Put(first ? " " : ", ");
+		WriteReg(out, instr.ops[i]);
+		first = false;
+	}
+
+	for (int t = 0; t < instr.NumTargets(); ++t){
+		out.Put(first ? " b" : ", b");
+		out.PutInt(instr.targets[t]);
+		first = false;
+	}
+}
+
+void IrModule::Write(OutputBuffer& out) const {
+	for (const auto& function : functions){
+		out.PutLit("function ");
+		out.Put(GetTypeName(function.retType));
+		out.Put(' ');
+		out.Put(function.name);
+		out.Put('(');
+		for (size_t i = 0; i < function.paramTypes.size(); ++i){
+			if (i > 0)
+				out.PutLit(", ");
+			out.Put(GetTypeName(function.paramTypes[i]));
+		}
+		out.PutLit(")\n");
+
+		for (size_t b = 0; b < function.blocks.size(); ++b){
+			const IrBlock& block = function.blocks[b];
+
+			out.Put('b');
+			out.PutInt(b);
+			out.Put(':');
+			if (!block.preds.empty()){
+				out.PadTo(32);
+				out.PutLit("; preds:");
+				for (int p : block.preds){
+					out.PutLit(" b");
+					out.PutInt(p);
+				}
+			}
+			out.Newline();
+
+			for (const auto& instr : block.instrs){
+				WriteInstr(out, *this, function, instr);
+
+				if (instr.op == IrOp::Phi){
+					for (size_t i = 0; i < instr.args.size(); ++i){
+						out.Put(i == 0 ? " [" : ", [");
+						WriteReg(out, instr.args[i]);
+						out.PutLit(", b");
+						out.PutInt(i < block.preds.size() ? block.preds[i] : -1);
+						out.Put(']');
+					}
+
+					if (instr.imm >= 0 && instr.imm < (int) function.varNames.size()){
+						out.PadTo(48);
+						out.PutLit("; ");
+						out.Put(function.varNames[instr.imm]);
+					}
+				}
+
+				out.Newline();
+			}
+		}
+
+		out.Newline();
+	}
+}
+
+
+static bool HasResult(IrOp op){
+	switch (op){
+	case IrOp::StoreVar:
+	case IrOp::StoreGlobal:
+	case IrOp::ArrayStore:
+	case IrOp::StoreField:
+	case IrOp::Jump:
+	case IrOp::Branch:
+	case IrOp::Return:
+		return false;
+	default:
+		return true;
+	}
+}
+
+//Number of register operands in IrInstr::ops
+static int NumOperands(IrOp op){
+	switch (op){
+	case IrOp::StoreVar:
+	case IrOp::StoreGlobal:
+	case IrOp::Neg:
+	case IrOp::Not:
+	case IrOp::ToString:
+	case IrOp::ArrayLength:
+	case IrOp::LoadField:
+	case IrOp::Branch:
+		return 1;
+	case IrOp::Add: case IrOp::Sub: case IrOp::Mul: case IrOp::Div: case IrOp::Mod:
+	case IrOp::And: case IrOp::Or: case IrOp::Xor:
+	case IrOp::CmpEq: case IrOp::CmpNe: case IrOp::CmpLt: case IrOp::CmpLe: case IrOp::CmpGt: case IrOp::CmpGe:
+	case IrOp::Concat:
+	case IrOp::ArrayLoad:
+	case IrOp::StoreField:
+		return 2;
+	case IrOp::ArrayStore:
+		return 3;
+	default:
+		return 0;
+	}
+}
+
+class FunctionVerifier{
+public:
+
+	void Verify(){
+		if (m_function.blocks.empty()){
+			AddError(-1, "function has no blocks");
+			return;
+		}
+
+		if (!CheckStructure() || !CheckCfg())
+			return;
+
+		CollectDefinitions();
+		CheckUses();
+	}
+
+	FunctionVerifier(const IrModule& module, const IrFunction& function, std::vector<std::string>& errors)
+		: m_module(module), m_original(function), m_function(function), m_errors(errors)
+	{}
+
+private:
+	struct Definition{
+		int block;
+		int index;
+	};
+
+	//Terminators and phis.
+	bool CheckStructure(){
+		bool ok = true;
+
+		for (size_t b = 0; b < m_function.blocks.size(); ++b){
+			const auto& instrs = m_function.blocks[b].instrs;
+
+			if (instrs.empty() || !instrs.back().IsTerminator()){
+				AddError(b, "block does not end with a terminator");
+				ok = false;
+				continue;
+			}
+
+			bool phisAllowed = true;
+			for (size_t i = 0; i < instrs.size(); ++i){
+				const IrInstr& instr = instrs[i];
+
+				if (instr.IsTerminator() && i != instrs.size() - 1){
+					AddError(b, "terminator in the middle of the block");
+					ok = false;
+				}
+
+				if (instr.op == IrOp::Phi && !phisAllowed){
+					AddError(b, "phi after a non-phi instruction");
+					ok = false;
+				}
+				phisAllowed &= instr.op == IrOp::Phi;
+
+				if (instr.op == IrOp::LoadVar || instr.op == IrOp::StoreVar){
+					AddError(b, "variable access left after SSA construction");
+					ok = false;
+				}
+
+				for (int t = 0; t < instr.NumTargets(); ++t){
+					if (instr.targets[t] < 0 || instr.targets[t] >= (int) m_function.blocks.size()){
+						AddError(b, "jump to unknown block b%d", instr.targets[t]);
+						ok = false;
+					}
+				}
+			}
+		}
+
+		return ok;
+	}
+
+	//The stored CFG has to match the terminators, otherwise phi arguments are matched with the wrong edges.
+	bool CheckCfg(){
+		bool ok = true;
+
+		m_function.ComputeCfg();
+		m_function.ComputeDominators();
+
+		for (size_t b = 0; b < m_function.blocks.size(); ++b){
+			const IrBlock& stored = m_original.blocks[b];
+
+			if (m_function.blocks[b].preds != stored.preds || m_function.blocks[b].succs != stored.succs){
+				AddError(b, "stored predecessors/successors do not match the terminators");
+				ok = false;
+			}
+
+			if (m_function.blocks[b].idom < 0){
+				AddError(b, "block is unreachable");
+				ok = false;
+			}
+		}
+
+		return ok;
+	}
+
+	void CollectDefinitions(){
+		m_defs.assign(m_function.regTypes.size(), Definition{ -1, -1 });
+
+		for (size_t b = 0; b < m_function.blocks.size(); ++b){
+			const auto& instrs = m_function.blocks[b].instrs;
+
+			for (size_t i = 0; i < instrs.size(); ++i){
+				const IrInstr& instr = instrs[i];
+
+				if (!HasResult(instr.op) && instr.dest >= 0)
+					AddError(b, "%s must not have a result", g_opNames[(int) instr.op]);
+
+				if (instr.dest < 0){
+					if (HasResult(instr.op) && !(instr.op == IrOp::Call && instr.type == IrType::Void))
+						AddError(b, "%s has no result register", g_opNames[(int) instr.op]);
+					continue;
+				}
+
+				if (instr.dest >= (int) m_defs.size()){
+					AddError(b, "%%%d is not a register of the function", instr.dest);
+					continue;
+				}
+
+				if (m_defs[instr.dest].block >= 0)
+					AddError(b, "%%%d is defined more than once", instr.dest);
+
+				if (m_function.regTypes[instr.dest] != instr.GetResultType())
+					AddError(b, "%%%d has type %s, but %s produces %s", instr.dest, GetTypeName(m_function.regTypes[instr.dest]),
+						g_opNames[(int) instr.op], GetTypeName(instr.GetResultType()));
+
+				m_defs[instr.dest] = Definition{ (int) b, (int) i };
+			}
+		}
+	}
+
+	void CheckUses(){
+		for (size_t b = 0; b < m_function.blocks.size(); ++b){
+			const IrBlock& block = m_function.blocks[b];
+
+			for (size_t i = 0; i < block.instrs.size(); ++i){
+				const IrInstr& instr = block.instrs[i];
+
+				const int numOperands = NumOperands(instr.op) + (instr.op == IrOp::Return && instr.type != IrType::Void ? 1 : 0);
+				for (int o = 0; o < 3; ++o){
+					if ((instr.ops[o] >= 0) != (o < numOperands))
+						AddError(b, "%s has the wrong number of operands", g_opNames[(int) instr.op]);
+					else if (instr.ops[o] >= 0)
+						CheckUse(instr.ops[o], b, i);
+				}
+
+				if (instr.op == IrOp::Phi){
+					if (instr.args.size() != block.preds.size()){
+						AddError(b, "phi %%%d has %d arguments but the block has %d predecessors", instr.dest, (int) instr.args.size(), (int) block.preds.size());
+						continue;
+					}
+
+					//A phi argument is used at the end of the corresponding predecessor
+					for (size_t a = 0; a < instr.args.size(); ++a){
+						int pred = block.preds[a];
+						CheckUse(instr.args[a], pred, m_function.blocks[pred].instrs.size());
+						CheckType(instr.args[a], instr.type, b);
+					}
+				}
+				else if (instr.op == IrOp::Call){
+					const IrFunction& callee = m_module.functions[instr.imm];
+					if (instr.args.size() != callee.paramTypes.size()){
+						AddError(b, "call of %s with the wrong number of arguments", callee.name.c_str());
+						continue;
+					}
+					for (size_t a = 0; a < instr.args.size(); ++a){
+						CheckUse(instr.args[a], b, i);
+						CheckType(instr.args[a], callee.paramTypes[a], b);
+					}
+					if (instr.type != callee.retType)
+						AddError(b, "call of %s has the wrong result type", callee.name.c_str());
+				}
+
+				CheckOperandTypes(instr, b);
+			}
+		}
+	}
+
+	void CheckOperandTypes(const IrInstr& instr, int b){
+		switch (instr.op){
+		case IrOp::Add: case IrOp::Sub: case IrOp::Mul: case IrOp::Div: case IrOp::Mod:
+		case IrOp::And: case IrOp::Or: case IrOp::Xor:
+		case IrOp::CmpEq: case IrOp::CmpNe: case IrOp::CmpLt: case IrOp::CmpLe: case IrOp::CmpGt: case IrOp::CmpGe:
+			CheckType(instr.ops[0], instr.type, b);
+			CheckType(instr.ops[1], instr.type, b);
+			break;
+		case IrOp::Neg:
+		case IrOp::Not:
+		case IrOp::ToString:
+		case IrOp::StoreGlobal:
+			CheckType(instr.ops[0], instr.type, b);
+			break;
+		case IrOp::Concat:
+			CheckType(instr.ops[0], IrType::String, b);
+			CheckType(instr.ops[1], IrType::String, b);
+			break;
+		case IrOp::ArrayLength:
+			CheckType(instr.ops[0], IrType::Array, b);
+			break;
+		case IrOp::ArrayLoad:
+			CheckType(instr.ops[0], IrType::Array, b);
+			CheckType(instr.ops[1], IrType::Int, b);
+			break;
+		case IrOp::ArrayStore:
+			CheckType(instr.ops[0], IrType::Array, b);
+			CheckType(instr.ops[1], IrType::Int, b);
+			CheckType(instr.ops[2], instr.type, b);
+			break;
+		case IrOp::LoadField:
+			CheckType(instr.ops[0], IrType::Object, b);
+			break;
+		case IrOp::StoreField:
+			CheckType(instr.ops[0], IrType::Object, b);
+			CheckType(instr.ops[1], instr.type, b);
+			break;
+		case IrOp::Branch:
+			CheckType(instr.ops[0], IrType::Bool, b);
+			break;
+		case IrOp::Return:
+			if (instr.type != m_function.retType)
+				AddError(b, "return type does not match the function");
+			else if (instr.type != IrType::Void)
+				CheckType(instr.ops[0], instr.type, b);
+			break;
+		default:
+			break;
+		}
+	}
+
+	//Checks that 'reg' is defined before it's used at instruction 'index' of 'block'.
+	void CheckUse(int reg, int block, int index){
+		if (reg < 0 || reg >= (int) m_defs.size() || m_defs[reg].block < 0){
+			AddError(block, "%%%d is used but never defined", reg);
+			return;
+		}
+
+		const Definition& def = m_defs[reg];
+		bool dominated = def.block == block ? def.index < index : m_function.Dominates(def.block, block);
+
+		if (!dominated)
+			AddError(block, "definition of %%%d does not dominate its use", reg);
+	}
+
+	void CheckType(int reg, IrType type, int block){
+		if (reg >= 0 && reg < (int) m_function.regTypes.size() && m_function.regTypes[reg] != type)
+			AddError(block, "%%%d has type %s, expected %s", reg, GetTypeName(m_function.regTypes[reg]), GetTypeName(type));
+	}
+
+	void AddError(int block, const std::string fmt_str, ...){
+		va_list ap;
+		va_start(ap, fmt_str);
+		std::string v = va_string_format(fmt_str, ap);
+		va_end(ap);
+
+		std::string location = "function " + m_function.name;
+		if (block >= 0)
+			location += ", b" + std::to_string(block);
+
+		m_errors.push_back(location + ": " + v);
+	}
+
+	const IrModule& m_module;
+	const IrFunction& m_original;
+	IrFunction m_function;		//Copy with freshly computed dominators
+	std::vector<std::string>& m_errors;
+	std::vector<Definition> m_defs;
+};
+
+bool IrModule::Verify(std::vector<std::string>& errors) const {
+	size_t numErrors = errors.size();
+
+	for (const auto& function : functions){
+		FunctionVerifier verifier(*this, function, errors);
+		verifier.Verify();
+	}
+
+	return errors.size() == numErrors;
+}
\ No newline at end of file
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "OutputBuffer.h"
+
+enum class IrType : unsigned char{
+	Void,
+	Int,
+	Float,
+	Bool,
+	String,
+	Array,
+	Object
+};
+
+//Instructions of the intermediate representation.
+//X(name, text in the dump)
+#define IR_OPS(X)							\
+	X(Const, "const")						\
+	X(ConstFloat, "fconst")					\
+	X(ConstString, "sconst")				\
+	X(ConstNull, "null")					\
+	X(Undef, "undef")						\
+	X(Param, "param")						\
+											\
+	X(LoadVar, "loadvar")					\
+	X(StoreVar, "storevar")					\
+	X(LoadGlobal, "loadglobal")				\
+	X(StoreGlobal, "storeglobal")			\
+											\
+	X(Add, "add")							\
+	X(Sub, "sub")							\
+	X(Mul, "mul")							\
+	X(Div, "div")							\
+	X(Mod, "mod")							\
+	X(Neg, "neg")							\
+	X(Not, "not")							\
+	X(And, "and")							\
+	X(Or, "or")								\
+	X(Xor, "xor")							\
+	X(CmpEq, "cmpeq")						\
+	X(CmpNe, "cmpne")						\
+	X(CmpLt, "cmplt")						\
+	X(CmpLe, "cmple")						\
+	X(CmpGt, "cmpgt")						\
+	X(CmpGe, "cmpge")						\
+											\
+	X(ToString, "tostring")					\
+	X(Concat, "concat")						\
+	X(ArrayLength, "arraylength")			\
+	X(ArrayLoad, "arrayload")				\
+	X(ArrayStore, "arraystore")				\
+	X(LoadField, "loadfield")				\
+	X(StoreField, "storefield")				\
+	X(Call, "call")							\
+	X(Phi, "phi")							\
+											\
+	X(Jump, "jmp")							\
+	X(Branch, "br")							\
+	X(Return, "ret")
+
+#define IR_OP_ENUM(name, text) name,
+
+enum class IrOp : unsigned char{
+	IR_OPS(IR_OP_ENUM)
+	NumOps
+};
+
+#undef IR_OP_ENUM
+
+/*
+	Three-address instruction. Registers are numbered per function and every register is written by exactly one
+	instruction once the function is in SSA form.
+
+	'type' is the type the instruction operates on, i.e. the operand type of comparisons, ToString and ArrayLength,
+	the element type of array accesses and the field type of field accesses. GetResultType() gives the type of the
+	destination register.
+*/
+class IrInstr{
+public:
+	IrOp op;
+	IrType type;
+	int dest;				//-1 if the instruction has no result
+	int ops[3];				//Register operands, -1 if unused
+	union{
+		int imm;			//Constant, parameter/variable/global/function/string index, field offset
+		float fimm;			//Value of ConstFloat
+	};
+	int targets[2];			//Successor blocks of Jump and Branch
+	std::vector<int> args;	//Call arguments, Phi values in the order of the block's predecessors
+
+	bool IsTerminator() const {
+		return op == IrOp::Jump || op == IrOp::Branch || op == IrOp::Return;
+	}
+
+	int NumTargets() const {
+		return op == IrOp::Jump ? 1 : op == IrOp::Branch ? 2 : 0;
+	}
+
+	IrType GetResultType() const {
+		switch (op){
+		case IrOp::CmpEq: case IrOp::CmpNe: case IrOp::CmpLt:
+		case IrOp::CmpLe: case IrOp::CmpGt: case IrOp::CmpGe:
+			return IrType::Bool;
+		case IrOp::ToString:
+		case IrOp::Concat:
+			return IrType::String;
+		case IrOp::ArrayLength:
+			return IrType::Int;
+		default:
+			return type;
+		}
+	}
+
+	IrInstr(IrOp op, IrType type = IrType::Void, int dest = -1, int a = -1, int b = -1, int c = -1)
+		: op(op), type(type), dest(dest), imm(0)
+	{
+		ops[0] = a;
+		ops[1] = b;
+		ops[2] = c;
+		targets[0] = targets[1] = -1;
+	}
+};
+
+class IrBlock{
+public:
+	std::vector<IrInstr> instrs;	//Phis first, exactly one terminator at the end
+	std::vector<int> preds;
+	std::vector<int> succs;
+	int idom;						//Immediate dominator, the entry block dominates itself. -1 if unreachable.
+};
+
+class IrFunction{
+public:
+	std::string name;
+	IrType retType;
+	std::vector<IrType> paramTypes;
+	std::vector<IrBlock> blocks;			//blocks[0] is the entry block
+	std::vector<IrType> regTypes;			//Type of every register
+	std::vector<std::string> varNames;		//Names of the source variables, used to comment phis
+
+	int NewReg(IrType type){
+		regTypes.push_back(type);
+		return regTypes.size() - 1;
+	}
+
+	//Recomputes preds and succs of all blocks from the terminators.
+	void ComputeCfg();
+
+	//Removes blocks which can't be reached from the entry block. Needs an up to date CFG and keeps it up to date.
+	void RemoveUnreachableBlocks();
+
+	std::vector<int> ComputeReversePostorder() const;
+
+	//Sets idom of every block (Cooper, Harvey and Kennedy: "A Simple, Fast Dominance Algorithm").
+	void ComputeDominators();
+
+	//Dominance frontier of every block. Needs dominators.
+	std::vector<std::vector<int>> ComputeDominanceFrontiers() const;
+
+	bool Dominates(int a, int b) const;
+};
+
+class IrModule{
+public:
+	std::vector<IrFunction> functions;
+	std::vector<std::string> strings;
+	std::vector<IrType> globals;
+	std::vector<std::string> globalNames;
+
+	//Writes a human readable listing of all functions.
+	void Write(OutputBuffer& out) const;
+
+	//Checks the structural invariants of SSA form. Returns false and fills 'errors' if any are violated.
+	bool Verify(std::vector<std::string>& errors) const;
+};
\ No newline at end of file
@@ -0,0 +1,801 @@
+#include "IrBuilder.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include "BaseVisitor.h"
+#include "SymbolScope.h"
+
+//Maps the types of the type table to IR types, so types can be compared without string comparisons.
+struct IrTypes{
+	TypeInfo const* voidType;
+	TypeInfo const* intType;
+	TypeInfo const* floatType;
+	TypeInfo const* boolType;
+	TypeInfo const* stringType;
+
+	IrTypes(const TypeTable& tt)
+		: voidType(tt.Get("void")), intType(tt.Get("int")), floatType(tt.Get("float")),
+		boolType(tt.Get("bool")), stringType(tt.Get("string"))
+	{}
+
+	IrType Get(TypeInfo const* ti) const {
+		if (ti == nullptr)			return IrType::Void;
+		if (ti->isArray)			return IrType::Array;
+		if (ti == voidType)			return IrType::Void;
+		if (ti == intType)			return IrType::Int;
+		if (ti == floatType)		return IrType::Float;
+		if (ti == boolType)			return IrType::Bool;
+		if (ti == stringType)		return IrType::String;
+		return IrType::Object;
+	}
+};
+
+//Lowers the statements of one function into blocks. Local variables are accessed with LoadVar/StoreVar.
+class IrLowering : public BaseVisitor{
+public:
+
+	void LowerFunction(FuncDef* n, IrFunction& function){
+		m_function = &function;
+		m_vars.clear();
+		m_varTypes.clear();
+		m_breakTargets.clear();
+
+		m_block = NewBlock();
+
+		int index = 0;
+		for (const auto& param : n->GetParamList()->GetChildren()){
+			IrType type = m_types.Get(param->GetType()->GetTypeInfo());
+			int var = NewVar(param.get(), param->GetName()->GetName(), type);
+
+			IrInstr instr(IrOp::Param, type, m_function->NewReg(type));
+			instr.imm = index++;
+			StoreVar(var, Emit(instr));
+		}
+
+		ACCEPT(GetStmtBlock(), true);
+
+		//Functions without a return statement at the end return the default value of their return type
+		if (!IsTerminated()){
+			if (function.retType == IrType::Void)
+				Emit(IrInstr(IrOp::Return));
+			else
+				Emit(IrInstr(IrOp::Return, function.retType, -1, PushDefault(function.retType)));
+		}
+	}
+
+	const std::vector<IrType>& GetVarTypes() const {
+		return m_varTypes;
+	}
+
+	//STATEMENTS
+	virtual void visit(StmtVarDecl* n, bool last){
+		IrType type = m_types.Get(n->GetType()->GetTypeInfo());
+		int var = NewVar(n, n->GetName()->GetName(), type);
+
+		StoreVar(var, n->GetExpr() ? GenExpr(n->GetExpr()) : PushDefault(type));
+	}
+
+	virtual void visit(StmtAssign* n, bool last){
+		Expr* lhs = n->GetLHS();
+
+		if (lhs->GetNodeType() == NodeType::Ident){
+			Ident* ident = (Ident*) lhs;
+			Symbol const* sym = ident->GetSymbol();
+
+			int value = GenExpr(n->GetExpr());
+
+			if (sym->type == Symbol::GLOBAL_VAR){
+				IrInstr instr(IrOp::StoreGlobal, m_types.Get(sym->GetTypeInfo()), -1, value);
+				instr.imm = m_globals.at(sym->GetNode());
+				Emit(instr);
+			}
+			else if (sym->type == Symbol::VARIABLE || sym->type == Symbol::PARAMETER)
+				StoreVar(m_vars.at(sym->GetNode()), value);
+			else
+				AddError(lhs->GetToken(), "Assignment to '%s' is not supported by the IR.", ident->GetName().c_str());
+			return;
+		}
+
+		if (lhs->GetNodeType() == NodeType::BinOp && ((BinOp*) lhs)->GetType() == BinOp::Subscript){
+			BinOp* subscript = (BinOp*) lhs;
+
+			int arr = GenExpr(subscript->GetLeft());
+			int index = GenExpr(subscript->GetRight());
+			int value = GenExpr(n->GetExpr());
+			Emit(IrInstr(IrOp::ArrayStore, m_types.Get(subscript->GetTypeInfo()), -1, arr, index, value));
+			return;
+		}
+
+		if (lhs->GetNodeType() == NodeType::BinOp && ((BinOp*) lhs)->GetType() == BinOp::MemberAccess){
+			BinOp* access = (BinOp*) lhs;
+
+			int obj = GenExpr(access->GetLeft());
+			int value = GenExpr(n->GetExpr());
+			IrInstr instr(IrOp::StoreField, m_types.Get(access->GetTypeInfo()), -1, obj, value);
+			instr.imm = ((Ident*) access->GetRight())->GetFieldOffset();
+			Emit(instr);
+			return;
+		}
+
+		AddError(lhs->GetToken(), "Assignment target is not supported by the IR.");
+	}
+
+	virtual void visit(StmtFuncCall* n, bool last){
+		GenCall(n->GetName(), n->GetArgList());
+	}
+
+	virtual void visit(StmtReturn* n, bool last){
+		if (n->GetExpr() == nullptr)
+			Emit(IrInstr(IrOp::Return));
+		else{
+			int value = GenExpr(n->GetExpr());
+			Emit(IrInstr(IrOp::Return, m_function->retType, -1, value));
+		}
+
+		//Anything following is unreachable, it's removed before SSA construction
+		m_block = NewBlock();
+	}
+
+	virtual void visit(StmtBreak* n, bool last){
+		Jump(m_breakTargets.back());
+		m_block = NewBlock();
+	}
+
+	virtual void visit(StmtWhile* n, bool last){
+		const int header = NewBlock();
+		const int body = NewBlock();
+		const int exit = NewBlock();
+
+		Jump(header);
+
+		m_block = header;
+		GenBranch(n->GetExpr(), body, exit);
+
+		m_block = body;
+		m_breakTargets.push_back(exit);
+		ACCEPT(GetBody(), true);
+		m_breakTargets.pop_back();
+		Jump(header);
+
+		m_block = exit;
+	}
+
+	virtual void visit(StmtIfThen* n, bool last){
+		const int then = NewBlock();
+		const int end = NewBlock();
+
+		GenBranch(n->GetExpr(), then, end);
+
+		m_block = then;
+		ACCEPT(GetThen(), true);
+		Jump(end);
+
+		m_block = end;
+	}
+
+	virtual void visit(StmtIfThenElse* n, bool last){
+		const int then = NewBlock();
+		const int els = NewBlock();
+		const int end = NewBlock();
+
+		GenBranch(n->GetExpr(), then, els);
+
+		m_block = then;
+		ACCEPT(GetThen(), true);
+		Jump(end);
+
+		m_block = els;
+		ACCEPT(GetElse(), true);
+		Jump(end);
+
+		m_block = end;
+	}
+
+	IrLowering(IrModule& module, const IrTypes& types, const std::unordered_map<ASTNode const*, int>& globals,
+		const std::unordered_map<ASTNode const*, int>& functions, std::vector<std::pair<std::string, Token>>& errors)
+		: m_module(module), m_types(types), m_globals(globals), m_functions(functions), m_errors(errors), m_function(nullptr), m_block(0)
+	{}
+
+private:
+
+	//EXPRESSIONS, return the register holding the result
+	int GenExpr(Expr* p){
+		const IrType type = m_types.Get(p->GetTypeInfo());
+
+		switch (p->GetNodeType()){
+		case NodeType::IntLit:
+			return EmitConst(IrType::Int, ((IntLit*) p)->GetValue());
+		case NodeType::BoolLit:
+			return EmitConst(IrType::Bool, ((BoolLit*) p)->GetValue() ? 1 : 0);
+		case NodeType::FloatLit:
+		{
+			IrInstr instr(IrOp::ConstFloat, IrType::Float, m_function->NewReg(IrType::Float));
+			instr.fimm = ((FloatLit*) p)->GetValue();
+			return Emit(instr);
+		}
+		case NodeType::StringLit:
+			return EmitString(unquote_string_literal(((StringLit*) p)->GetValue()));
+		case NodeType::Ident:
+			return Load((Ident*) p);
+		case NodeType::UnOp:
+		{
+			UnOp* n = (UnOp*) p;
+			int operand = GenExpr(n->GetExpr());
+			IrOp op = n->GetType() == UnOp::Not ? IrOp::Not : IrOp::Neg;
+			return Emit(IrInstr(op, type, m_function->NewReg(type), operand));
+		}
+		case NodeType::BinOp:
+			return GenBinOp((BinOp*) p);
+		case NodeType::FuncCallExpr:
+		{
+			FuncCallExpr* n = (FuncCallExpr*) p;
+			return GenCall(n->GetCallee(), n->GetArgs());
+		}
+		default:
+			AddError(p->GetToken(), "Expression '%s' is not supported by the IR.", p->GetNodeAsString().c_str());
+			return EmitConst(IrType::Int, 0);
+		}
+	}
+
+	int GenBinOp(BinOp* n){
+		const IrType type = m_types.Get(n->GetTypeInfo());
+		const IrType operandType = m_types.Get(n->GetLeft()->GetTypeInfo());
+
+		if (n->GetType() == BinOp::Add && type == IrType::String){
+			int left = GenStringOperand(n->GetLeft());
+			int right = GenStringOperand(n->GetRight());
+			return Emit(IrInstr(IrOp::Concat, IrType::String, m_function->NewReg(IrType::String), left, right));
+		}
+
+		if (n->GetType() == BinOp::And || n->GetType() == BinOp::Or){
+			//The result of the short-circuit evaluation goes through a variable, SSA construction turns it into a phi
+			const int var = NewVar(n, BinOp::GetTypeAsString(n->GetType()), IrType::Bool);
+			const int then = NewBlock();
+			const int els = NewBlock();
+			const int end = NewBlock();
+
+			GenBranch(n, then, els);
+
+			m_block = then;
+			StoreVar(var, EmitConst(IrType::Bool, 1));
+			Jump(end);
+
+			m_block = els;
+			StoreVar(var, EmitConst(IrType::Bool, 0));
+			Jump(end);
+
+			m_block = end;
+			IrInstr instr(IrOp::LoadVar, IrType::Bool, m_function->NewReg(IrType::Bool));
+			instr.imm = var;
+			return Emit(instr);
+		}
+
+		if (n->GetType() == BinOp::MemberAccess && operandType == IrType::Array){
+			int arr = GenExpr(n->GetLeft());
+			return Emit(IrInstr(IrOp::ArrayLength, IrType::Array, m_function->NewReg(IrType::Int), arr));
+		}
+
+		if (n->GetType() == BinOp::MemberAccess && operandType == IrType::Object){
+			int obj = GenExpr(n->GetLeft());
+			IrInstr instr(IrOp::LoadField, type, m_function->NewReg(type), obj);
+			instr.imm = ((Ident*) n->GetRight())->GetFieldOffset();
+			return Emit(instr);
+		}
+
+		IrOp op;
+		switch (n->GetType()){
+		case BinOp::Add:		op = IrOp::Add; break;
+		case BinOp::Sub:		op = IrOp::Sub; break;
+		case BinOp::Mul:		op = IrOp::Mul; break;
+		case BinOp::Div:		op = IrOp::Div; break;
+		case BinOp::Mod:		op = IrOp::Mod; break;
+		case BinOp::Xor:		op = IrOp::Xor; break;
+		case BinOp::Equal:		op = IrOp::CmpEq; break;
+		case BinOp::Unequal:	op = IrOp::CmpNe; break;
+		case BinOp::LThan:		op = IrOp::CmpLt; break;
+		case BinOp::LThanEq:	op = IrOp::CmpLe; break;
+		case BinOp::GThan:		op = IrOp::CmpGt; break;
+		case BinOp::GThanEq:	op = IrOp::CmpGe; break;
+		case BinOp::Subscript:	op = IrOp::ArrayLoad; break;
+		default:
+			AddError(n->GetToken(), "Operation '%s' is not supported by the IR.", BinOp::GetTypeAsString(n->GetType()));
+			return EmitConst(IrType::Int, 0);
+		}
+
+		int left = GenExpr(n->GetLeft());
+		int right = GenExpr(n->GetRight());
+
+		//Array accesses operate on the element type, everything else on the operand type
+		IrInstr instr(op, op == IrOp::ArrayLoad ? type : operandType, m_function->NewReg(type), left, right);
+		return Emit(instr);
+	}
+
+	//Ends the current block with a branch to 'then' if p is true and to 'els' otherwise. && and || get blocks of
+	//their own for the right operand, which is only evaluated if the left one doesn't decide the result.
+	void GenBranch(Expr* p, int then, int els){
+		if (p->GetNodeType() == NodeType::BoolLit){
+			Jump(((BoolLit*) p)->GetValue() ? then : els);
+			return;
+		}
+
+		if (p->GetNodeType() == NodeType::UnOp && ((UnOp*) p)->GetType() == UnOp::Not){
+			GenBranch(((UnOp*) p)->GetExpr(), els, then);
+			return;
+		}
+
+		if (p->GetNodeType() == NodeType::BinOp && (((BinOp*) p)->GetType() == BinOp::And || ((BinOp*) p)->GetType() == BinOp::Or)){
+			BinOp* n = (BinOp*) p;
+			const int right = NewBlock();
+
+			if (n->GetType() == BinOp::And)
+				GenBranch(n->GetLeft(), right, els);
+			else
+				GenBranch(n->GetLeft(), then, right);
+
+			m_block = right;
+			GenBranch(n->GetRight(), then, els);
+			return;
+		}
+
+		Branch(GenExpr(p), then, els);
+	}
+
+	int GenStringOperand(Expr* p){
+		int value = GenExpr(p);
+		IrType type = m_types.Get(p->GetTypeInfo());
+
+		if (type == IrType::String)
+			return value;
+
+		return Emit(IrInstr(IrOp::ToString, type, m_function->NewReg(IrType::String), value));
+	}
+
+	//Returns the result register, -1 for void functions
+	int GenCall(Ident* callee, ArgList* args){
+		Symbol const* sym = callee->GetSymbol();
+
+		if (sym->type != Symbol::FUNCTION){
+			AddError(callee->GetToken(), "Symbol '%s' is not a function.", sym->name.c_str());
+			return -1;
+		}
+
+		std::vector<int> argRegs;
+		for (const auto& arg : args->GetChildren())
+			argRegs.push_back(GenExpr(arg.get()));
+
+		const int index = m_functions.at(sym->GetNode());
+		const IrType retType = m_module.functions[index].retType;
+
+		IrInstr instr(IrOp::Call, retType, retType == IrType::Void ? -1 : m_function->NewReg(retType));
+		instr.imm = index;
+		instr.args = std::move(argRegs);
+		return Emit(instr);
+	}
+
+	int Load(Ident* n){
+		Symbol const* sym = n->GetSymbol();
+		const IrType type = m_types.Get(n->GetTypeInfo());
+
+		if (sym->type == Symbol::GLOBAL_VAR){
+			IrInstr instr(IrOp::LoadGlobal, type, m_function->NewReg(type));
+			instr.imm = m_globals.at(sym->GetNode());
+			return Emit(instr);
+		}
+
+		if (sym->type == Symbol::VARIABLE || sym->type == Symbol::PARAMETER){
+			IrInstr instr(IrOp::LoadVar, type, m_function->NewReg(type));
+			instr.imm = m_vars.at(sym->GetNode());
+			return Emit(instr);
+		}
+
+		AddError(n->GetToken(), "Symbol '%s' can not be used as a value by the IR.", n->GetName().c_str());
+		return EmitConst(IrType::Int, 0);
+	}
+
+	int PushDefault(IrType type){
+		switch (type){
+		case IrType::Int:
+		case IrType::Bool:
+			return EmitConst(type, 0);
+		case IrType::Float:
+		{
+			IrInstr instr(IrOp::ConstFloat, IrType::Float, m_function->NewReg(IrType::Float));
+			instr.fimm = 0.0f;
+			return Emit(instr);
+		}
+		case IrType::String:
+			return EmitString("");
+		default:
+			return Emit(IrInstr(IrOp::ConstNull, type, m_function->NewReg(type)));
+		}
+	}
+
+	int EmitConst(IrType type, int value){
+		IrInstr instr(IrOp::Const, type, m_function->NewReg(type));
+		instr.imm = value;
+		return Emit(instr);
+	}
+
+	int EmitString(const std::string& str){
+		auto it = m_stringIndices.find(str);
+		int index;
+
+		if (it != m_stringIndices.end())
+			index = it->second;
+		else{
+			index = m_module.strings.size();
+			m_module.strings.push_back(str);
+			m_stringIndices.emplace(str, index);
+		}
+
+		IrInstr instr(IrOp::ConstString, IrType::String, m_function->NewReg(IrType::String));
+		instr.imm = index;
+		return Emit(instr);
+	}
+
+	void StoreVar(int var, int value){
+		IrInstr instr(IrOp::StoreVar, m_varTypes[var], -1, value);
+		instr.imm = var;
+		Emit(instr);
+	}
+
+	void Jump(int target){
+		if (IsTerminated())
+			return;
+
+		IrInstr instr(IrOp::Jump);
+		instr.targets[0] = target;
+		Emit(instr);
+	}
+
+	void Branch(int cond, int then, int els){
+		IrInstr instr(IrOp::Branch, IrType::Void, -1, cond);
+		instr.targets[0] = then;
+		instr.targets[1] = els;
+		Emit(instr);
+	}
+
+	//Returns the destination register of the instruction
+	int Emit(const IrInstr& instr){
+		m_function->blocks[m_block].instrs.push_back(instr);
+		return instr.dest;
+	}
+
+	bool IsTerminated() const {
+		const auto& instrs = m_function->blocks[m_block].instrs;
+		return !instrs.empty() && instrs.back().IsTerminator();
+	}
+
+	int NewBlock(){
+		m_function->blocks.emplace_back();
+		return m_function->blocks.size() - 1;
+	}
+
+	int NewVar(ASTNode const* decl, const std::string& name, IrType type){
+		int var = m_varTypes.size();
+		m_vars[decl] = var;
+		m_varTypes.push_back(type);
+		m_function->varNames.push_back(name);
+		return var;
+	}
+
+	void AddError(const Token& tok, const std::string fmt_str, ...){
+		va_list ap;
+		va_start(ap, fmt_str);
+		std::string v = va_string_format(fmt_str, ap);
+		m_errors.emplace_back(v, tok);
+		va_end(ap);
+	}
+
+	IrModule& m_module;
+	const IrTypes& m_types;
+	const std::unordered_map<ASTNode const*, int>& m_globals;		//Declaration node of global variables -> global index
+	const std::unordered_map<ASTNode const*, int>& m_functions;		//FuncDef -> function index
+	std::vector<std::pair<std::string, Token>>& m_errors;
+	std::unordered_map<std::string, int> m_stringIndices;
+
+	IrFunction* m_function;
+	int m_block;										//Block new instructions are appended to
+	std::unordered_map<ASTNode const*, int> m_vars;		//Declaration node of parameters and local variables -> variable index
+	std::vector<IrType> m_varTypes;
+	std::vector<int> m_breakTargets;					//Exit blocks of the enclosing while loops
+};
+
+/*
+	Turns LoadVar/StoreVar into SSA form (Cytron et al.): phis are placed on the iterated dominance frontiers of the
+	blocks storing a variable, then variables are renamed in a walk over the dominator tree. Phis which end up unused
+	are removed and the registers are renumbered densely.
+*/
+class SsaConstruction{
+public:
+
+	void Run(){
+		m_function.ComputeCfg();
+		m_function.RemoveUnreachableBlocks();
+		m_function.ComputeDominators();
+
+		PlacePhis(m_function.ComputeDominanceFrontiers());
+		Rename();
+		RemoveDeadPhis();
+		RenumberRegisters();
+	}
+
+	SsaConstruction(IrFunction& function, const std::vector<IrType>& varTypes)
+		: m_function(function), m_varTypes(varTypes)
+	{}
+
+private:
+
+	void PlacePhis(const std::vector<std::vector<int>>& frontiers){
+		const size_t numBlocks = m_function.blocks.size();
+		const size_t numVars = m_varTypes.size();
+
+		std::vector<std::vector<int>> defBlocks(numVars);
+		std::vector<bool> isLoaded(numVars, false);
+
+		for (size_t b = 0; b < numBlocks; ++b){
+			for (const auto& instr : m_function.blocks[b].instrs){
+				if (instr.op == IrOp::StoreVar){
+					auto& blocks = defBlocks[instr.imm];
+					if (blocks.empty() || blocks.back() != (int) b)
+						blocks.push_back(b);
+				}
+				else if (instr.op == IrOp::LoadVar)
+					isLoaded[instr.imm] = true;
+			}
+		}
+
+		//Last variable a block got a phi for / was put on the worklist for. Avoids clearing sets for every variable.
+		std::vector<int> hasPhi(numBlocks, -1);
+		std::vector<int> queued(numBlocks, -1);
+		std::vector<int> worklist;
+
+		for (size_t var = 0; var < numVars; ++var){
+			if (!isLoaded[var])
+				continue;
+
+			worklist = defBlocks[var];
+			for (int b : worklist)
+				queued[b] = var;
+
+			while (!worklist.empty()){
+				int d = worklist.back();
+				worklist.pop_back();
+
+				for (int y : frontiers[d]){
+					if (hasPhi[y] == (int) var)
+						continue;
+
+					IrType type = m_varTypes[var];
+					IrInstr phi(IrOp::Phi, type, m_function.NewReg(type));
+					phi.imm = var;
+					phi.args.assign(m_function.blocks[y].preds.size(), -1);
+
+					auto& instrs = m_function.blocks[y].instrs;
+					instrs.insert(instrs.begin(), phi);
+					hasPhi[y] = var;
+
+					if (queued[y] != (int) var){
+						queued[y] = var;
+						worklist.push_back(y);
+					}
+				}
+			}
+		}
+	}
+
+	void Rename(){
+		const size_t numBlocks = m_function.blocks.size();
+
+		std::vector<std::vector<int>> children(numBlocks);
+		for (size_t b = 1; b < numBlocks; ++b)
+			children[m_function.blocks[b].idom].push_back(b);
+
+		m_stacks.assign(m_varTypes.size(), std::vector<int>());
+		m_replace.assign(m_function.regTypes.size(), -1);
+
+		std::vector<std::vector<int>> pushed(numBlocks);	//Variables pushed while processing a block
+		std::vector<std::pair<int, bool>> walk;				//Block, true if its subtree is done
+		walk.emplace_back(0, false);
+
+		while (!walk.empty()){
+			auto item = walk.back();
+			walk.pop_back();
+			const int b = item.first;
+
+			if (item.second){
+				for (int var : pushed[b])
+					m_stacks[var].pop_back();
+				continue;
+			}
+
+			IrBlock& block = m_function.blocks[b];
+
+			for (auto& instr : block.instrs){
+				if (instr.op == IrOp::Phi){
+					m_stacks[instr.imm].push_back(instr.dest);
+					pushed[b].push_back(instr.imm);
+					continue;
+				}
+
+				for (int& op : instr.ops)
+					op = Replace(op);
+				for (int& arg : instr.args)
+					arg = Replace(arg);
+
+				if (instr.op == IrOp::LoadVar)
+					m_replace[instr.dest] = GetCurrentValue(instr.imm);
+				else if (instr.op == IrOp::StoreVar){
+					m_stacks[instr.imm].push_back(instr.ops[0]);
+					pushed[b].push_back(instr.imm);
+				}
+			}
+
+			for (int s : block.succs){
+				IrBlock& succ = m_function.blocks[s];
+				size_t edge = std::find(succ.preds.begin(), succ.preds.end(), b) - succ.preds.begin();
+
+				for (auto& instr : succ.instrs){
+					if (instr.op != IrOp::Phi)
+						break;
+					instr.args[edge] = GetCurrentValue(instr.imm);
+				}
+			}
+
+			block.instrs.erase(std::remove_if(block.instrs.begin(), block.instrs.end(), [](const IrInstr& instr){
+				return instr.op == IrOp::LoadVar || instr.op == IrOp::StoreVar;
+			}), block.instrs.end());
+
+			walk.emplace_back(b, true);
+			for (int child : children[b])
+				walk.emplace_back(child, false);
+		}
+
+		//Reads of variables without a reaching definition (only possible for phi arguments of loops)
+		auto& entry = m_function.blocks[0].instrs;
+		entry.insert(entry.begin(), m_undefs.begin(), m_undefs.end());
+	}
+
+	int Replace(int reg) const {
+		return reg >= 0 && reg < (int) m_replace.size() && m_replace[reg] >= 0 ? m_replace[reg] : reg;
+	}
+
+	int GetCurrentValue(int var){
+		if (!m_stacks[var].empty())
+			return m_stacks[var].back();
+
+		IrType type = m_varTypes[var];
+		for (const auto& undef : m_undefs)
+			if (undef.type == type)
+				return undef.dest;
+
+		m_undefs.push_back(IrInstr(IrOp::Undef, type, m_function.NewReg(type)));
+		return m_undefs.back().dest;
+	}
+
+	//Removes phis and undefs whose value is never used by a real instruction.
+	void RemoveDeadPhis(){
+		const size_t numRegs = m_function.regTypes.size();
+		std::vector<IrInstr const*> phis(numRegs, nullptr);
+		std::vector<bool> live(numRegs, false);
+		std::vector<int> worklist;
+
+		auto markLive = [&](int reg){
+			if (reg >= 0 && !live[reg]){
+				live[reg] = true;
+				worklist.push_back(reg);
+			}
+		};
+
+		for (const auto& block : m_function.blocks){
+			for (const auto& instr : block.instrs){
+				if (instr.op == IrOp::Phi){
+					phis[instr.dest] = &instr;
+					continue;
+				}
+
+				for (int op : instr.ops)
+					markLive(op);
+				for (int arg : instr.args)
+					markLive(arg);
+			}
+		}
+
+		while (!worklist.empty()){
+			int reg = worklist.back();
+			worklist.pop_back();
+
+			if (phis[reg])
+				for (int arg : phis[reg]->args)
+					markLive(arg);
+		}
+
+		for (auto& block : m_function.blocks){
+			block.instrs.erase(std::remove_if(block.instrs.begin(), block.instrs.end(), [&](const IrInstr& instr){
+				return (instr.op == IrOp::Phi || instr.op == IrOp::Undef) && !live[instr.dest];
+			}), block.instrs.end());
+		}
+	}
+
+	//Registers of LoadVars and dead phis are gone, so give the remaining ones dense numbers in order of definition.
+	void RenumberRegisters(){
+		std::vector<int> newIndex(m_function.regTypes.size(), -1);
+		std::vector<IrType> regTypes;
+
+		for (const auto& block : m_function.blocks){
+			for (const auto& instr : block.instrs){
+				if (instr.dest >= 0){
+					newIndex[instr.dest] = regTypes.size();
+					regTypes.push_back(m_function.regTypes[instr.dest]);
+				}
+			}
+		}
+
+		for (auto& block : m_function.blocks){
+			for (auto& instr : block.instrs){
+				if (instr.dest >= 0)
+					instr.dest = newIndex[instr.dest];
+				for (int& op : instr.ops)
+					if (op >= 0)
+						op = newIndex[op];
+				for (int& arg : instr.args)
+					arg = newIndex[arg];
+			}
+		}
+
+		m_function.regTypes = std::move(regTypes);
+	}
+
+	IrFunction& m_function;
+	const std::vector<IrType>& m_varTypes;
+	std::vector<std::vector<int>> m_stacks;		//Current SSA value of every variable
+	std::vector<int> m_replace;					//Register of a LoadVar -> register holding the value
+	std::vector<IrInstr> m_undefs;
+};
+
+
+bool IrBuilder::Build( StartBlockPtr& node, const TypeTable& typeTable, IrModule& module ){
+	module = IrModule();
+	m_errors.clear();
+
+	IrTypes types(typeTable);
+	std::unordered_map<ASTNode const*, int> globals;
+	std::unordered_map<ASTNode const*, int> functions;
+
+	//Register all globals and functions first, functions may be called before their definition.
+	for (const auto& stmt : node->GetChildren()){
+		if (stmt->GetNodeType() == NodeType::GlobVarDef){
+			GlobVarDef* n = (GlobVarDef*) stmt.get();
+			globals[n] = module.globals.size();
+			module.globals.push_back(types.Get(n->GetType()->GetTypeInfo()));
+			module.globalNames.push_back(n->GetName()->GetName());
+		}
+		else if (stmt->GetNodeType() == NodeType::FuncDef){
+			FuncDef* n = (FuncDef*) stmt.get();
+			IrFunction function;
+			function.name = n->GetName()->GetName();
+			function.retType = types.Get(n->GetRetType()->GetTypeInfo());
+
+			for (const auto& param : n->GetParamList()->GetChildren())
+				function.paramTypes.push_back(types.Get(param->GetType()->GetTypeInfo()));
+
+			functions[n] = module.functions.size();
+			module.functions.push_back(std::move(function));
+		}
+	}
+
+	IrLowering lowering(module, types, globals, functions, m_errors);
+
+	for (const auto& stmt : node->GetChildren()){
+		if (stmt->GetNodeType() != NodeType::FuncDef)
+			continue;
+
+		IrFunction& function = module.functions[functions[stmt.get()]];
+		lowering.LowerFunction((FuncDef*) stmt.get(), function);
+
+		SsaConstruction ssa(function, lowering.GetVarTypes());
+		ssa.Run();
+	}
+
+	return m_errors.empty();
+}
\ No newline at end of file
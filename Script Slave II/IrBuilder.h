@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "ASTNode.h"
+#include "TypeTable.h"
+#include "Ir.h"
+#include "StringUtil.h"
+
+/*
+	Lowers the type checked AST into the register based IR. Every FuncDef becomes an IrFunction in SSA form: local
+	variables and parameters are first lowered to LoadVar/StoreVar, then phis are placed on the iterated dominance
+	frontiers of the blocks storing a variable and the variables are renamed along the dominator tree.
+	Global variables, array elements and fields of objects stay memory operations.
+*/
+class IrBuilder
+{
+public:
+
+	bool Build( StartBlockPtr& node, const TypeTable& typeTable, IrModule& module );
+
+	const std::vector<std::pair<std::string, Token>>& GetErrors() const {
+		return m_errors;
+	}
+
+private:
+
+	void AddError(const Token& tok, const std::string fmt_str, ...){
+		va_list ap;
+		va_start(ap, fmt_str);
+		std::string v = va_string_format(fmt_str, ap);
+		m_errors.emplace_back(v, tok);
+		va_end(ap);
+	}
+
+	std::vector<std::pair<std::string, Token>> m_errors;
+};
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include "Lexer.h"
+#include "AllocationCounter.h"
 
 #include <algorithm>
+#include <iostream>
 #include <string.h>
 #include <stdexcept>
 
@@ -180,7 +182,10 @@ bool lex( const char *src, std::vector<Token>& tokens ) {
 
 		//String literals
 		if( *begin == '"' ){
-			while( *beyond == '\\' || *(++beyond) != '"' );
+			//Skips the character after a backslash, so escaped quotes don't end the literal.
+			while( ++beyond < lim && *beyond != '"' )
+				if( *beyond == '\\' && beyond + 1 < lim )
+					++beyond;
 			auto token = Token(TokenType::StringLit, std::string(begin + 1, beyond - begin - 1));
 			token.filePosition = GetFilePosition(src, begin);
 			tokens.push_back( token );
@@ -200,8 +205,8 @@ bool lex( const char *src, std::vector<Token>& tokens ) {
 				auto beg = std::find( std::reverse_iterator<const char*>(begin), std::reverse_iterator<const char*>(src), '\n' );
 				auto end = std::find( begin, lim, '\n' );
 
-				printf( "Error, unknown token found during lexing: %s\n", std::string(begin,beyond-begin).c_str() );
-				printf( "Line %d: %s\n", lineCount(src, begin), std::string( beg.base(), end ).c_str() );
+				std::cout << "Error, unknown token found during lexing: " << std::string(begin,beyond-begin) << "\n";
+				std::cout << "Line " << lineCount(src, begin) << ": " << std::string( beg.base(), end ) << "\n";
 
 				return false;
 			}
@@ -228,8 +233,8 @@ bool lex( const char *src, std::vector<Token>& tokens ) {
 				auto beg = std::find( std::reverse_iterator<const char*>(begin), std::reverse_iterator<const char*>(src), '\n' );
 				auto end = std::find( begin, lim, '\n' );
 
-				printf( "Error, invalid integral suffix: %c\n", *beyond );
-				printf( "Line %d: %s\n", lineCount( src, begin ), std::string( beg.base(), end ).c_str() );
+				std::cout << "Error, invalid integral suffix: " << *beyond << "\n";
+				std::cout << "Line " << lineCount( src, begin ) << ": " << std::string( beg.base(), end ) << "\n";
 
 				return false;
 			}
@@ -255,6 +260,7 @@ bool lex( const char *src, std::vector<Token>& tokens ) {
 }
 
 bool Tokenize( std::string inString, std::vector<Token>& tokens ){
+	AllocationCounter::Scope scope( AllocationCategory::Tokens );
 	bool retVal = lex( inString.c_str(), tokens );
 
 
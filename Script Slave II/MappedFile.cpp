@@ -0,0 +1,67 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& fileName)
+	: m_data(nullptr), m_size(0), m_valid(false)
+{
+#ifdef _WIN32
+	m_file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	m_mapping = nullptr;
+	if (m_file == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size))
+		return;
+	m_size = (size_t) size.QuadPart;
+	m_valid = true;
+	if (m_size == 0)		//Empty files can't be mapped
+		return;
+
+	m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping != nullptr)
+		m_data = (const char*) MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	m_valid = m_data != nullptr;
+#else
+	m_file = open(fileName.c_str(), O_RDONLY);
+	if (m_file < 0)
+		return;
+
+	struct stat st;
+	if (fstat(m_file, &st) != 0)
+		return;
+	m_size = (size_t) st.st_size;
+	m_valid = true;
+	if (m_size == 0)		//Empty files can't be mapped
+		return;
+
+	void* p = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+	m_data = p == MAP_FAILED ? nullptr : (const char*) p;
+	m_valid = m_data != nullptr;
+#endif
+}
+
+MappedFile::~MappedFile(){
+#ifdef _WIN32
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+	if (m_mapping != nullptr)
+		CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+#else
+	if (m_data != nullptr)
+		munmap((void*) m_data, m_size);
+	if (m_file >= 0)
+		close(m_file);
+#endif
+}
\ No newline at end of file
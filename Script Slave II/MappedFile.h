@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+//Read only view of a whole file, mapped into memory.
+class MappedFile{
+public:
+
+	MappedFile(const std::string& fileName);
+	~MappedFile();
+
+	//False if the file couldn't be opened or mapped. Empty files are valid, Data() is nullptr then.
+	bool IsValid() const { return m_valid; }
+
+	const char* Data() const { return m_data; }
+	size_t Size() const { return m_size; }
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+#ifdef _WIN32
+	void* m_file;		//HANDLE
+	void* m_mapping;	//HANDLE
+#else
+	int m_file;
+#endif
+	const char* m_data;
+	size_t m_size;
+	bool m_valid;
+};
\ No newline at end of file
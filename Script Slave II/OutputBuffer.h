@@ -0,0 +1,151 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstring>
+
+#pragma warning (push)
+#pragma warning (disable : 4996 )
+
+//Growable character buffer used for all generated output. Text is appended without creating temporary
+//std::string objects and the whole buffer is written with a single fwrite() call.
+class OutputBuffer{
+public:
+
+	void Put(char c){
+		m_data.push_back(c);
+		if (c == '\n')
+			m_lineStart = m_data.size();
+	}
+
+	void Put(const char* str, size_t length){
+		size_t oldSize = m_data.size();
+		m_data.insert(m_data.end(), str, str + length);
+
+		for (size_t i = length; i > 0; --i){
+			if (str[i - 1] == '\n'){
+				m_lineStart = oldSize + i;
+				break;
+			}
+		}
+	}
+
+	void Put(const char* str){
+		Put(str, strlen(str));
+	}
+
+	void Put(const std::string& str){
+		Put(str.data(), str.size());
+	}
+
+	//Appends a string literal, its length is known at compile time.
+	template<size_t N>
+	void PutLit(const char(&str)[N]){
+		Put(str, N - 1);
+	}
+
+	//Big endian binary values, used for class files.
+	void PutU1(unsigned char value){
+		m_data.push_back((char) value);
+	}
+
+	void PutU2(unsigned short value){
+		m_data.push_back((char) (value >> 8));
+		m_data.push_back((char) value);
+	}
+
+	void PutU4(unsigned int value){
+		PutU2((unsigned short) (value >> 16));
+		PutU2((unsigned short) value);
+	}
+
+	//Overwrites two bytes which have already been written.
+	void PatchU2(size_t offset, unsigned short value){
+		m_data[offset] = (char) (value >> 8);
+		m_data[offset + 1] = (char) value;
+	}
+
+	void PutLine(const char* str, size_t length){
+		Put(str, length);
+		Put('\n');
+	}
+
+	void PutInt(long long value){
+		char buf[24];
+		char* end = buf + sizeof(buf);
+		char* p = end;
+		unsigned long long v = value < 0 ? 0ull - (unsigned long long) value : (unsigned long long) value;
+
+		do{
+			*--p = '0' + (char)(v % 10);
+			v /= 10;
+		} while (v != 0);
+
+		if (value < 0)
+			*--p = '-';
+
+		Put(p, end - p);
+	}
+
+	//Always contains a period or an exponent so the value can't be confused with an integer.
+	void PutFloat(float value){
+		char buf[32];
+		int length = sprintf(buf, "%.9g", value);
+
+		Put(buf, length);
+		if (strpbrk(buf, ".eEni") == nullptr)
+			PutLit(".0");
+	}
+
+	//Pads the current line with spaces until it reaches 'column'. Tabs count as 4 columns. Puts at least one space.
+	void PadTo(size_t column){
+		const size_t tabLength = 4;
+		size_t length = 0;
+
+		for (size_t i = m_lineStart; i < m_data.size(); ++i)
+			length = m_data[i] == '\t' ? (length / tabLength + 1) * tabLength : length + 1;
+
+		size_t count = length < column ? column - length : 1;
+		m_data.insert(m_data.end(), count, ' ');
+	}
+
+	void Newline(){
+		Put('\n');
+	}
+
+	const char* Data() const { return m_data.data(); }
+	size_t Size() const { return m_data.size(); }
+
+	void Clear(){
+		m_data.clear();
+		m_lineStart = 0;
+	}
+
+	bool WriteToFile(const std::string& fileName, const char* mode = "wb") const {
+		FILE* file = fopen(fileName.c_str(), mode);
+
+		if (!file)
+			return false;
+
+		bool success = fwrite(m_data.data(), 1, m_data.size(), file) == m_data.size();
+		return fclose(file) == 0 && success;
+	}
+
+	void WriteTo(FILE* file) const {
+		fwrite(m_data.data(), 1, m_data.size(), file);
+	}
+
+	//Most buffers hold a few lines, the writers of whole files pass a larger size hint.
+	OutputBuffer(size_t reserve = 256)
+		: m_lineStart(0)
+	{
+		m_data.reserve(reserve);
+	}
+
+private:
+	std::vector<char> m_data;
+	size_t m_lineStart;		//Offset of the first character of the current line, used for comment alignment
+};
+
+#pragma warning (pop)
\ No newline at end of file
@@ -0,0 +1,378 @@
+#include "Peephole.h"
+
+#include <algorithm>
+
+const Peephole::Rule Peephole::s_rules[] = {
+	{ "iinc formation", &Peephole::FormIInc },			//Before store-load forwarding, which would take the load away
+	{ "store-load forwarding", &Peephole::ForwardStoreLoad },
+	{ "load-store removal", &Peephole::RemoveLoadStore },
+	{ "not folding", &Peephole::FoldNotBranch },
+	{ "constant branches", &Peephole::FoldConstantBranch },
+	{ "branch inversion", &Peephole::InvertBranchOverGoto },
+	{ "goto next removal", &Peephole::RemoveGotoNext },
+	{ "jump threading", &Peephole::ThreadJump },
+	{ "unreachable code", &Peephole::RemoveUnreachable },
+	{ "dead labels", &Peephole::RemoveDeadLabel },
+};
+
+int Peephole::GetNumRules(){
+	return sizeof(s_rules) / sizeof(s_rules[0]);
+}
+
+const char* Peephole::GetRuleName(int rule){
+	return s_rules[rule].name;
+}
+
+static bool IsLoad(Op op){
+	return op == Op::ILoad || op == Op::FLoad || op == Op::ALoad;
+}
+
+static bool IsStore(Op op){
+	return op == Op::IStore || op == Op::FStore || op == Op::AStore;
+}
+
+//Load instruction of the same type as the store instruction 'op'
+static Op GetLoadOf(Op op){
+	return op == Op::IStore ? Op::ILoad : op == Op::FStore ? Op::FLoad : Op::ALoad;
+}
+
+//Instructions after which execution never continues with the next instruction
+static bool IsUnconditional(Op op){
+	return op == Op::Goto || op == Op::IReturn || op == Op::FReturn || op == Op::AReturn || op == Op::Return;
+}
+
+static int CountInstrs(const std::vector<Instr>& code){
+	return std::count_if(code.begin(), code.end(), [](const Instr& instr){ return instr.op != Op::Label; });
+}
+
+void Peephole::Optimize(JvmClass& cls){
+	m_ruleHits.assign(GetNumRules(), 0);
+
+	for (auto& method : cls.methods)
+		OptimizeMethod(method);
+}
+
+void Peephole::OptimizeMethod(JvmMethod& method){
+	std::vector<Instr>& code = method.code;
+	m_code = &code;
+	m_usesDup = false;
+	m_numBefore += CountInstrs(code);
+
+	bool changed;
+	do{
+		changed = false;
+		m_removed.assign(code.size(), false);
+		m_labelPositions.assign(method.numLabels, -1);
+		m_labelRefs.assign(method.numLabels, 0);
+		m_localLoads.assign(std::max(method.maxLocals, 1), 0);
+		Analyze();
+
+		for (int rule = 0; rule < GetNumRules(); ++rule){
+			for (size_t i = 0; i < code.size(); ++i){
+				if (!m_removed[i] && (this->*s_rules[rule].apply)(i)){
+					++m_ruleHits[rule];
+					changed = true;
+				}
+			}
+		}
+
+		size_t out = 0;
+		for (size_t i = 0; i < code.size(); ++i){
+			if (!m_removed[i])
+				code[out++] = code[i];
+		}
+		code.erase(code.begin() + out, code.end());
+	} while (changed);
+
+	//dup; xstore needs one more stack slot than xstore; xload
+	if (m_usesDup)
+		++method.maxStack;
+
+	m_numAfter += CountInstrs(code);
+}
+
+void Peephole::Analyze(){
+	const std::vector<Instr>& code = *m_code;
+
+	for (size_t i = 0; i < code.size(); ++i){
+		const Instr& instr = code[i];
+
+		if (instr.op == Op::Label)
+			m_labelPositions[instr.operand] = i;
+		else if (IsBranch(instr.op))
+			++m_labelRefs[instr.operand];
+		else if (IsLoad(instr.op) || instr.op == Op::IInc)
+			++m_localLoads[instr.operand];
+	}
+}
+
+size_t Peephole::Next(size_t i) const {
+	do{
+		++i;
+	} while (i < m_code->size() && m_removed[i]);
+	return i;
+}
+
+size_t Peephole::NextExecuted(size_t i) const {
+	do{
+		i = Next(i);
+	} while (i < m_code->size() && (*m_code)[i].op == Op::Label);
+	return i;
+}
+
+bool Peephole::IsLabelNext(size_t i, int label) const {
+	for (i = Next(i); i < m_code->size() && (*m_code)[i].op == Op::Label; i = Next(i)){
+		if ((*m_code)[i].operand == label)
+			return true;
+	}
+	return false;
+}
+
+int Peephole::FinalTarget(int label) const {
+	std::vector<int> visited(1, label);
+	int target = label;
+
+	while (m_labelPositions[target] >= 0){
+		size_t next = NextExecuted(m_labelPositions[target]);
+		if (next >= m_code->size() || (*m_code)[next].op != Op::Goto)
+			break;
+
+		target = (*m_code)[next].operand;
+		if (std::find(visited.begin(), visited.end(), target) != visited.end())
+			return label;	//Endless loop of gotos, leave it alone
+		visited.push_back(target);
+	}
+
+	return target;
+}
+
+void Peephole::Remove(size_t i){
+	const Instr& instr = (*m_code)[i];
+
+	if (IsBranch(instr.op))
+		--m_labelRefs[instr.operand];
+	else if (IsLoad(instr.op) || instr.op == Op::IInc)
+		--m_localLoads[instr.operand];
+
+	m_removed[i] = true;
+}
+
+void Peephole::Replace(size_t i, const Instr& instr){
+	Remove(i);
+	m_removed[i] = false;
+	(*m_code)[i] = instr;
+
+	if (IsBranch(instr.op))
+		++m_labelRefs[instr.operand];
+	else if (IsLoad(instr.op) || instr.op == Op::IInc)
+		++m_localLoads[instr.operand];
+}
+
+int Peephole::GetPushedConstant(const Instr& instr, bool& isConstant){
+	isConstant = true;
+
+	switch (instr.op){
+	case Op::IConstM1: case Op::IConst0: case Op::IConst1: case Op::IConst2:
+	case Op::IConst3: case Op::IConst4: case Op::IConst5:
+		return (int) instr.op - (int) Op::IConst0;
+	case Op::BIPush:
+	case Op::SIPush:
+	case Op::LdcInt:
+		return instr.operand;
+	default:
+		isConstant = false;
+		return 0;
+	}
+}
+
+//iload n; <const c>; iadd; istore n  =>  iinc n c
+//Also for isub and for <const c>; iload n; iadd; istore n
+bool Peephole::FormIInc(size_t i){
+	const std::vector<Instr>& code = *m_code;
+	const size_t j = Next(i);
+	const size_t k = Next(j);
+	const size_t l = Next(k);
+
+	if (l >= code.size() || code[l].op != Op::IStore)
+		return false;
+
+	const int slot = code[l].operand;
+	bool isConstant;
+	long long c;
+
+	if (code[i].op == Op::ILoad && code[i].operand == slot && (code[k].op == Op::IAdd || code[k].op == Op::ISub)){
+		c = GetPushedConstant(code[j], isConstant);
+		if (code[k].op == Op::ISub)
+			c = -c;
+	}
+	else if (code[j].op == Op::ILoad && code[j].operand == slot && code[k].op == Op::IAdd)
+		c = GetPushedConstant(code[i], isConstant);
+	else
+		return false;
+
+	if (!isConstant || c < -32768 || c > 32767)
+		return false;
+
+	Instr iinc(Op::IInc, slot, "increment", code[l].symbol);
+	iinc.operand2 = (int) c;
+
+	Replace(i, iinc);
+	Remove(j);
+	Remove(k);
+	Remove(l);
+	return true;
+}
+
+//xstore n; xload n  =>  dup; xstore n
+//Both are removed if this is the only load of n.
+bool Peephole::ForwardStoreLoad(size_t i){
+	const std::vector<Instr>& code = *m_code;
+	const size_t j = Next(i);
+
+	if (!IsStore(code[i].op) || j >= code.size() || code[j].op != GetLoadOf(code[i].op) || code[j].operand != code[i].operand)
+		return false;
+
+	if (m_localLoads[code[i].operand] == 1){
+		Remove(i);
+		Remove(j);
+		return true;
+	}
+
+	Instr store = code[i];
+	Replace(i, Instr(Op::Dup));
+	Replace(j, store);
+	m_usesDup = true;
+	return true;
+}
+
+//xload n; xstore n  =>  nothing
+bool Peephole::RemoveLoadStore(size_t i){
+	const std::vector<Instr>& code = *m_code;
+	const size_t j = Next(i);
+
+	if (!IsLoad(code[i].op) || j >= code.size() || !IsStore(code[j].op) || GetLoadOf(code[j].op) != code[i].op || code[j].operand != code[i].operand)
+		return false;
+
+	Remove(i);
+	Remove(j);
+	return true;
+}
+
+//iconst_1; ixor; ifeq L  =>  ifne L
+bool Peephole::FoldNotBranch(size_t i){
+	const std::vector<Instr>& code = *m_code;
+	const size_t j = Next(i);
+	const size_t k = Next(j);
+
+	if (code[i].op != Op::IConst1 || k >= code.size() || code[j].op != Op::IXor || (code[k].op != Op::IfEq && code[k].op != Op::IfNe))
+		return false;
+
+	Instr branch = code[k];
+	branch.op = NegateBranch(branch.op);
+
+	Remove(i);
+	Remove(j);
+	Replace(k, branch);
+	return true;
+}
+
+//iconst_0; ifeq L  =>  goto L
+//iconst_0; ifne L  =>  nothing
+bool Peephole::FoldConstantBranch(size_t i){
+	const std::vector<Instr>& code = *m_code;
+	const size_t j = Next(i);
+
+	if ((code[i].op != Op::IConst0 && code[i].op != Op::IConst1) || j >= code.size() || (code[j].op != Op::IfEq && code[j].op != Op::IfNe))
+		return false;
+
+	const bool taken = (code[i].op == Op::IConst0) == (code[j].op == Op::IfEq);
+
+	Remove(i);
+	if (taken){
+		Instr jump = code[j];
+		jump.op = Op::Goto;
+		Replace(j, jump);
+	}
+	else
+		Remove(j);
+	return true;
+}
+
+//ifxx L1; goto L2; L1:  =>  ifnotxx L2; L1:
+bool Peephole::InvertBranchOverGoto(size_t i){
+	const std::vector<Instr>& code = *m_code;
+	const size_t j = Next(i);
+
+	if (!IsBranch(code[i].op) || code[i].op == Op::Goto || j >= code.size() || code[j].op != Op::Goto || !IsLabelNext(j, code[i].operand))
+		return false;
+
+	Instr branch = code[i];
+	branch.op = NegateBranch(branch.op);
+	branch.operand = code[j].operand;
+
+	Replace(i, branch);
+	Remove(j);
+	return true;
+}
+
+//goto L; L:  =>  L:
+bool Peephole::RemoveGotoNext(size_t i){
+	if ((*m_code)[i].op != Op::Goto || !IsLabelNext(i, (*m_code)[i].operand))
+		return false;
+
+	Remove(i);
+	return true;
+}
+
+//Branches to a goto jump to the goto's target instead, gotos to a return are replaced by the return.
+bool Peephole::ThreadJump(size_t i){
+	const std::vector<Instr>& code = *m_code;
+
+	if (!IsBranch(code[i].op))
+		return false;
+
+	const int label = code[i].operand;
+	const int target = FinalTarget(label);
+
+	if (target != label){
+		Instr branch = code[i];
+		branch.operand = target;
+		Replace(i, branch);
+		return true;
+	}
+
+	if (code[i].op == Op::Goto && m_labelPositions[label] >= 0){
+		const size_t next = NextExecuted(m_labelPositions[label]);
+		if (next < code.size() && code[next].op != Op::Goto && IsUnconditional(code[next].op)){
+			Replace(i, Instr(code[next].op));
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//Everything after a goto or return up to the next label in use
+bool Peephole::RemoveUnreachable(size_t i){
+	const std::vector<Instr>& code = *m_code;
+
+	if (!IsUnconditional(code[i].op))
+		return false;
+
+	bool removed = false;
+	for (size_t j = Next(i); j < code.size() && (code[j].op != Op::Label || m_labelRefs[code[j].operand] == 0); j = Next(j)){
+		Remove(j);
+		removed = true;
+	}
+	return removed;
+}
+
+bool Peephole::RemoveDeadLabel(size_t i){
+	const Instr& instr = (*m_code)[i];
+
+	if (instr.op != Op::Label || m_labelRefs[instr.operand] > 0)
+		return false;
+
+	Remove(i);
+	return true;
+}
\ No newline at end of file
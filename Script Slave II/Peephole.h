@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+#include "CodeGen.h"
+
+/*
+	Peephole optimizer over the instructions generated by CodeGen. The rules are kept in a table (s_rules) and
+	applied in table order, one sweep over the method per rule, until a round of sweeps doesn't change anything
+	anymore.
+
+	Removed instructions are only marked during a round, so label positions stay valid, and are dropped at the end
+	of the round.
+*/
+class Peephole
+{
+public:
+
+	void Optimize(JvmClass& cls);
+
+	//Instructions without labels, over all methods
+	int GetNumBefore() const {
+		return m_numBefore;
+	}
+
+	int GetNumAfter() const {
+		return m_numAfter;
+	}
+
+	//Number of times every rule was applied, in the order of GetRuleName().
+	const std::vector<int>& GetRuleHits() const {
+		return m_ruleHits;
+	}
+
+	static int GetNumRules();
+	static const char* GetRuleName(int rule);
+
+private:
+
+	struct Rule{
+		const char* name;
+		bool (Peephole::*apply)(size_t i);
+	};
+
+	static const Rule s_rules[];
+
+	//The rules, return true if they changed the code at position i.
+	bool FormIInc(size_t i);
+	bool ForwardStoreLoad(size_t i);
+	bool RemoveLoadStore(size_t i);
+	bool FoldNotBranch(size_t i);
+	bool FoldConstantBranch(size_t i);
+	bool InvertBranchOverGoto(size_t i);
+	bool RemoveGotoNext(size_t i);
+	bool ThreadJump(size_t i);
+	bool RemoveUnreachable(size_t i);
+	bool RemoveDeadLabel(size_t i);
+
+	void OptimizeMethod(JvmMethod& method);
+
+	//Computes label positions, label references and loads per local variable
+	void Analyze();
+
+	//Index of the next instruction after i which isn't removed, code size if there is none
+	size_t Next(size_t i) const;
+
+	//Like Next(), but also skips labels. This is the instruction executed after the label at i.
+	size_t NextExecuted(size_t i) const;
+
+	//True if the label 'label' is among the labels directly following i
+	bool IsLabelNext(size_t i, int label) const;
+
+	//Label reached after following gotos starting at 'label'
+	int FinalTarget(int label) const;
+
+	void Remove(size_t i);
+	void Replace(size_t i, const Instr& instr);
+
+	static int GetPushedConstant(const Instr& instr, bool& isConstant);
+
+	std::vector<Instr>* m_code;
+	std::vector<bool> m_removed;
+	std::vector<int> m_labelPositions;
+	std::vector<int> m_labelRefs;
+	std::vector<int> m_localLoads;	//Loads and iincs per local variable index
+	bool m_usesDup;
+
+	int m_numBefore = 0;
+	int m_numAfter = 0;
+	std::vector<int> m_ruleHits;
+};
\ No newline at end of file
@@ -106,6 +106,7 @@ bool match_arg_list( ArgListPtr& in ){
 
 	//arg_list -> e
 	in = std::make_unique<ArgList>();
+	in->SetToken( g_tokenStack->GetCurrentToken() );
 	return true;
 }
 
@@ -216,14 +217,58 @@ bool match_stmt( StmtPtr& in ){
 	MATCH_RETURN
 }
 
+//Skips the rest of a statement which can't be parsed, up to and including the next ';' or up to the '}' which closes
+//the enclosing block. Blocks opened on the way are skipped as a whole.
+void skip_stmt(){
+	int depth = 0;
+
+	for(;;){
+		TokenType type = g_tokenStack->GetCurrentToken().type;
+		if( type == TokenType::Eof || ( type == TokenType::RBrace && depth == 0 ) )
+			return;
+
+		g_tokenStack->Skip();
+
+		if( type == TokenType::LBrace )
+			++depth;
+		else if( type == TokenType::RBrace && --depth == 0 )
+			return;
+		else if( type == TokenType::Semicolon && depth == 0 )
+			return;
+	}
+}
+
+//stmt* up to the end of the block. A statement which can't be parsed is reported, skipped and replaced by a
+//StmtError, so the following statements are still parsed and checked.
+bool match_stmts( StmtBlockPtr& node ){
+	for(;;){
+		TokenType next = g_tokenStack->GetCurrentToken().type;
+		if( next == TokenType::RBrace || next == TokenType::Eof )
+			return true;
+
+		StmtPtr& stmt = node->Push();
+
+		g_tokenStack->ResetFurthest( "Stmt" );
+		g_tokenStack->PushIndex();
+		if( match_stmt( stmt ) ){
+			g_tokenStack->DiscardIndex();
+			continue;
+		}
+		g_tokenStack->PopIndex();
+
+		g_tokenStack->AddError();
+		stmt = std::make_unique<StmtError>();
+		stmt->SetToken( g_tokenStack->GetCurrentToken() );
+		skip_stmt();
+	}
+}
+
 bool match_stmtblock( StmtBlockPtr& in ){
 	//stmt_block -> stmt*
 	PREPARE_NODE( StmtBlock );	
 	TRY_MATCH( 
 		match(LBrace) &&
-		STAR(
-			match_stmt( node->Push() )
-		) &&
+		match_stmts( node ) &&
 		match(RBrace)
 	);
 
@@ -254,6 +299,7 @@ bool match_param_list( ParamListPtr& in ){
 
 	//param_list -> e
 	in = std::make_unique<ParamList>();
+	in->SetToken( g_tokenStack->GetCurrentToken() );
 	return true;
 }
 
@@ -342,23 +388,60 @@ bool match_global_stmt(GlobalStmtPtr& in){
 	MATCH_RETURN;
 }
 
+//Skips a definition which can't be parsed, up to the next one. That is behind a ';' or '}' outside of braces, or at
+//'class' or an identifier at the start of a line, e.g. the type of a function.
+void skip_global_stmt(){
+	int depth = 0;
+	bool first = true;
+
+	for(;;){
+		const Token& t = g_tokenStack->GetCurrentToken();
+		if( t.type == TokenType::Eof )
+			return;
+		if( !first && depth == 0 && ( t.type == TokenType::Class || ( t.type == TokenType::Ident && t.filePosition.pos == 1 ) ) )
+			return;
+
+		TokenType type = t.type;
+		g_tokenStack->Skip();
+		first = false;
+
+		if( type == TokenType::LBrace )
+			++depth;
+		else if( type == TokenType::RBrace && ( depth == 0 || --depth == 0 ) )
+			return;
+		else if( type == TokenType::Semicolon && depth == 0 )
+			return;
+	}
+}
+
+//Parses the whole program. Syntax errors are recovered from and collected in the token stack, the returned AST
+//contains everything that could be parsed.
 bool match_start( TokenStack& ts,  StartBlockPtr& in ){
-	g_exprParser = new ExprParser( ts );
+	//Deleted on every return, the compile server and incremental compiles parse many times per process.
+	std::unique_ptr<ExprParser> exprParser( new ExprParser( ts ) );
+	g_exprParser = exprParser.get();
 	g_tokenStack = &ts;
 	g_tokenStack->SetFurthestProductionName( "StartBlock" );
 
-	//start -> func_def*
+	//start -> global_stmt*
 	PREPARE_NODE( StartBlock );
 
-	TRY_MATCH(
-		STAR(
-			match_global_stmt(node->Push())
-		)
-	);
+	while( g_tokenStack->GetCurrentToken().type != TokenType::Eof ){
+		g_tokenStack->ResetFurthest( "GlobalStmt" );
+		g_tokenStack->PushIndex();
+		if( match_global_stmt( node->Push() ) ){
+			g_tokenStack->DiscardIndex();
+			continue;
+		}
+		g_tokenStack->PopIndex();
+		node->Pop();
 
-	//TODO: delete this, doesn't get called most of the time
-	delete g_exprParser;
-	MATCH_RETURN;
+		g_tokenStack->AddError();
+		skip_global_stmt();
+	}
+
+	in = std::move( node );
+	return true;
 }
 
 #endif
\ No newline at end of file
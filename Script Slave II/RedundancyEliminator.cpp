@@ -0,0 +1,709 @@
+#include "RedundancyEliminator.h"
+#include "DeadCodeEliminator.h"
+#include "SymbolScope.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+namespace{
+
+	//Calls 'f' for every expression of the statements in a subtree which is evaluated as a value, in evaluation
+	//order. Targets of assignments are left out, the index and array of an array store are included.
+	class ExprSlotVisitor : public BaseVisitor{
+	public:
+		ExprSlotVisitor(std::function<void(ExprPtr&)> f) : m_f(f) {}
+
+		virtual bool inNode(StmtVarDecl* n, bool last) override {
+			if (n->GetExpr() != nullptr)
+				m_f(n->GetExprRef());
+			return false;
+		}
+
+		virtual bool inNode(StmtAssign* n, bool last) override {
+			if (n->GetLHS()->GetNodeType() == NodeType::BinOp && ((BinOp*) n->GetLHS())->GetType() == BinOp::Subscript){
+				m_f(((BinOp*) n->GetLHS())->GetLeftRef());
+				m_f(((BinOp*) n->GetLHS())->GetRightRef());
+			}
+			m_f(n->GetExprRef());
+			return false;
+		}
+
+		virtual bool inNode(StmtFuncCall* n, bool last) override {
+			for (auto& arg : n->GetArgList()->GetChildren())
+				m_f(arg);
+			return false;
+		}
+
+		virtual bool inNode(StmtReturn* n, bool last) override {
+			if (n->GetExpr() != nullptr)
+				m_f(n->GetExprRef());
+			return false;
+		}
+
+		virtual bool inNode(StmtWhile* n, bool last) override {
+			m_f(n->GetExprRef());
+			return true;
+		}
+
+		virtual bool inNode(StmtIfThen* n, bool last) override {
+			m_f(n->GetExprRef());
+			return true;
+		}
+
+		virtual bool inNode(StmtIfThenElse* n, bool last) override {
+			m_f(n->GetExprRef());
+			return true;
+		}
+
+	private:
+		std::function<void(ExprPtr&)> m_f;
+	};
+
+	void ForEachExpr(ASTNode* n, std::function<void(ExprPtr&)> f){
+		ExprSlotVisitor visitor(f);
+		n->accept(&visitor, true);
+	}
+
+	//Variables written, calls and array stores within a loop.
+	class LoopEffects : public BaseVisitor{
+	public:
+		std::set<ASTNode const*> written;
+		bool hasCalls = false;
+		bool hasArrayStores = false;
+
+		virtual bool inNode(StmtVarDecl* n, bool last) override {
+			written.insert(n);
+			return true;
+		}
+
+		virtual bool inNode(StmtAssign* n, bool last) override {
+			if (n->GetLHS()->GetNodeType() == NodeType::Ident && ((Ident*) n->GetLHS())->GetSymbol() != nullptr)
+				written.insert(((Ident*) n->GetLHS())->GetSymbol()->GetNode());
+			else if (n->GetLHS()->GetNodeType() == NodeType::BinOp && ((BinOp*) n->GetLHS())->GetType() == BinOp::Subscript)
+				hasArrayStores = true;
+			return true;
+		}
+
+		virtual bool inNode(StmtFuncCall* n, bool last) override {
+			hasCalls = true;
+			return true;
+		}
+
+		virtual bool inNode(FuncCallExpr* n, bool last) override {
+			hasCalls = true;
+			return true;
+		}
+
+		virtual bool inNode(BinOp* n, bool last) override {
+			if (n->GetType() == BinOp::FunctionCall)
+				hasCalls = true;
+			return true;
+		}
+	};
+
+	int CountNodes(Expr const* p){
+		switch (p->GetNodeType()){
+		case NodeType::UnOp:
+			return 1 + CountNodes(((UnOp const*) p)->GetExpr());
+		case NodeType::BinOp:
+			return 1 + CountNodes(((BinOp const*) p)->GetLeft()) + CountNodes(((BinOp const*) p)->GetRight());
+		default:
+			return 1;
+		}
+	}
+
+	bool IsOperation(Expr const* p){
+		if (p->GetNodeType() == NodeType::UnOp)
+			return true;
+		if (p->GetNodeType() != NodeType::BinOp)
+			return false;
+		BinOp::Types type = ((BinOp const*) p)->GetType();
+		return type != BinOp::FunctionCall && type != BinOp::MemberAccess;
+	}
+
+	//With 'canFail', divisions and subscripts are allowed as well, the elements of arrays don't change if the loop
+	//neither stores to arrays nor calls functions.
+	bool IsInvariant(Expr const* p, const LoopEffects& effects, bool canFail = false){
+		switch (p->GetNodeType()){
+		case NodeType::IntLit:
+		case NodeType::FloatLit:
+		case NodeType::BoolLit:
+		case NodeType::StringLit:
+			return true;
+		case NodeType::Ident:
+		{
+			Symbol const* sym = ((Ident const*) p)->GetSymbol();
+			if (sym == nullptr || effects.written.count(sym->GetNode()) > 0)
+				return false;
+			return sym->type == Symbol::VARIABLE || sym->type == Symbol::PARAMETER || (sym->type == Symbol::GLOBAL_VAR && !effects.hasCalls);
+		}
+		case NodeType::UnOp:
+			return IsInvariant(((UnOp const*) p)->GetExpr(), effects, canFail);
+		case NodeType::BinOp:
+		{
+			BinOp const* n = (BinOp const*) p;
+			bool invariant = canFail ?
+				IsOperation(p) && (n->GetType() != BinOp::Subscript || (!effects.hasArrayStores && !effects.hasCalls)) :
+				DeadCodeEliminator::IsPure(p);
+			return invariant && IsInvariant(n->GetLeft(), effects, canFail) && IsInvariant(n->GetRight(), effects, canFail);
+		}
+		default:
+			return false;
+		}
+	}
+
+	//Finds the largest invariant operations in an expression.
+	void CollectInvariants(ExprPtr& slot, const LoopEffects& effects, std::vector<ExprPtr*>& invariants){
+		Expr* p = slot.get();
+
+		if (IsOperation(p) && CountNodes(p) >= 3 && IsInvariant(p, effects)){
+			invariants.push_back(&slot);
+			return;
+		}
+
+		switch (p->GetNodeType()){
+		case NodeType::UnOp:
+			CollectInvariants(((UnOp*) p)->GetExprRef(), effects, invariants);
+			return;
+		case NodeType::BinOp:
+			if (((BinOp*) p)->GetType() == BinOp::FunctionCall)
+				return;
+			CollectInvariants(((BinOp*) p)->GetLeftRef(), effects, invariants);
+			if (((BinOp*) p)->GetType() != BinOp::MemberAccess)
+				CollectInvariants(((BinOp*) p)->GetRightRef(), effects, invariants);
+			return;
+		case NodeType::FuncCallExpr:
+			for (auto& arg : ((FuncCallExpr*) p)->GetArgs()->GetChildren())
+				CollectInvariants(arg, effects, invariants);
+			return;
+		default:
+			return;
+		}
+	}
+
+	//Finds the largest invariant operations in an expression which may fail, leaving out operands evaluated only
+	//depending on another, like the right side of && and ||.
+	void CollectFailingInvariants(ExprPtr& slot, const LoopEffects& effects, std::vector<ExprPtr*>& invariants){
+		Expr* p = slot.get();
+
+		if (IsOperation(p) && CountNodes(p) >= 3 && IsInvariant(p, effects, true)){
+			invariants.push_back(&slot);
+			return;
+		}
+
+		switch (p->GetNodeType()){
+		case NodeType::UnOp:
+			CollectFailingInvariants(((UnOp*) p)->GetExprRef(), effects, invariants);
+			return;
+		case NodeType::BinOp:
+		{
+			BinOp::Types type = ((BinOp*) p)->GetType();
+			if (type == BinOp::FunctionCall)
+				return;
+			CollectFailingInvariants(((BinOp*) p)->GetLeftRef(), effects, invariants);
+			if (type != BinOp::MemberAccess && type != BinOp::And && type != BinOp::Or)
+				CollectFailingInvariants(((BinOp*) p)->GetRightRef(), effects, invariants);
+			return;
+		}
+		default:
+			return;
+		}
+	}
+
+	//Operations which can be reused: no calls, only variables.
+	bool IsReusable(Expr const* p){
+		switch (p->GetNodeType()){
+		case NodeType::IntLit:
+		case NodeType::FloatLit:
+		case NodeType::BoolLit:
+		case NodeType::StringLit:
+			return true;
+		case NodeType::Ident:
+		{
+			Symbol const* sym = ((Ident const*) p)->GetSymbol();
+			return sym != nullptr && (sym->type == Symbol::VARIABLE || sym->type == Symbol::PARAMETER || sym->type == Symbol::GLOBAL_VAR);
+		}
+		case NodeType::UnOp:
+			return IsReusable(((UnOp const*) p)->GetExpr());
+		case NodeType::BinOp:
+			return IsOperation(p) && IsReusable(((BinOp const*) p)->GetLeft()) && IsReusable(((BinOp const*) p)->GetRight());
+		default:
+			return false;
+		}
+	}
+
+	//Calls and operations which can throw, except for those within 'except'.
+	int CountEffects(Expr const* p, Expr const* except){
+		if (p == except)
+			return 0;
+
+		switch (p->GetNodeType()){
+		case NodeType::UnOp:
+			return CountEffects(((UnOp const*) p)->GetExpr(), except);
+		case NodeType::BinOp:
+		{
+			BinOp const* n = (BinOp const*) p;
+			int effects = CountEffects(n->GetLeft(), except) + CountEffects(n->GetRight(), except);
+			switch (n->GetType()){
+			case BinOp::Div:
+			case BinOp::Mod:
+			case BinOp::Subscript:
+			case BinOp::MemberAccess:
+			case BinOp::FunctionCall:
+				++effects;
+			default:
+				break;
+			}
+			return effects;
+		}
+		case NodeType::FuncCallExpr:
+		{
+			int effects = 1;
+			for (const auto& arg : ((FuncCallExpr const*) p)->GetArgs()->GetChildren())
+				effects += CountEffects(arg.get(), except);
+			return effects;
+		}
+		default:
+			return 0;
+		}
+	}
+
+	bool HasCalls(Expr const* p){
+		switch (p->GetNodeType()){
+		case NodeType::UnOp:
+			return HasCalls(((UnOp const*) p)->GetExpr());
+		case NodeType::BinOp:
+			return ((BinOp const*) p)->GetType() == BinOp::FunctionCall || HasCalls(((BinOp const*) p)->GetLeft())
+				|| HasCalls(((BinOp const*) p)->GetRight());
+		case NodeType::FuncCallExpr:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	//Reads only locals and can't fail, so it can be evaluated earlier than it was.
+	bool IsStable(Expr const* p){
+		switch (p->GetNodeType()){
+		case NodeType::Ident:
+		{
+			Symbol const* sym = ((Ident const*) p)->GetSymbol();
+			return sym->type == Symbol::VARIABLE || sym->type == Symbol::PARAMETER;
+		}
+		case NodeType::UnOp:
+			return IsStable(((UnOp const*) p)->GetExpr());
+		case NodeType::BinOp:
+			return DeadCodeEliminator::IsPure(p) && IsStable(((BinOp const*) p)->GetLeft()) && IsStable(((BinOp const*) p)->GetRight());
+		default:
+			return true;
+		}
+	}
+
+	bool IsSimpleStmt(Stmt const* p){
+		switch (p->GetNodeType()){
+		case NodeType::StmtVarDecl:
+		case NodeType::StmtAssign:
+		case NodeType::StmtFuncCall:
+		case NodeType::StmtReturn:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	//Ident or Subscript target of an assignment, nullptr for other statements
+	Expr const* GetAssignTarget(Stmt const* p){
+		if (p->GetNodeType() != NodeType::StmtAssign)
+			return nullptr;
+		return ((StmtAssign const*) p)->GetLHS();
+	}
+
+	//Copy of a loop condition which IsReusable() and IsStable().
+	ExprPtr CloneCondition(Expr const* p){
+		ExprPtr expr;
+
+		switch (p->GetNodeType()){
+		case NodeType::Ident:
+		{
+			Symbol const* sym = ((Ident const*) p)->GetSymbol();
+			IdentPtr ident = std::make_unique<Ident>(((Ident const*) p)->GetName());
+			ident->SetSymbol(sym);
+			++sym->useCount;
+			expr = std::move(ident);
+			break;
+		}
+		case NodeType::IntLit:		expr = std::make_unique<IntLit>(((IntLit const*) p)->GetValue()); break;
+		case NodeType::FloatLit:	expr = std::make_unique<FloatLit>(((FloatLit const*) p)->GetValue()); break;
+		case NodeType::BoolLit:		expr = std::make_unique<BoolLit>(((BoolLit const*) p)->GetValue()); break;
+		case NodeType::StringLit:	expr = std::make_unique<StringLit>(((StringLit const*) p)->GetValue()); break;
+		case NodeType::UnOp:
+			expr = std::make_unique<UnOp>(((UnOp const*) p)->GetType(), CloneCondition(((UnOp const*) p)->GetExpr()));
+			break;
+		case NodeType::BinOp:
+		{
+			BinOp const* n = (BinOp const*) p;
+			expr = std::make_unique<BinOp>(n->GetType(), CloneCondition(n->GetLeft()), CloneCondition(n->GetRight()));
+			break;
+		}
+		default:
+			return nullptr;
+		}
+
+		expr->SetTypeInfo(p->GetTypeInfo());
+		expr->SetToken(p->GetToken());
+		return expr;
+	}
+
+	TypePtr MakeType(TypeInfo const* info){
+		TypePtr type = std::make_unique<Type>(info->GetSimpleTypeName());
+		type->SetTypeInfo(info);
+		type->SetIsArray(info->isArray);
+		return type;
+	}
+}
+
+void RedundancyEliminator::Process(StartBlockPtr& start){
+	//The temporaries are declared in the function scopes, which are frozen since the second pass.
+	m_globalScope.Thaw();
+
+	for (auto& global : start->GetChildren()){
+		if (global->GetNodeType() != NodeType::FuncDef)
+			continue;
+
+		FuncDef* func = (FuncDef*) global.get();
+		m_scope = m_globalScope.GetSubScope(func->GetName()->GetName());
+		func->GetStmtBlock()->accept(this, true);
+	}
+
+	m_globalScope.Freeze();
+}
+
+void RedundancyEliminator::outNode(StmtBlock* n, bool last){
+	auto& children = n->GetChildren();
+
+	for (size_t i = 0; i < children.size(); ++i){
+		std::vector<StmtPtr> decls = HoistInvariants(children[i]);
+		children.insert(children.begin() + i, std::make_move_iterator(decls.begin()), std::make_move_iterator(decls.end()));
+		i += decls.size();
+	}
+
+	for (size_t begin = 0; begin < children.size(); ++begin){
+		if (!IsSimpleStmt(children[begin].get()))
+			continue;
+
+		size_t end = begin;
+		while (end < children.size() && IsSimpleStmt(children[end].get()))
+			++end;
+
+		//Every reuse declares a temporary in front of the run
+		while (EliminateCommonSubexpression(children, begin, end))
+			++end;
+
+		begin = end;
+	}
+}
+
+void RedundancyEliminator::outNode(StmtWhile* n, bool last){
+	HoistInvariantsInPlace(n->GetBodyRef());
+}
+
+void RedundancyEliminator::outNode(StmtIfThen* n, bool last){
+	HoistInvariantsInPlace(n->GetThenRef());
+}
+
+void RedundancyEliminator::outNode(StmtIfThenElse* n, bool last){
+	HoistInvariantsInPlace(n->GetThenRef());
+	HoistInvariantsInPlace(n->GetElseRef());
+}
+
+std::vector<StmtPtr> RedundancyEliminator::HoistInvariants(StmtPtr& stmt){
+	std::vector<StmtPtr> decls;
+	if (stmt->GetNodeType() != NodeType::StmtWhile)
+		return decls;
+
+	LoopEffects effects;
+	stmt->accept(&effects, true);
+
+	std::vector<ExprPtr*> invariants;
+	ForEachExpr(stmt.get(), [&](ExprPtr& slot){ CollectInvariants(slot, effects, invariants); });
+	ReplaceByTemps(invariants, decls);
+
+	//Operations which can fail may only be evaluated if the loop runs, and not before anything else that can fail
+	//or call a function. They are taken from the statements at the start of the body, if these have no other effects,
+	//and evaluated behind a check of the condition: while(c) body -> if(c){ tmp = ...; while(c) body }. The condition
+	//is checked once more, so it must be cheap and can't fail itself.
+	StmtWhile* loop = (StmtWhile*) stmt.get();
+	if (!IsReusable(loop->GetExpr()) || !IsStable(loop->GetExpr()))
+		return decls;
+
+	std::vector<Stmt*> body;
+	if (loop->GetBody()->GetNodeType() == NodeType::StmtBlock){
+		for (auto& child : ((StmtBlock*) loop->GetBody())->GetChildren())
+			body.push_back(child.get());
+	}
+	else
+		body.push_back(loop->GetBody());
+
+	std::vector<ExprPtr*> failing;
+	for (Stmt* child : body){
+		if (!IsSimpleStmt(child))
+			break;
+
+		//The statement's calls and operations which can fail must all be hoisted, so they keep their order.
+		std::vector<ExprPtr*> found;
+		int numEffects = 0;
+		ForEachExpr(child, [&](ExprPtr& slot){
+			numEffects += CountEffects(slot.get(), nullptr);
+			CollectFailingInvariants(slot, effects, found);
+		});
+
+		for (auto slot : found)
+			numEffects -= CountEffects(slot->get(), nullptr);
+		if (numEffects != 0)
+			break;
+
+		failing.insert(failing.end(), found.begin(), found.end());
+
+		//An array store can fail after the operands, the rest of the body isn't reached by returns.
+		Expr const* target = GetAssignTarget(child);
+		if (child->GetNodeType() != NodeType::StmtVarDecl && (target == nullptr || target->GetNodeType() != NodeType::Ident))
+			break;
+	}
+
+	std::vector<StmtPtr> guarded;
+	ReplaceByTemps(failing, guarded);
+	if (guarded.empty())
+		return decls;
+
+	StmtBlockPtr block = std::make_unique<StmtBlock>();
+	block->SetToken(stmt->GetToken());
+	for (auto& decl : guarded)
+		block->Add(std::move(decl));
+
+	StmtIfThenPtr guard = std::make_unique<StmtIfThen>();
+	guard->SetToken(stmt->GetToken());
+	guard->GetExprRef() = CloneCondition(loop->GetExpr());
+	block->Add(std::move(stmt));
+	guard->GetThenRef() = std::move(block);
+	stmt = std::move(guard);
+
+	return decls;
+}
+
+void RedundancyEliminator::ReplaceByTemps(const std::vector<ExprPtr*>& slots, std::vector<StmtPtr>& decls){
+	//Equal expressions share one temporary. Nothing in the loop writes their variables or arrays, so version 0 will do.
+	m_versions.clear();
+	m_memoryVersion = 0;
+	std::map<std::string, StmtVarDecl const*> temps;
+
+	for (auto slot : slots){
+		const std::string key = GetKey(slot->get());
+		Token tok = (*slot)->GetToken();
+		auto temp = temps.find(key);
+
+		if (temp == temps.end()){
+			StmtVarDeclPtr decl = NewTemp(std::move(*slot));
+			temp = temps.insert(std::make_pair(key, decl.get())).first;
+			decls.push_back(std::move(decl));
+			++m_numHoisted;
+		}
+		else
+			ReleaseSymbolUses(slot->get());
+
+		*slot = ReadTemp(temp->second, tok);
+	}
+}
+
+void RedundancyEliminator::HoistInvariantsInPlace(StmtPtr& stmt){
+	std::vector<StmtPtr> decls = HoistInvariants(stmt);
+	if (decls.empty())
+		return;
+
+	StmtBlockPtr block = std::make_unique<StmtBlock>();
+	block->SetToken(stmt->GetToken());
+	for (auto& decl : decls)
+		block->Add(std::move(decl));
+	block->Add(std::move(stmt));
+	stmt = std::move(block);
+}
+
+bool RedundancyEliminator::EliminateCommonSubexpression(std::vector<StmtPtr>& stmts, size_t begin, size_t end){
+	m_versions.clear();
+	m_memoryVersion = 0;
+
+	std::vector<Occurrence> occurrences;
+	for (size_t i = begin; i < end; ++i){
+		Stmt* stmt = stmts[i].get();
+		ForEachExpr(stmt, [&](ExprPtr& slot){ CollectOccurrences(slot, i, false, occurrences); });
+
+		//Writes of the statement, after it read its operands
+		bool hasCalls = stmt->GetNodeType() == NodeType::StmtFuncCall;
+		ForEachExpr(stmt, [&](ExprPtr& slot){ hasCalls = hasCalls || HasCalls(slot.get()); });
+
+		if (stmt->GetNodeType() == NodeType::StmtVarDecl)
+			++m_versions[stmt];
+
+		Expr const* target = GetAssignTarget(stmt);
+		if (target != nullptr && target->GetNodeType() == NodeType::Ident)
+			++m_versions[((Ident const*) target)->GetSymbol()->GetNode()];
+		else if (target != nullptr || hasCalls)
+			++m_memoryVersion;
+	}
+
+	std::map<std::string, std::vector<Occurrence const*>> groups;
+	for (const auto& occurrence : occurrences)
+		groups[occurrence.key].push_back(&occurrence);
+
+	//The largest repeated expression which saves something
+	std::vector<Occurrence const*> const* best = nullptr;
+	for (const auto& group : groups){
+		const auto& occs = group.second;
+		const int n = occs.size();
+		const int size = occs[0]->size;
+
+		//n evaluations against one evaluation, a store and n loads
+		if ((n - 1) * size <= n + 1)
+			continue;
+
+		//Moving the first evaluation in front of its statement must not change what it reads or which exception
+		//comes first
+		Occurrence const* first = occs[0];
+		Expr const* expr = first->slot->get();
+		if (!IsStable(expr)){
+			if (first->conditional && CountEffects(expr, nullptr) > 0)
+				continue;
+
+			int effects = 0;
+			ForEachExpr(stmts[first->stmt].get(), [&](ExprPtr& slot){ effects += CountEffects(slot.get(), expr); });
+			if (effects > 0)
+				continue;
+		}
+
+		if (best == nullptr || size > (*best)[0]->size)
+			best = &occs;
+	}
+
+	if (best == nullptr)
+		return false;
+
+	const size_t firstStmt = (*best)[0]->stmt;
+	StmtVarDecl const* decl = nullptr;
+
+	for (auto occurrence : *best){
+		Token tok = (*occurrence->slot)->GetToken();
+
+		if (decl == nullptr){
+			StmtVarDeclPtr temp = NewTemp(std::move(*occurrence->slot));
+			decl = temp.get();
+			*occurrence->slot = ReadTemp(decl, tok);
+			stmts.insert(stmts.begin() + firstStmt, std::move(temp));
+		}
+		else{
+			ReleaseSymbolUses(occurrence->slot->get());
+			*occurrence->slot = ReadTemp(decl, tok);
+			++m_numEliminated;
+		}
+	}
+
+	return true;
+}
+
+void RedundancyEliminator::CollectOccurrences(ExprPtr& slot, size_t stmt, bool conditional, std::vector<Occurrence>& occurrences){
+	Expr* p = slot.get();
+
+	if (IsOperation(p) && IsReusable(p)){
+		const int size = CountNodes(p);
+		if (size >= 3)
+			occurrences.push_back(Occurrence{ stmt, &slot, GetKey(p), size, conditional });
+	}
+
+	switch (p->GetNodeType()){
+	case NodeType::UnOp:
+		CollectOccurrences(((UnOp*) p)->GetExprRef(), stmt, conditional, occurrences);
+		return;
+	case NodeType::BinOp:
+	{
+		BinOp* n = (BinOp*) p;
+		if (n->GetType() == BinOp::FunctionCall)
+			return;
+		CollectOccurrences(n->GetLeftRef(), stmt, conditional, occurrences);
+		if (n->GetType() != BinOp::MemberAccess)
+			CollectOccurrences(n->GetRightRef(), stmt, conditional || n->GetType() == BinOp::And || n->GetType() == BinOp::Or, occurrences);
+		return;
+	}
+	case NodeType::FuncCallExpr:
+		for (auto& arg : ((FuncCallExpr*) p)->GetArgs()->GetChildren())
+			CollectOccurrences(arg, stmt, conditional, occurrences);
+		return;
+	default:
+		return;
+	}
+}
+
+std::string RedundancyEliminator::GetKey(Expr const* p){
+	switch (p->GetNodeType()){
+	case NodeType::Ident:
+	{
+		Symbol const* sym = ((Ident const*) p)->GetSymbol();
+		std::string key = "v" + std::to_string((uintptr_t) sym->GetNode()) + "." + std::to_string(m_versions[sym->GetNode()]);
+		if (sym->type == Symbol::GLOBAL_VAR)
+			key += "m" + std::to_string(m_memoryVersion);
+		return key;
+	}
+	case NodeType::IntLit:
+		return "i" + std::to_string(((IntLit const*) p)->GetValue());
+	case NodeType::FloatLit:
+	{
+		float value = ((FloatLit const*) p)->GetValue();
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return "f" + std::to_string(bits);
+	}
+	case NodeType::BoolLit:
+		return ((BoolLit const*) p)->GetValue() ? "true" : "false";
+	case NodeType::StringLit:
+		return "s" + ((StringLit const*) p)->GetValue();
+	case NodeType::UnOp:
+		return "u" + std::to_string((int) ((UnOp const*) p)->GetType()) + "(" + GetKey(((UnOp const*) p)->GetExpr()) + ")";
+	case NodeType::BinOp:
+	{
+		BinOp const* n = (BinOp const*) p;
+		std::string key = "b" + std::to_string((int) n->GetType()) + "(" + GetKey(n->GetLeft()) + "," + GetKey(n->GetRight()) + ")";
+		if (n->GetType() == BinOp::Subscript)
+			key += "m" + std::to_string(m_memoryVersion);
+		return key;
+	}
+	default:
+		return "?";
+	}
+}
+
+StmtVarDeclPtr RedundancyEliminator::NewTemp(ExprPtr value){
+	const std::string name = "tmp$" + std::to_string(m_numTemps++);
+
+	StmtVarDeclPtr decl = std::make_unique<StmtVarDecl>();
+	decl->SetToken(value->GetToken());
+	decl->GetTypeRef() = MakeType(value->GetTypeInfo());
+	decl->GetNameRef() = std::make_unique<Ident>(name);
+	decl->GetName()->SetToken(value->GetToken());
+	decl->GetName()->SetTypeInfo(value->GetTypeInfo());
+	decl->GetExprRef() = std::move(value);
+
+	m_scope->AddSymbol(name, Symbol::CreateVariableSymbol(decl.get()));
+	decl->GetName()->SetSymbol(m_scope->GetSymbol(name, SymbolScope::Variable));
+	return decl;
+}
+
+ExprPtr RedundancyEliminator::ReadTemp(StmtVarDecl const* decl, Token tok){
+	Symbol const* sym = decl->GetName()->GetSymbol();
+
+	IdentPtr ident = std::make_unique<Ident>(sym->name);
+	ident->SetSymbol(sym);
+	ident->SetTypeInfo(decl->GetType()->GetTypeInfo());
+	ident->SetToken(tok);
+	++sym->useCount;
+	return std::move(ident);
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include "ASTNode.h"
+#include "BaseVisitor.h"
+
+class Symbol;
+class SymbolScope;
+
+/*
+	Removes repeated evaluations of the same expression on the type checked AST, both by storing the value in a new
+	local "tmp$<n>" declared in the function's scope:
+
+	- Loop-invariant code motion: pure BinOp and UnOp subtrees inside a while loop whose locals aren't assigned or
+	  declared in the loop are evaluated once before it. Globals count as invariant if they aren't assigned and the
+	  loop calls no functions. Expressions which can fail (division, subscripts) might fail although the loop doesn't
+	  run at all, they are only hoisted from the start of the body into a check of the loop condition in front of it.
+	- Common subexpression elimination within basic blocks, runs of statements without control flow. Every variable
+	  has a value number which changes when it is written, array elements and globals also change with every call or
+	  array store. Two subtrees with equal value numbers compute the same value, the first evaluation is moved into a
+	  temporary right before its statement if that can't change the order of side effects or exceptions.
+
+	Subexpressions are only replaced if that saves instructions, counting one instruction per AST node.
+*/
+class RedundancyEliminator : public BaseVisitor
+{
+public:
+
+	RedundancyEliminator(SymbolScope& globalScope) : m_globalScope(globalScope) {}
+
+	void Process(StartBlockPtr& start);
+
+	//Subtrees replaced by a temporary holding the value of an earlier evaluation.
+	int GetNumEliminated() const {
+		return m_numEliminated;
+	}
+
+	//Different expressions evaluated before a loop instead of inside.
+	int GetNumHoisted() const {
+		return m_numHoisted;
+	}
+
+	virtual void outNode(StmtBlock* n, bool last) override;
+	virtual void outNode(StmtWhile* n, bool last) override;
+	virtual void outNode(StmtIfThen* n, bool last) override;
+	virtual void outNode(StmtIfThenElse* n, bool last) override;
+
+private:
+
+	struct Occurrence{
+		size_t stmt;			//Index of the statement in the block
+		ExprPtr* slot;
+		std::string key;
+		int size;
+		bool conditional;		//Right of a && or ||
+	};
+
+	//Hoists invariant expressions out of stmt if it is a loop. Returns the declarations which have to be placed before
+	//it, those of expressions which can fail are placed into a new if statement replacing stmt.
+	std::vector<StmtPtr> HoistInvariants(StmtPtr& stmt);
+
+	//Moves the expressions into new temporaries declared by decls, equal ones share one.
+	void ReplaceByTemps(const std::vector<ExprPtr*>& slots, std::vector<StmtPtr>& decls);
+
+	//Hoisting for loops which aren't directly in a block, these are wrapped in a new block.
+	void HoistInvariantsInPlace(StmtPtr& stmt);
+
+	//Reuses one common subexpression among the statements [begin, end) of a block. Returns false if there is none.
+	bool EliminateCommonSubexpression(std::vector<StmtPtr>& stmts, size_t begin, size_t end);
+
+	void CollectOccurrences(ExprPtr& slot, size_t stmt, bool conditional, std::vector<Occurrence>& occurrences);
+
+	//Structure of p, with value numbers for the variables and memory it reads.
+	std::string GetKey(Expr const* p);
+
+	//Declaration of a new temporary holding 'value'.
+	StmtVarDeclPtr NewTemp(ExprPtr value);
+
+	//Ident reading the temporary declared by 'decl'.
+	ExprPtr ReadTemp(StmtVarDecl const* decl, Token tok);
+
+	SymbolScope& m_globalScope;
+	SymbolScope* m_scope;
+
+	std::map<ASTNode const*, int> m_versions;	//Value numbers of the variables, by declaration
+	int m_memoryVersion;						//Value number of array elements and globals
+
+	int m_numTemps = 0;
+	int m_numEliminated = 0;
+	int m_numHoisted = 0;
+};
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <chrono>
+#include <map>
 
 #include "Token.h"
 #include "Lexer.h"
@@ -11,37 +13,33 @@
 #include "RDParser.h"
 #include "SymbolScope.h"
 #include "CodeGen.h"
+#include "Peephole.h"
+#include "VmCompiler.h"
+#include "IrBuilder.h"
 #include "BaseVisitor.h"
 
 #include "TypeTable.h"
 #include "FirstPass.h"
+#include "ClassLayout.h"
 #include "CollectTypeInfo.h"
 #include "SecondPass.h"
-
-//Removes useless nodes from the AST which are a left-over from parsing phase.
-class EmptyStmtRemover : public BaseVisitor{
-public:
-
-	virtual void outNode( StmtBlock* n, bool last ){ //Want to perform this check *after* the containing elements have been checked.
-		auto& children = n->GetChildren( );
-		children.erase( std::remove_if( children.begin( ), children.end( ), 
-			[]( const StmtPtr& ptr ) -> bool 
-		{
-			if( ptr->GetNodeType() == NodeType::StmtEmpty )	//Remove EmptyStmt's
-				return true;
-
-			if( ptr->GetNodeType() == NodeType::StmtBlock &&		//Remove StmtBlocks which don't contain any Stmts
-				((StmtBlock*) ptr.get())->GetChildren().size() == 0 )
-				return true;
-			return false;
-		}
-		
-		), children.end( ) );
-
-
-		return;
-	}
-};
+#include "TaskPool.h"
+#include "ConstantFolder.h"
+#include "ControlFlowSimplifier.h"
+#include "DeadCodeEliminator.h"
+#include "Inliner.h"
+#include "RedundancyEliminator.h"
+#include "CompileCache.h"
+#include "AstReader.h"
+#include "AstWriter.h"
+#include "EmptyStmtRemover.h"
+#include "IncrementalCompiler.h"
+#include "CompileServer.h"
+#include "TimeReport.h"
+#include "BenchmarkGenerator.h"
+#include "SelfTest.h"
+#include "StringUtil.h"
+#include "DiagnosticPrinter.h"
 
 /*
 template<class T>
@@ -128,136 +126,158 @@ template<classE> static Expected<T> fromException(const E& exception){
 }*/
 
 
-void GetFormattedTokenStringForError(Token t, std::vector<Token>& tokens){
-	auto it = std::find_if(tokens.begin(), tokens.end(), [&t](const Token& tok)
-	{ 
-		return t.filePosition.line == tok.filePosition.line &&
-			t.filePosition.pos == tok.filePosition.pos;
-	});
-
-	if (it == tokens.end())
-		throw std::invalid_argument("Token not found");
-
-	size_t mid = it - tokens.begin();
-
-	int line = tokens[mid].filePosition.line;
+//The front end's results for a source: its tokens and the type checked AST with its types and symbols. The compile
+//server keeps one per file between requests.
+struct CheckedState{
+	std::vector<Token> tokens;
+	StartBlockPtr start;
+	TypeTable typeTable;
+	SymbolScope globalScope;
+	bool isChecked = false;	//The AST belongs to tokens and has no errors
+
+	CheckedState() : typeTable( CreateNativeTypes() ), globalScope( "global", nullptr ) {}
+
+	//Forgets the AST, the symbols point into it, so it goes first.
+	void Reset(){
+		start.reset();
+		typeTable = CreateNativeTypes();
+		globalScope = SymbolScope( "global", nullptr );
+		isChecked = false;
+	}
+};
 
-	//Get start and end index of line. So [beg,end) are all tokens on line 'line'.
-	size_t beg = [&](){ int it = mid; while (it >= 0 && tokens[it].filePosition.line == line) --it; return it; }() + 1; //counts one too far to the left, so +1
-	size_t end = [&](){ int it = mid; while (tokens[it].filePosition.line == line) ++it; return it; }();
+//Runs the script's main function in the embedded VM and writes its return value to out, with the number of array
+//accesses compiled without bounds checks if printStats is set. Returns false if the script couldn't be run or failed.
+bool runInVm(StartBlockPtr& start, const TypeTable& typeTable, DiagnosticPrinter& diagnostics, OutputBuffer& out, bool printStats){
+	VmCompiler vc;
+	VmProgram program;
 
-	size_t count = 0;
-	for (size_t i = beg; i < end; ++i){
-		const Token& t = tokens[i];
-		std::cout << t.GetTokenValue() << " ";
+	if (!vc.Compile(start, typeTable, program)){
+		for (auto&& error : vc.GetErrors())
+			diagnostics.Error(error.first, error.second.filePosition);
+		return false;
+	}
 
-		if (i<mid)
-			count += t.GetTokenValue().size() + 1;
+	int mainIndex = program.FindFunction("main");
+	if (mainIndex < 0 || program.functions[mainIndex].numParams != 0){
+		out.PutLit("Error: The script has no function main() without parameters.\n");
+		return false;
 	}
-	std::cout << "\n";
-	std::string ws(count, ' ');
-	std::cout << ws << "^\n";
-}
 
+	if( printStats && vc.GetNumArrayAccesses() > 0 )
+		out.Put( string_format("Array accesses: %d of %d compiled without bounds checks.\n", vc.GetNumUnchecked(), vc.GetNumArrayAccesses()) );
 
-TypeTable CreateNativeTypes(){
-	TypeTable tt;
+	auto startTime = std::chrono::high_resolution_clock::now();
 
-	tt.Add(TypeInfo{ "void", 0, false });
-	tt.Add(TypeInfo{ "int", 4, false });
-	tt.Add(TypeInfo{ "float", 4, false });
-	tt.Add(TypeInfo{ "bool", 1, false });
-	tt.Add(TypeInfo{ "string", 4, false });
+	Vm vm(program);
+	VmValue result;
+	bool success = vm.Call(mainIndex, std::vector<VmValue>(), result);
 
-	tt.Add(TypeInfo{ "int", 4, true });
-	tt.Add(TypeInfo{ "float", 4, true });
-	tt.Add(TypeInfo{ "bool", 1, true });
-	tt.Add(TypeInfo{ "string", 4, true });
+	auto endTime = std::chrono::high_resolution_clock::now();
 
-	return tt;
-}
+	if (!success){
+		out.Put( "Runtime error: " + vm.GetError() + "\n" );
+		return false;
+	}
 
-void compile(std::string fileName, bool printLiveness = false){
+	switch (program.functions[mainIndex].retType){
+	case VmType::Int:		out.PutLit("main() returned "); out.PutInt(result.i); out.Newline(); break;
+	case VmType::Float:		out.Put( string_format("main() returned %g\n", result.f) ); break;
+	case VmType::Bool:		out.Put( result.i ? "main() returned true\n" : "main() returned false\n" ); break;
+	case VmType::String:	out.Put( "main() returned \"" + ((VmString*) result.obj)->value + "\"\n" ); break;
+	default:				out.PutLit("main() finished\n"); break;
+	}
 
-	std::vector<Token> tokens;
+	out.Put( string_format("Run time: %lld us\n", (long long) std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count()) );
+	return true;
+}
 
-	//READ FILE
-	std::ifstream file(fileName);
+//Lowers the program to SSA form, verifies it and writes the listing to fileName.
+void dumpIr(StartBlockPtr& start, const TypeTable& typeTable, DiagnosticPrinter& diagnostics, const std::string& fileName){
+	IrBuilder builder;
+	IrModule module;
 
-	if( !file.good() ){
-		std::cout << "Error: Could not read file " << fileName << "\n";
+	if (!builder.Build(start, typeTable, module)){
+		for (auto&& error : builder.GetErrors())
+			diagnostics.Error(error.first, error.second.filePosition);
 		return;
 	}
 
-	std::istreambuf_iterator<char> eos;
-	std::string s(std::istreambuf_iterator<char>(file), eos);
-	//Turn everything into lower caps
-	//std::transform( s.begin(), s.end(), s.begin(), ::tolower );
-
-	//LEXING
-	bool lexingSuccessful = Tokenize( s, tokens );
-	//Return if lexing was unsuccessful. Tokenize() will output some console message regarding the error.
-	if( !lexingSuccessful ){
-		return;
-	}
+	std::vector<std::string> errors;
+	if (!module.Verify(errors))
+		for (auto&& error : errors)
+			std::cout << "IR error: " << error << "\n";
 
-	
-	
+	OutputBuffer out(64 * 1024);
+	module.Write(out);
+	if (!out.WriteToFile(fileName))
+		std::cout << "Error: Could not write file " << fileName << "\n";
+}
 
-	for( auto&& a : tokens ){
-		//std::cout << a.GetTypeAsString() + ":\t" + a.GetTokenValue() + "\t" << a.filePosition.line << ":" << a.filePosition.pos << "\n";
+struct CompileOptions{
+	bool printLiveness = false;
+	bool writeJasmin = false;	//Also write Jasmin assembly next to the class file
+	bool run = false;			//Run main() in the embedded VM instead of writing a class file
+	bool dumpIr = false;		//Write the SSA form of all functions to <file>.ir
+	bool writeAst = false;		//Write the checked AST to <file>.ast, it can be compiled instead of the source
+	bool incremental = false;	//Only check the definitions which changed since the <file>.ast of the last compile
+	bool checkOnly = false;		//Stop after checking the source
+	bool timeReport = false;	//Print the time and memory used by each phase, also written to <file>.time.json
+	bool dumpTokens = false;	//Print the tokens of the source
+	bool dumpAst = false;		//Print the checked AST
+	bool dumpSymbols = false;	//Print all symbols with their signatures
+	bool printStats = false;	//Print what the incremental update and the optimizations did
+	std::string cacheDir;		//Reuse outputs of earlier compiles of the same source from this directory, off if empty
+	unsigned checkThreads = 1;	//Type check the function bodies on this many threads, 0 for one per core
+
+	const std::string* source = nullptr;	//Compiled instead of the file's content, the file name is still used for the outputs
+	CheckedState* warmState = nullptr;		//Keeps the checked AST for incremental compiles in memory instead of in <file>.ast
+};
 
-		printf("%-16s%-14.12s%d:%d\n", a.GetTypeAsString().c_str(), a.GetTokenValue().c_str(), a.filePosition.line, a.filePosition.pos);
+//Parses and type checks the tokens of the source. Parsing resumes after syntax errors, so one run reports the errors of
+//the whole program. Returns false if there are any. The dumps requested by the options are collected in dump, nothing
+//else is printed. The phases are measured for the report if it isn't nullptr.
+bool checkSource(std::vector<Token>& tokens, StartBlockPtr& start, TypeTable& typeTable, SymbolScope& globalScope,
+	const CompileOptions& options, DiagnosticPrinter& diagnostics, OutputBuffer& dump, TimeReport* report){
+	if( options.dumpTokens ){
+		TimeReport::Timer timer( report, "Printing" );
+
+		for( auto&& a : tokens )
+			dump.Put( string_format("%-16s%-14.12s%d:%d\n", a.GetTypeAsString().c_str(), a.GetTokenValue().c_str(), a.filePosition.line, a.filePosition.pos) );
+		dump.Newline();
 	}
 
 	//PARSING
 	TokenStack ts(tokens);
 	
-	//Start parsing
-	StartBlockPtr start;
-	bool success = match_start(ts, start);
-	
-	//Figure out if something went wrong
-	if( success && ts.GetCurrentToken().type == TokenType::Eof ){
-#ifdef _DEBUG
-		std::cout << "Successfully matched.\n\n";
-#endif
+	//Start parsing. Syntax errors are recovered from, so the passes below still check the rest of the program.
+	{
+		TimeReport::Timer timer( report, "Parsing" );
+		match_start(ts, start);
 	}
-	else{
-		if (!success && ts.GetFurthestToken().type == TokenType::Eof)
-			std::cout << "Unexpected end of file.\n";
-		else if( success ){
-			const auto& err = ts.GetErrorInfo(); //Error info is a tuple of <previous token, erroneous token, production rule>
-			std::cout << "End of program found, but not all input was consumed. Last Token read is \"" << std::get<1>(err)->GetTokenValue() << "\".\n";
-			GetFormattedTokenStringForError(*std::get<1>(err), tokens);
-		}else{
-			const auto& err = ts.GetErrorInfo();
-			if( std::get<0>(err) == 0 )
-				std::cout << "Cannot parse Token \"" << std::get<1>(err)->GetTokenValue() << "\" in " << std::get<2>(err) << ".\n";
-			else
-				std::cout << "Cannot parse Token \"" << std::get<1>(err)->GetTokenValue() << "\" after Token \"" << std::get<0>(err)->GetTokenValue() << "\" in " << std::get<2>(err) << ".\n";
 
-			GetFormattedTokenStringForError(*std::get<1>(err), tokens);
-		}
-			
-		return;
-	}	
+	for( auto&& err : ts.GetErrors() ){ //Error info is a tuple of <previous token, erroneous token, production rule>
+		const Token* token = std::get<1>(err);
 
-	//Clean up AST - remove empty statements. Should probably be integrated into the AST construction in the first place.
-	EmptyStmtRemover esr;
-	start->accept( &esr, false );
+		if( token->type == TokenType::Eof )
+			diagnostics.Error( "Unexpected end of file in " + std::get<2>(err) + ".", token->filePosition );
+		else if( std::get<0>(err) == nullptr )
+			diagnostics.Error( "Cannot parse Token \"" + token->GetTokenValue() + "\" in " + std::get<2>(err) + ".", token->filePosition );
+		else
+			diagnostics.Error( "Cannot parse Token \"" + token->GetTokenValue() + "\" after Token \"" + std::get<0>(err)->GetTokenValue() +
+				"\" in " + std::get<2>(err) + ".", token->filePosition );
+	}
 
-#ifdef _DEBUG
-	//PRINT AST
-	TreePrinter tv;
-	start->accept( &tv, true );
-	std::cout << "\n\n";
-#endif
+	bool syntaxErrors = !ts.GetErrors().empty();
 
-	//GENERATE SYMBOLS
+	//Clean up AST - remove empty statements. Should probably be integrated into the AST construction in the first place.
+	{
+		TimeReport::Timer timer( report, "Removing empty statements" );
+		EmptyStmtRemover esr;
+		start->accept( &esr, false );
+	}
 
-	TypeTable typeTable = CreateNativeTypes();
-	SymbolScope globalScope("global", nullptr);
+	//GENERATE SYMBOLS
 
 	//First pass:
 	// Register all functions and store in symbol table
@@ -266,60 +286,119 @@ void compile(std::string fileName, bool printLiveness = false){
 	// Add variables to symbol table, make sure no double definitions
 
 	FirstPass firstPass(typeTable, globalScope);
-	firstPass.Process(start);
-
-	for (auto&& error : firstPass.GetErrors()){
-		std::cout << error.second.filePosition.ToString() << " " << error.first << "\n";
-		GetFormattedTokenStringForError(error.second, tokens);
+	{
+		TimeReport::Timer timer( report, "First pass" );
+		firstPass.Process(start);
 	}
 
+	for (auto&& error : firstPass.GetErrors())
+		diagnostics.Error(error.first, error.second.filePosition);
+
 	if (firstPass.GetErrors().size() > 0)
-		return;
+		return false;
 
-	CollectTypeInfo cti(typeTable);
-	cti.Process(start);
+	//Class layout:
+	// Register the classes as types
+	// Give their fields offsets
+	ClassLayout classLayout(typeTable);
+	{
+		TimeReport::Timer timer( report, "Class layout" );
+		classLayout.Process(start->GetChildren());
+	}
 
-	for (auto&& error : cti.GetErrors()){
-		std::cout << error.second.filePosition.ToString() << " " << error.first << "\n";
-		GetFormattedTokenStringForError(error.second, tokens);
+	CollectTypeInfo cti(typeTable);
+	{
+		TimeReport::Timer timer( report, "Collecting type info" );
+		cti.Process(start);
 	}
 
+	for (auto&& error : cti.GetErrors())
+		diagnostics.Error(error.first, error.second.filePosition);
+
 	if (cti.GetErrors().size() > 0)
-		return;
+		return false;
 
 	//Second pass:
 	// Check if all ident-nodes are known variables
 	// Deduce types of all expression nodes
 	SecondPass secondPass(typeTable, globalScope);
-	secondPass.Process(start);
-
-	for (auto&& error : secondPass.GetErrors()){
-		std::cout << error.second.filePosition.ToString() << " " << error.first << "\n";
-		GetFormattedTokenStringForError(error.second, tokens);
+	{
+		TimeReport::Timer timer( report, "Second pass" );
+		secondPass.Process( start, options.checkThreads > 0 ? options.checkThreads : TaskPool::GetDefaultThreadCount() );
 	}
 
+	for (auto&& error : secondPass.GetErrors())
+		diagnostics.Error(error.first, error.second.filePosition);
 
-	std::cout << std::endl;
+	if( options.dumpSymbols ){
+		TimeReport::Timer timer( report, "Printing" );
+		globalScope.PrintAll( dump );
+		classLayout.Print( dump );
+		dump.Newline();
+	}
 
-	globalScope.PrintAll();
+	if( options.dumpAst ){
+		TimeReport::Timer timer( report, "Printing" );
+		TreePrinter tv( dump );
+		start->accept( &tv, true );
+		dump.Newline();
+	}
 
-	std::cout << std::endl;
+	if (syntaxErrors || secondPass.GetErrors().size() > 0)
+		return false;
 
+	return true;
+}
 
-	std::cout << "\n\n";
-	start->accept(&tv, true);
-	std::cout << std::endl;
+//Updates the checked AST of the last compile of the source to its new tokens. The compile server keeps it in state,
+//otherwise it is read from the file astName. Returns false if there is no usable AST or the changes can't be applied,
+//the source has to be checked completely then. What was reused is added to stats if it isn't nullptr.
+bool updateIncrementally(const std::string& astName, const std::vector<Token>& tokens, CheckedState& state, OutputBuffer* stats){
+	if( !state.isChecked ){
+		AstReader reader;
+		if( !reader.Read( astName, state.tokens, state.start, state.typeTable, state.globalScope ) )
+			return false;
+	}
 
-	//GetFormattedTokenStringForError(tokens[25], tokens);
+	IncrementalCompiler incremental( match_start, state.typeTable, state.globalScope );
+	if( !incremental.Update( state.tokens, tokens, state.start ) )
+		return false;
 
+	if( stats != nullptr )
+		stats->Put( string_format("Incremental compile: %d definitions reused, %d checked again (%d bodies only).\n",
+			incremental.GetNumReused(), incremental.GetNumChecked(), incremental.GetNumBodies()) );
+	return true;
+}
 
+//Copies the checked AST of from into the empty state to, through the AST format. The optimizations change the AST,
+//they work on a copy when the compile server keeps the original.
+bool copyCheckedState(const CheckedState& from, CheckedState& to){
+	OutputBuffer out(64 * 1024);
+	AstWriter writer;
+	writer.Write( from.start.get(), from.globalScope, from.tokens, out );
+
+	AstReader reader;
+	if( !reader.Read( out.Data(), out.Size(), "checked AST", to.tokens, to.start, to.typeTable, to.globalScope ) ){
+		std::cout << "Error: " << reader.GetError() << "\n";
+		return false;
+	}
 
+	to.isChecked = true;
+	return true;
+}
 
-	//CodeGen cg;
-	//cg.Generate( start, st );
+//Writes the collected dumps and statistics to std::cout.
+void printDump(OutputBuffer& dump, TimeReport* report){
+	if( dump.Size() == 0 )
+		return;
 
-//#ifndef _DEBUG
-	//ALL GOOD, NO ERRORS.
+	TimeReport::Timer timer( report, "Printing" );
+	std::cout.write( dump.Data(), dump.Size() );
+	dump.Clear();
+}
+
+//Name of the outputs without their extensions, including the period.
+std::string getOutName(const std::string& fileName){
 	//Will go haywire if something like "folder./file" is the input name. The first period isn't in the actual file name, so the path will be cut off. 
 
 	auto it = std::find_if( fileName.rbegin(), fileName.rend(), []( const char& c ){ return c == '.'; } );
@@ -328,39 +407,720 @@ void compile(std::string fileName, bool printLiveness = false){
 	if( outName == "" )	//Use the full filename if no ".xyz" ending has been found.
 		outName = fileName+".";
 
+	return outName;
+}
+
+//Returns false if the source has errors or an output couldn't be written. The phases are measured for the report if
+//it isn't nullptr.
+bool compileFile(const std::string& fileName, const CompileOptions& options, TimeReport* report){
+
+	//READ FILE
+	std::string s;
+
+	if( options.source != nullptr )
+		s = *options.source;
+	else{
+		TimeReport::Timer timer( report, "Reading" );
+		std::ifstream file(fileName);
+
+		if( !file.good() ){
+			std::cout << "Error: Could not read file " << fileName << "\n";
+			return false;
+		}
+
+		std::istreambuf_iterator<char> eos;
+		s.assign(std::istreambuf_iterator<char>(file), eos);
+	}
+	//Turn everything into lower caps
+	//std::transform( s.begin(), s.end(), s.begin(), ::tolower );
+
+	bool isAstFile = fileName.size() > 4 && fileName.compare( fileName.size() - 4, 4, ".ast" ) == 0;
+
+	//Errors are shown with their line of the source, AST files have none.
+	const std::string noSource;
+	DiagnosticPrinter diagnostics( isAstFile ? noSource : s );
+
+	std::string outName = getOutName( fileName );
+
+	//The class is named after the file, without directories and extension.
+	std::string className = outName.substr( 0, outName.size() - 1 );
+	size_t slash = className.find_last_of( "/\\" );
+	if( slash != std::string::npos )
+		className = className.substr( slash + 1 );
+
+	//CACHE LOOKUP
+	//Class and Jasmin files are reused if nothing else is needed, the other outputs and the statistics need the AST.
+	//The checked AST is cached as well, unless the front end's dumps or an incremental compile want to see it checked.
+	const bool needsAst = options.run || options.dumpIr || options.writeAst || options.checkOnly ||
+		options.dumpTokens || options.dumpAst || options.dumpSymbols || options.printStats;
+	const bool cacheAst = !isAstFile && !options.incremental && options.warmState == nullptr &&
+		!options.dumpTokens && !options.dumpAst && !options.dumpSymbols;
+	CompileCache cache( needsAst && !cacheAst ? "" : options.cacheDir );
+	std::string cacheKey;
+
+	if( cache.IsEnabled() ){
+		TimeReport::Timer timer( report, "Cache lookup" );
+		cacheKey = CompileCache::MakeKey( s, className + (options.writeJasmin ? "\njasmin" : "") );
+
+		if( !needsAst && cache.Fetch( cacheKey, "class", outName + "class" ) &&
+			( !options.writeJasmin || cache.Fetch( cacheKey, "j", outName + "j" ) ) ){
+			std::cout << "Unchanged, loaded " << outName << "class from cache.\n";
+			return true;
+		}
+	}
+
+	//Dumps and statistics are collected here and printed after each stage.
+	OutputBuffer dump;
+	OutputBuffer* stats = options.printStats ? &dump : nullptr;
+
+	//FRONT END
+	//AST files have already been checked, they only have to be loaded. The compile server keeps the checked state of
+	//the last request, otherwise it only lives for this compile.
+	CheckedState localState;
+	CheckedState& state = options.warmState != nullptr ? *options.warmState : localState;
+
+	//The cached AST is read in place, like an AST file. A damaged entry is only a miss.
+	bool astCached = false;
+	if( cacheAst && cache.IsEnabled() ){
+		TimeReport::Timer timer( report, "Loading AST" );
+		AstReader reader;
+		astCached = reader.Read( cache.GetEntryName( cacheKey, "ast" ), state.tokens, state.start, state.typeTable, state.globalScope );
+		state.isChecked = astCached;
+
+		if( !astCached )
+			state.Reset();
+		else{
+			std::cout << "Unchanged, loaded the checked AST of " << fileName << " from cache.\n";
+
+			if( options.writeAst && !cache.Fetch( cacheKey, "ast", outName + "ast" ) )
+				std::cout << "Error: Could not write file " << outName << "ast\n";
+		}
+	}
+
+	if( isAstFile ){
+		TimeReport::Timer timer( report, "Loading AST" );
+		state.Reset();
+		state.tokens.clear();
+
+		AstReader reader;
+		bool read = options.source != nullptr ?
+			reader.Read( s.data(), s.size(), fileName, state.tokens, state.start, state.typeTable, state.globalScope ) :
+			reader.Read( fileName, state.tokens, state.start, state.typeTable, state.globalScope );
+
+		if( !read ){
+			std::cout << "Error: " << reader.GetError() << "\n";
+			state.Reset();
+			return false;
+		}
+	}
+	else if( !astCached ){
+		//LEXING
+		//Tokenize() will output some console message regarding the error.
+		std::vector<Token> tokens;
+		bool lexed;
+		{
+			TimeReport::Timer timer( report, "Lexing" );
+			lexed = Tokenize( s, tokens );
+		}
+
+		if( !lexed )
+			return false;
+
+		bool updated = false;
+		if( options.incremental ){
+			TimeReport::Timer timer( report, "Incremental update" );
+			updated = updateIncrementally( outName + "ast", tokens, state, stats );
+		}
+
+		if( !updated ){
+			if( options.incremental )
+				std::cout << "Incremental compile not possible, checking everything.\n";
+			state.Reset();
+		}
+
+		//The nodes keep copies of their tokens, the old ones aren't needed after the update.
+		state.tokens = std::move( tokens );
+		state.isChecked = updated || checkSource( state.tokens, state.start, state.typeTable, state.globalScope, options, diagnostics, dump, report );
+
+		diagnostics.Flush();
+		printDump( dump, report );
+
+		if( !state.isChecked ){
+			state.Reset();
+			return false;
+		}
+
+		//Incremental compiles outside of the compile server read the AST of this one from the file.
+		const bool writeAstFile = options.writeAst || ( options.incremental && options.warmState == nullptr );
+		const bool storeAst = cacheAst && cache.IsEnabled();
+
+		if( writeAstFile || storeAst ){
+			TimeReport::Timer timer( report, "Writing AST" );
+			OutputBuffer out(64 * 1024);
+			AstWriter writer;
+			writer.Write( state.start.get(), state.globalScope, state.tokens, out );
+
+			if( writeAstFile && !out.WriteToFile( outName + "ast" ) )
+				std::cout << "Error: Could not write file " << outName << "ast\n";
 
-	//cg.WriteToFile( outName + "j" );
+			if( storeAst && !cache.Store( cacheKey, "ast", out.Data(), out.Size() ) )
+				std::cout << "Warning: Could not store the AST in the cache.\n";
+		}
+	}
+
+	if( report != nullptr ){
+		report->SetCount( "tokens", state.tokens.size() );
+		report->SetCount( "nodes", TimeReport::CountNodes( state.start.get() ) );
+		report->SetCount( "symbols", TimeReport::CountSymbols( state.globalScope ) );
+	}
 
-//#endif
+	if( options.checkOnly )
+		return true;
+
+	//The compile server's state has to stay as checked for the next request.
+	CheckedState optimizedState;
+	if( options.warmState != nullptr ){
+		TimeReport::Timer timer( report, "Copying AST" );
+		if( !copyCheckedState( state, optimizedState ) )
+			return false;
+	}
+
+	CheckedState& optimized = options.warmState != nullptr ? optimizedState : state;
+	StartBlockPtr& start = optimized.start;
+	TypeTable& typeTable = optimized.typeTable;
+	SymbolScope& globalScope = optimized.globalScope;
+
+	//OPTIMIZE
+	Inliner inliner(globalScope);
+	{
+		TimeReport::Timer timer( report, "Inlining" );
+		inliner.Process(start);
+	}
+	if( stats != nullptr ){
+		stats->Put( string_format("Inlining: %d calls inlined, about %d instructions saved.\n", inliner.GetNumInlined(), inliner.GetEstimatedSavings()) );
+		for (auto&& r : inliner.GetReport())
+			stats->Put( string_format("\t%s into %s: %d calls, body cost %d, saves %d\n", r.callee.c_str(), r.caller.c_str(), r.numCalls, r.cost, r.saved) );
+	}
+
+	ConstantFolder folder;
+	{
+		TimeReport::Timer timer( report, "Constant folding" );
+		folder.Process(start);
+	}
+	if( stats != nullptr )
+		stats->Put( string_format("Constant folding: %d nodes eliminated, %d constants propagated.\n",
+			folder.GetNumEliminated(), folder.GetNumPropagated()) );
+
+	ControlFlowSimplifier cfs;
+	{
+		TimeReport::Timer timer( report, "Control flow simplification" );
+		cfs.Process(start);
+	}
+	if( stats != nullptr )
+		stats->Put( string_format("Control flow simplification: %d branches removed, %d conditions simplified.\n",
+			cfs.GetNumBranchesRemoved(), cfs.GetNumConditionsSimplified()) );
+
+	//Removed nodes stay alive until the end of compile(), symbols point to them.
+	DeadCodeEliminator dce;
+	{
+		TimeReport::Timer timer( report, "Dead code elimination" );
+		dce.Process(start);
+	}
+	if( stats != nullptr )
+		stats->Put( string_format("Dead code elimination: %d functions, %d variables, %d statements removed.\n",
+			dce.GetNumFunctionsRemoved(), dce.GetNumVariablesRemoved(), dce.GetNumStatementsRemoved()) );
+
+	RedundancyEliminator redundancy(globalScope);
+	{
+		TimeReport::Timer timer( report, "Redundancy elimination" );
+		redundancy.Process(start);
+	}
+	if( stats != nullptr )
+		stats->Put( string_format("Redundancy elimination: %d common subexpressions reused, %d loop invariants hoisted.\n",
+			redundancy.GetNumEliminated(), redundancy.GetNumHoisted()) );
+
+	printDump( dump, report );
+
+	//ALL GOOD, NO ERRORS.
+	if( options.dumpIr ){
+		TimeReport::Timer timer( report, "Writing IR" );
+		dumpIr( start, typeTable, diagnostics, outName + "ir" );
+	}
+
+	//The output of the script goes through the dump as well, a failed run fails the compile.
+	if( options.run ){
+		bool ran;
+		{
+			TimeReport::Timer timer( report, "Running" );
+			ran = runInVm( start, typeTable, diagnostics, dump, stats != nullptr );
+		}
+		printDump( dump, report );
+		return ran;
+	}
+
+	//GENERATE CODE
+	CodeGen cg;
+	bool generated;
+	{
+		TimeReport::Timer timer( report, "Code generation" );
+		generated = cg.Generate( start, typeTable, className );
+	}
+
+	if( !generated ){
+		for (auto&& error : cg.GetErrors())
+			diagnostics.Error(error.first, error.second.filePosition);
+		return false;
+	}
+
+	Peephole peephole;
+	{
+		TimeReport::Timer timer( report, "Peephole optimization" );
+		peephole.Optimize( cg.GetClass() );
+	}
+
+	if( stats != nullptr ){
+		stats->Put( string_format("Peephole optimization: %d -> %d instructions", peephole.GetNumBefore(), peephole.GetNumAfter()) );
+		for( int rule = 0; rule < Peephole::GetNumRules(); ++rule ){
+			if( peephole.GetRuleHits()[rule] > 0 )
+				stats->Put( string_format(", %s: %d", Peephole::GetRuleName( rule ), peephole.GetRuleHits()[rule]) );
+		}
+		stats->Newline();
+		printDump( dump, report );
+	}
+
+	TimeReport::Timer timer( report, "Writing output" );
+
+	//The class file is written directly, Jasmin assembly only on request.
+	if( !cg.WriteClassFile( outName + "class" ) ){
+		std::cout << "Error: " << cg.GetWriteError() << "\n";
+		return false;
+	}
+
+	if( options.writeJasmin && !cg.WriteToFile( outName + "j" ) ){
+		std::cout << "Error: Could not write file " << outName << "j\n";
+		return false;
+	}
+
+	//The class file is stored last, it marks the entry as complete for the lookup.
+	if( cache.IsEnabled() ){
+		if( ( options.writeJasmin && !cache.Store( cacheKey, "j", outName + "j" ) ) || !cache.Store( cacheKey, "class", outName + "class" ) )
+			std::cout << "Warning: Could not store the output in the cache.\n";
+	}
+
+	return true;
+}
+
+//Returns false if the source has errors or an output couldn't be written.
+bool compile(std::string fileName, const CompileOptions& options = CompileOptions()){
+	if( !options.timeReport )
+		return compileFile( fileName, options, nullptr );
+
+	TimeReport report;
+	bool success;
+	{
+		TimeReport::Timer timer( &report, "Total" );
+		success = compileFile( fileName, options, &report );
+	}
+
+	OutputBuffer table;
+	report.WriteTable( table );
+	std::cout << "\n";
+	std::cout.write( table.Data(), table.Size() );
+
+	OutputBuffer json;
+	report.WriteJson( fileName, json );
+	std::string jsonName = getOutName( fileName ) + "time.json";
+	if( !json.WriteToFile( jsonName ) )
+		std::cout << "Error: Could not write file " << jsonName << "\n";
+
+	return success;
+}
+
+//Compiles files on request of clients, see CompileServer.h. The checked ASTs with their types and symbols stay in
+//memory, so every compile after the first one of a file is incremental.
+int serve(const std::string& socketPath, const CompileOptions& options){
+	std::map<std::string, std::unique_ptr<CheckedState>> states;
+
+	CompileServer server( socketPath );
+	bool success = server.Run( [&]( const CompileServer::Request& request ) -> bool {
+		std::unique_ptr<CheckedState>& state = states[request.fileName];
+		if( state == nullptr )
+			state = std::make_unique<CheckedState>();
+
+		CompileOptions requestOptions = options;
+		requestOptions.incremental = true;
+		requestOptions.checkOnly = request.checkOnly;
+		requestOptions.source = request.hasSource ? &request.source : nullptr;
+		requestOptions.warmState = state.get();
+
+		return compile( request.fileName, requestOptions );
+	} );
+
+	if( !success ){
+		std::cout << "Error: " << server.GetError() << "\n";
+		return 1;
+	}
+	return 0;
+}
+
+//Sends a request to a compile server and prints its output. The sources of "-buffer" requests are read here.
+int sendRequest(const std::string& socketPath, const std::string& command, const std::string& fileName){
+	std::string source;
+	bool hasSource = command.size() > 7 && command.compare( command.size() - 7, 7, "-buffer" ) == 0;
+
+	if( hasSource ){
+		std::ifstream file( fileName, std::ios::binary );
+		if( !file.good() ){
+			std::cout << "Error: Could not read file " << fileName << "\n";
+			return 1;
+		}
+
+		source.assign( std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() );
+	}
+
+	bool succeeded = false;
+	std::string output, error;
+
+	if( !CompileServer::Send( socketPath, command, fileName, hasSource ? &source : nullptr, succeeded, output, error ) ){
+		std::cout << "Error: " << error << "\n";
+		return 1;
+	}
+
+	std::cout << output;
+	return succeeded ? 0 : 1;
+}
+
+//Compiles the generated programs of each benchmark shape at growing sizes. The fastest of a few runs is printed for
+//each phase, with the growth of the total time over the previous size, so superlinear phases stand out. Builds which
+//count allocations also print the allocations of a compile. Only the shapes whose name contains the filter are run,
+//"all" runs every shape.
+int benchmark(const std::string& filter, const CompileOptions& options){
+	const int runs = 3;
+
+	//Columns of the table and the phases they add up.
+	struct Column{
+		const char* title;
+		std::vector<const char*> phases;
+	};
+
+	const std::vector<Column> columns = {
+		{ "Lexing", { "Lexing" } },
+		{ "Parsing", { "Parsing" } },
+		{ "First", { "First pass" } },
+		{ "TypeInfo", { "Class layout", "Collecting type info" } },
+		{ "Second", { "Second pass" } },
+		{ "Optimize", { "Inlining", "Constant folding", "Control flow simplification", "Dead code elimination", "Redundancy elimination" } },
+		{ "CodeGen", { "Code generation", "Peephole optimization" } },
+		{ "Total", { "Total" } },
+	};
+
+	bool found = false;
+
+	for( auto&& shape : BenchmarkGenerator::GetShapes() ){
+		if( filter != "all" && std::string( shape.name ).find( filter ) == std::string::npos )
+			continue;
+		found = true;
+
+		OutputBuffer out;
+		out.Put( shape.name );
+		out.PutLit( ": " );
+		out.Put( shape.description );
+		out.Newline();
+
+		out.PutLit( "Size" );
+		out.PadTo( 8 );
+		out.PutLit( "Bytes" );
+		for( size_t i = 0; i < columns.size(); ++i ){
+			out.PadTo( 17 + i * 10 );
+			out.Put( columns[i].title );
+		}
+		out.PadTo( 17 + columns.size() * 10 );
+		out.PutLit( "Growth" );
+		if( AllocationCounter::IsEnabled() ){
+			out.PadTo( 27 + columns.size() * 10 );
+			out.PutLit( "Allocs" );
+		}
+		out.Newline();
+
+		std::cout.write( out.Data(), out.Size() );
+
+		std::string fileName = std::string( "benchmark_" ) + shape.name + ".jack";
+		double lastTotal = 0;
+
+		for( size_t size : shape.sizes ){
+			std::string source = shape.generate( size );
+
+			//Cached outputs would skip the phases.
+			CompileOptions runOptions = options;
+			runOptions.source = &source;
+			runOptions.cacheDir.clear();
+
+			std::vector<double> best( columns.size(), -1 );
+			unsigned long long allocations = 0;
+			bool success = true;
+
+			for( int run = 0; run < runs && success; ++run ){
+				TimeReport report;
+
+				//The compiler's own output would dominate the times on a console.
+				std::streambuf* console = std::cout.rdbuf( nullptr );
+				{
+					TimeReport::Timer timer( &report, "Total" );
+					success = compileFile( fileName, runOptions, &report );
+				}
+				std::cout.rdbuf( console );
+
+				for( size_t i = 0; i < columns.size(); ++i ){
+					double ms = 0;
+					for( auto&& phase : report.GetPhases() )
+						for( auto&& name : columns[i].phases )
+							if( phase.name == name )
+								ms += phase.wallMs;
+
+					if( best[i] < 0 || ms < best[i] )
+						best[i] = ms;
+				}
+
+				allocations = report.GetPhases().back().allocations;
+			}
+
+			out.Clear();
+			out.PutInt( (long long) size );
+			out.PadTo( 8 );
+			out.PutInt( (long long) source.size() );
+
+			if( success ){
+				char buf[32];
+				for( size_t i = 0; i < columns.size(); ++i ){
+					out.PadTo( 17 + i * 10 );
+					out.Put( buf, sprintf( buf, "%.3f", best[i] ) );
+				}
+
+				out.PadTo( 17 + columns.size() * 10 );
+				if( lastTotal > 0 )
+					out.Put( buf, sprintf( buf, "x%.2f", best.back() / lastTotal ) );
+				lastTotal = best.back();
+
+				if( AllocationCounter::IsEnabled() ){
+					out.PadTo( 27 + columns.size() * 10 );
+					out.PutInt( (long long) allocations );
+				}
+			}
+			else
+				out.Put( " Failed to compile, see " + fileName );
+			out.Newline();
+
+			std::cout.write( out.Data(), out.Size() );
+
+			if( !success ){
+				std::ofstream file( fileName, std::ios::binary );
+				file << source;
+				break;
+			}
+		}
+
+		std::string outName = getOutName( fileName );
+		std::remove( ( outName + "class" ).c_str() );
+		std::remove( ( outName + "j" ).c_str() );
+		std::remove( ( outName + "ast" ).c_str() );
+		std::remove( ( outName + "ir" ).c_str() );
+
+		std::cout << "\n";
+	}
+
+	if( !found ){
+		std::cout << "Error: No benchmark matches '" << filter << "'.\n";
+		return 1;
+	}
+	return 0;
+}
+
+//Runs the self test cases whose names contain filter, all of them for "all". Returns 1 if one fails.
+int selfTest(const std::string& filter){
+	bool found = false;
+	int numFailed = 0;
+
+	for( auto&& testCase : SelfTest::GetCases() ){
+		if( filter != "all" && std::string( testCase.name ).find( filter ) == std::string::npos )
+			continue;
+		found = true;
+
+		OutputBuffer log;
+		bool passed = testCase.run( match_start, log );
+		if( !passed )
+			++numFailed;
+
+		OutputBuffer out;
+		out.Put( testCase.name );
+		out.PutLit( ": " );
+		out.Put( testCase.description );
+		out.Put( passed ? ", passed\n" : ", FAILED\n" );
+		out.Put( log.Data(), log.Size() );
+		std::cout.write( out.Data(), out.Size() );
+	}
+
+	if( !found ){
+		std::cout << "Error: No self test matches '" << filter << "'.\n";
+		return 1;
+	}
+
+	if( numFailed > 0 ){
+		std::cout << numFailed << " self tests failed.\n";
+		return 1;
+	}
+	return 0;
 }
 
 
 int main(int argc, char* argv[])
 {
 #ifdef _DEBUG
-	compile("code.jack");
+	CompileOptions options;
+	options.dumpTokens = true;
+	options.dumpAst = true;
+	options.dumpSymbols = true;
+	options.printStats = true;
+	compile( "code.jack", options );
 	std::cin.get();
 #else
+	//Commandline switches
+	CompileOptions options;
+
+	while( argc > 3 ){
+		if( std::string("-cache") == argv[1] ){
+			options.cacheDir = argv[2];
+			argc -= 2;
+			argv += 2;
+		}
+		else if( std::string("-check-threads") == argv[1] ){
+			options.checkThreads = (unsigned) atoi( argv[2] );
+			argc -= 2;
+			argv += 2;
+		}
+		else if( std::string("-time-report") == argv[1] ){
+			options.timeReport = true;
+			argc -= 1;
+			argv += 1;
+		}
+		else if( std::string("-dump-tokens") == argv[1] ){
+			options.dumpTokens = true;
+			argc -= 1;
+			argv += 1;
+		}
+		else if( std::string("-dump-ast") == argv[1] ){
+			options.dumpAst = true;
+			argc -= 1;
+			argv += 1;
+		}
+		else if( std::string("-dump-symbols") == argv[1] ){
+			options.dumpSymbols = true;
+			argc -= 1;
+			argv += 1;
+		}
+		else if( std::string("-stats") == argv[1] ){
+			options.printStats = true;
+			argc -= 1;
+			argv += 1;
+		}
+		else
+			break;
+	}
+
+	if( ( argc == 4 || argc == 5 ) && std::string("-client") == argv[1] )
+		return sendRequest( argv[2], argv[3], argc == 5 ? argv[4] : "" );
+
 	if( argc != 3 ){
 		std::cout << "Error: Unknown command line input.\n Valid input is:\n"
 			<< "\tStupsCompiler -compile [filename.pas]\n"
-			<< "\tStupsCompiler -liveness [filename.pas]\n";
+			<< "\tStupsCompiler -liveness [filename.pas]\n"
+			<< "\tStupsCompiler -jasmin [filename.pas]\n"
+			<< "\tStupsCompiler -run [filename.pas]\n"
+			<< "\tStupsCompiler -ir [filename.pas]\n"
+			<< "\tStupsCompiler -ast [filename.pas]\n"
+			<< "\tStupsCompiler -incremental [filename.pas]\n"
+			<< "\tStupsCompiler -server [socket]\n"
+			<< "\tStupsCompiler -client [socket] [compile|check|compile-buffer|check-buffer] [filename.pas]\n"
+			<< "\tStupsCompiler -client [socket] shutdown\n"
+			<< "\tStupsCompiler -benchmark [all|functions|nesting|expression|locals|class|string]\n"
+			<< "\tStupsCompiler -self-test [all|name]\n"
+			<< "Files ending in .ast are compiled without checking them again.\n"
+			<< "Prefix with -cache [directory] to reuse the output of unchanged sources.\n"
+			<< "Prefix with -check-threads [count] to type check the functions on several threads, 0 for one per core.\n"
+			<< "Prefix with -time-report to print the time and memory used by each phase, also written to [filename].time.json.\n"
+			<< "Prefix with -dump-tokens, -dump-ast or -dump-symbols to print the tokens, the checked AST or the symbols.\n"
+			<< "Prefix with -stats to print what the incremental update and the optimizations did.\n";
 		return 0;
 	}
-	//Commandline switches
+
 	if( std::string("-compile") == argv[1] ){
-		compile( argv[2] );
+		compile( argv[2], options );
 		return 0;
 	}
 
 	if( std::string("-liveness") == argv[1] ){
-		compile( argv[2], true);
+		options.printLiveness = true;
+		compile( argv[2], options );
 		return 0;
 	}
 
+	if( std::string("-jasmin") == argv[1] ){
+		options.writeJasmin = true;
+		compile( argv[2], options );
+		return 0;
+	}
+
+	//Scripts which fail at run time exit with an error, so callers can tell.
+	if( std::string("-run") == argv[1] ){
+		options.run = true;
+		return compile( argv[2], options ) ? 0 : 1;
+	}
+
+	if( std::string("-ir") == argv[1] ){
+		options.dumpIr = true;
+		compile( argv[2], options );
+		return 0;
+	}
+
+	if( std::string("-ast") == argv[1] ){
+		options.writeAst = true;
+		compile( argv[2], options );
+		return 0;
+	}
+
+	if( std::string("-incremental") == argv[1] ){
+		options.incremental = true;
+		compile( argv[2], options );
+		return 0;
+	}
+
+	if( std::string("-server") == argv[1] )
+		return serve( argv[2], options );
+
+	if( std::string("-benchmark") == argv[1] )
+		return benchmark( argv[2], options );
+
+	if( std::string("-self-test") == argv[1] )
+		return selfTest( argv[2] );
+
 	std::cout << "Error: Unknown command line input.\n Valid input is:\n"
 		<< "\tStupsCompiler -compile [filename.pas]\n"
-		<< "\tStupsCompiler -liveness [filename.pas]\n";
+		<< "\tStupsCompiler -liveness [filename.pas]\n"
+		<< "\tStupsCompiler -jasmin [filename.pas]\n"
+		<< "\tStupsCompiler -run [filename.pas]\n"
+		<< "\tStupsCompiler -ir [filename.pas]\n"
+		<< "\tStupsCompiler -ast [filename.pas]\n"
+		<< "\tStupsCompiler -incremental [filename.pas]\n"
+		<< "\tStupsCompiler -server [socket]\n"
+		<< "\tStupsCompiler -client [socket] [compile|check|compile-buffer|check-buffer] [filename.pas]\n"
+		<< "\tStupsCompiler -client [socket] shutdown\n"
+		<< "\tStupsCompiler -benchmark [all|functions|nesting|expression|locals|class|string]\n"
+		<< "\tStupsCompiler -self-test [all|name]\n"
+		<< "Files ending in .ast are compiled without checking them again.\n"
+		<< "Prefix with -cache [directory] to reuse the output of unchanged sources.\n"
+		<< "Prefix with -check-threads [count] to type check the functions on several threads, 0 for one per core.\n"
+		<< "Prefix with -time-report to print the time and memory used by each phase, also written to [filename].time.json.\n"
+		<< "Prefix with -dump-tokens, -dump-ast or -dump-symbols to print the tokens, the checked AST or the symbols.\n"
+		<< "Prefix with -stats to print what the incremental update and the optimizations did.\n";
 	return 0;
 #endif
-}
+}
\ No newline at end of file
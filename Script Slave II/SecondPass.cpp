@@ -1,6 +1,40 @@
 #include "SecondPass.h"
+#include <algorithm>
+#include "TaskPool.h"
+#include "Util.h"
+
+void SecondPass::Process(StartBlockPtr& start, unsigned numThreads){
+	//Nothing is declared from here on. The scopes stay frozen for the rest of the compile, any attempt throws, and the
+	//lookups don't have to walk the maps. Passes which declare symbols later thaw them explicitly.
+	m_globalScope.Freeze();
+
+	if (numThreads <= 1)
+		start->accept(this, false);
+	else{
+		auto& globals = start->GetChildren();
+		std::vector<std::unique_ptr<SecondPass>> passes(globals.size());
+
+		TaskPool::Run(globals.size(), numThreads, [&](size_t i){
+			passes[i] = std::make_unique<SecondPass>(m_typeTable, m_globalScope);
+			passes[i]->m_deferUses = true;
+			globals[i]->accept(passes[i].get(), i + 1 == globals.size());
+		});
+
+		for (auto&& pass : passes){
+			m_errors.insert(m_errors.end(), pass->m_errors.begin(), pass->m_errors.end());
+
+			for (auto&& use : pass->m_uses)
+				use.first->useCount += use.second;
+		}
+	}
+
+	//Errors of the same position keep the order they were found in.
+	std::stable_sort(m_errors.begin(), m_errors.end(), [](const std::pair<std::string, Token>& a, const std::pair<std::string, Token>& b){
+		return a.second.filePosition < b.second.filePosition;
+	});
+}
 
-TypeInfo const* SecondPass::GetResultTypeOf(Expr* p, Symbol const* doNotUse = nullptr){
+TypeInfo const* SecondPass::GetResultTypeOf(Expr* p, Symbol const* doNotUse){
 	NodeType nt = p->GetNodeType();
 
 	switch (nt){
@@ -49,13 +83,41 @@ TypeInfo const* SecondPass::GetResultTypeOf(Expr* p, Symbol const* doNotUse = nu
 			return nullptr;
 		}
 
-		p->SetTypeInfo(m_typeTable.Get("bool"));
+		p->SetTypeInfo(ntype == UnOp::Neg ? ti : m_typeTable.Get("bool"));
 		return p->GetTypeInfo();
 	}
 	case NodeType::BinOp:
 	{
 		BinOp* n = (BinOp*) p;
 		TypeInfo const* lt = GetResultTypeOf(n->GetLeft());
+
+		if (n->GetType() == BinOp::MemberAccess){
+			if (lt == nullptr)
+				return nullptr;
+
+			Ident* member = (Ident*) n->GetRight(); //ExprParser only accepts an Ident here
+			if (lt->isArray && member->GetName() == "length"){
+				p->SetTypeInfo(m_typeTable.Get("int"));
+				return p->GetTypeInfo();
+			}
+
+			if (!lt->isClass){
+				AddError(n->GetToken(), "Type '%s' has no members, but '%s' is accessed.", lt->name.c_str(), member->GetName().c_str());
+				return nullptr;
+			}
+
+			TypeInfo::Field const* field = lt->GetField(member->GetName());
+			if (field == nullptr){
+				AddError(member->GetToken(), "Class '%s' has no member '%s'.", lt->name.c_str(), member->GetName().c_str());
+				return nullptr;
+			}
+
+			member->SetTypeInfo(field->type);
+			member->SetFieldOffset((int) field->offset);
+			p->SetTypeInfo(field->type);
+			return p->GetTypeInfo();
+		}
+
 		TypeInfo const* rt = GetResultTypeOf(n->GetRight());
 
 		if (lt == nullptr || rt == nullptr)
@@ -77,7 +139,7 @@ TypeInfo const* SecondPass::GetResultTypeOf(Expr* p, Symbol const* doNotUse = nu
 		case BinOp::GThan:
 		case BinOp::GThanEq:
 			{
-				if( rt != lt || rt->name != "int" || rt->name != "float" ){
+				if( rt != lt || ( rt->name != "int" && rt->name != "float" ) ){
 					AddError(n->GetToken(), "Type mismatch: Expected matching numeric types but found '%s' and '%s' in operation '%s'.", lt->name.c_str(), rt->name.c_str(), BinOp::GetTypeAsString(n->GetType()));
 					return nullptr;
 				}
@@ -161,6 +223,9 @@ TypeInfo const* SecondPass::GetResultTypeOf(Expr* p, Symbol const* doNotUse = nu
 		
 		TypeInfo const* calleeTI = p->GetTypeInfo(); // GetResultTypeOf(n->GetCallee());
 
+		if (calleeSym == nullptr)
+			return nullptr; //FindIdentSymbol( ... ) has already added an error for this.
+
 		if (calleeSym->type != Symbol::FUNCTION){
 			AddError(n->GetCallee()->GetToken(), "Symbol '%s' is not a function, but used as one.", calleeSym->name.c_str());
 			return nullptr;
@@ -199,6 +264,18 @@ TypeInfo const* SecondPass::GetResultTypeOf(Expr* p, Symbol const* doNotUse = nu
 
 void SecondPass::outNode(StmtAssign* n, bool last){
 	
+	//Writing a variable doesn't use it
+	if (n->GetLHS()->GetNodeType() == NodeType::Ident && ((Ident*) n->GetLHS())->GetSymbol() != nullptr)
+		CountUse(((Ident*) n->GetLHS())->GetSymbol(), -1);
+
+	if (n->GetLHS()->GetNodeType() == NodeType::BinOp && ((BinOp*) n->GetLHS())->GetType() == BinOp::MemberAccess){
+		TypeInfo const* objType = GetResultTypeOf(((BinOp*) n->GetLHS())->GetLeft());
+		if (objType != nullptr && objType->isArray){
+			AddError(n->GetToken(), "The length of an array can't be assigned.");
+			return;
+		}
+	}
+
 	auto varType = GetResultTypeOf(n->GetLHS());  //n->GetLHS()->GetTypeInfo();
 	auto exprType = GetResultTypeOf( n->GetExpr() );
 
@@ -266,6 +343,9 @@ void SecondPass::outNode(StmtFuncCall* n, bool last){
 	TypeInfo const* calleeTI = n->GetName()->GetTypeInfo(); // GetResultTypeOf(n->GetName());
 	Symbol const* calleeSym = n->GetName()->GetSymbol();
 
+	if (calleeSym == nullptr)
+		return; //FindIdentSymbol( ... ) has already added an error for this.
+
 	if (calleeSym->type != Symbol::FUNCTION){
 		AddError(n->GetToken(), "Symbol '%s' is not a function but used as such.", calleeSym->name.c_str());
 		return;
@@ -65,6 +65,16 @@ public:
 	}
 
 
+	//The right side of a member access names a field of the left side's class, not a symbol. GetResultTypeOf( ... )
+	//looks it up in the class's field table.
+	virtual bool inNode(BinOp* n, bool last) override {
+		if (n->GetType() != BinOp::MemberAccess)
+			return true;
+
+		n->GetLeft()->accept(this, false);
+		return false;
+	}
+
 	virtual bool inNode(FuncCallExpr* n, bool last) override {
 		auto callee = n->GetCallee();
 
@@ -157,7 +167,10 @@ public:
 		else if (!n->GetExpr() && retType->name == "void")
 			return;
 			
-		TypeInfo const* exprType = n->GetExpr()->GetTypeInfo();
+		TypeInfo const* exprType = GetResultTypeOf(n->GetExpr());
+
+		if (exprType == nullptr)
+			return; //GetResultTypeOf( ... ) has already added an error for this.
 
 		if (retType != exprType){
 			AddError(n->GetExpr()->GetToken(), "Expected return type of type '%s' but found '%s'", retType->name.c_str(), exprType->name.c_str());
@@ -166,13 +179,14 @@ public:
 
 	}
 
-	SecondPass(TypeTable& typeTable, SymbolScope& symbolScope)
+	SecondPass(const TypeTable& typeTable, SymbolScope& symbolScope)
 		: m_typeTable(typeTable), m_globalScope(symbolScope), m_currentScope(&symbolScope)
 	{}
 
-	void Process(StartBlockPtr& start){
-		start->accept(this, false);
-	}
+	//The scopes are frozen while it runs. With more than one thread, every global statement is checked by its own
+	//SecondPass, which has its own scope cursor and errors, and the use counts are added up when all are done. The
+	//errors are sorted by their position, so they come in the same order whatever the number of threads.
+	void Process(StartBlockPtr& start, unsigned numThreads = 1);
 
 	const std::vector<std::pair<std::string, Token>>& GetErrors() const {
 		return m_errors;
@@ -192,9 +206,20 @@ private:
 		else{
 			n->SetSymbol(sym);
 			n->SetTypeInfo(sym->GetTypeInfo());
+
+			if (sym->GetNameNode() != n)
+				CountUse(sym, 1);
 		}
 	}
 
+	//Global symbols are shared with the other threads, so with m_deferUses the change is only collected.
+	void CountUse(Symbol const* sym, int change){
+		if (m_deferUses)
+			m_uses.emplace_back(sym, change);
+		else
+			sym->useCount += change;
+	}
+
 	void AddError(const Token& tok, const std::string fmt_str, ...){
 		va_list ap;
 		va_start(ap, fmt_str);
@@ -203,9 +228,11 @@ private:
 		va_end(ap);
 	}
 
-	TypeInfo const* GetResultTypeOf(Expr* p, Symbol const* doNotUse);
+	TypeInfo const* GetResultTypeOf(Expr* p, Symbol const* doNotUse = nullptr);
 
 	std::vector<std::pair<std::string, Token>> m_errors;
+	bool m_deferUses = false;				//Collect the changes of the use counts in m_uses instead of applying them
+	std::vector<std::pair<Symbol const*, int>> m_uses;
 	const TypeTable& m_typeTable;			//Since we're using pointers to TypeInfo, SymbolScope and Symbol objects, these collections must not be modified
 	SymbolScope& m_globalScope;				//after this stage! Resizing/reordering of the underlying containers might otherwise invalidate the pointers.
 	SymbolScope* m_currentScope;
@@ -0,0 +1,494 @@
+#include "SelfTest.h"
+
+#include <functional>
+#include "Lexer.h"
+#include "TokenStack.h"
+#include "EmptyStmtRemover.h"
+#include "FirstPass.h"
+#include "ClassLayout.h"
+#include "CollectTypeInfo.h"
+#include "SecondPass.h"
+#include "RedundancyEliminator.h"
+#include "IrBuilder.h"
+#include "VmCompiler.h"
+#include "Vm.h"
+#include "BaseVisitor.h"
+#include "SymbolScope.h"
+#include "TypeTable.h"
+#include "StringUtil.h"
+
+namespace{
+
+	//A source after the front end, like the CheckedState of a compile.
+	struct Checked{
+		std::vector<Token> tokens;
+		StartBlockPtr start;
+		TypeTable typeTable;
+		SymbolScope globalScope;
+		std::vector<std::pair<std::string, Token>> errors;	//Of the second pass
+
+		Checked() : typeTable(CreateNativeTypes()), globalScope("global", nullptr) {}
+	};
+
+	//Runs the front end with the second pass on numThreads threads. Returns false if the source fails before the
+	//second pass, the cases only use sources which get that far.
+	bool Check(SelfTest::ParseFunc parse, const std::string& source, unsigned numThreads, Checked& checked, OutputBuffer& log){
+		if (!Tokenize(source, checked.tokens)){
+			log.PutLit("The source can't be tokenized.\n");
+			return false;
+		}
+
+		TokenStack ts(checked.tokens);
+		parse(ts, checked.start);
+		if (!ts.GetErrors().empty()){
+			log.PutLit("The source can't be parsed.\n");
+			return false;
+		}
+
+		EmptyStmtRemover esr;
+		checked.start->accept(&esr, false);
+
+		FirstPass firstPass(checked.typeTable, checked.globalScope);
+		firstPass.Process(checked.start);
+		if (!firstPass.GetErrors().empty()){
+			log.PutLit("The source has errors in the first pass.\n");
+			return false;
+		}
+
+		ClassLayout classLayout(checked.typeTable);
+		classLayout.Process(checked.start->GetChildren());
+
+		CollectTypeInfo cti(checked.typeTable);
+		cti.Process(checked.start);
+		if (!cti.GetErrors().empty()){
+			log.PutLit("The source has errors in its types.\n");
+			return false;
+		}
+
+		SecondPass secondPass(checked.typeTable, checked.globalScope);
+		secondPass.Process(checked.start, numThreads);
+		checked.errors = secondPass.GetErrors();
+		return true;
+	}
+
+	//Calls the function 'name' of the checked program in the VM. 'makeArgs' gets the VM to create arrays. 'inspect'
+	//runs after the call, while its objects are still alive.
+	bool Run(Checked& checked, const std::string& name, std::function<std::vector<VmValue>(Vm&)> makeArgs, VmValue& result, OutputBuffer& log,
+		std::function<bool(Vm&)> inspect = nullptr){
+		VmCompiler vc;
+		VmProgram program;
+		if (!vc.Compile(checked.start, checked.typeTable, program)){
+			log.PutLit("The program can't be compiled for the VM.\n");
+			return false;
+		}
+
+		Vm vm(program);
+		if (!vm.Call(program.FindFunction(name), makeArgs(vm), result)){
+			log.Put(name + "() failed: " + vm.GetError() + "\n");
+			return false;
+		}
+		return inspect == nullptr || inspect(vm);
+	}
+
+	//Subscripts in the while loops of a subtree and outside of them.
+	class SubscriptCounter : public BaseVisitor{
+	public:
+		int inLoops = 0;
+		int outside = 0;
+
+		virtual bool inNode(StmtWhile* n, bool last) override {
+			++m_depth;
+			return true;
+		}
+
+		virtual void outNode(StmtWhile* n, bool last) override {
+			--m_depth;
+		}
+
+		virtual bool inNode(BinOp* n, bool last) override {
+			if (n->GetType() == BinOp::Subscript)
+				++(m_depth > 0 ? inLoops : outside);
+			return true;
+		}
+
+	private:
+		int m_depth = 0;
+	};
+
+	SubscriptCounter CountSubscripts(Checked& checked, const std::string& funcName){
+		SubscriptCounter counter;
+		for (auto& global : checked.start->GetChildren()){
+			if (global->GetNodeType() == NodeType::FuncDef && ((FuncDef*) global.get())->GetName()->GetName() == funcName)
+				((FuncDef*) global.get())->GetStmtBlock()->accept(&counter, true);
+		}
+		return counter;
+	}
+
+	void PutError(OutputBuffer& log, const std::pair<std::string, Token>& error){
+		log.PutLit("\t");
+		log.Put(error.second.filePosition.ToString());
+		log.PutLit(" ");
+		log.Put(error.first);
+		log.Newline();
+	}
+}
+
+const std::vector<SelfTest::Case>& SelfTest::GetCases(){
+	static const std::vector<Case> cases = {
+		{ "error-order", "Errors of functions checked on several threads are sorted by position", &SelfTest::ErrorOrder },
+		{ "hoist-failing", "Invariant subscripts are only hoisted where the loop would evaluate them first", &SelfTest::HoistFailing },
+		{ "fields", "Field accesses in the IR and the VM use the offsets of the class layout", &SelfTest::Fields },
+		{ "array-bounds", "Only subscripts proven to be in bounds are compiled without checks", &SelfTest::ArrayBounds },
+	};
+	return cases;
+}
+
+bool SelfTest::ErrorOrder(ParseFunc parse, OutputBuffer& log){
+	//The if condition is checked after its body and the arguments after the rest of the expression, so each function
+	//finds its errors out of order. The threads finish in any order as well.
+	std::string source;
+	for (int i = 0; i < 8; ++i){
+		std::string n = std::to_string(i);
+		source += "int f" + n + "(int a){\n";
+		source += "\tif(a){\n";
+		source += "\t\treturn unknown" + n + ";\n";
+		source += "\t}\n";
+		source += "\treturn f" + n + "(true) + missing" + n + ";\n";
+		source += "}\n\n";
+	}
+	source += "int main(){\n\treturn f0(1);\n}\n";
+
+	Checked single;
+	Checked threaded;
+	if (!Check(parse, source, 1, single, log) || !Check(parse, source, 4, threaded, log))
+		return false;
+
+	bool passed = single.errors.size() == 32 && threaded.errors.size() == single.errors.size();
+
+	for (size_t i = 0; passed && i < threaded.errors.size(); ++i){
+		if (threaded.errors[i].first != single.errors[i].first ||
+			threaded.errors[i].second.filePosition < single.errors[i].second.filePosition ||
+			single.errors[i].second.filePosition < threaded.errors[i].second.filePosition)
+			passed = false;
+		else if (i > 0 && threaded.errors[i].second.filePosition < threaded.errors[i - 1].second.filePosition)
+			passed = false;
+	}
+
+	if (!passed){
+		log.PutLit("Expected 32 errors sorted by position on both one and four threads, one thread:\n");
+		for (auto&& error : single.errors)
+			PutError(log, error);
+		log.PutLit("Four threads:\n");
+		for (auto&& error : threaded.errors)
+			PutError(log, error);
+	}
+
+	return passed;
+}
+
+bool SelfTest::HoistFailing(ParseFunc parse, OutputBuffer& log){
+	const std::string source =
+		"int g;\n"
+		"\n"
+		"int first(int[] a, int n){\n"
+		"\tint s = 0;\n"
+		"\tint i = 0;\n"
+		"\twhile(i < n){\n"
+		"\t\ts = s + a[5];\n"
+		"\t\ti = i + 1;\n"
+		"\t}\n"
+		"\treturn s;\n"
+		"}\n"
+		"\n"
+		"int conditional(int[] a, int n){\n"
+		"\tint s = 0;\n"
+		"\tint i = 0;\n"
+		"\twhile(i < n){\n"
+		"\t\tif(i > 2)\n"
+		"\t\t\ts = s + a[5];\n"
+		"\t\ti = i + 1;\n"
+		"\t}\n"
+		"\treturn s;\n"
+		"}\n"
+		"\n"
+		"int afterCall(int[] a, int n){\n"
+		"\tint s = 0;\n"
+		"\tint i = 0;\n"
+		"\twhile(i < n){\n"
+		"\t\tg = first(a, i);\n"
+		"\t\ts = s + a[5];\n"
+		"\t\ti = i + 1;\n"
+		"\t}\n"
+		"\treturn s;\n"
+		"}\n"
+		"\n"
+		"int stored(int[] a, int n){\n"
+		"\tint s = 0;\n"
+		"\tint i = 0;\n"
+		"\twhile(i < n){\n"
+		"\t\ts = s + a[5];\n"
+		"\t\ta[i] = s;\n"
+		"\t\ti = i + 1;\n"
+		"\t}\n"
+		"\treturn s;\n"
+		"}\n"
+		"\n"
+		"int main(){\n"
+		"\tint[] none;\n"
+		"\treturn first(none, 0) + conditional(none, 0) + afterCall(none, 0) + stored(none, 0);\n"
+		"}\n";
+
+	Checked checked;
+	if (!Check(parse, source, 1, checked, log))
+		return false;
+
+	RedundancyEliminator redundancy(checked.globalScope);
+	redundancy.Process(checked.start);
+
+	struct Expected{
+		const char* function;
+		int inLoops;
+		int outside;
+	};
+
+	const Expected expected[] = {
+		{ "first", 0, 1 },			//Evaluated first in every iteration, hoisted behind if(i < n)
+		{ "conditional", 1, 0 },	//Not evaluated in every iteration
+		{ "afterCall", 1, 0 },		//The call could change the array, and has to come first
+		{ "stored", 2, 0 },			//The loop changes the array
+	};
+
+	bool passed = true;
+	for (auto&& e : expected){
+		SubscriptCounter counter = CountSubscripts(checked, e.function);
+		if (counter.inLoops != e.inLoops || counter.outside != e.outside){
+			log.Put(string_format("\t%s: expected %d subscripts in the loop and %d outside, found %d and %d.\n",
+				e.function, e.inLoops, e.outside, counter.inLoops, counter.outside));
+			passed = false;
+		}
+	}
+
+	//Loops which don't run don't evaluate the hoisted subscript, the null array isn't accessed.
+	VmValue result;
+	if (!Run(checked, "main", [](Vm&) -> std::vector<VmValue> { return std::vector<VmValue>(); }, result, log))
+		return false;
+
+	//The hoisted subscript reads the same element as the loop did.
+	if (!Run(checked, "first", [](Vm& vm) -> std::vector<VmValue> {
+		VmArray* a = vm.NewArray(VmType::Int, 8);
+		a->GetData<int>()[5] = 7;
+		return std::vector<VmValue>{ VmValue::Object(a), VmValue::Int(3) };
+	}, result, log))
+		return false;
+
+	if (result.i != 21){
+		log.Put(string_format("\tfirst() returned %d instead of 21.\n", result.i));
+		passed = false;
+	}
+
+	return passed;
+}
+
+bool SelfTest::Fields(ParseFunc parse, OutputBuffer& log){
+	const std::string source =
+		"class P{\n"
+		"\tbool b;\n"
+		"\tint x;\n"
+		"\tP next;\n"
+		"\tfloat f;\n"
+		"\tstring s;\n"
+		"}\n"
+		"\n"
+		"int bump(P p){\n"
+		"\tp.x = p.x + p.next.x;\n"
+		"\tp.b = p.b == false;\n"
+		"\tp.f = p.f * 2.0;\n"
+		"\tp.s = p.s + \"a\";\n"
+		"\treturn p.x;\n"
+		"}\n";
+
+	Checked checked;
+	if (!Check(parse, source, 1, checked, log))
+		return false;
+
+	TypeInfo const* classInfo = checked.typeTable.Get("P");
+	bool passed = true;
+
+	//Every store of bump() goes to the offset of its field.
+	IrBuilder builder;
+	IrModule module;
+	std::vector<std::string> irErrors;
+	if (!builder.Build(checked.start, checked.typeTable, module) || !module.Verify(irErrors)){
+		log.PutLit("\tThe IR can't be built or is invalid.\n");
+		for (auto&& error : irErrors)
+			log.Put("\t" + error + "\n");
+		return false;
+	}
+
+	std::vector<int> stored;
+	for (const auto& block : module.functions[0].blocks)
+		for (const auto& instr : block.instrs)
+			if (instr.op == IrOp::StoreField)
+				stored.push_back(instr.imm);
+
+	const char* storedFields[] = { "x", "b", "f", "s" };
+	for (size_t i = 0; i < 4; ++i){
+		if (i >= stored.size() || stored[i] != (int) classInfo->GetField(storedFields[i])->offset){
+			log.Put(string_format("\tStore %d of bump() doesn't go to the offset of '%s'.\n", (int) i, storedFields[i]));
+			passed = false;
+		}
+	}
+
+	//The VM's instances have the layout of the class, they are set up and read back through the VmClass.
+	VmInstance* p = nullptr;
+	auto makeArgs = [&p](Vm& vm) -> std::vector<VmValue> {
+		const int cls = vm.GetProgram().FindClass("P");
+		const VmClass& pClass = vm.GetProgram().classes[cls];
+
+		VmInstance* next = vm.NewInstance(cls);
+		next->GetField<int>(pClass.FindField("x")->offset) = 4;
+
+		p = vm.NewInstance(cls);
+		p->GetField<int>(pClass.FindField("x")->offset) = 3;
+		p->GetField<float>(pClass.FindField("f")->offset) = 1.5f;
+		p->GetField<VmObject*>(pClass.FindField("next")->offset) = next;
+		return std::vector<VmValue>{ VmValue::Object(p) };
+	};
+
+	auto inspect = [&](Vm& vm) -> bool {
+		const VmClass& pClass = *p->cls;
+
+		if (pClass.size != classInfo->size || pClass.fields.size() != classInfo->fields.size()){
+			log.PutLit("\tThe VmClass doesn't have the size and the fields of the class.\n");
+			return false;
+		}
+
+		for (size_t i = 0; i < pClass.fields.size(); ++i){
+			if (pClass.fields[i].name != classInfo->fields[i].name || pClass.fields[i].offset != (int) classInfo->fields[i].offset){
+				log.Put("\tField '" + pClass.fields[i].name + "' of the VmClass is not where the class has it.\n");
+				return false;
+			}
+		}
+
+		const bool fieldsSet = p->GetField<int>(pClass.FindField("x")->offset) == 7 && p->GetField<unsigned char>(pClass.FindField("b")->offset) == 1 &&
+			p->GetField<float>(pClass.FindField("f")->offset) == 3.0f && ((VmString*) p->GetField<VmObject*>(pClass.FindField("s")->offset))->value == "a";
+		if (!fieldsSet)
+			log.PutLit("\tbump() didn't set the fields to x = 7, b = true, f = 3.0 and s = \"a\".\n");
+		return fieldsSet;
+	};
+
+	VmValue result;
+	if (!Run(checked, "bump", makeArgs, result, log, inspect))
+		return false;
+
+	if (result.i != 7){
+		log.Put(string_format("\tbump() returned %d instead of 7.\n", result.i));
+		passed = false;
+	}
+
+	return passed;
+}
+
+bool SelfTest::ArrayBounds(ParseFunc parse, OutputBuffer& log){
+	const std::string source =
+		"int sum(int[] a){\n"
+		"\tint s = 0;\n"
+		"\tint i = 0;\n"
+		"\twhile(i < a.length){\n"
+		"\t\ts = s + a[i];\n"
+		"\t\ti = i + 1;\n"
+		"\t}\n"
+		"\treturn s;\n"
+		"}\n"
+		"\n"
+		"int pastEnd(int[] a){\n"
+		"\tint s = 0;\n"
+		"\tint i = 0;\n"
+		"\twhile(i <= a.length){\n"
+		"\t\ts = s + a[i];\n"
+		"\t\ti = i + 1;\n"
+		"\t}\n"
+		"\treturn s;\n"
+		"}\n";
+
+	Checked checked;
+	if (!Check(parse, source, 1, checked, log))
+		return false;
+
+	bool passed = true;
+
+	//The loop conditions read the length in the IR as well.
+	IrBuilder builder;
+	IrModule module;
+	std::vector<std::string> irErrors;
+	if (!builder.Build(checked.start, checked.typeTable, module) || !module.Verify(irErrors)){
+		log.PutLit("\tThe IR can't be built or is invalid.\n");
+		for (auto&& error : irErrors)
+			log.Put("\t" + error + "\n");
+		return false;
+	}
+
+	int numLengths = 0;
+	for (const auto& function : module.functions)
+		for (const auto& block : function.blocks)
+			for (const auto& instr : block.instrs)
+				numLengths += instr.op == IrOp::ArrayLength ? 1 : 0;
+
+	if (numLengths != 2){
+		log.Put(string_format("\tExpected an arraylength in each loop condition, found %d.\n", numLengths));
+		passed = false;
+	}
+
+	VmCompiler vc;
+	VmProgram program;
+	if (!vc.Compile(checked.start, checked.typeTable, program)){
+		log.PutLit("The program can't be compiled for the VM.\n");
+		return false;
+	}
+
+	if (vc.GetNumArrayAccesses() != 2 || vc.GetNumUnchecked() != 1){
+		log.Put(string_format("\tExpected 1 of 2 subscripts without checks, found %d of %d.\n", vc.GetNumUnchecked(), vc.GetNumArrayAccesses()));
+		passed = false;
+	}
+
+	auto makeArray = [](Vm& vm) -> std::vector<VmValue> {
+		VmArray* a = vm.NewArray(VmType::Int, 100);
+		for (int i = 0; i < a->length; ++i)
+			a->GetData<int>()[i] = i;
+		return std::vector<VmValue>{ VmValue::Object(a) };
+	};
+
+	auto makeNull = [](Vm&) -> std::vector<VmValue> {
+		return std::vector<VmValue>{ VmValue::Object(nullptr) };
+	};
+
+	//The unchecked loop reads every element, and a null array still fails at a.length.
+	VmValue result;
+	if (!Run(checked, "sum", makeArray, result, log))
+		return false;
+
+	if (result.i != 4950){
+		log.Put(string_format("\tsum() returned %d instead of 4950.\n", result.i));
+		passed = false;
+	}
+
+	//Failures are expected from here on, their messages go to a log of their own.
+	const struct{
+		const char* function;
+		std::function<std::vector<VmValue>(Vm&)> makeArgs;
+		const char* error;
+	} failing[] = {
+		{ "sum", makeNull, "Null array access" },
+		{ "pastEnd", makeArray, "Array index out of bounds" },
+	};
+
+	for (auto&& f : failing){
+		OutputBuffer runLog;
+		if (Run(checked, f.function, f.makeArgs, result, runLog) || std::string(runLog.Data(), runLog.Size()).find(f.error) == std::string::npos){
+			log.Put(string_format("\t%s() didn't fail with \"%s\".\n", f.function, f.error));
+			passed = false;
+		}
+	}
+
+	return passed;
+}
\ No newline at end of file
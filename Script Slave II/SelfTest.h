@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "ASTNode.h"
+#include "OutputBuffer.h"
+
+class TokenStack;
+
+//Checks for -self-test of what a script's output can't show, e.g. the order of the errors or what an optimization
+//left in place. Each case compiles a small embedded program and looks at the results of the passes. A failed case
+//writes what it expected to log.
+class SelfTest{
+public:
+
+	//match_start(), which is only available in the main translation unit.
+	typedef bool (*ParseFunc)(TokenStack& ts, StartBlockPtr& start);
+
+	struct Case{
+		const char* name;
+		const char* description;
+		bool (*run)(ParseFunc parse, OutputBuffer& log);
+	};
+
+	static const std::vector<Case>& GetCases();
+
+	//Errors of several functions checked on several threads come in the order of their positions
+	static bool ErrorOrder(ParseFunc parse, OutputBuffer& log);
+
+	//Subscripts at the start of a loop body are hoisted behind a check of the condition, others stay in the loop
+	static bool HoistFailing(ParseFunc parse, OutputBuffer& log);
+
+	//The IR and the VM access fields at the offsets of ClassLayout
+	static bool Fields(ParseFunc parse, OutputBuffer& log);
+
+	//Subscripts of i < a.length loops are compiled without checks, others keep them and fail at runtime
+	static bool ArrayBounds(ParseFunc parse, OutputBuffer& log);
+};
\ No newline at end of file
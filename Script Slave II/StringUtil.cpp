@@ -1,4 +1,5 @@
 #include "StringUtil.h"
+#include "AllocationCounter.h"
 
 #include <stdarg.h>  // for va_start, etc
 #include <memory>    // for std::unique_ptr
@@ -6,6 +7,7 @@
 #pragma warning (disable : 4996 )
 
 std::string string_format(const std::string fmt_str, ...) {
+	AllocationCounter::Scope scope(AllocationCategory::Strings);
 	int final_n, n = ((int)fmt_str.size()) * 2; /* reserve 2 times as much as the length of the fmt_str */
 	std::string str;
 	std::unique_ptr<char[]> formatted;
@@ -26,6 +28,7 @@ std::string string_format(const std::string fmt_str, ...) {
 }
 
 std::string va_string_format(const std::string fmt_str, va_list arg_list) {
+	AllocationCounter::Scope scope(AllocationCategory::Strings);
 	int final_n, n = ((int)fmt_str.size()) * 2; /* reserve 2 times as much as the length of the fmt_str */
 	std::string str;
 	std::unique_ptr<char[]> formatted;
@@ -43,4 +46,31 @@ std::string va_string_format(const std::string fmt_str, va_list arg_list) {
 	return std::string(formatted.get());
 }
 
+std::string unquote_string_literal(const std::string& literal) {
+	size_t begin = 0, end = literal.size();
+	if (end >= 2 && literal[0] == '"' && literal[end - 1] == '"') {
+		begin = 1;
+		end -= 1;
+	}
+
+	std::string str;
+	str.reserve(end - begin);
+
+	for (size_t i = begin; i < end; ++i) {
+		if (literal[i] != '\\' || i + 1 == end) {
+			str += literal[i];
+			continue;
+		}
+
+		switch (literal[++i]) {
+		case 'n': str += '\n'; break;
+		case 't': str += '\t'; break;
+		case 'r': str += '\r'; break;
+		case '0': str += '\0'; break;
+		default: str += literal[i]; break; /* \" \\ and unknown escapes */
+		}
+	}
+	return str;
+}
+
 #pragma warning (default : 4996 )
\ No newline at end of file
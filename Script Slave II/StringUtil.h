@@ -6,3 +6,6 @@
 std::string string_format(const std::string fmt_str, ...);
 
 std::string va_string_format(const std::string fmt_str, va_list arg_list);
+
+//Removes the quotes of a string literal as stored in StringLit and resolves its escape sequences.
+std::string unquote_string_literal(const std::string& literal);
\ No newline at end of file
@@ -1,8 +1,58 @@
 #include "SymbolScope.h"
 
 #include <iostream>
+#include <stdexcept>
+#include "BaseVisitor.h"
+#include "FrozenSymbolTable.h"
+
+namespace{
+
+	//Mirrors the counting in SecondPass
+	class UseReleaser : public BaseVisitor{
+	public:
+		virtual bool inNode(Ident* n, bool last) override {
+			Symbol const* sym = n->GetSymbol();
+			if (sym != nullptr && sym->GetNameNode() != n)
+				--sym->useCount;
+			return false;
+		}
+
+		virtual bool inNode(StmtAssign* n, bool last) override {
+			if (n->GetLHS()->GetNodeType() != NodeType::Ident)
+				n->GetLHS()->accept(this, false);
+			n->GetExpr()->accept(this, true);
+			return false;
+		}
+	};
+
+	class CallCollector : public BaseVisitor{
+	public:
+		CallCollector(std::set<ASTNode const*>& callees) : m_callees(callees) {}
+
+		virtual bool inNode(Ident* n, bool last) override {
+			Symbol const* sym = n->GetSymbol();
+			if (sym != nullptr && sym->type == Symbol::FUNCTION && sym->GetNameNode() != n)
+				m_callees.insert(sym->GetNode());
+			return false;
+		}
+
+	private:
+		std::set<ASTNode const*>& m_callees;
+	};
+}
+
+void ReleaseSymbolUses(ASTNode* removed){
+	UseReleaser releaser;
+	removed->accept(&releaser, true);
+}
+
+void CollectCallees(ASTNode* n, std::set<ASTNode const*>& callees){
+	CallCollector collector(callees);
+	n->accept(&collector, false);
+}
 
 std::string Symbol::GetQualifiedName() const {
+	AllocationCounter::Scope allocationScope(AllocationCategory::Strings);
 	if (scope)
 		return scope->GetQualifiedScopeName() + "." + name;
 	else
@@ -10,6 +60,7 @@ std::string Symbol::GetQualifiedName() const {
 }
 
 std::string Symbol::GetSignature() const {
+	AllocationCounter::Scope allocationScope(AllocationCategory::Strings);
 	switch (type){
 	case FUNCTION:
 	{
@@ -32,49 +83,58 @@ std::string Symbol::GetSignature() const {
 }
 
 std::string Symbol::GetQualifiedSignature() const {
+	AllocationCounter::Scope allocationScope(AllocationCategory::Strings);
 	if (scope)
 		return scope->GetQualifiedScopeName() + "." + GetSignature();
 	else
 		return GetSignature();
 }
 
-Symbol const* SymbolScope::GetSymbol(std::string name, PreferredSymbol ps) const {
-	auto it = m_symbols.find(name);
+Symbol const* SymbolScope::GetSymbol(const std::string& name, PreferredSymbol ps) const {
+	Symbol const* sym = FindLocalSymbol(name);
 
-	if (it == m_symbols.end())
+	if (sym == nullptr){
 		if (m_parent)	return m_parent->GetSymbol(name, ps);
 		else			return nullptr;
+	}
 
 	//check if symbol is of preferred type
-	if (ps == Function && it->second.type == Symbol::FUNCTION)
-		return &it->second;
+	if (ps == Function && sym->type == Symbol::FUNCTION)
+		return sym;
 	else if (ps == Variable &&
-		(it->second.type == Symbol::VARIABLE ||
-		it->second.type == Symbol::PARAMETER ||
-		it->second.type == Symbol::GLOBAL_VAR ||
-		it->second.type == Symbol::CLASS_VAR ||
-		it->second.type == Symbol::RETURN_VALUE))
-		return &it->second;
+		(sym->type == Symbol::VARIABLE ||
+		sym->type == Symbol::PARAMETER ||
+		sym->type == Symbol::GLOBAL_VAR ||
+		sym->type == Symbol::CLASS_VAR ||
+		sym->type == Symbol::RETURN_VALUE))
+		return sym;
 	else if (ps == Any)
-		return &it->second;
+		return sym;
 
 	auto alternative = m_parent->GetSymbol(name, ps);
 	if (alternative != nullptr)
 		return alternative;
 
-	return &it->second;
+	return sym;
 }
 
 bool SymbolScope::AddSymbol( std::string name, Symbol symbol ){
+	RejectIfFrozen();
+
 	if (GetSymbol(name)) //Return false if re-declared symbol
 		return false;
 	
 	symbol.scope = this;
+
+	AllocationCounter::Scope allocationScope(AllocationCategory::Maps);
 	m_symbols.emplace(name, symbol);
 	return true;
 }
 
-const SymbolScope* SymbolScope::GetSubScope( std::string name ) const {
+const SymbolScope* SymbolScope::GetSubScope( const std::string& name ) const {
+	if (m_frozen)
+		return m_frozen->FindSubScope(m_frozenIndex, name);
+
 	auto it = m_subScopes.find( name );
 
 	if (it == m_subScopes.end())
@@ -83,11 +143,52 @@ const SymbolScope* SymbolScope::GetSubScope( std::string name ) const {
 	return &it->second;
 }
 
-SymbolScope* SymbolScope::GetSubScope(std::string name) {
+SymbolScope* SymbolScope::GetSubScope(const std::string& name) {
+	if (m_frozen)
+		return m_frozen->FindSubScope(m_frozenIndex, name);
+
 	auto it = m_subScopes.find(name);
 
 	if (it == m_subScopes.end())
 		return nullptr;
 
 	return &it->second;
+}
+
+Symbol const* SymbolScope::FindLocalSymbol(const std::string& name) const {
+	if (m_frozen)
+		return m_frozen->FindSymbol(m_frozenIndex, name);
+
+	auto it = m_symbols.find(name);
+
+	if (it == m_symbols.end())
+		return nullptr;
+
+	return &it->second;
+}
+
+void SymbolScope::RejectIfFrozen() const {
+	if (m_frozen)
+		throw std::logic_error("Symbol scope '" + GetQualifiedScopeName() + "' is frozen and can't be changed.");
+}
+
+void SymbolScope::Freeze(){
+	Thaw();
+	m_frozenTable = std::make_shared<FrozenSymbolTable>(*this);
+}
+
+void SymbolScope::Thaw(){
+	if (m_frozenTable == nullptr)
+		return;
+
+	Unfreeze();
+	m_frozenTable.reset();
+}
+
+void SymbolScope::Unfreeze(){
+	m_frozen = nullptr;
+	m_frozenIndex = 0;
+
+	for (auto&& sub : m_subScopes)
+		sub.second.Unfreeze();
 }
\ No newline at end of file
@@ -3,13 +3,17 @@
 
 #include <string>
 #include <map>
+#include <set>
+#include <memory>
 #include "ASTNode.h"
 #include "Optional.h"
 #include "TypeInfo.h"
+#include "OutputBuffer.h"
 
 #include <iostream>
 
 class SymbolScope;
+class FrozenSymbolTable;
 
 class Symbol{
 public:
@@ -31,10 +35,27 @@ public:
 
 	SymbolType type;
 
+	//Number of Idents reading the symbol. Declarations and assignment targets don't count. Counted by SecondPass,
+	//passes removing nodes afterwards call ReleaseSymbolUses() on them.
+	mutable int useCount;
+
 	ASTNode const* GetNode() const {
 		return node;
 	}
 
+	//Ident naming the symbol in its declaration, nullptr for return values
+	Ident const* GetNameNode() const {
+		switch (type){
+		case FUNCTION:		return funcNode->GetName();
+		case VARIABLE:		return varNode->GetName();
+		case GLOBAL_VAR:	return globVarNode->GetName();
+		case CLASS_VAR:		return classVarNode->GetName();
+		case PARAMETER:		return paramNode->GetName();
+		case CLASS:			return classNode->GetName();
+		default:			return nullptr;
+		}
+	}
+
 	TypeInfo const* GetTypeInfo() const {
 		switch (type){
 		case FUNCTION:		return funcNode->GetRetType()->GetTypeInfo();
@@ -101,17 +122,33 @@ private:
 	};
 
 	Symbol(SymbolType t, std::string name, ASTNode const* node)
-		: type(t), name(name), node(node)
+		: type(t), useCount(0), name(name), node(node)
 	{};
 };
 
+//Decrements the use count of every symbol read within a subtree which is removed from the AST.
+void ReleaseSymbolUses(ASTNode* removed);
+
+//Adds the definitions of all functions referenced within a subtree to 'callees'.
+void CollectCallees(ASTNode* n, std::set<ASTNode const*>& callees);
+
 class SymbolScope{
+	friend class FrozenSymbolTable;
+
 	std::string m_scopeName;
 	SymbolScope* m_parent;
 
 	std::map<std::string, SymbolScope> m_subScopes;
 	std::map<std::string, Symbol> m_symbols;
 
+	FrozenSymbolTable const* m_frozen = nullptr;	//Answers the lookups while the scope is frozen
+	size_t m_frozenIndex = 0;
+	std::shared_ptr<FrozenSymbolTable> m_frozenTable;	//Of a frozen root scope
+
+	Symbol const* FindLocalSymbol(const std::string& name) const;
+	void RejectIfFrozen() const;
+	void Unfreeze();
+
 public:
 
 	SymbolScope(SymbolScope const &) = delete;
@@ -125,6 +162,9 @@ public:
 		m_parent = std::move(o.m_parent);
 		m_subScopes = std::move(o.m_subScopes);
 		m_symbols = std::move(o.m_symbols);
+		m_frozen = o.m_frozen;
+		m_frozenIndex = o.m_frozenIndex;
+		m_frozenTable = std::move(o.m_frozenTable);
 
 		return *this;
 	}
@@ -137,12 +177,16 @@ public:
 		: m_scopeName(std::move(o.m_scopeName)),
 		m_parent(std::move(o.m_parent)),
 		m_subScopes(std::move(o.m_subScopes)),
-		m_symbols(std::move(o.m_symbols))
+		m_symbols(std::move(o.m_symbols)),
+		m_frozen(o.m_frozen),
+		m_frozenIndex(o.m_frozenIndex),
+		m_frozenTable(std::move(o.m_frozenTable))
 	{}
 
 	std::string		GetScopeName() const { return m_scopeName; }
 
 	std::string	GetQualifiedScopeName() const {
+		AllocationCounter::Scope scope(AllocationCategory::Strings);
 		SymbolScope const* current = m_parent;
 		std::string fullName = m_scopeName;
 
@@ -160,29 +204,47 @@ public:
 		Any
 	};
 
-	Symbol const*	GetSymbol( std::string name, PreferredSymbol ps = Any ) const;
+	Symbol const*	GetSymbol( const std::string& name, PreferredSymbol ps = Any ) const;
 	bool			AddSymbol( std::string name, Symbol );
 
+	//See FrozenSymbolTable. Changing a frozen scope throws std::logic_error.
+	bool IsFrozen() const { return m_frozen != nullptr; }
+
+	//Freezes the root scope and all scopes nested in it, again if they already are, until Thaw() is called.
+	void Freeze();
+	void Thaw();
+
 	SymbolScope* GetParentScope() const { return m_parent; }
 
-	const SymbolScope* GetSubScope( std::string name ) const;
-	SymbolScope* GetSubScope(std::string name);
+	//Symbols declared directly in this scope and the scopes nested in it, by name.
+	const std::map<std::string, Symbol>& GetSymbols() const { return m_symbols; }
+	const std::map<std::string, SymbolScope>& GetSubScopes() const { return m_subScopes; }
+
+	//For declarations which are replaced. Pointers to the removed symbols and scopes become invalid.
+	void RemoveSymbol(const std::string& name){ RejectIfFrozen(); m_symbols.erase(name); }
+	void RemoveSubScope(const std::string& name){ RejectIfFrozen(); m_subScopes.erase(name); }
+
+	const SymbolScope* GetSubScope( const std::string& name ) const;
+	SymbolScope* GetSubScope(const std::string& name);
 
 	bool AddSubScope(std::string name){
 		if (GetSubScope(name)) //Return if scope already exists
 			return false;
 
+		RejectIfFrozen();
+		AllocationCounter::Scope scope(AllocationCategory::Maps);
 		auto k = m_subScopes.emplace(name, SymbolScope(name, this));
 		return true;
 	}
 
-	void PrintAll() const {
-		//std::cout << "== " << GetQualifiedScopeName() << " ==\n";
-		for (auto&& sym : m_symbols)
-			std::cout << sym.second.GetQualifiedSignature() << "\n";
+	void PrintAll(OutputBuffer& out) const {
+		for (auto&& sym : m_symbols){
+			out.Put(sym.second.GetQualifiedSignature());
+			out.Newline();
+		}
 
 		for (auto&& scope : m_subScopes)
-			scope.second.PrintAll();
+			scope.second.PrintAll(out);
 	}
 
 };
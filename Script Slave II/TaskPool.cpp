@@ -0,0 +1,48 @@
+#include "TaskPool.h"
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+void TaskPool::Run(size_t numTasks, unsigned numThreads, const std::function<void(size_t)>& task){
+	if (numThreads > numTasks)
+		numThreads = (unsigned) numTasks;
+
+	std::atomic<size_t> next(0);
+	std::atomic<bool> failed(false);
+	std::exception_ptr exception;
+	std::mutex exceptionMutex;
+
+	auto work = [&](){
+		for (size_t i = next++; i < numTasks && !failed; i = next++){
+			try{
+				task(i);
+			}
+			catch (...){
+				std::lock_guard<std::mutex> lock(exceptionMutex);
+				if (!exception)
+					exception = std::current_exception();
+				failed = true;
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < numThreads; ++i)
+		threads.emplace_back(work);
+
+	work();
+
+	for (auto&& thread : threads)
+		thread.join();
+
+	if (exception)
+		std::rethrow_exception(exception);
+}
+
+unsigned TaskPool::GetDefaultThreadCount(){
+	unsigned cores = std::thread::hardware_concurrency();
+	return cores > 0 ? cores : 1;
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+//Runs numbered tasks on several threads. Idle threads take the next task nobody started yet, so a few expensive tasks
+//don't hold up the cheap ones behind them.
+class TaskPool{
+public:
+
+	//Calls task(i) for every i < numTasks on at most numThreads threads, including the calling one, and returns when
+	//all of them are done. The first exception thrown by a task is rethrown here, after the other threads stopped.
+	static void Run(size_t numTasks, unsigned numThreads, const std::function<void(size_t)>& task);
+
+	//One thread per core, at least 1.
+	static unsigned GetDefaultThreadCount();
+};
\ No newline at end of file
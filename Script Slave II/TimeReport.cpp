@@ -0,0 +1,286 @@
+#include "TimeReport.h"
+#include "AllocationCounter.h"
+#include "ASTNode.h"
+#include "BaseVisitor.h"
+#include "SymbolScope.h"
+
+#include <chrono>
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#pragma warning (push)
+#pragma warning (disable : 4996 )
+
+namespace{
+
+	double GetWallMs(){
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+	}
+
+	//User and kernel time of the process.
+	double GetCpuMs(){
+#ifdef _WIN32
+		FILETIME creation, exit, kernel, user;
+		if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+			return 0;
+
+		//100 ns units
+		unsigned long long k = ((unsigned long long) kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+		unsigned long long u = ((unsigned long long) user.dwHighDateTime << 32) | user.dwLowDateTime;
+		return (k + u) / 10000.0;
+#else
+		rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0;
+
+		return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+#endif
+	}
+
+	long long GetPeakRssKb(){
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return 0;
+		return (long long) (counters.PeakWorkingSetSize / 1024);
+#else
+		rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0;
+#ifdef __APPLE__
+		return usage.ru_maxrss / 1024;	//Bytes
+#else
+		return usage.ru_maxrss;
+#endif
+#endif
+	}
+
+	class NodeCounter : public BaseVisitor{
+	public:
+		virtual bool inNode(ASTNode* n, bool last) override {
+			++m_count;
+			return true;
+		}
+
+		unsigned long long GetCount() const {
+			return m_count;
+		}
+
+	private:
+		unsigned long long m_count = 0;
+	};
+
+	void PutJsonString(const std::string& str, OutputBuffer& out){
+		out.Put('"');
+		for (char c : str){
+			if (c == '"' || c == '\\'){
+				out.Put('\\');
+				out.Put(c);
+			}
+			else if ((unsigned char) c < 0x20){
+				char buf[8];
+				sprintf(buf, "\\u%04x", (unsigned char) c);
+				out.Put(buf);
+			}
+			else
+				out.Put(c);
+		}
+		out.Put('"');
+	}
+
+	void PutMs(double ms, OutputBuffer& out){
+		char buf[32];
+		out.Put(buf, sprintf(buf, "%.3f", ms));
+	}
+}
+
+TimeReport::Timer::Timer(TimeReport* report, const char* name)
+	: m_report(report), m_name(name)
+{
+	if (m_report == nullptr)
+		return;
+
+	m_peakRssKb = GetPeakRssKb();
+	m_allocations = AllocationCounter::GetNumAllocations();
+	m_allocatedBytes = AllocationCounter::GetAllocatedBytes();
+	for (int i = 0; i < (int) AllocationCategory::Count; ++i)
+		m_categoryAllocations[i] = AllocationCounter::GetNumAllocations((AllocationCategory) i);
+	m_cpuMs = GetCpuMs();
+	m_wallMs = GetWallMs();
+}
+
+TimeReport::Timer::~Timer(){
+	if (m_report == nullptr)
+		return;
+
+	Phase phase;
+	phase.wallMs = GetWallMs() - m_wallMs;
+	phase.cpuMs = GetCpuMs() - m_cpuMs;
+	phase.allocations = AllocationCounter::GetNumAllocations() - m_allocations;
+	phase.allocatedBytes = AllocationCounter::GetAllocatedBytes() - m_allocatedBytes;
+	for (int i = 0; i < (int) AllocationCategory::Count; ++i)
+		phase.categoryAllocations[i] = AllocationCounter::GetNumAllocations((AllocationCategory) i) - m_categoryAllocations[i];
+	phase.peakRssDeltaKb = GetPeakRssKb() - m_peakRssKb;
+	phase.name = m_name;
+
+	m_report->Add(phase);
+}
+
+void TimeReport::Add(const Phase& phase){
+	for (auto& p : m_phases){
+		if (p.name == phase.name){
+			p.wallMs += phase.wallMs;
+			p.cpuMs += phase.cpuMs;
+			p.peakRssDeltaKb += phase.peakRssDeltaKb;
+			p.allocations += phase.allocations;
+			p.allocatedBytes += phase.allocatedBytes;
+			for (int i = 0; i < (int) AllocationCategory::Count; ++i)
+				p.categoryAllocations[i] += phase.categoryAllocations[i];
+			return;
+		}
+	}
+
+	m_phases.push_back(phase);
+}
+
+void TimeReport::SetCount(const std::string& name, unsigned long long value){
+	for (auto& count : m_counts){
+		if (count.first == name){
+			count.second = value;
+			return;
+		}
+	}
+
+	m_counts.push_back(std::make_pair(name, value));
+}
+
+void TimeReport::WriteTable(OutputBuffer& out) const {
+	const size_t columns[] = { 28, 40, 52, 66, 80 };
+
+	out.PutLit("Phase");
+	out.PadTo(columns[0]);
+	out.PutLit("Wall ms");
+	out.PadTo(columns[1]);
+	out.PutLit("CPU ms");
+	out.PadTo(columns[2]);
+	out.PutLit("Peak RSS +KB");
+	out.PadTo(columns[3]);
+	out.PutLit("Allocations");
+	out.PadTo(columns[4]);
+	out.PutLit("Bytes");
+	out.Newline();
+
+	for (const auto& phase : m_phases){
+		out.Put(phase.name);
+		out.PadTo(columns[0]);
+		PutMs(phase.wallMs, out);
+		out.PadTo(columns[1]);
+		PutMs(phase.cpuMs, out);
+		out.PadTo(columns[2]);
+		out.PutInt(phase.peakRssDeltaKb);
+		out.PadTo(columns[3]);
+		out.PutInt((long long) phase.allocations);
+		out.PadTo(columns[4]);
+		out.PutInt((long long) phase.allocatedBytes);
+		out.Newline();
+	}
+
+	//Allocations of each phase by the call site they were made from
+	out.Newline();
+	if (AllocationCounter::IsEnabled()){
+		out.PutLit("Allocations by category");
+		for (int i = 0; i < (int) AllocationCategory::Count; ++i){
+			out.PadTo(columns[0] + i * 12);
+			out.Put(AllocationCounter::GetCategoryName((AllocationCategory) i));
+		}
+		out.Newline();
+
+		for (const auto& phase : m_phases){
+			out.Put(phase.name);
+			for (int i = 0; i < (int) AllocationCategory::Count; ++i){
+				out.PadTo(columns[0] + i * 12);
+				out.PutInt((long long) phase.categoryAllocations[i]);
+			}
+			out.Newline();
+		}
+	}
+	else
+		out.PutLit("Allocations are only counted in builds with TRACK_ALLOCATIONS defined, e.g. with /p:TrackAllocations=true.\n");
+	out.Newline();
+
+	for (const auto& count : m_counts){
+		out.Put(count.first);
+		out.PutLit(": ");
+		out.PutInt((long long) count.second);
+		out.Newline();
+	}
+}
+
+void TimeReport::WriteJson(const std::string& fileName, OutputBuffer& out) const {
+	out.PutLit("{\n\t\"file\": ");
+	PutJsonString(fileName, out);
+	out.Put(AllocationCounter::IsEnabled() ? ",\n\t\"allocationsCounted\": true" : ",\n\t\"allocationsCounted\": false");
+	out.PutLit(",\n\t\"phases\": [");
+
+	for (size_t i = 0; i < m_phases.size(); ++i){
+		const Phase& phase = m_phases[i];
+
+		out.Put(i == 0 ? "\n\t\t{ \"name\": " : ",\n\t\t{ \"name\": ");
+		PutJsonString(phase.name, out);
+		out.PutLit(", \"wallMs\": ");
+		PutMs(phase.wallMs, out);
+		out.PutLit(", \"cpuMs\": ");
+		PutMs(phase.cpuMs, out);
+		out.PutLit(", \"peakRssDeltaKb\": ");
+		out.PutInt(phase.peakRssDeltaKb);
+		out.PutLit(", \"allocations\": ");
+		out.PutInt((long long) phase.allocations);
+		out.PutLit(", \"allocatedBytes\": ");
+		out.PutInt((long long) phase.allocatedBytes);
+		out.PutLit(", \"categories\": {");
+		for (int c = 0; c < (int) AllocationCategory::Count; ++c){
+			out.Put(c == 0 ? " \"" : ", \"");
+			out.Put(AllocationCounter::GetCategoryName((AllocationCategory) c));
+			out.PutLit("\": ");
+			out.PutInt((long long) phase.categoryAllocations[c]);
+		}
+		out.PutLit(" } }");
+	}
+
+	out.PutLit("\n\t],\n\t\"counts\": {");
+
+	for (size_t i = 0; i < m_counts.size(); ++i){
+		out.Put(i == 0 ? "\n\t\t" : ",\n\t\t");
+		PutJsonString(m_counts[i].first, out);
+		out.PutLit(": ");
+		out.PutInt((long long) m_counts[i].second);
+	}
+
+	out.PutLit("\n\t}\n}\n");
+}
+
+unsigned long long TimeReport::CountNodes(ASTNode* root){
+	if (root == nullptr)
+		return 0;
+
+	NodeCounter counter;
+	root->accept(&counter, false);
+	return counter.GetCount();
+}
+
+unsigned long long TimeReport::CountSymbols(const SymbolScope& scope){
+	unsigned long long count = scope.GetSymbols().size();
+	for (const auto& sub : scope.GetSubScopes())
+		count += CountSymbols(sub.second);
+	return count;
+}
+
+#pragma warning (pop)
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "OutputBuffer.h"
+#include "AllocationCounter.h"
+
+class ASTNode;
+class SymbolScope;
+
+//Time and memory used by each phase of a compile, for -time-report.
+class TimeReport{
+public:
+
+	struct Phase{
+		std::string name;
+		double wallMs;
+		double cpuMs;
+		long long peakRssDeltaKb;		//Growth of the peak resident set size
+		unsigned long long allocations;
+		unsigned long long allocatedBytes;
+		unsigned long long categoryAllocations[(int) AllocationCategory::Count];
+	};
+
+	//Measures a phase from its construction to its destruction. Does nothing if the report is nullptr, so phases
+	//can always be wrapped in a timer.
+	class Timer{
+	public:
+		Timer(TimeReport* report, const char* name);
+		~Timer();
+
+	private:
+		Timer(const Timer&);
+		Timer& operator=(const Timer&);
+
+		TimeReport* m_report;
+		const char* m_name;
+		double m_wallMs;
+		double m_cpuMs;
+		long long m_peakRssKb;
+		unsigned long long m_allocations;
+		unsigned long long m_allocatedBytes;
+		unsigned long long m_categoryAllocations[(int) AllocationCategory::Count];
+	};
+
+	//Phases measured more than once, e.g. printing, are added up.
+	void Add(const Phase& phase);
+
+	//Sizes of the compiled program, e.g. the number of tokens.
+	void SetCount(const std::string& name, unsigned long long value);
+
+	const std::vector<Phase>& GetPhases() const {
+		return m_phases;
+	}
+
+	void WriteTable(OutputBuffer& out) const;
+	void WriteJson(const std::string& fileName, OutputBuffer& out) const;
+
+	static unsigned long long CountNodes(ASTNode* root);
+	static unsigned long long CountSymbols(const SymbolScope& scope);
+
+private:
+	std::vector<Phase> m_phases;
+	std::vector<std::pair<std::string, unsigned long long>> m_counts;
+};
\ No newline at end of file
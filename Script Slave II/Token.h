@@ -123,6 +123,7 @@ default: return "TokenError"; //Should never happen
 	{}
 
 	Token()
+		: type( TokenType::Eof )
 	{}
 
 private:
@@ -9,18 +9,23 @@
 
 class TokenStack{
 public:
+	//Previous token, erroneous token, production rule
+	typedef std::tuple<const Token*, const Token*, std::string> ErrorInfo;
+
 	TokenStack( const std::vector<Token>& tokens )
 		: m_tokens( tokens ),
 		m_currIndex( 0 ),
 		m_highestIndex( 0 )
 	{}
 
+	//Errors recorded after the index was pushed are dropped with it, they belong to an alternative which wasn't taken.
 	void PushIndex(){
-		m_indices.push( m_currIndex );
+		m_indices.push( std::make_pair( m_currIndex, m_errors.size() ) );
 	}
 
 	void PopIndex(){
-		m_currIndex = m_indices.top();
+		m_currIndex = m_indices.top().first;
+		m_errors.resize( m_indices.top().second );
 		m_indices.pop();
 	}
 
@@ -40,6 +45,12 @@ public:
 		return m_tokens[m_currIndex];
 	}
 
+	//Moves past the current token without tracking it as the furthest one, used to skip erroneous input.
+	void Skip(){
+		if( m_tokens[m_currIndex].type != TokenType::Eof )
+			++m_currIndex;
+	}
+
 	const Token& GetFurthestToken(){
 		return m_tokens[m_highestIndex];
 	}
@@ -51,13 +62,29 @@ public:
 		m_highestProductionName = name;
 	}
 
-	std::tuple<const Token*,const Token*, std::string> GetErrorInfo(){
+	ErrorInfo GetErrorInfo(){
 		if( m_highestIndex > 0 )
 			return std::make_tuple( &m_tokens[m_highestIndex - 1], &m_tokens[m_highestIndex], m_highestProductionName );
 		else
 			return std::make_tuple( nullptr, &m_tokens[m_highestIndex], m_highestProductionName );
 	}
 
+	//Starts looking for the furthest token again from the current one, so that the error of the next failed
+	//production can be told apart from earlier ones.
+	void ResetFurthest( std::string prodName ){
+		m_highestIndex = m_currIndex;
+		m_highestProductionName = prodName;
+	}
+
+	//Keeps the error of the furthest token, parsing continues after recovering from it.
+	void AddError(){
+		m_errors.push_back( GetErrorInfo() );
+	}
+
+	const std::vector<ErrorInfo>& GetErrors() const {
+		return m_errors;
+	}
+
 	bool IsEmpty(){
 		return m_currIndex == m_tokens.size() - 1;
 	}
@@ -66,7 +93,8 @@ private:
 	int m_highestIndex;
 	std::string m_highestProductionName;
 	int m_currIndex;
-	std::stack<int> m_indices;
+	std::stack<std::pair<int, size_t>> m_indices;
+	std::vector<ErrorInfo> m_errors;
 	const std::vector<Token>& m_tokens;
 };
 
@@ -2,14 +2,18 @@
 
 #include "ASTNode.h"
 
-#include <iostream>
 #include "SymbolScope.h"
 
 bool TreePrinter::inNode(Expr* n, bool last){
 
 	std::string ti = n->GetTypeInfo() ? n->GetTypeInfo()->name : "<none>";
 
-	std::cout << indent << "+-" << n->GetNodeAsString() << " : " << ti << "\n";
+	m_out.Put(indent);
+	m_out.PutLit("+-");
+	m_out.Put(n->GetNodeAsString());
+	m_out.PutLit(" : ");
+	m_out.Put(ti);
+	m_out.Newline();
 	if (last)
 		indent += "  ";
 	else
@@ -20,7 +24,10 @@ bool TreePrinter::inNode(Expr* n, bool last){
 
 bool TreePrinter::inNode( ASTNode* n, bool last ){
 
-	std::cout << indent << "+-" << n->GetNodeAsString() << "\n";
+	m_out.Put( indent );
+	m_out.PutLit( "+-" );
+	m_out.Put( n->GetNodeAsString() );
+	m_out.Newline();
 	if( last )
 		indent += "  ";
 	else
@@ -2,11 +2,15 @@
 #define TREEPRINTER_H
 
 #include "BaseVisitor.h"
+#include "OutputBuffer.h"
 #include <string>
 
 class TreePrinter : public BaseVisitor
 {
 public:
+	explicit TreePrinter( OutputBuffer& out )
+		: m_out( out )
+	{}
 
 	bool inNode(Expr* n, bool last);
 
@@ -16,6 +20,7 @@ public:
 	//bool inNode(Ident* n, bool last);
 
 private:
+	OutputBuffer& m_out;
 	std::string indent;
 };
 
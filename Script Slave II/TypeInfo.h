@@ -1,12 +1,31 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 class TypeInfo{
 public:
+
+	//Field of a class object, see ClassLayout.
+	struct Field{
+		std::string name;
+		TypeInfo const* type;
+		size_t offset;
+		size_t size;
+	};
+
 	std::string name;
 	bool isArray;
-	size_t size;
+	size_t size;					//Of the objects for classes, variables of a class type hold a reference
+	bool isClass = false;
+	std::vector<Field> fields;		//Of classes, ordered by offset
+
+	Field const* GetField(const std::string& fieldName) const {
+		for (const auto& field : fields)
+			if (field.name == fieldName)
+				return &field;
+		return nullptr;
+	}
 
 	std::string GetSimpleTypeName() const { //TODO: I'd rather have a direct link to the simple type
 		if (isArray) 
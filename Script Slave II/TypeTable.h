@@ -3,12 +3,14 @@
 #include <string>
 #include <map>
 #include "TypeInfo.h"
+#include "AllocationCounter.h"
 
 class TypeTable{
 	std::map<std::string, TypeInfo> types;
 
 public:
 	void Add(TypeInfo ti){
+		AllocationCounter::Scope scope(AllocationCategory::Maps);
 		types.emplace(std::make_pair(ti.name, ti));
 	}
 
@@ -19,4 +21,31 @@ public:
 		else
 			return &it->second;
 	}
-};
\ No newline at end of file
+
+	//For ClassLayout, which fills in the classes after adding them.
+	TypeInfo* Get(const std::string& typeName){
+		auto it = types.find(typeName);
+		if (it == types.end())
+			return nullptr;
+		else
+			return &it->second;
+	}
+};
+
+//The built-in types and their arrays, every compile starts with them.
+inline TypeTable CreateNativeTypes(){
+	TypeTable tt;
+
+	tt.Add(TypeInfo{ "void", 0, false });
+	tt.Add(TypeInfo{ "int", 4, false });
+	tt.Add(TypeInfo{ "float", 4, false });
+	tt.Add(TypeInfo{ "bool", 1, false });
+	tt.Add(TypeInfo{ "string", 4, false });
+
+	tt.Add(TypeInfo{ "int", 4, true });
+	tt.Add(TypeInfo{ "float", 4, true });
+	tt.Add(TypeInfo{ "bool", 1, true });
+	tt.Add(TypeInfo{ "string", 4, true });
+
+	return tt;
+}
\ No newline at end of file
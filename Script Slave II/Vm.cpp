@@ -0,0 +1,614 @@
+#include "Vm.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+#pragma warning (push)
+#pragma warning (disable : 4996 )
+
+//GCC and Clang support labels as values, which allows to jump directly to the next instruction's handler instead of
+//going through a switch. Other compilers use the switch.
+#if defined(__GNUC__) || defined(__clang__)
+#define VM_COMPUTED_GOTO
+#endif
+
+static std::string FloatToString(float value){
+	char buf[32];
+	sprintf(buf, "%.7g", value);
+
+	std::string str = buf;
+	if (str.find_first_of(".eEni") == std::string::npos)
+		str += ".0";
+	return str;
+}
+
+static_assert(sizeof(VmArray) % sizeof(void*) == 0, "The elements of a VmArray must be aligned for pointers");
+
+VmArray* VmArray::Create(VmType elemType, int length){
+	const size_t dataSize = (size_t) length * GetElemSize(elemType);
+
+	VmArray* arr = new (::operator new(sizeof(VmArray) + dataSize)) VmArray(elemType, length);
+	memset(arr->GetData<unsigned char>(), 0, dataSize);
+	return arr;
+}
+
+size_t VmArray::GetElemSize(VmType elemType){
+	switch (elemType){
+	case VmType::Int:		return sizeof(int);
+	case VmType::Float:		return sizeof(float);
+	case VmType::Bool:		return sizeof(unsigned char);
+	default:				return sizeof(VmObject*);
+	}
+}
+
+static_assert(sizeof(VmInstance) % sizeof(void*) == 0, "The fields of a VmInstance must be aligned for pointers");
+
+VmInstance* VmInstance::Create(const VmClass* cls){
+	VmInstance* instance = new (::operator new(sizeof(VmInstance) + cls->size)) VmInstance(cls);
+	memset(instance + 1, 0, cls->size);
+	return instance;
+}
+
+Vm::Vm(const VmProgram& program, size_t stackSize, size_t maxCallDepth)
+	: m_program(program), m_stack(stackSize), m_maxCallDepth(maxCallDepth), m_gcThreshold(1024)
+{
+	m_frames.reserve(maxCallDepth);
+
+	for (VmType type : program.globals)
+		m_globals.push_back(type == VmType::String ? VmValue::Object(program.strings[0].get()) : VmValue::Int(0));
+}
+
+VmString* Vm::NewString(std::string value){
+	VmString* str = new VmString(std::move(value));
+	m_heap.emplace_back(str);
+	return str;
+}
+
+VmArray* Vm::NewArray(VmType elemType, size_t length){
+	VmArray* arr = VmArray::Create(elemType, (int) length);
+	if (elemType == VmType::String)
+		std::fill_n(arr->GetData<VmObject*>(), arr->length, (VmObject*) m_program.strings[0].get());
+
+	m_heap.emplace_back(arr);
+	return arr;
+}
+
+VmInstance* Vm::NewInstance(int classIndex){
+	const VmClass& cls = m_program.classes[classIndex];
+	VmInstance* instance = VmInstance::Create(&cls);
+
+	for (const auto& field : cls.fields)
+		if (field.type == VmType::String)
+			instance->GetField<VmObject*>(field.offset) = m_program.strings[0].get();
+
+	m_heap.emplace_back(instance);
+	return instance;
+}
+
+//Objects are pushed on m_markStack instead of being marked recursively, long lists of instances would overflow the
+//native stack.
+void Vm::Mark(VmObject* obj){
+	if (obj == nullptr || obj->marked)
+		return;
+
+	obj->marked = true;
+	m_markStack.push_back(obj);
+
+	while (!m_markStack.empty()){
+		VmObject* next = m_markStack.back();
+		m_markStack.pop_back();
+
+		if (next->kind == VmObject::ARRAY){
+			VmArray* arr = (VmArray*) next;
+			if (arr->HasReferences()){
+				VmObject** elems = arr->GetData<VmObject*>();
+				for (int i = 0; i < arr->length; ++i){
+					if (elems[i] != nullptr && !elems[i]->marked){
+						elems[i]->marked = true;
+						m_markStack.push_back(elems[i]);
+					}
+				}
+			}
+		}
+		else if (next->kind == VmObject::INSTANCE){
+			VmInstance* instance = (VmInstance*) next;
+			for (int offset : instance->cls->references){
+				VmObject* field = instance->GetField<VmObject*>(offset);
+				if (field != nullptr && !field->marked){
+					field->marked = true;
+					m_markStack.push_back(field);
+				}
+			}
+		}
+	}
+}
+
+void Vm::CollectGarbage(const std::vector<VmObject*>& roots){
+	for (size_t i = 0; i < m_globals.size(); ++i)
+		if (IsReference(m_program.globals[i]))
+			Mark(m_globals[i].obj);
+
+	for (VmObject* obj : roots)
+		Mark(obj);
+
+	m_heap.erase(std::remove_if(m_heap.begin(), m_heap.end(), [](const std::unique_ptr<VmObject>& obj){
+		return !obj->marked;
+	}), m_heap.end());
+
+	for (const auto& obj : m_heap)
+		obj->marked = false;
+
+	//Constants may have been marked as well
+	for (const auto& str : m_program.strings)
+		str->marked = false;
+}
+
+bool Vm::Call(int index, const std::vector<VmValue>& args, VmValue& result){
+	m_error.clear();
+
+	if (index < 0 || index >= (int) m_program.functions.size()){
+		m_error = "Unknown function.";
+		return false;
+	}
+
+	const VmFunction& function = m_program.functions[index];
+
+	if ((int) args.size() != function.numParams){
+		m_error = "Function '" + function.name + "' expects " + std::to_string(function.numParams) + " arguments.";
+		return false;
+	}
+
+	//Nothing on the heap is referenced by the stack between calls, only the arguments have to be kept.
+	if (m_heap.size() >= m_gcThreshold){
+		std::vector<VmObject*> roots;
+		for (size_t i = 0; i < args.size(); ++i)
+			if (IsReference(function.paramTypes[i]))
+				roots.push_back(args[i].obj);
+
+		CollectGarbage(roots);
+		m_gcThreshold = std::max<size_t>(1024, m_heap.size() * 2);
+	}
+
+	if ((size_t) (function.numLocals + function.maxStack) > m_stack.size()){
+		m_error = "Stack overflow in function '" + function.name + "'.";
+		return false;
+	}
+
+	std::copy(args.begin(), args.end(), m_stack.begin());
+	std::fill(m_stack.begin() + function.numParams, m_stack.begin() + function.numLocals, VmValue::Object(nullptr));
+
+	m_frames.clear();
+	m_frames.push_back(Frame{ nullptr, m_stack.data(), &function });
+
+	return Run(function, result);
+}
+
+bool Vm::CollectInCall(const int* pc){
+	//The current frame is at the instruction before pc, its callers at the Call instructions they return behind.
+	//Without a stack map the references on the operand stack are unknown, nothing is freed then.
+	const int* instruction = pc - 1;
+
+	for (size_t i = m_frames.size(); i-- > 0;){
+		const Frame& frame = m_frames[i];
+		const VmFunction& function = *frame.function;
+
+		for (int slot = 0; slot < function.numLocals; ++slot)
+			if (IsReference(function.localTypes[slot]))
+				Mark(frame.base[slot].obj);
+
+		auto stackMap = m_program.stackMaps.find((int) (instruction - m_program.code.data()));
+		if (stackMap == m_program.stackMaps.end())
+			return false;
+
+		const std::vector<VmType>& operands = stackMap->second;
+		VmValue* stack = frame.base + function.numLocals;
+		for (size_t slot = 0; slot < operands.size(); ++slot)
+			if (IsReference(operands[slot]))
+				Mark(stack[slot].obj);
+
+		if (frame.returnPc != nullptr)
+			instruction = frame.returnPc - 2;
+	}
+
+	CollectGarbage();
+	m_gcThreshold = std::max<size_t>(1024, m_heap.size() * 2);
+	return true;
+}
+
+bool Vm::Run(const VmFunction& entry, VmValue& result){
+	const int* const code = m_program.code.data();
+	const VmFunction* const functions = m_program.functions.data();
+	VmValue* const stackEnd = m_stack.data() + m_stack.size();
+	VmValue* globals = m_globals.data();
+
+	const int* pc = code + entry.codeOffset;
+	VmValue* base = m_stack.data();
+	VmValue* sp = base + entry.numLocals;
+	const char* error = nullptr;
+
+#ifdef VM_COMPUTED_GOTO
+#define VM_LABEL(name, operands, stackDelta) &&op_ ## name,
+	static void* const dispatchTable[] = {
+		VM_OPS(VM_LABEL)
+	};
+#undef VM_LABEL
+
+#define TARGET(name) op_ ## name:
+#define NEXT() goto *dispatchTable[*pc++]
+
+	NEXT();
+#else
+#define TARGET(name) case VmOp::name:
+#define NEXT() continue
+
+	for (;;) switch ((VmOp) *pc++){
+#endif
+
+	//CONSTANTS AND VARIABLES
+	TARGET(PushInt){
+		(sp++)->i = *pc++;
+		NEXT();
+	}
+	TARGET(PushFloat){
+		memcpy(&(sp++)->f, pc++, sizeof(float));
+		NEXT();
+	}
+	TARGET(PushString){
+		(sp++)->obj = m_program.strings[*pc++].get();
+		NEXT();
+	}
+	TARGET(PushNull){
+		(sp++)->obj = nullptr;
+		NEXT();
+	}
+	TARGET(Load){
+		*sp++ = base[*pc++];
+		NEXT();
+	}
+	TARGET(Store){
+		base[*pc++] = *--sp;
+		NEXT();
+	}
+	TARGET(LoadGlobal){
+		*sp++ = globals[*pc++];
+		NEXT();
+	}
+	TARGET(StoreGlobal){
+		globals[*pc++] = *--sp;
+		NEXT();
+	}
+
+	//ARITHMETIC, integers wrap around like on the JVM
+	TARGET(IAdd){
+		--sp;
+		sp[-1].i = (int) ((unsigned int) sp[-1].i + (unsigned int) sp[0].i);
+		NEXT();
+	}
+	TARGET(ISub){
+		--sp;
+		sp[-1].i = (int) ((unsigned int) sp[-1].i - (unsigned int) sp[0].i);
+		NEXT();
+	}
+	TARGET(IMul){
+		--sp;
+		sp[-1].i = (int) ((unsigned int) sp[-1].i * (unsigned int) sp[0].i);
+		NEXT();
+	}
+	TARGET(IDiv){
+		--sp;
+		if (sp[0].i == 0){
+			error = "Division by zero";
+			goto runtime_error;
+		}
+		sp[-1].i = sp[0].i == -1 ? (int) (0u - (unsigned int) sp[-1].i) : sp[-1].i / sp[0].i;
+		NEXT();
+	}
+	TARGET(IMod){
+		--sp;
+		if (sp[0].i == 0){
+			error = "Division by zero";
+			goto runtime_error;
+		}
+		sp[-1].i = sp[0].i == -1 ? 0 : sp[-1].i % sp[0].i;
+		NEXT();
+	}
+	TARGET(INeg){
+		sp[-1].i = (int) (0u - (unsigned int) sp[-1].i);
+		NEXT();
+	}
+	TARGET(FAdd){
+		--sp;
+		sp[-1].f += sp[0].f;
+		NEXT();
+	}
+	TARGET(FSub){
+		--sp;
+		sp[-1].f -= sp[0].f;
+		NEXT();
+	}
+	TARGET(FMul){
+		--sp;
+		sp[-1].f *= sp[0].f;
+		NEXT();
+	}
+	TARGET(FDiv){
+		--sp;
+		sp[-1].f /= sp[0].f;
+		NEXT();
+	}
+	TARGET(FNeg){
+		sp[-1].f = -sp[-1].f;
+		NEXT();
+	}
+	TARGET(Not){
+		sp[-1].i ^= 1;
+		NEXT();
+	}
+	TARGET(And){
+		--sp;
+		sp[-1].i &= sp[0].i;
+		NEXT();
+	}
+	TARGET(Or){
+		--sp;
+		sp[-1].i |= sp[0].i;
+		NEXT();
+	}
+	TARGET(Xor){
+		--sp;
+		sp[-1].i ^= sp[0].i;
+		NEXT();
+	}
+
+	//COMPARISONS
+#define COMPARE(name, field, op)						\
+	TARGET(name){										\
+		--sp;											\
+		sp[-1].i = sp[-1].field op sp[0].field ? 1 : 0;	\
+		NEXT();											\
+	}
+
+	COMPARE(ICmpEq, i, == )
+	COMPARE(ICmpNe, i, != )
+	COMPARE(ICmpLt, i, < )
+	COMPARE(ICmpLe, i, <= )
+	COMPARE(ICmpGt, i, > )
+	COMPARE(ICmpGe, i, >= )
+	COMPARE(FCmpEq, f, == )
+	COMPARE(FCmpNe, f, != )
+	COMPARE(FCmpLt, f, < )
+	COMPARE(FCmpLe, f, <= )
+	COMPARE(FCmpGt, f, > )
+	COMPARE(FCmpGe, f, >= )
+	COMPARE(RefEq, obj, == )
+	COMPARE(RefNe, obj, != )
+
+#undef COMPARE
+
+	TARGET(SCmpEq){
+		--sp;
+		sp[-1].i = ((VmString*) sp[-1].obj)->value == ((VmString*) sp[0].obj)->value ? 1 : 0;
+		NEXT();
+	}
+	TARGET(SCmpNe){
+		--sp;
+		sp[-1].i = ((VmString*) sp[-1].obj)->value != ((VmString*) sp[0].obj)->value ? 1 : 0;
+		NEXT();
+	}
+
+	//STRINGS, the heap is collected before the operands are taken off the stack
+#define COLLECT_IF_NEEDED()										\
+		if (m_heap.size() >= m_gcThreshold && !CollectInCall(pc)){	\
+			error = "Missing stack map";							\
+			goto runtime_error;										\
+		}
+
+	TARGET(IntToStr){
+		COLLECT_IF_NEEDED()
+		sp[-1].obj = NewString(std::to_string(sp[-1].i));
+		NEXT();
+	}
+	TARGET(FloatToStr){
+		COLLECT_IF_NEEDED()
+		sp[-1].obj = NewString(FloatToString(sp[-1].f));
+		NEXT();
+	}
+	TARGET(BoolToStr){
+		COLLECT_IF_NEEDED()
+		sp[-1].obj = NewString(sp[-1].i ? "true" : "false");
+		NEXT();
+	}
+	TARGET(Concat){
+		COLLECT_IF_NEEDED()
+		--sp;
+		sp[-1].obj = NewString(((VmString*) sp[-1].obj)->value + ((VmString*) sp[0].obj)->value);
+		NEXT();
+	}
+
+#undef COLLECT_IF_NEEDED
+
+	//ARRAYS, floats are copied as the bits of their int field
+	TARGET(ArrayLength){
+		VmArray* arr = (VmArray*) sp[-1].obj;
+		if (arr == nullptr){
+			error = "Null array access";
+			goto runtime_error;
+		}
+		sp[-1].i = arr->length;
+		NEXT();
+	}
+
+#define ARRAY_CHECK(arr, index)									\
+		if (arr == nullptr){									\
+			error = "Null array access";						\
+			goto runtime_error;									\
+		}														\
+		if ((unsigned int) (index) >= (unsigned int) arr->length){	\
+			error = "Array index out of bounds";				\
+			goto runtime_error;									\
+		}
+
+#define ARRAY_NO_CHECK(arr, index)
+
+#define ARRAY_LOAD(name, check, elemType, field)				\
+	TARGET(name){												\
+		--sp;													\
+		VmArray* arr = (VmArray*) sp[-1].obj;					\
+		check(arr, sp[0].i)										\
+		sp[-1].field = arr->GetData<elemType>()[sp[0].i];		\
+		NEXT();													\
+	}
+
+#define ARRAY_STORE(name, check, elemType, field)				\
+	TARGET(name){												\
+		sp -= 3;												\
+		VmArray* arr = (VmArray*) sp[0].obj;					\
+		check(arr, sp[1].i)										\
+		arr->GetData<elemType>()[sp[1].i] = (elemType) sp[2].field;	\
+		NEXT();													\
+	}
+
+	ARRAY_LOAD(ArrayLoad32, ARRAY_CHECK, int, i)
+	ARRAY_LOAD(ArrayLoad8, ARRAY_CHECK, unsigned char, i)
+	ARRAY_LOAD(ArrayLoadRef, ARRAY_CHECK, VmObject*, obj)
+	ARRAY_STORE(ArrayStore32, ARRAY_CHECK, int, i)
+	ARRAY_STORE(ArrayStore8, ARRAY_CHECK, unsigned char, i)
+	ARRAY_STORE(ArrayStoreRef, ARRAY_CHECK, VmObject*, obj)
+	ARRAY_LOAD(ArrayLoad32Unchecked, ARRAY_NO_CHECK, int, i)
+	ARRAY_LOAD(ArrayLoad8Unchecked, ARRAY_NO_CHECK, unsigned char, i)
+	ARRAY_LOAD(ArrayLoadRefUnchecked, ARRAY_NO_CHECK, VmObject*, obj)
+	ARRAY_STORE(ArrayStore32Unchecked, ARRAY_NO_CHECK, int, i)
+	ARRAY_STORE(ArrayStore8Unchecked, ARRAY_NO_CHECK, unsigned char, i)
+	ARRAY_STORE(ArrayStoreRefUnchecked, ARRAY_NO_CHECK, VmObject*, obj)
+
+#undef ARRAY_STORE
+#undef ARRAY_LOAD
+#undef ARRAY_NO_CHECK
+#undef ARRAY_CHECK
+
+	//FIELDS, the operand is the offset. Floats are copied as the bits of their int field like array elements.
+#define INSTANCE_CHECK(instance)								\
+		if (instance == nullptr){								\
+			error = "Null object access";						\
+			goto runtime_error;									\
+		}
+
+#define LOAD_FIELD(name, fieldType, field)						\
+	TARGET(name){												\
+		VmInstance* instance = (VmInstance*) sp[-1].obj;		\
+		INSTANCE_CHECK(instance)								\
+		sp[-1].field = instance->GetField<fieldType>(*pc++);	\
+		NEXT();													\
+	}
+
+#define STORE_FIELD(name, fieldType, field)						\
+	TARGET(name){												\
+		sp -= 2;												\
+		VmInstance* instance = (VmInstance*) sp[0].obj;			\
+		INSTANCE_CHECK(instance)								\
+		instance->GetField<fieldType>(*pc++) = (fieldType) sp[1].field;	\
+		NEXT();													\
+	}
+
+	LOAD_FIELD(LoadField32, int, i)
+	LOAD_FIELD(LoadField8, unsigned char, i)
+	LOAD_FIELD(LoadFieldRef, VmObject*, obj)
+	STORE_FIELD(StoreField32, int, i)
+	STORE_FIELD(StoreField8, unsigned char, i)
+	STORE_FIELD(StoreFieldRef, VmObject*, obj)
+
+#undef STORE_FIELD
+#undef LOAD_FIELD
+#undef INSTANCE_CHECK
+
+	//CONTROL FLOW, jump operands are absolute code offsets
+	TARGET(Jump){
+		pc = code + *pc;
+		NEXT();
+	}
+	TARGET(JumpIfFalse){
+		if ((--sp)->i == 0)
+			pc = code + *pc;
+		else
+			++pc;
+		NEXT();
+	}
+	TARGET(JumpIfTrue){
+		if ((--sp)->i != 0)
+			pc = code + *pc;
+		else
+			++pc;
+		NEXT();
+	}
+	TARGET(Call){
+		//The arguments are already in place, they become the first locals of the callee.
+		const VmFunction& callee = functions[*pc++];
+		VmValue* calleeBase = sp - callee.numParams;
+
+		if (m_frames.size() >= m_maxCallDepth || calleeBase + callee.numLocals + callee.maxStack > stackEnd){
+			error = "Stack overflow";
+			goto runtime_error;
+		}
+
+		m_frames.push_back(Frame{ pc, calleeBase, &callee });
+
+		for (VmValue* p = sp; p < calleeBase + callee.numLocals; ++p)
+			p->obj = nullptr;
+
+		base = calleeBase;
+		sp = base + callee.numLocals;
+		pc = code + callee.codeOffset;
+		NEXT();
+	}
+	TARGET(Return){
+		sp = base;
+		pc = m_frames.back().returnPc;
+		m_frames.pop_back();
+
+		if (m_frames.empty()){
+			result = VmValue::Int(0);
+			return true;
+		}
+
+		base = m_frames.back().base;
+		NEXT();
+	}
+	TARGET(ReturnValue){
+		base[0] = sp[-1];
+		sp = base + 1;
+		pc = m_frames.back().returnPc;
+		m_frames.pop_back();
+
+		if (m_frames.empty()){
+			result = base[0];
+			return true;
+		}
+
+		base = m_frames.back().base;
+		NEXT();
+	}
+	TARGET(Pop){
+		--sp;
+		NEXT();
+	}
+
+#ifndef VM_COMPUTED_GOTO
+	default:
+		error = "Invalid instruction";
+		goto runtime_error;
+	}
+#endif
+
+#undef TARGET
+#undef NEXT
+
+runtime_error:
+	m_error = std::string(error) + " in function '" + m_frames.back().function->name + "'.";
+	m_frames.clear();
+	return false;
+}
+
+#pragma warning (pop)
\ No newline at end of file
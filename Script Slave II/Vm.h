@@ -0,0 +1,357 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include "ASTNode.h"
+
+//Instructions of the embedded virtual machine, see VmCompiler for how they are generated.
+//X(name, number of operands, change of the stack depth)
+//Array accesses come in one variant per element size, 32 bit for ints and floats, 8 bit for bools and Ref for
+//pointers. The Unchecked variants skip the null and bounds checks for subscripts proven by ArrayBoundsAnalysis.
+//Fields of class instances are addressed by their byte offset, with the same size variants as array elements.
+#define VM_OPS(X)			\
+	X(PushInt, 1, 1)		\
+	X(PushFloat, 1, 1)		\
+	X(PushString, 1, 1)		\
+	X(PushNull, 0, 1)		\
+							\
+	X(Load, 1, 1)			\
+	X(Store, 1, -1)			\
+	X(LoadGlobal, 1, 1)		\
+	X(StoreGlobal, 1, -1)	\
+							\
+	X(IAdd, 0, -1)			\
+	X(ISub, 0, -1)			\
+	X(IMul, 0, -1)			\
+	X(IDiv, 0, -1)			\
+	X(IMod, 0, -1)			\
+	X(INeg, 0, 0)			\
+	X(FAdd, 0, -1)			\
+	X(FSub, 0, -1)			\
+	X(FMul, 0, -1)			\
+	X(FDiv, 0, -1)			\
+	X(FNeg, 0, 0)			\
+	X(Not, 0, 0)			\
+	X(And, 0, -1)			\
+	X(Or, 0, -1)			\
+	X(Xor, 0, -1)			\
+							\
+	X(ICmpEq, 0, -1)		\
+	X(ICmpNe, 0, -1)		\
+	X(ICmpLt, 0, -1)		\
+	X(ICmpLe, 0, -1)		\
+	X(ICmpGt, 0, -1)		\
+	X(ICmpGe, 0, -1)		\
+	X(FCmpEq, 0, -1)		\
+	X(FCmpNe, 0, -1)		\
+	X(FCmpLt, 0, -1)		\
+	X(FCmpLe, 0, -1)		\
+	X(FCmpGt, 0, -1)		\
+	X(FCmpGe, 0, -1)		\
+	X(SCmpEq, 0, -1)		\
+	X(SCmpNe, 0, -1)		\
+	X(RefEq, 0, -1)			\
+	X(RefNe, 0, -1)			\
+							\
+	X(IntToStr, 0, 0)		\
+	X(FloatToStr, 0, 0)		\
+	X(BoolToStr, 0, 0)		\
+	X(Concat, 0, -1)		\
+							\
+	X(ArrayLength, 0, 0)	\
+	X(ArrayLoad32, 0, -1)	\
+	X(ArrayLoad8, 0, -1)	\
+	X(ArrayLoadRef, 0, -1)	\
+	X(ArrayStore32, 0, -3)	\
+	X(ArrayStore8, 0, -3)	\
+	X(ArrayStoreRef, 0, -3)	\
+	X(ArrayLoad32Unchecked, 0, -1)	\
+	X(ArrayLoad8Unchecked, 0, -1)	\
+	X(ArrayLoadRefUnchecked, 0, -1)	\
+	X(ArrayStore32Unchecked, 0, -3)	\
+	X(ArrayStore8Unchecked, 0, -3)	\
+	X(ArrayStoreRefUnchecked, 0, -3)	\
+							\
+	X(LoadField32, 1, 0)	\
+	X(LoadField8, 1, 0)		\
+	X(LoadFieldRef, 1, 0)	\
+	X(StoreField32, 1, -2)	\
+	X(StoreField8, 1, -2)	\
+	X(StoreFieldRef, 1, -2)	\
+							\
+	X(Jump, 1, 0)			\
+	X(JumpIfFalse, 1, -1)	\
+	X(JumpIfTrue, 1, -1)	\
+	X(Call, 1, 0)			\
+	X(Return, 0, 0)			\
+	X(ReturnValue, 0, -1)	\
+	X(Pop, 0, -1)
+
+#define VM_OP_ENUM(name, operands, stackDelta) name,
+
+enum class VmOp : int{
+	VM_OPS(VM_OP_ENUM)
+	NumOps
+};
+
+#undef VM_OP_ENUM
+
+enum class VmType : unsigned char{
+	Void,
+	Int,
+	Float,
+	Bool,
+	String,
+	Array,
+	Object
+};
+
+//Strings, arrays and class instances are heap objects, the collector has to follow slots of these types.
+inline bool IsReference(VmType type){
+	return type == VmType::String || type == VmType::Array || type == VmType::Object;
+}
+
+//Instructions which allocate may collect garbage, while a call runs its callers are scanned at their Call. The
+//compiler records a stack map for each of them.
+inline bool IsSafepoint(VmOp op){
+	return op == VmOp::IntToStr || op == VmOp::FloatToStr || op == VmOp::BoolToStr || op == VmOp::Concat || op == VmOp::Call;
+}
+
+class VmObject;
+
+//Untagged value, the compiler knows the type of every slot. Bools are stored as int 0 or 1.
+union VmValue{
+	int i;
+	float f;
+	VmObject* obj;
+
+	static VmValue Int(int value){ VmValue v; v.obj = nullptr; v.i = value; return v; }
+	static VmValue Float(float value){ VmValue v; v.obj = nullptr; v.f = value; return v; }
+	static VmValue Bool(bool value){ return Int(value ? 1 : 0); }
+	static VmValue Object(VmObject* value){ VmValue v; v.obj = value; return v; }
+};
+
+class VmObject{
+public:
+	enum Kind{
+		STRING,
+		ARRAY,
+		INSTANCE
+	};
+
+	const Kind kind;
+	bool marked;
+
+	VmObject(Kind kind) : kind(kind), marked(false) {}
+	virtual ~VmObject(){}
+};
+
+class VmString : public VmObject{
+public:
+	std::string value;
+
+	VmString(std::string value) : VmObject(STRING), value(std::move(value)) {}
+};
+
+//Fixed length array. The elements are stored unboxed right behind the header, 4 bytes for ints and floats, 1 byte
+//for bools and a pointer for strings, arrays and objects. Created by Vm::NewArray().
+class VmArray : public VmObject{
+public:
+	const VmType elemType;
+	const int length;
+
+	static VmArray* Create(VmType elemType, int length);
+
+	//Bytes per element
+	static size_t GetElemSize(VmType elemType);
+
+	bool HasReferences() const {
+		return IsReference(elemType);
+	}
+
+	//int, float, unsigned char or VmObject*, depending on elemType
+	template<class T>
+	T* GetData(){
+		return (T*) (this + 1);
+	}
+
+	//Create() allocates the header and the elements in one block
+	void operator delete(void* p){
+		::operator delete(p);
+	}
+
+private:
+	VmArray(VmType elemType, int length) : VmObject(ARRAY), elemType(elemType), length(length) {}
+};
+
+//Class of the script. Its fields have the offsets and sizes ClassLayout gave them in TypeInfo::fields.
+class VmClass{
+public:
+	struct Field{
+		std::string name;
+		VmType type;
+		int offset;
+	};
+
+	std::string name;
+	size_t size;					//Of the fields, see TypeInfo::size
+	std::vector<Field> fields;		//Ordered by offset
+	std::vector<int> references;	//Offsets of the fields the collector follows
+
+	//Returns nullptr if the class has no field with this name.
+	Field const* FindField(const std::string& fieldName) const {
+		for (const auto& field : fields)
+			if (field.name == fieldName)
+				return &field;
+		return nullptr;
+	}
+};
+
+//Object of a script class. The fields are stored unboxed right behind the header like the elements of a VmArray,
+//at the offsets of the class. Created by Vm::NewInstance().
+class VmInstance : public VmObject{
+public:
+	const VmClass* const cls;
+
+	static VmInstance* Create(const VmClass* cls);
+
+	//int, float, unsigned char or VmObject*, depending on the type of the field
+	template<class T>
+	T& GetField(int offset){
+		return *(T*) ((unsigned char*) (this + 1) + offset);
+	}
+
+	//Create() allocates the header and the fields in one block
+	void operator delete(void* p){
+		::operator delete(p);
+	}
+
+private:
+	VmInstance(const VmClass* cls) : VmObject(INSTANCE), cls(cls) {}
+};
+
+class VmFunction{
+public:
+	std::string name;
+	int codeOffset;
+	int numParams;
+	int numLocals;			//Including the parameters
+	std::vector<VmType> localTypes;	//Of the parameters and locals, every local variable has a slot of its own
+	int maxStack;			//Operand stack slots needed on top of the locals
+	VmType retType;
+	std::vector<VmType> paramTypes;
+};
+
+//Everything the VM needs to run a script. Created by VmCompiler, never changed by the VM.
+class VmProgram{
+public:
+	std::vector<int> code;
+	std::vector<VmFunction> functions;
+	std::vector<VmType> globals;
+	std::vector<VmClass> classes;
+	//Code offset of the instructions which may run the collector, directly or in a call -> types of the operand stack
+	//slots of the function when they start.
+	std::unordered_map<int, std::vector<VmType>> stackMaps;
+	std::vector<std::unique_ptr<VmString>> strings;		//String constants, never collected. strings[0] is always "".
+	std::unordered_map<FuncDef const*, int> functionIndices;
+
+	//Returns -1 if there is no function with this name.
+	int FindFunction(const std::string& name) const {
+		for (size_t i = 0; i < functions.size(); ++i)
+			if (functions[i].name == name)
+				return (int) i;
+		return -1;
+	}
+
+	//Returns -1 if there is no class with this name.
+	int FindClass(const std::string& name) const {
+		for (size_t i = 0; i < classes.size(); ++i)
+			if (classes[i].name == name)
+				return (int) i;
+		return -1;
+	}
+
+	int GetFunctionIndex(FuncDef const* funcDef) const {
+		auto it = functionIndices.find(funcDef);
+		return it == functionIndices.end() ? -1 : it->second;
+	}
+};
+
+/*
+	Stack based interpreter for programs created by VmCompiler. Starting a call only sets up a frame on the preallocated
+	stack, so a host can call script functions from C++ with next to no overhead.
+
+	Strings, arrays and class instances live on the VM's heap. Once it has doubled since the last collection, the
+	next call or the next instruction which allocates collects it. The values on the stack are untagged, so VmCompiler
+	records the types of every function's locals and of the operand stack slots at these instructions, and the
+	collector follows exactly the slots which hold references. Objects returned by Call() stay valid until the next
+	call.
+*/
+class Vm{
+public:
+
+	//Calls function 'index' of the program. Returns false if a runtime error occured, see GetError().
+	bool Call(int index, const std::vector<VmValue>& args, VmValue& result);
+
+	bool Call(FuncDef const* funcDef, const std::vector<VmValue>& args, VmValue& result){
+		return Call(m_program.GetFunctionIndex(funcDef), args, result);
+	}
+
+	VmString* NewString(std::string value);
+	//The elements start as 0, 0.0, false, "" or null. 'length' must be below INT_MAX.
+	VmArray* NewArray(VmType elemType, size_t length);
+	//Instance of class 'classIndex' of the program, the fields start like the elements of a new array.
+	VmInstance* NewInstance(int classIndex);
+
+	//Frees every heap object which is not reachable from the globals or 'roots'.
+	void CollectGarbage(const std::vector<VmObject*>& roots = std::vector<VmObject*>());
+
+	size_t GetHeapSize() const {
+		return m_heap.size();
+	}
+
+	const std::string& GetError() const {
+		return m_error;
+	}
+
+	const VmProgram& GetProgram() const {
+		return m_program;
+	}
+
+	VmValue GetGlobal(int index) const {
+		return m_globals[index];
+	}
+
+	void SetGlobal(int index, VmValue value){
+		m_globals[index] = value;
+	}
+
+	Vm(const VmProgram& program, size_t stackSize = 256 * 1024, size_t maxCallDepth = 4096);
+
+private:
+	struct Frame{
+		const int* returnPc;
+		VmValue* base;
+		const VmFunction* function;
+	};
+
+	bool Run(const VmFunction& entry, VmValue& result);
+
+	//Collects from inside Run(), the frames are roots as well. 'pc' points behind the opcode of the instruction
+	//which allocates. Returns false if one of the frames is at an instruction without a stack map.
+	bool CollectInCall(const int* pc);
+
+	void Mark(VmObject* obj);
+
+	const VmProgram& m_program;
+	std::vector<VmValue> m_stack;
+	std::vector<Frame> m_frames;
+	size_t m_maxCallDepth;
+	std::vector<VmValue> m_globals;
+	std::vector<std::unique_ptr<VmObject>> m_heap;
+	std::vector<VmObject*> m_markStack;	//Marked objects whose references still have to be marked
+	size_t m_gcThreshold;		//Heap size which triggers a collection at the start of the next call or allocation
+	std::string m_error;
+};
\ No newline at end of file
@@ -0,0 +1,645 @@
+#include "VmCompiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include "ArrayBoundsAnalysis.h"
+#include "BaseVisitor.h"
+#include "ClassLayout.h"
+#include "SymbolScope.h"
+#include "Util.h"
+
+#define VM_STACK_DELTA(name, operands, stackDelta) stackDelta,
+#define VM_NUM_OPERANDS(name, operands, stackDelta) operands,
+
+static const int g_stackDeltas[] = {
+	VM_OPS(VM_STACK_DELTA)
+};
+
+static const int g_numOperands[] = {
+	VM_OPS(VM_NUM_OPERANDS)
+};
+
+#undef VM_STACK_DELTA
+#undef VM_NUM_OPERANDS
+
+static_assert(sizeof(g_stackDeltas) / sizeof(g_stackDeltas[0]) == (size_t) VmOp::NumOps, "g_stackDeltas does not match VmOp");
+static_assert(sizeof(g_numOperands) / sizeof(g_numOperands[0]) == (size_t) VmOp::NumOps, "g_numOperands does not match VmOp");
+static_assert(ClassLayout::REFERENCE_SIZE == sizeof(VmObject*), "VmInstances store their fields at the offsets of ClassLayout");
+
+//Maps the types of the type table to VM types, so types can be compared without string comparisons.
+struct VmTypes{
+	TypeInfo const* voidType;
+	TypeInfo const* intType;
+	TypeInfo const* floatType;
+	TypeInfo const* boolType;
+	TypeInfo const* stringType;
+
+	VmTypes(const TypeTable& tt)
+		: voidType(tt.Get("void")), intType(tt.Get("int")), floatType(tt.Get("float")),
+		boolType(tt.Get("bool")), stringType(tt.Get("string"))
+	{}
+
+	VmType Get(TypeInfo const* ti) const {
+		if (ti == nullptr)			return VmType::Void;
+		if (ti->isArray)			return VmType::Array;
+		if (ti == voidType)			return VmType::Void;
+		if (ti == intType)			return VmType::Int;
+		if (ti == floatType)		return VmType::Float;
+		if (ti == boolType)			return VmType::Bool;
+		if (ti == stringType)		return VmType::String;
+		return VmType::Object;
+	}
+};
+
+class VmCodeWalker : public BaseVisitor{
+public:
+
+	void CompileFunction(FuncDef* n, VmFunction& function){
+		m_locals.clear();
+		m_localTypes.clear();
+		m_numLocals = 0;
+		m_currStackDepth = 0;
+		m_maxStackDepth = 0;
+		m_stackTypes.clear();
+		m_bounds.Process(n);
+
+		for (const auto& param : n->GetParamList()->GetChildren()){
+			m_locals[param.get()] = m_numLocals++;
+			m_localTypes.push_back(m_types.Get(param->GetType()->GetTypeInfo()));
+		}
+
+		function.codeOffset = m_program.code.size();
+
+		ACCEPT(GetStmtBlock(), true);
+
+		//Functions without a return statement at the end return the default value of their return type
+		const auto& stmts = n->GetStmtBlock()->GetChildren();
+		if (stmts.empty() || stmts.back()->GetNodeType() != NodeType::StmtReturn){
+			if (function.retType == VmType::Void)
+				Emit(VmOp::Return);
+			else{
+				PushDefault(function.retType);
+				Emit(VmOp::ReturnValue);
+			}
+		}
+
+		function.numLocals = m_numLocals;
+		function.localTypes = m_localTypes;
+		function.maxStack = m_maxStackDepth;
+	}
+
+	//STATEMENTS
+	virtual void visit(StmtVarDecl* n, bool last){
+		int slot = m_numLocals++;
+		m_locals[n] = slot;
+		m_localTypes.push_back(m_types.Get(n->GetType()->GetTypeInfo()));
+
+		if (n->GetExpr())
+			GenExpr(n->GetExpr());
+		else
+			PushDefault(m_types.Get(n->GetType()->GetTypeInfo()));
+
+		Emit(VmOp::Store, slot);
+	}
+
+	virtual void visit(StmtAssign* n, bool last){
+		Expr* lhs = n->GetLHS();
+
+		if (lhs->GetNodeType() == NodeType::Ident){
+			Ident* ident = (Ident*) lhs;
+			Symbol const* sym = ident->GetSymbol();
+
+			GenExpr(n->GetExpr());
+
+			if (sym->type == Symbol::GLOBAL_VAR)
+				Emit(VmOp::StoreGlobal, m_globals.at(sym->GetNode()));
+			else if (sym->type == Symbol::VARIABLE || sym->type == Symbol::PARAMETER)
+				Emit(VmOp::Store, m_locals.at(sym->GetNode()));
+			else
+				AddError(lhs->GetToken(), "Assignment to '%s' is not supported by the VM.", ident->GetName().c_str());
+			return;
+		}
+
+		if (lhs->GetNodeType() == NodeType::BinOp && ((BinOp*) lhs)->GetType() == BinOp::Subscript){
+			BinOp* subscript = (BinOp*) lhs;
+
+			GenExpr(subscript->GetLeft());
+			GenExpr(subscript->GetRight());
+			GenExpr(n->GetExpr());
+			EmitArrayAccess(subscript, true);
+			return;
+		}
+
+		if (lhs->GetNodeType() == NodeType::BinOp && ((BinOp*) lhs)->GetType() == BinOp::MemberAccess){
+			BinOp* access = (BinOp*) lhs;
+
+			GenExpr(access->GetLeft());
+			GenExpr(n->GetExpr());
+			EmitFieldAccess(access, true);
+			return;
+		}
+
+		AddError(lhs->GetToken(), "Assignment target is not supported by the VM.");
+	}
+
+	virtual void visit(StmtFuncCall* n, bool last){
+		GenCall(n->GetName(), n->GetArgList());
+
+		if (n->GetName()->GetSymbol()->GetTypeInfo() != m_types.voidType)
+			Emit(VmOp::Pop);
+	}
+
+	virtual void visit(StmtReturn* n, bool last){
+		if (n->GetExpr() == nullptr){
+			Emit(VmOp::Return);
+			return;
+		}
+
+		GenExpr(n->GetExpr());
+		Emit(VmOp::ReturnValue);
+	}
+
+	virtual void visit(StmtBreak* n, bool last){
+		m_breakJumps.back().push_back(EmitJump(VmOp::Jump));
+	}
+
+	virtual void visit(StmtWhile* n, bool last){
+		const int start = m_program.code.size();
+
+		//No jump is emitted for while(true), it is only left through a break
+		std::vector<int> exitJumps;
+		GenCondJump(n->GetExpr(), false, exitJumps);
+
+		m_breakJumps.emplace_back();
+		ACCEPT(GetBody(), true);
+
+		Emit(VmOp::Jump, start);
+		for (int jump : exitJumps)
+			PatchJump(jump);
+		for (int jump : m_breakJumps.back())
+			PatchJump(jump);
+		m_breakJumps.pop_back();
+	}
+
+	virtual void visit(StmtIfThen* n, bool last){
+		std::vector<int> skipJumps;
+		GenCondJump(n->GetExpr(), false, skipJumps);
+
+		ACCEPT(GetThen(), true);
+
+		for (int jump : skipJumps)
+			PatchJump(jump);
+	}
+
+	virtual void visit(StmtIfThenElse* n, bool last){
+		std::vector<int> elseJumps;
+		GenCondJump(n->GetExpr(), false, elseJumps);
+
+		ACCEPT(GetThen(), true);
+		const int endJump = EmitJump(VmOp::Jump);
+		for (int jump : elseJumps)
+			PatchJump(jump);
+
+		ACCEPT(GetElse(), true);
+		PatchJump(endJump);
+	}
+
+	VmCodeWalker(VmProgram& program, const VmTypes& types, const std::unordered_map<ASTNode const*, int>& globals,
+		std::vector<std::pair<std::string, Token>>& errors)
+		: m_program(program), m_types(types), m_globals(globals), m_errors(errors)
+	{
+		//strings[0] is used for default values
+		GetStringIndex("");
+	}
+
+	int GetNumArrayAccesses() const {
+		return m_numArrayAccesses;
+	}
+
+	int GetNumUnchecked() const {
+		return m_numUnchecked;
+	}
+
+private:
+
+	//EXPRESSIONS
+	//Every expression leaves one value of its type on the stack, the stack maps record which of them are references.
+	void GenExpr(Expr* p){
+		GenValue(p);
+
+		const VmType type = m_types.Get(p->GetTypeInfo());
+		if (type != VmType::Void && !m_stackTypes.empty())
+			m_stackTypes.back() = type;
+	}
+
+	void GenValue(Expr* p){
+		switch (p->GetNodeType()){
+		case NodeType::IntLit:
+			Emit(VmOp::PushInt, ((IntLit*) p)->GetValue());
+			return;
+		case NodeType::FloatLit:
+			PushFloat(((FloatLit*) p)->GetValue());
+			return;
+		case NodeType::BoolLit:
+			Emit(VmOp::PushInt, ((BoolLit*) p)->GetValue() ? 1 : 0);
+			return;
+		case NodeType::StringLit:
+			Emit(VmOp::PushString, GetStringIndex(unquote_string_literal(((StringLit*) p)->GetValue())));
+			return;
+		case NodeType::Ident:
+			Load((Ident*) p);
+			return;
+		case NodeType::UnOp:
+		{
+			UnOp* n = (UnOp*) p;
+			GenExpr(n->GetExpr());
+
+			if (n->GetType() == UnOp::Not)
+				Emit(VmOp::Not);
+			else if (n->GetExpr()->GetTypeInfo() == m_types.floatType)
+				Emit(VmOp::FNeg);
+			else
+				Emit(VmOp::INeg);
+			return;
+		}
+		case NodeType::BinOp:
+			GenBinOp((BinOp*) p);
+			return;
+		case NodeType::FuncCallExpr:
+		{
+			FuncCallExpr* n = (FuncCallExpr*) p;
+			GenCall(n->GetCallee(), n->GetArgs());
+			return;
+		}
+		default:
+			AddError(p->GetToken(), "Expression '%s' is not supported by the VM.", p->GetNodeAsString().c_str());
+			return;
+		}
+	}
+
+	void GenBinOp(BinOp* n){
+		const VmType lt = m_types.Get(n->GetLeft()->GetTypeInfo());
+		const bool isFloat = lt == VmType::Float;
+
+		if (n->GetType() == BinOp::Add && n->GetTypeInfo() == m_types.stringType){
+			GenStringOperand(n->GetLeft());
+			GenStringOperand(n->GetRight());
+			Emit(VmOp::Concat);
+			return;
+		}
+
+		if (n->GetType() == BinOp::And || n->GetType() == BinOp::Or){
+			//Materialize the result of the short-circuit evaluation as 0 or 1
+			std::vector<int> falseJumps;
+			GenCondJump(n, false, falseJumps);
+			Emit(VmOp::PushInt, 1);
+			const int endJump = EmitJump(VmOp::Jump);
+			for (int jump : falseJumps)
+				PatchJump(jump);
+			Emit(VmOp::PushInt, 0);
+			PatchJump(endJump);
+			IncStackDepth(-1); //Only one of the two constants is pushed at runtime
+			return;
+		}
+
+		if (n->GetType() == BinOp::MemberAccess && lt == VmType::Array){
+			GenExpr(n->GetLeft());
+			Emit(VmOp::ArrayLength);
+			return;
+		}
+
+		if (n->GetType() == BinOp::MemberAccess){
+			GenExpr(n->GetLeft());
+			EmitFieldAccess(n, false);
+			return;
+		}
+
+		GenExpr(n->GetLeft());
+		GenExpr(n->GetRight());
+
+		switch (n->GetType()){
+		case BinOp::Add:		Emit(isFloat ? VmOp::FAdd : VmOp::IAdd); return;
+		case BinOp::Sub:		Emit(isFloat ? VmOp::FSub : VmOp::ISub); return;
+		case BinOp::Mul:		Emit(isFloat ? VmOp::FMul : VmOp::IMul); return;
+		case BinOp::Div:		Emit(isFloat ? VmOp::FDiv : VmOp::IDiv); return;
+		case BinOp::Mod:		Emit(VmOp::IMod); return;
+		case BinOp::Xor:		Emit(VmOp::Xor); return;
+		case BinOp::Subscript:	EmitArrayAccess(n, false); return;
+		case BinOp::LThan:		Emit(isFloat ? VmOp::FCmpLt : VmOp::ICmpLt); return;
+		case BinOp::LThanEq:	Emit(isFloat ? VmOp::FCmpLe : VmOp::ICmpLe); return;
+		case BinOp::GThan:		Emit(isFloat ? VmOp::FCmpGt : VmOp::ICmpGt); return;
+		case BinOp::GThanEq:	Emit(isFloat ? VmOp::FCmpGe : VmOp::ICmpGe); return;
+		case BinOp::Equal:
+		case BinOp::Unequal:
+		{
+			const bool equal = n->GetType() == BinOp::Equal;
+			if (lt == VmType::Int || lt == VmType::Bool)
+				Emit(equal ? VmOp::ICmpEq : VmOp::ICmpNe);
+			else if (lt == VmType::Float)
+				Emit(equal ? VmOp::FCmpEq : VmOp::FCmpNe);
+			else if (lt == VmType::String)
+				Emit(equal ? VmOp::SCmpEq : VmOp::SCmpNe);
+			else
+				Emit(equal ? VmOp::RefEq : VmOp::RefNe);
+			return;
+		}
+		default:
+			AddError(n->GetToken(), "Operation '%s' is not supported by the VM.", BinOp::GetTypeAsString(n->GetType()));
+			return;
+		}
+	}
+
+	//Emits jumps which are taken if p evaluates to 'jumpIf' and adds them to 'jumps', the caller patches them once
+	//the target is known. && and || skip their right operand if the left one decides the result.
+	void GenCondJump(Expr* p, bool jumpIf, std::vector<int>& jumps){
+		if (p->GetNodeType() == NodeType::BoolLit){
+			if (((BoolLit*) p)->GetValue() == jumpIf)
+				jumps.push_back(EmitJump(VmOp::Jump));
+			return;
+		}
+
+		if (p->GetNodeType() == NodeType::UnOp && ((UnOp*) p)->GetType() == UnOp::Not){
+			GenCondJump(((UnOp*) p)->GetExpr(), !jumpIf, jumps);
+			return;
+		}
+
+		if (p->GetNodeType() == NodeType::BinOp && (((BinOp*) p)->GetType() == BinOp::And || ((BinOp*) p)->GetType() == BinOp::Or)){
+			BinOp* n = (BinOp*) p;
+			const bool decidingValue = n->GetType() == BinOp::Or; //false decides &&, true decides ||
+
+			if (decidingValue == jumpIf){
+				GenCondJump(n->GetLeft(), jumpIf, jumps);
+				GenCondJump(n->GetRight(), jumpIf, jumps);
+			}
+			else{
+				std::vector<int> skipJumps;
+				GenCondJump(n->GetLeft(), decidingValue, skipJumps);
+				GenCondJump(n->GetRight(), jumpIf, jumps);
+				for (int jump : skipJumps)
+					PatchJump(jump);
+			}
+			return;
+		}
+
+		GenExpr(p);
+		jumps.push_back(EmitJump(jumpIf ? VmOp::JumpIfTrue : VmOp::JumpIfFalse));
+	}
+
+	//Pushes the value of p converted to a string
+	void GenStringOperand(Expr* p){
+		GenExpr(p);
+
+		switch (m_types.Get(p->GetTypeInfo())){
+		case VmType::String:	return;
+		case VmType::Int:		Emit(VmOp::IntToStr); break;
+		case VmType::Float:		Emit(VmOp::FloatToStr); break;
+		case VmType::Bool:		Emit(VmOp::BoolToStr); break;
+		default:
+			AddError(p->GetToken(), "Values of type '%s' can not be converted to a string by the VM.", p->GetTypeInfo()->name.c_str());
+			return;
+		}
+
+		m_stackTypes.back() = VmType::String;
+	}
+
+	void GenCall(Ident* callee, ArgList* args){
+		Symbol const* sym = callee->GetSymbol();
+
+		if (sym->type != Symbol::FUNCTION){
+			AddError(callee->GetToken(), "Symbol '%s' is not a function.", sym->name.c_str());
+			return;
+		}
+
+		for (const auto& arg : args->GetChildren())
+			GenExpr(arg.get());
+
+		const int index = m_program.functionIndices.at((FuncDef const*) sym->GetNode());
+		const VmFunction& function = m_program.functions[index];
+
+		Emit(VmOp::Call, index);
+		IncStackDepth((function.retType == VmType::Void ? 0 : 1) - function.numParams);
+	}
+
+	//The object and for stores the value are on the stack.
+	void EmitFieldAccess(BinOp* access, bool store){
+		//[store][32 bit, 8 bit, reference]
+		static const VmOp ops[2][3] = {
+			{ VmOp::LoadField32, VmOp::LoadField8, VmOp::LoadFieldRef },
+			{ VmOp::StoreField32, VmOp::StoreField8, VmOp::StoreFieldRef }
+		};
+
+		Ident* member = (Ident*) access->GetRight();
+		if (member->GetFieldOffset() < 0){
+			AddError(member->GetToken(), "Class '%s' has no member '%s'.", access->GetLeft()->GetTypeInfo()->name.c_str(), member->GetName().c_str());
+			return;
+		}
+
+		int size;
+		switch (m_types.Get(access->GetTypeInfo())){
+		case VmType::Int:
+		case VmType::Float:		size = 0; break;
+		case VmType::Bool:		size = 1; break;
+		default:				size = 2; break;
+		}
+
+		Emit(ops[store][size], member->GetFieldOffset());
+	}
+
+	void Load(Ident* n){
+		Symbol const* sym = n->GetSymbol();
+
+		if (sym->type == Symbol::GLOBAL_VAR)
+			Emit(VmOp::LoadGlobal, m_globals.at(sym->GetNode()));
+		else if (sym->type == Symbol::VARIABLE || sym->type == Symbol::PARAMETER)
+			Emit(VmOp::Load, m_locals.at(sym->GetNode()));
+		else
+			AddError(n->GetToken(), "Symbol '%s' can not be used as a value by the VM.", n->GetName().c_str());
+	}
+
+	void PushDefault(VmType type){
+		switch (type){
+		case VmType::Int:
+		case VmType::Bool:		Emit(VmOp::PushInt, 0); return;
+		case VmType::Float:		PushFloat(0.0f); return;
+		case VmType::String:	Emit(VmOp::PushString, 0); return;
+		default:				Emit(VmOp::PushNull); return;
+		}
+	}
+
+	void PushFloat(float f){
+		int bits;
+		memcpy(&bits, &f, sizeof(bits));
+		Emit(VmOp::PushFloat, bits);
+	}
+
+	//Emits the load or store for the element type of 'subscript', without checks if ArrayBoundsAnalysis proved it
+	//to be in bounds.
+	void EmitArrayAccess(BinOp* subscript, bool store){
+		//[store][unchecked][32 bit, 8 bit, reference]
+		static const VmOp ops[2][2][3] = {
+			{
+				{ VmOp::ArrayLoad32, VmOp::ArrayLoad8, VmOp::ArrayLoadRef },
+				{ VmOp::ArrayLoad32Unchecked, VmOp::ArrayLoad8Unchecked, VmOp::ArrayLoadRefUnchecked }
+			},
+			{
+				{ VmOp::ArrayStore32, VmOp::ArrayStore8, VmOp::ArrayStoreRef },
+				{ VmOp::ArrayStore32Unchecked, VmOp::ArrayStore8Unchecked, VmOp::ArrayStoreRefUnchecked }
+			}
+		};
+
+		int size;
+		switch (m_types.Get(subscript->GetTypeInfo())){
+		case VmType::Int:
+		case VmType::Float:		size = 0; break;
+		case VmType::Bool:		size = 1; break;
+		default:				size = 2; break;
+		}
+
+		const bool unchecked = m_bounds.IsInBounds(subscript);
+		Emit(ops[store][unchecked][size]);
+
+		++m_numArrayAccesses;
+		if (unchecked)
+			++m_numUnchecked;
+	}
+
+	void Emit(VmOp op){
+		if (IsSafepoint(op))
+			m_program.stackMaps[m_program.code.size()] = m_stackTypes;
+
+		m_program.code.push_back((int) op);
+		IncStackDepth(g_stackDeltas[(int) op]);
+	}
+
+	void Emit(VmOp op, int operand){
+		Emit(op);
+		m_program.code.push_back(operand);
+	}
+
+	//Emits a jump with an unknown target and returns the position of its operand for PatchJump().
+	int EmitJump(VmOp op){
+		Emit(op, -1);
+		return m_program.code.size() - 1;
+	}
+
+	//Lets the jump at 'operand' jump to the current end of the code.
+	void PatchJump(int operand){
+		m_program.code[operand] = m_program.code.size();
+	}
+
+	int GetStringIndex(const std::string& str){
+		auto it = m_stringIndices.find(str);
+		if (it != m_stringIndices.end())
+			return it->second;
+
+		int index = m_program.strings.size();
+		m_program.strings.push_back(std::make_unique<VmString>(str));
+		m_stringIndices.emplace(str, index);
+		return index;
+	}
+
+	//New slots hold no reference until GenExpr() sets the type of the value.
+	void IncStackDepth(int amount){
+		m_currStackDepth += amount;
+		m_maxStackDepth = std::max(m_maxStackDepth, m_currStackDepth);
+		m_stackTypes.resize(std::max(m_currStackDepth, 0), VmType::Void);
+	}
+
+	void AddError(const Token& tok, const std::string fmt_str, ...){
+		va_list ap;
+		va_start(ap, fmt_str);
+		std::string v = va_string_format(fmt_str, ap);
+		m_errors.emplace_back(v, tok);
+		va_end(ap);
+	}
+
+	VmProgram& m_program;
+	const VmTypes& m_types;
+	const std::unordered_map<ASTNode const*, int>& m_globals;	//Declaration node of global variables -> global index
+	std::vector<std::pair<std::string, Token>>& m_errors;
+	std::unordered_map<std::string, int> m_stringIndices;
+
+	std::unordered_map<ASTNode const*, int> m_locals;	//Declaration node of parameters and local variables -> local index
+	std::vector<VmType> m_localTypes;
+	std::vector<VmType> m_stackTypes;					//Of the values on the operand stack at the end of the code
+	std::vector<std::vector<int>> m_breakJumps;			//Jumps of break statements of the enclosing while loops
+	ArrayBoundsAnalysis m_bounds;
+	int m_numArrayAccesses = 0;
+	int m_numUnchecked = 0;
+	int m_numLocals;
+	int m_currStackDepth;
+	int m_maxStackDepth;
+};
+
+
+bool VmCompiler::Compile( StartBlockPtr& node, const TypeTable& typeTable, VmProgram& program ){
+	program = VmProgram();
+	m_errors.clear();
+
+	VmTypes types(typeTable);
+	std::unordered_map<ASTNode const*, int> globals;
+
+	//Register all globals and functions first, functions may be called before their definition.
+	for (const auto& stmt : node->GetChildren()){
+		if (stmt->GetNodeType() == NodeType::GlobVarDef){
+			GlobVarDef* n = (GlobVarDef*) stmt.get();
+			globals[n] = program.globals.size();
+			program.globals.push_back(types.Get(n->GetType()->GetTypeInfo()));
+		}
+		else if (stmt->GetNodeType() == NodeType::ClassDef){
+			TypeInfo const* ti = typeTable.Get(((ClassDef*) stmt.get())->GetName()->GetName());
+			VmClass cls;
+			cls.name = ti->name;
+			cls.size = ti->size;
+
+			for (const auto& field : ti->fields){
+				VmClass::Field vmField = { field.name, types.Get(field.type), (int) field.offset };
+				cls.fields.push_back(vmField);
+				if (IsReference(vmField.type))
+					cls.references.push_back(vmField.offset);
+			}
+
+			program.classes.push_back(std::move(cls));
+		}
+		else if (stmt->GetNodeType() == NodeType::FuncDef){
+			FuncDef* n = (FuncDef*) stmt.get();
+			VmFunction function;
+			function.name = n->GetName()->GetName();
+			function.codeOffset = 0;
+			function.numParams = n->GetParamList()->GetChildren().size();
+			function.numLocals = function.numParams;
+			function.maxStack = 0;
+			function.retType = types.Get(n->GetRetType()->GetTypeInfo());
+
+			for (const auto& param : n->GetParamList()->GetChildren())
+				function.paramTypes.push_back(types.Get(param->GetType()->GetTypeInfo()));
+
+			program.functionIndices[n] = program.functions.size();
+			program.functions.push_back(std::move(function));
+		}
+	}
+
+	VmCodeWalker cw(program, types, globals, m_errors);
+
+	for (const auto& stmt : node->GetChildren()){
+		if (stmt->GetNodeType() != NodeType::FuncDef)
+			continue;
+
+		FuncDef* n = (FuncDef*) stmt.get();
+		cw.CompileFunction(n, program.functions[program.functionIndices[n]]);
+	}
+
+	m_numArrayAccesses = cw.GetNumArrayAccesses();
+	m_numUnchecked = cw.GetNumUnchecked();
+
+	//The collector can't run at a safepoint without a stack map, every one of them has to be recorded by Emit().
+	if (m_errors.empty()){
+		for (size_t pc = 0; pc < program.code.size(); pc += 1 + g_numOperands[program.code[pc]]){
+			if (IsSafepoint((VmOp) program.code[pc]) && program.stackMaps.count((int) pc) == 0)
+				m_errors.emplace_back("Internal error: instruction " + std::to_string(pc) + " has no stack map.", Token());
+		}
+	}
+
+	return m_errors.empty();
+}
\ No newline at end of file
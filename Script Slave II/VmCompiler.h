@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "ASTNode.h"
+#include "TypeTable.h"
+#include "Vm.h"
+#include "StringUtil.h"
+
+/*
+	Lowers a type checked AST into a program for the embedded virtual machine. Like CodeGen, every function and global
+	variable of the script is translated, class definitions become the VmClasses of the program and member accesses
+	address the fields by the offsets of ClassLayout, which the second pass stored in the member. Array accesses which ArrayBoundsAnalysis proves to be in bounds are compiled
+	without checks.
+
+	The types of each function's locals and the stack maps of the instructions which may collect garbage are recorded
+	for the collector, see Vm.
+*/
+class VmCompiler
+{
+public:
+
+	bool Compile( StartBlockPtr& node, const TypeTable& typeTable, VmProgram& program );
+
+	const std::vector<std::pair<std::string, Token>>& GetErrors() const {
+		return m_errors;
+	}
+
+	//Array loads and stores of the last compiled program.
+	int GetNumArrayAccesses() const {
+		return m_numArrayAccesses;
+	}
+
+	//The part of them compiled without null and bounds checks.
+	int GetNumUnchecked() const {
+		return m_numUnchecked;
+	}
+
+private:
+
+	void AddError(const Token& tok, const std::string fmt_str, ...){
+		va_list ap;
+		va_start(ap, fmt_str);
+		std::string v = va_string_format(fmt_str, ap);
+		m_errors.emplace_back(v, tok);
+		va_end(ap);
+	}
+
+	std::vector<std::pair<std::string, Token>> m_errors;
+	int m_numArrayAccesses = 0;
+	int m_numUnchecked = 0;
+};
\ No newline at end of file
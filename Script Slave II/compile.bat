@@ -1,3 +1,2 @@
 echo off
-java -jar jasmin.jar code.j
 java  -cp . test
\ No newline at end of file